@@ -41,10 +41,50 @@
 #include "sys/param.h"
 #include "esp_system.h"
 #include "esp_efuse.h"
+#include "soc/soc.h"
+#include "mbedtls/sha256.h"
 
 
 #define SUB_TYPE_ID(i) (i & 0x0F)
 
+#define ESP_ROM_CHECKSUM_INITIAL 0xEF
+
+/* Parts of the app image, in the order in which they are checked by ota_verify_data() */
+typedef enum {
+    OTA_VERIFY_IMAGE_HEADER,
+    OTA_VERIFY_SEGMENT_HEADER,
+    OTA_VERIFY_SEGMENT_DATA,
+    OTA_VERIFY_CHECKSUM,        /* padding to a 16 byte block, ending with the checksum byte */
+    OTA_VERIFY_HASH,            /* appended SHA-256 of the image */
+    OTA_VERIFY_DONE,
+    OTA_VERIFY_FAILED,
+} ota_verify_stage_t;
+
+/* State of the verification of an app image as it is written, see ota_verify_data() */
+typedef struct {
+    ota_verify_stage_t stage;
+    uint32_t offset;            /* offset in the image of the next byte */
+    uint32_t stage_start;       /* offset in the image where the current stage starts */
+    uint32_t stage_end;         /* offset in the image where the current stage ends */
+    uint8_t *field;             /* if not NULL, the bytes of the current stage are copied here */
+    uint8_t segment;
+    uint32_t checksum_word;
+    esp_image_header_t image;
+    union {
+        esp_image_segment_header_t segment_header;
+        uint8_t checksum_block[16];
+        uint8_t hash[ESP_IMAGE_HASH_LEN];
+    } fields;
+    mbedtls_sha256_context sha;
+} ota_verify_t;
+
+/* Buffer for OTA_WITH_SEQUENTIAL_WRITES, holding the data of the sector at the write pointer */
+typedef struct {
+    uint32_t buf_len;
+    uint8_t buf[SPI_FLASH_SEC_SIZE];
+    ota_verify_t verify;
+} ota_stream_t;
+
 typedef struct ota_ops_entry_ {
     uint32_t handle;
     const esp_partition_t *part;
@@ -52,6 +92,7 @@ typedef struct ota_ops_entry_ {
     uint32_t wrote_size;
     uint8_t partial_bytes;
     uint8_t partial_data[16];
+    ota_stream_t *stream;       /* only used with OTA_WITH_SEQUENTIAL_WRITES */
     LIST_ENTRY(ota_ops_entry_) entries;
 } ota_ops_entry_t;
 
@@ -60,6 +101,9 @@ static LIST_HEAD(ota_ops_entries_head, ota_ops_entry_) s_ota_ops_entries_head =
 
 static uint32_t s_ota_ops_last_handle = 0;
 
+/* Partition holding the image last verified by esp_ota_end() while it was written */
+static const esp_partition_t *s_ota_verified_part = NULL;
+
 const static char *TAG = "esp_ota_ops";
 
 /* Return true if this is an OTA app partition */
@@ -128,6 +172,226 @@ static esp_ota_img_states_t set_new_state_otadata(void)
 #endif
 }
 
+static bool should_map(uint32_t load_addr)
+{
+    return (load_addr >= SOC_IROM_LOW && load_addr < SOC_IROM_HIGH)
+        || (load_addr >= SOC_DROM_LOW && load_addr < SOC_DROM_HIGH);
+}
+
+static void ota_verify_set_stage(ota_verify_t *v, ota_verify_stage_t stage, uint32_t size, void *field)
+{
+    v->stage = stage;
+    v->stage_start = v->offset;
+    v->stage_end = v->offset + size;
+    v->field = (uint8_t *)field;
+}
+
+static void ota_verify_start(ota_verify_t *v)
+{
+    v->offset = 0;
+    v->segment = 0;
+    v->checksum_word = ESP_ROM_CHECKSUM_INITIAL;
+    ota_verify_set_stage(v, OTA_VERIFY_IMAGE_HEADER, sizeof(esp_image_header_t), &v->image);
+    mbedtls_sha256_init(&v->sha);
+    mbedtls_sha256_starts_ret(&v->sha, false);
+}
+
+/* Checksum the segment data a word at a time, segment data always starts at a word boundary */
+static void ota_verify_checksum(ota_verify_t *v, const uint8_t *data, size_t len)
+{
+    uint32_t offset = v->offset;
+    for (; len > 0 && (offset & 3) != 0; len--, offset++) {
+        v->checksum_word ^= (uint32_t)*data++ << (8 * (offset & 3));
+    }
+    for (; len >= 4; len -= 4, offset += 4, data += 4) {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        v->checksum_word ^= word;
+    }
+    for (; len > 0; len--, offset++) {
+        v->checksum_word ^= (uint32_t)*data++ << (8 * (offset & 3));
+    }
+}
+
+/* Check the part of the image received completely and continue with the next one */
+static esp_err_t ota_verify_next_stage(ota_verify_t *v)
+{
+    switch (v->stage) {
+    case OTA_VERIFY_IMAGE_HEADER:
+        if (v->image.magic != ESP_IMAGE_HEADER_MAGIC) {
+            ESP_LOGE(TAG, "OTA image has invalid magic byte (expected 0xE9, saw 0x%02x)", v->image.magic);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        if (bootloader_common_check_chip_validity(&v->image, ESP_IMAGE_APPLICATION) != ESP_OK) {
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        if (v->image.segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+            ESP_LOGE(TAG, "OTA image segment count %d exceeds max %d", v->image.segment_count, ESP_IMAGE_MAX_SEGMENTS);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        if (v->image.hash_appended) {
+            mbedtls_sha256_update_ret(&v->sha, (const uint8_t *)&v->image, sizeof(esp_image_header_t));
+        }
+        break;
+
+    case OTA_VERIFY_SEGMENT_HEADER: {
+        const esp_image_segment_header_t *header = &v->fields.segment_header;
+        if ((header->data_len & 3) != 0 || header->data_len >= 0x1000000) {
+            ESP_LOGE(TAG, "OTA image segment %d has invalid length 0x%x", v->segment, header->data_len);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        /* Segments mapped via flash cache need the same offset within a 64KB page in flash and in the address space.
+           OTA partitions are 64KB aligned, so the offset in the image can be checked instead of the flash address. */
+        if (should_map(header->load_addr)
+            && (v->offset % SPI_FLASH_MMU_PAGE_SIZE) != (header->load_addr % SPI_FLASH_MMU_PAGE_SIZE)) {
+            ESP_LOGE(TAG, "OTA image segment %d load address 0x%08x doesn't match data offset 0x%08x",
+                     v->segment, header->load_addr, v->offset);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        ESP_LOGD(TAG, "segment %d: offset=0x%08x vaddr=0x%08x size=0x%05x",
+                 v->segment, v->offset, header->load_addr, header->data_len);
+        ota_verify_set_stage(v, OTA_VERIFY_SEGMENT_DATA, header->data_len, NULL);
+        return ESP_OK;
+    }
+
+    case OTA_VERIFY_SEGMENT_DATA:
+        v->segment++;
+        break;
+
+    case OTA_VERIFY_CHECKSUM: {
+        uint8_t checksum = (v->checksum_word >> 24)
+            ^ (v->checksum_word >> 16)
+            ^ (v->checksum_word >> 8)
+            ^ (v->checksum_word >> 0);
+        uint8_t calc = v->fields.checksum_block[v->stage_end - v->stage_start - 1];
+        if (checksum != calc) {
+            ESP_LOGE(TAG, "OTA image checksum failed. Calculated 0x%x read 0x%x", checksum, calc);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        if (v->image.hash_appended) {
+            ota_verify_set_stage(v, OTA_VERIFY_HASH, ESP_IMAGE_HASH_LEN, v->fields.hash);
+        } else {
+            ota_verify_set_stage(v, OTA_VERIFY_DONE, 0, NULL);
+        }
+        return ESP_OK;
+    }
+
+    case OTA_VERIFY_HASH: {
+        uint8_t image_hash[ESP_IMAGE_HASH_LEN];
+        mbedtls_sha256_finish_ret(&v->sha, image_hash);
+        if (memcmp(image_hash, v->fields.hash, ESP_IMAGE_HASH_LEN) != 0) {
+            ESP_LOGE(TAG, "OTA image hash failed - image is corrupt");
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        ota_verify_set_stage(v, OTA_VERIFY_DONE, 0, NULL);
+        return ESP_OK;
+    }
+
+    default:
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    // After the image header or the data of a segment
+    if (v->segment < v->image.segment_count) {
+        ota_verify_set_stage(v, OTA_VERIFY_SEGMENT_HEADER, sizeof(esp_image_segment_header_t), &v->fields.segment_header);
+    } else {
+        // Add a byte for the checksum and pad to the next full 16 byte block
+        uint32_t end = (v->offset + 1 + 15) & ~15;
+        ota_verify_set_stage(v, OTA_VERIFY_CHECKSUM, end - v->offset, v->fields.checksum_block);
+    }
+    return ESP_OK;
+}
+
+/* Verify the next part of an image written with OTA_WITH_SEQUENTIAL_WRITES, making the same checks as
+   esp_image_verify() makes when reading the image back from flash. Data after the end of the image is ignored. */
+static esp_err_t ota_verify_data(ota_verify_t *v, const uint8_t *data, size_t size)
+{
+    while (size > 0 && v->stage < OTA_VERIFY_DONE) {
+        size_t len = MIN(size, v->stage_end - v->offset);
+        if (v->field != NULL) {
+            memcpy(v->field + (v->offset - v->stage_start), data, len);
+        }
+        if (v->stage == OTA_VERIFY_SEGMENT_DATA) {
+            ota_verify_checksum(v, data, len);
+        }
+        if (v->image.hash_appended && v->stage != OTA_VERIFY_IMAGE_HEADER && v->stage != OTA_VERIFY_HASH) {
+            mbedtls_sha256_update_ret(&v->sha, data, len);
+        }
+        v->offset += len;
+        data += len;
+        size -= len;
+
+        while (v->offset == v->stage_end && v->stage < OTA_VERIFY_DONE) {
+            if (ota_verify_next_stage(v) != ESP_OK) {
+                v->stage = OTA_VERIFY_FAILED;
+            }
+        }
+    }
+    return (v->stage == OTA_VERIFY_FAILED) ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+/* Erase the sectors at the write pointer and write them in one burst */
+static esp_err_t ota_write_sectors(ota_ops_entry_t *it, const void *data, size_t size)
+{
+    size_t erase_size = (size + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+    esp_err_t ret = esp_partition_erase_range(it->part, it->wrote_size, erase_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    it->erased_size = it->wrote_size + erase_size;
+
+    ret = esp_partition_write(it->part, it->wrote_size, data, size);
+    if (ret == ESP_OK) {
+        it->wrote_size += size;
+    }
+    return ret;
+}
+
+static esp_err_t ota_stream_write(ota_ops_entry_t *it, const uint8_t *data, size_t size)
+{
+    ota_stream_t *stream = it->stream;
+    esp_err_t ret = ota_verify_data(&stream->verify, data, size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    while (size > 0) {
+        size_t len;
+        if (stream->buf_len == 0 && size >= SPI_FLASH_SEC_SIZE) {
+            /* whole sectors are written without copying them to the buffer */
+            len = size & ~(SPI_FLASH_SEC_SIZE - 1);
+            ret = ota_write_sectors(it, data, len);
+        } else {
+            len = MIN(size, SPI_FLASH_SEC_SIZE - stream->buf_len);
+            memcpy(stream->buf + stream->buf_len, data, len);
+            stream->buf_len += len;
+            if (stream->buf_len == SPI_FLASH_SEC_SIZE) {
+                ret = ota_write_sectors(it, stream->buf, SPI_FLASH_SEC_SIZE);
+                stream->buf_len = 0;
+            }
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        data += len;
+        size -= len;
+    }
+    return ESP_OK;
+}
+
+/* Write out the rest of the buffered data, padded to a 16 byte block as needed for flash encryption */
+static esp_err_t ota_stream_flush(ota_ops_entry_t *it)
+{
+    ota_stream_t *stream = it->stream;
+    if (stream->buf_len == 0) {
+        return ESP_OK;
+    }
+    size_t len = (stream->buf_len + 15) & ~15;
+    memset(stream->buf + stream->buf_len, 0xFF, len - stream->buf_len);
+    stream->buf_len = 0;
+    return ota_write_sectors(it, stream->buf, len);
+}
+
 esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
 {
     ota_ops_entry_t *new_entry;
@@ -161,10 +425,15 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
     }
 #endif
 
+    if (partition == s_ota_verified_part) {
+        s_ota_verified_part = NULL;
+    }
+
     // If input image size is 0 or OTA_SIZE_UNKNOWN, erase entire partition
+    // With OTA_WITH_SEQUENTIAL_WRITES, each sector is erased by esp_ota_write() just before it is written
     if ((image_size == 0) || (image_size == OTA_SIZE_UNKNOWN)) {
         ret = esp_partition_erase_range(partition, 0, partition->size);
-    } else {
+    } else if (image_size != OTA_WITH_SEQUENTIAL_WRITES) {
         ret = esp_partition_erase_range(partition, 0, (image_size / SPI_FLASH_SEC_SIZE + 1) * SPI_FLASH_SEC_SIZE);
     }
 
@@ -177,11 +446,20 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
         return ESP_ERR_NO_MEM;
     }
 
+    if (image_size == OTA_WITH_SEQUENTIAL_WRITES) {
+        new_entry->stream = (ota_stream_t *) calloc(sizeof(ota_stream_t), 1);
+        if (new_entry->stream == NULL) {
+            free(new_entry);
+            return ESP_ERR_NO_MEM;
+        }
+        ota_verify_start(&new_entry->stream->verify);
+    }
+
     LIST_INSERT_HEAD(&s_ota_ops_entries_head, new_entry, entries);
 
     if ((image_size == 0) || (image_size == OTA_SIZE_UNKNOWN)) {
         new_entry->erased_size = partition->size;
-    } else {
+    } else if (image_size != OTA_WITH_SEQUENTIAL_WRITES) {
         new_entry->erased_size = image_size;
     }
 
@@ -205,6 +483,10 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
     // find ota handle in linked list
     for (it = LIST_FIRST(&s_ota_ops_entries_head); it != NULL; it = LIST_NEXT(it, entries)) {
         if (it->handle == handle) {
+            if (it->stream != NULL) {
+                return ota_stream_write(it, data_bytes, size);
+            }
+
             // must erase the partition before writing to it
             assert(it->erased_size > 0 && "must erase the partition before writing to it");
             if (it->wrote_size == 0 && it->partial_bytes == 0 && size > 0 && data_bytes[0] != ESP_IMAGE_HEADER_MAGIC) {
@@ -274,6 +556,13 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
 
     /* 'it' holds the ota_ops_entry_t for 'handle' */
 
+    if (it->stream != NULL) {
+        ret = ota_stream_flush(it);
+        if (ret != ESP_OK) {
+            goto cleanup;
+        }
+    }
+
     // esp_ota_end() is only valid if some data was written to this handle
     if ((it->erased_size == 0) || (it->wrote_size == 0)) {
         ret = ESP_ERR_INVALID_ARG;
@@ -291,6 +580,21 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
         it->partial_bytes = 0;
     }
 
+    if (it->stream != NULL) {
+        if (it->stream->verify.stage != OTA_VERIFY_DONE) {
+            if (it->stream->verify.stage != OTA_VERIFY_FAILED) {
+                ESP_LOGE(TAG, "OTA image is incomplete");
+            }
+            ret = ESP_ERR_OTA_VALIDATE_FAILED;
+            goto cleanup;
+        }
+#ifndef CONFIG_SECURE_SIGNED_ON_UPDATE
+        // The image was verified as it was written. The signature of signed images is not, so they are read back below.
+        s_ota_verified_part = it->part;
+        goto cleanup;
+#endif
+    }
+
     esp_image_metadata_t data;
     const esp_partition_pos_t part_pos = {
       .offset = it->part->address,
@@ -304,6 +608,10 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
 
  cleanup:
     LIST_REMOVE(it, entries);
+    if (it->stream != NULL) {
+        mbedtls_sha256_free(&it->stream->verify.sha);
+        free(it->stream);
+    }
     free(it);
     return ret;
 }
@@ -387,7 +695,8 @@ esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (image_validate(partition, ESP_IMAGE_VERIFY) != ESP_OK) {
+    // An image verified by esp_ota_end() while it was written is not read back again
+    if (partition != s_ota_verified_part && image_validate(partition, ESP_IMAGE_VERIFY) != ESP_OK) {
         return ESP_ERR_OTA_VALIDATE_FAILED;
     }
 
@@ -410,6 +719,7 @@ esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
 
             if (esp_efuse_check_secure_version(partition_app_desc.secure_version) == false) {
                 ESP_LOGE(TAG, "This a new partition can not be booted due to a secure version is lower than stored in efuse. Partition will be erased.");
+                s_ota_verified_part = NULL;
                 esp_err_t err = esp_partition_erase_range(partition, 0, partition->size);
                 if (err != ESP_OK) {
                     return err;
@@ -815,6 +1125,10 @@ esp_err_t esp_ota_erase_last_boot_app_partition(void)
         return ESP_FAIL;
     }
 
+    if (last_boot_app_partition_from_otadata == s_ota_verified_part) {
+        s_ota_verified_part = NULL;
+    }
+
     esp_err_t err = esp_partition_erase_range(last_boot_app_partition_from_otadata, 0, last_boot_app_partition_from_otadata->size);
     if (err != ESP_OK) {
         return err;
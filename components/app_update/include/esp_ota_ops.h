@@ -29,6 +29,7 @@ extern "C"
 #endif
 
 #define OTA_SIZE_UNKNOWN 0xffffffff /*!< Used for esp_ota_begin() if new image size is unknown */
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe /*!< Used for esp_ota_begin() to erase the partition as the image is written, instead of in advance */
 
 #define ESP_ERR_OTA_BASE                         0x1500                     /*!< Base error code for ota_ops api */
 #define ESP_ERR_OTA_PARTITION_CONFLICT           (ESP_ERR_OTA_BASE + 0x01)  /*!< Error if request was to write or erase the current running partition */
@@ -73,6 +74,14 @@ int esp_ota_get_app_elf_sha256(char* dst, size_t size);
  * If image size is not yet known, pass OTA_SIZE_UNKNOWN which will
  * cause the entire partition to be erased.
  *
+ * If OTA_WITH_SEQUENTIAL_WRITES is passed instead, nothing is erased here.
+ * esp_ota_write() then collects the data into whole flash sectors, erasing each
+ * sector just before it is written, and verifies the image as it is received,
+ * so that esp_ota_end() and esp_ota_set_boot_partition() don't need to read it
+ * back from flash (unless CONFIG_SECURE_SIGNED_ON_UPDATE is enabled, as the
+ * signature is still checked in flash). This needs an additional 4KB of memory
+ * until esp_ota_end().
+ *
  * On success, this function allocates memory that remains in use
  * until esp_ota_end() is called with the returned handle.
  *
@@ -82,6 +91,7 @@ int esp_ota_get_app_elf_sha256(char* dst, size_t size);
  *
  * @param partition Pointer to info for partition which will receive the OTA update. Required.
  * @param image_size Size of new OTA app image. Partition will be erased in order to receive this size of image. If 0 or OTA_SIZE_UNKNOWN, the entire partition is erased.
+ *                   If OTA_WITH_SEQUENTIAL_WRITES, the partition is erased as the image is written.
  * @param out_handle On success, returns a handle which should be used for subsequent esp_ota_write() and esp_ota_end() calls.
 
  * @return
@@ -104,6 +114,10 @@ esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp
  * data is received during the OTA operation. Data is written
  * sequentially to the partition.
  *
+ * If the update was started with OTA_WITH_SEQUENTIAL_WRITES, data is written
+ * whenever a whole flash sector has been received, and errors in the image
+ * are reported as soon as they are received.
+ *
  * @param handle  Handle obtained from esp_ota_begin
  * @param data    Data buffer to write
  * @param size    Size of data buffer in bytes.
@@ -112,6 +126,8 @@ esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp
  *    - ESP_OK: Data was written to flash successfully.
  *    - ESP_ERR_INVALID_ARG: handle is invalid.
  *    - ESP_ERR_OTA_VALIDATE_FAILED: First byte of image contains invalid app image magic byte.
+ *      With OTA_WITH_SEQUENTIAL_WRITES, any part of the image received so far is invalid.
+ *    - ESP_ERR_INVALID_SIZE: Data doesn't fit in the partition.
  *    - ESP_ERR_FLASH_OP_TIMEOUT or ESP_ERR_FLASH_OP_FAIL: Flash write failed.
  *    - ESP_ERR_OTA_SELECT_INFO_INVALID: OTA data partition has invalid contents
  */
@@ -130,6 +146,7 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
  *    - ESP_ERR_INVALID_ARG: Handle was never written to.
  *    - ESP_ERR_OTA_VALIDATE_FAILED: OTA image is invalid (either not a valid app image, or - if secure boot is enabled - signature failed to verify.)
  *    - ESP_ERR_INVALID_STATE: If flash encryption is enabled, this result indicates an internal error writing the final encrypted bytes to flash.
+ *    - ESP_ERR_FLASH_OP_TIMEOUT or ESP_ERR_FLASH_OP_FAIL: With OTA_WITH_SEQUENTIAL_WRITES, writing the last buffered data failed.
  */
 esp_err_t esp_ota_end(esp_ota_handle_t handle);
 
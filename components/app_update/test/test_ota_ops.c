@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
@@ -107,3 +108,61 @@ TEST_CASE("esp_ota_get_partition_description ", "[ota]")
     };
     TEST_ESP_ERR(ESP_ERR_NOT_FOUND, bootloader_common_get_partition_description(&not_app_pos, &app_desc1));
 }
+
+TEST_CASE("esp_ota_write() with OTA_WITH_SEQUENTIAL_WRITES verifies the image", "[ota]")
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(running);
+    TEST_ASSERT_NOT_NULL(update);
+
+    esp_image_metadata_t data;
+    const esp_partition_pos_t running_pos = {
+            .offset = running->address,
+            .size = running->size
+    };
+    TEST_ESP_OK(esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &running_pos, &data));
+
+    const uint8_t *image;
+    spi_flash_mmap_handle_t image_map;
+    TEST_ESP_OK(esp_partition_mmap(running, 0, data.image_len, SPI_FLASH_MMAP_DATA, (const void **)&image, &image_map));
+
+    /* chunks which don't fill whole sectors, as received over the network */
+    const size_t chunk_size = 1000;
+    uint8_t *chunk = malloc(chunk_size);
+    TEST_ASSERT_NOT_NULL(chunk);
+
+    /* copy of the running app is valid */
+    esp_ota_handle_t handle;
+    TEST_ESP_OK(esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle));
+    for (size_t offset = 0; offset < data.image_len; offset += chunk_size) {
+        size_t len = MIN(chunk_size, data.image_len - offset);
+        memcpy(chunk, image + offset, len);
+        TEST_ESP_OK(esp_ota_write(handle, chunk, len));
+    }
+    TEST_ESP_OK(esp_ota_end(handle));
+
+    const void *written;
+    spi_flash_mmap_handle_t written_map;
+    TEST_ESP_OK(esp_partition_mmap(update, 0, data.image_len, SPI_FLASH_MMAP_DATA, &written, &written_map));
+    TEST_ASSERT_EQUAL_MEMORY(image, written, data.image_len);
+    spi_flash_munmap(written_map);
+
+    /* copy with one corrupted byte is rejected, by esp_ota_write() as soon as it is detected */
+    const size_t corrupt_offset = data.image_len / 2;
+    esp_err_t err = ESP_OK;
+    TEST_ESP_OK(esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle));
+    for (size_t offset = 0; offset < data.image_len && err == ESP_OK; offset += chunk_size) {
+        size_t len = MIN(chunk_size, data.image_len - offset);
+        memcpy(chunk, image + offset, len);
+        if (corrupt_offset >= offset && corrupt_offset < offset + len) {
+            chunk[corrupt_offset - offset] ^= 0x01;
+        }
+        err = esp_ota_write(handle, chunk, len);
+    }
+    TEST_ASSERT(err == ESP_OK || err == ESP_ERR_OTA_VALIDATE_FAILED);
+    TEST_ESP_ERR(ESP_ERR_OTA_VALIDATE_FAILED, esp_ota_end(handle));
+
+    free(chunk);
+    spi_flash_munmap(image_map);
+}
@@ -521,6 +521,11 @@ static void main_task(void* args)
     }
 #endif
 
+#ifdef CONFIG_LOG_DEFERRED
+    ESP_ERROR_CHECK(esp_log_deferred_init());
+    ESP_ERROR_CHECK(esp_register_shutdown_handler(&esp_log_flush));
+#endif
+
     //Initialize task wdt if configured to do so
 #ifdef CONFIG_TASK_WDT_PANIC
     ESP_ERROR_CHECK(esp_task_wdt_init(CONFIG_TASK_WDT_TIMEOUT_S, true));
@@ -0,0 +1,46 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file esp_crc.h
+ *
+ * CRC32 shared by components which checksum small records, such as NVS and wear levelling.
+ * Unlike the ROM functions declared in rom/crc.h, this one is also available in host builds.
+ */
+
+/**
+ * @brief Calculate CRC32 in little endian bit order, same as crc32_le in ROM
+ *
+ * Depending on CONFIG_ESP32_CRC32_SLICING_BY_8, the function either calls the ROM
+ * implementation, which processes one byte per table lookup, or processes 8 bytes
+ * at a time using 8 lookup tables (8 kB in flash). Host builds always use the tables.
+ *
+ * @param crc  CRC of the preceding data, or the initial value
+ * @param buf  data
+ * @param len  length of data in bytes
+ *
+ * @return CRC of the data
+ */
+uint32_t esp_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -40,6 +40,7 @@
 #include "esp_spi_flash.h"
 #include "esp_cache_err_int.h"
 #include "esp_app_trace.h"
+#include "esp_log.h"
 #include "esp_system_internal.h"
 #include "sdkconfig.h"
 #include "esp_ota_ops.h"
@@ -583,6 +584,11 @@ static __attribute__((noreturn)) void commonErrorHandler(XtExcFrame *frame)
     //Feed the watchdogs, so they will give us time to print out debug info
     reconfigureAllWdts();
 
+#if CONFIG_LOG_DEFERRED
+    //Output the log messages which were logged before the panic
+    esp_log_flush_nolock();
+#endif
+
     commonErrorHandler_dump(frame, core_id);
 #if !CONFIG_FREERTOS_UNICORE
     if (other_core_frame != NULL) {
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_crc.h"
+#include "rom/crc.h"
+#include "xtensa/hal.h"
+
+TEST_CASE("esp_crc32_le gives same result as ROM function", "[crc]")
+{
+    uint8_t buf[128 + 4];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = (uint8_t) rand();
+    }
+    for (int offset = 0; offset < 4; ++offset) {
+        for (int len = 0; len <= 128; ++len) {
+            TEST_ASSERT_EQUAL_HEX32(crc32_le(0xffffffff, buf + offset, len), esp_crc32_le(0xffffffff, buf + offset, len));
+        }
+    }
+}
+
+TEST_CASE("esp_crc32_le performance", "[crc]")
+{
+    const int count = 1000;
+    // size of an NVS entry
+    uint32_t entry[8];
+    for (int i = 0; i < 8; ++i) {
+        entry[i] = (uint32_t) rand();
+    }
+
+    volatile uint32_t sink = 0;
+    uint32_t start = xthal_get_ccount();
+    for (int i = 0; i < count; ++i) {
+        sink += esp_crc32_le(0xffffffff, (const uint8_t *) entry, sizeof(entry));
+    }
+    uint32_t esp_cycles = (xthal_get_ccount() - start) / count;
+
+    start = xthal_get_ccount();
+    for (int i = 0; i < count; ++i) {
+        sink += crc32_le(0xffffffff, (const uint8_t *) entry, sizeof(entry));
+    }
+    uint32_t rom_cycles = (xthal_get_ccount() - start) / count;
+
+    printf("CRC32 of a 32 byte entry: esp_crc32_le %u cycles, ROM crc32_le %u cycles\n", esp_cycles, rom_cycles);
+}
@@ -30,8 +30,16 @@
 /* ---------------------------- Definitions --------------------------------- */
 
 #ifdef CONFIG_EVENT_LOOP_PROFILING
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+// LOOP @<address, name> rx:<recieved events no.> dr:<dropped events no.>
+//      pool:<buffers in use>/<buffers> max:<most buffers in use> miss:<event data allocated from heap>
+#define LOOP_DUMP_FORMAT              "LOOP @%p,%s rx:%u dr:%u pool:%u/%u max:%u miss:%u\n"
+#define LOOP_DUMP_NUMBERS             6
+#else
 // LOOP @<address, name> rx:<recieved events no.> dr:<dropped events no.>
 #define LOOP_DUMP_FORMAT              "LOOP @%p,%s rx:%u dr:%u\n"
+#define LOOP_DUMP_NUMBERS             2
+#endif
  // handler @<address> ev:<base, id> inv:<times invoked> time:<runtime>
 #define HANDLER_DUMP_FORMAT           "  HANDLER @%p ev:%s,%s inv:%u time:%lld us\n"
 
@@ -42,6 +50,12 @@
                                         } while(0);
 #endif
 
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+// Size of each buffer in the pool, large enough to link the buffer in the list of unused buffers
+#define POST_POOL_BUF_SIZE            ((CONFIG_EVENT_LOOP_POST_POOL_DATA_SIZE + 3) & ~3)
+_Static_assert(POST_POOL_BUF_SIZE >= sizeof(void*), "pool buffer too small");
+#endif
+
 /* ------------------------- Static Variables ------------------------------- */
 
 static const char* TAG = "event";
@@ -95,7 +109,7 @@ static int esp_event_dump_prepare()
 
     // Reserve slightly more memory than computed
     int allowance = 3;
-    int size = (((loops + allowance) * (sizeof(LOOP_DUMP_FORMAT) + 10 + 20 + 2 * 11)) +
+    int size = (((loops + allowance) * (sizeof(LOOP_DUMP_FORMAT) + 10 + 20 + LOOP_DUMP_NUMBERS * 11)) +
                         ((handlers + allowance) * (sizeof(HANDLER_DUMP_FORMAT) + 10 + 2 * 20 + 11 + 20)));
 
     return size;
@@ -277,14 +291,21 @@ static esp_err_t loop_node_add_handler(esp_event_loop_node_t* loop_node, esp_eve
     }
 }
 
-static esp_err_t handler_instances_remove(esp_event_handler_instances_t* handlers, esp_event_handler_t handler)
+static esp_err_t handler_instances_remove(esp_event_loop_instance_t* loop, esp_event_handler_instances_t* handlers, esp_event_handler_t handler)
 {
     esp_event_handler_instance_t *it, *temp;
 
     SLIST_FOREACH_SAFE(it, handlers, next, temp) {
         if (it->handler == handler) {
             SLIST_REMOVE(handlers, it, esp_event_handler_instance, next);
-            free(it);
+
+            if (loop->dispatch_index_valid) {
+                // The dispatch index may still reference the handler, keep it until the index is updated
+                it->handler = NULL;
+                SLIST_INSERT_HEAD(&(loop->handlers_unregistered), it, next);
+            } else {
+                free(it);
+            }
             return ESP_OK;
         }
     }
@@ -293,16 +314,16 @@ static esp_err_t handler_instances_remove(esp_event_handler_instances_t* handler
 }
 
 
-static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int32_t id, esp_event_handler_t handler)
+static esp_err_t base_node_remove_handler(esp_event_loop_instance_t* loop, esp_event_base_node_t* base_node, int32_t id, esp_event_handler_t handler)
 {
     if (id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(base_node->handlers), handler);
+        return handler_instances_remove(loop, &(base_node->handlers), handler);
     }
     else {
         esp_event_id_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(base_node->id_nodes), next, temp) {
             if (it->id == id) {
-                esp_err_t res = handler_instances_remove(&(it->handlers), handler);
+                esp_err_t res = handler_instances_remove(loop, &(it->handlers), handler);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers))) {
@@ -318,16 +339,16 @@ static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int3
     return ESP_ERR_NOT_FOUND;
 }
 
-static esp_err_t loop_node_remove_handler(esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_t handler)
+static esp_err_t loop_node_remove_handler(esp_event_loop_instance_t* loop, esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_t handler)
 {
     if (base == esp_event_any_base && id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(loop_node->handlers), handler);
+        return handler_instances_remove(loop, &(loop_node->handlers), handler);
     }
     else {
         esp_event_base_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(loop_node->base_nodes), next, temp) {
             if (it->base == base) {
-                esp_err_t res = base_node_remove_handler(it, id, handler);
+                esp_err_t res = base_node_remove_handler(loop, it, id, handler);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers)) && SLIST_EMPTY(&(it->id_nodes))) {
@@ -376,13 +397,407 @@ static void loop_node_remove_all_handler(esp_event_loop_node_t* loop_node)
     }
 }
 
-static esp_err_t post_instance_create(esp_event_base_t event_base, int32_t event_id, void* event_data, int32_t event_data_size, esp_event_post_instance_t* post)
+/* The handlers to execute for each event are found by walking the linked lists, comparing the base and id
+ * of every base and id node. To avoid this, the dispatch index keeps an array of the handlers to execute, in
+ * order, for each event with base or id level handlers, found by hashing its base and id. Other events execute
+ * only the loop level handlers, kept in the array dispatch_any.
+ *
+ * Registering or unregistering a handler rebuilds the arrays of the affected events. Handlers can (un)register
+ * handlers while an event is being dispatched, so the index is then rebuilt after dispatch, and unregistered
+ * handlers are kept until no array references them. The event being dispatched then continues with the handlers
+ * found by walking the linked lists, see dispatch_entry_execute(). If memory for the index can't be allocated,
+ * events are dispatched by walking the linked lists.
+ */
+
+static uint32_t dispatch_index_bucket(esp_event_base_t base, int32_t id)
+{
+    uint32_t hash = ((uint32_t) (uintptr_t) base >> 2) ^ ((uint32_t) id * 2654435761u);
+    return (hash ^ (hash >> 16)) % ESP_EVENT_DISPATCH_INDEX_BUCKETS;
+}
+
+// Walks the linked lists to find the handlers executed for an event, in the order they are executed. If base is
+// NULL, finds the loop level handlers only. Returns the number of handlers, and sets specific to the number of them
+// registered to the event id (or to the base, if id is ESP_EVENT_ANY_ID).
+static uint32_t dispatch_entry_collect(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id,
+                                       esp_event_handler_instance_t** handlers, uint32_t* specific)
+{
+    esp_event_handler_instance_t *handler;
+    esp_event_loop_node_t *loop_node;
+    esp_event_base_node_t *base_node;
+    esp_event_id_node_t *id_node;
+
+    uint32_t num = 0;
+    *specific = 0;
+
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        SLIST_FOREACH(handler, &(loop_node->handlers), next) {
+            if (handlers != NULL) {
+                handlers[num] = handler;
+            }
+            num++;
+        }
+
+        if (base == NULL) {
+            continue;
+        }
+
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            if (base_node->base != base) {
+                continue;
+            }
+
+            SLIST_FOREACH(handler, &(base_node->handlers), next) {
+                if (handlers != NULL) {
+                    handlers[num] = handler;
+                }
+                num++;
+                if (id == ESP_EVENT_ANY_ID) {
+                    (*specific)++;
+                }
+            }
+
+            if (id == ESP_EVENT_ANY_ID) {
+                continue;
+            }
+
+            SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                if (id_node->id == id) {
+                    SLIST_FOREACH(handler, &(id_node->handlers), next) {
+                        if (handlers != NULL) {
+                            handlers[num] = handler;
+                        }
+                        num++;
+                        (*specific)++;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    return num;
+}
+
+// Creates the index entry for an event. Sets entry to NULL if the event has no handlers registered to its id (or
+// to its base, if id is ESP_EVENT_ANY_ID), in which case the more general entry applies to it.
+static esp_err_t dispatch_entry_create(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id,
+                                       esp_event_dispatch_entry_t** entry)
+{
+    uint32_t specific;
+    uint32_t num = dispatch_entry_collect(loop, base, id, NULL, &specific);
+
+    *entry = NULL;
+
+    if (base != NULL && specific == 0) {
+        return ESP_OK;
+    }
+
+    esp_event_dispatch_entry_t* new_entry = malloc(sizeof(*new_entry) + num * sizeof(new_entry->handlers[0]));
+    if (new_entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    new_entry->base = base;
+    new_entry->id = id;
+    new_entry->handlers_num = dispatch_entry_collect(loop, base, id, new_entry->handlers, &specific);
+
+    *entry = new_entry;
+
+    return ESP_OK;
+}
+
+static esp_event_dispatch_entry_t* dispatch_entry_find(esp_event_dispatch_entries_t* entries, esp_event_base_t base, int32_t id)
+{
+    esp_event_dispatch_entry_t* entry;
+
+    SLIST_FOREACH(entry, entries, next) {
+        if (entry->base == base && entry->id == id) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static esp_event_dispatch_entry_t* dispatch_index_find(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    esp_event_dispatch_entry_t* entry;
+
+    entry = dispatch_entry_find(&(loop->dispatch_index[dispatch_index_bucket(base, id)]), base, id);
+    if (entry == NULL) {
+        entry = dispatch_entry_find(&(loop->dispatch_index[dispatch_index_bucket(base, ESP_EVENT_ANY_ID)]), base, ESP_EVENT_ANY_ID);
+    }
+    if (entry == NULL) {
+        entry = loop->dispatch_any;
+    }
+
+    return entry;
+}
+
+// Executes the handlers of an index entry for an event. If a handler (un)registers handlers, the handlers of the
+// event are found again by walking the linked lists, and dispatch resumes after the last handler executed which is
+// still registered, so that the event is dispatched to the same handlers as if the linked lists were walked. The
+// handlers are found again once for each handler that (un)registers handlers. Returns whether any handler was
+// executed.
+static bool dispatch_entry_execute(esp_event_loop_instance_t* loop, esp_event_dispatch_entry_t* entry,
+                                   esp_event_post_instance_t post)
+{
+    esp_event_handler_instance_t** handlers = entry->handlers;
+    uint32_t handlers_num = entry->handlers_num;
+    esp_event_handler_instance_t** collected = NULL;
+    uint32_t changes = loop->dispatch_changes;
+    bool exec = false;
+
+    uint32_t i = 0;
+    while (i < handlers_num) {
+        esp_event_handler_instance_t* handler = handlers[i++];
+
+        // Skip handlers unregistered by a previous handler
+        if (handler->handler == NULL) {
+            continue;
+        }
+
+        handler_execute(loop, handler, post);
+        exec = true;
+
+        if (loop->dispatch_changes == changes) {
+            continue;
+        }
+        changes = loop->dispatch_changes;
+
+        uint32_t specific;
+        uint32_t num = dispatch_entry_collect(loop, post.base, post.id, NULL, &specific);
+        esp_event_handler_instance_t** found = malloc(num * sizeof(*found));
+        if (found == NULL && num > 0) {
+            ESP_LOGW(TAG, "not enough memory to find handlers registered while dispatching %s:%d", post.base, post.id);
+            continue;
+        }
+        dispatch_entry_collect(loop, post.base, post.id, found, &specific);
+
+        // Unregistered handlers are cleared but kept until dispatch ends, so the last handler executed which is
+        // still registered can be told apart. (Un)registering handlers doesn't change the order of the others,
+        // so the handlers found after it are the ones the linked lists walk would still reach.
+        esp_event_handler_instance_t* last = NULL;
+        for (uint32_t k = i; k > 0 && last == NULL; k--) {
+            if (handlers[k - 1]->handler != NULL) {
+                last = handlers[k - 1];
+            }
+        }
+
+        uint32_t resume = 0;
+        for (uint32_t j = 0; last != NULL && j < num; j++) {
+            if (found[j] == last) {
+                resume = j + 1;
+                break;
+            }
+        }
+
+        free(collected);
+        collected = found;
+        handlers = found;
+        handlers_num = num;
+        i = resume;
+    }
+
+    free(collected);
+
+    return exec;
+}
+
+// Creates an entry and adds it to a list, unless the event has none of its own or the list already has it
+static esp_err_t dispatch_entries_add(esp_event_loop_instance_t* loop, esp_event_dispatch_entries_t* entries,
+                                      esp_event_base_t base, int32_t id)
+{
+    esp_event_dispatch_entry_t* entry;
+
+    if (dispatch_entry_find(entries, base, id) != NULL) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = dispatch_entry_create(loop, base, id, &entry);
+    if (entry != NULL) {
+        SLIST_INSERT_HEAD(entries, entry, next);
+    }
+
+    return err;
+}
+
+// Removes the index entries of events with the given base and id. A NULL base matches all bases, and
+// ESP_EVENT_ANY_ID matches all ids.
+static void dispatch_index_remove(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    esp_event_dispatch_entry_t *it, *temp;
+
+    for (int i = 0; i < ESP_EVENT_DISPATCH_INDEX_BUCKETS; i++) {
+        SLIST_FOREACH_SAFE(it, &(loop->dispatch_index[i]), next, temp) {
+            if ((base == NULL || it->base == base) && (id == ESP_EVENT_ANY_ID || it->id == id)) {
+                SLIST_REMOVE(&(loop->dispatch_index[i]), it, esp_event_dispatch_entry, next);
+                free(it);
+            }
+        }
+    }
+}
+
+// Updates the dispatch index after handlers for an event were registered or unregistered. Handlers registered
+// to a base change the entries of all events of the base, and loop level handlers change all entries.
+static void dispatch_index_update(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    if (loop->dispatch_depth > 0) {
+        // The entry of the event being dispatched must not change, rebuild the index afterwards
+        loop->dispatch_index_dirty = true;
+        loop->dispatch_changes++;
+        return;
+    }
+
+    esp_event_dispatch_entries_t entries = SLIST_HEAD_INITIALIZER(entries);
+    esp_event_dispatch_entry_t *entry, *dispatch_any = NULL;
+    esp_err_t err = ESP_OK;
+
+    bool rebuild = !loop->dispatch_index_valid || loop->dispatch_index_dirty || base == esp_event_any_base;
+
+    if (rebuild) {
+        esp_event_loop_node_t *loop_node;
+        esp_event_base_node_t *base_node;
+        esp_event_id_node_t *id_node;
+
+        SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+            SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+                if (err == ESP_OK && !SLIST_EMPTY(&(base_node->handlers))) {
+                    err = dispatch_entries_add(loop, &entries, base_node->base, ESP_EVENT_ANY_ID);
+                }
+                SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                    if (err == ESP_OK) {
+                        err = dispatch_entries_add(loop, &entries, base_node->base, id_node->id);
+                    }
+                }
+            }
+        }
+
+        if (err == ESP_OK) {
+            err = dispatch_entry_create(loop, NULL, ESP_EVENT_ANY_ID, &dispatch_any);
+        }
+    } else if (id == ESP_EVENT_ANY_ID) {
+        err = dispatch_entries_add(loop, &entries, base, ESP_EVENT_ANY_ID);
+
+        for (int i = 0; i < ESP_EVENT_DISPATCH_INDEX_BUCKETS && err == ESP_OK; i++) {
+            SLIST_FOREACH(entry, &(loop->dispatch_index[i]), next) {
+                if (entry->base == base && err == ESP_OK) {
+                    err = dispatch_entries_add(loop, &entries, base, entry->id);
+                }
+            }
+        }
+    } else {
+        err = dispatch_entries_add(loop, &entries, base, id);
+    }
+
+    if (err == ESP_OK) {
+        dispatch_index_remove(loop, rebuild ? NULL : base, rebuild ? ESP_EVENT_ANY_ID : id);
+
+        while ((entry = SLIST_FIRST(&entries)) != NULL) {
+            SLIST_REMOVE_HEAD(&entries, next);
+            SLIST_INSERT_HEAD(&(loop->dispatch_index[dispatch_index_bucket(entry->base, entry->id)]), entry, next);
+        }
+
+        if (rebuild) {
+            free(loop->dispatch_any);
+            loop->dispatch_any = dispatch_any;
+        }
+
+        loop->dispatch_index_valid = true;
+    } else {
+        ESP_LOGW(TAG, "alloc for dispatch index of loop %p failed", loop);
+
+        while ((entry = SLIST_FIRST(&entries)) != NULL) {
+            SLIST_REMOVE_HEAD(&entries, next);
+            free(entry);
+        }
+
+        dispatch_index_remove(loop, NULL, ESP_EVENT_ANY_ID);
+        free(loop->dispatch_any);
+        loop->dispatch_any = NULL;
+
+        loop->dispatch_index_valid = false;
+    }
+
+    loop->dispatch_index_dirty = false;
+
+    // No entry references the unregistered handlers anymore
+    handler_instances_remove_all(&(loop->handlers_unregistered));
+}
+
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+static esp_err_t post_pool_create(esp_event_loop_instance_t* loop, uint32_t size)
+{
+    loop->pool = malloc(size * POST_POOL_BUF_SIZE);
+    if (loop->pool == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    loop->pool_free = NULL;
+    for (int i = size - 1; i >= 0; i--) {
+        void** buf = (void**) (loop->pool + i * POST_POOL_BUF_SIZE);
+        *buf = loop->pool_free;
+        loop->pool_free = buf;
+    }
+
+    loop->pool_size = size;
+    vPortCPUInitializeMutex(&(loop->pool_spinlock));
+
+    return ESP_OK;
+}
+
+// The pool functions are also called from esp_event_isr_post_to
+static void* POST_ISR_ATTR post_pool_get(esp_event_loop_instance_t* loop, size_t size)
+{
+    void** buf = NULL;
+
+    portENTER_CRITICAL_SAFE(&(loop->pool_spinlock));
+    if (size <= CONFIG_EVENT_LOOP_POST_POOL_DATA_SIZE && loop->pool_free != NULL) {
+        buf = loop->pool_free;
+        loop->pool_free = *buf;
+        loop->pool_used++;
+        if (loop->pool_used > loop->pool_used_max) {
+            loop->pool_used_max = loop->pool_used;
+        }
+    } else {
+        loop->pool_misses++;
+    }
+    portEXIT_CRITICAL_SAFE(&(loop->pool_spinlock));
+
+    return buf;
+}
+
+// Returns true if the buffer belongs to the pool, false if it needs to be freed
+static bool POST_ISR_ATTR post_pool_put(esp_event_loop_instance_t* loop, void* data)
+{
+    uint8_t* buf = (uint8_t*) data;
+    if (buf < loop->pool || buf >= loop->pool + loop->pool_size * POST_POOL_BUF_SIZE) {
+        return false;
+    }
+
+    portENTER_CRITICAL_SAFE(&(loop->pool_spinlock));
+    *(void**) buf = loop->pool_free;
+    loop->pool_free = buf;
+    loop->pool_used--;
+    portEXIT_CRITICAL_SAFE(&(loop->pool_spinlock));
+
+    return true;
+}
+#endif
+
+static esp_err_t post_instance_create(esp_event_loop_instance_t* loop, esp_event_base_t event_base, int32_t event_id,
+                                      void* event_data, int32_t event_data_size, esp_event_post_instance_t* post)
 {
     void* event_data_copy = NULL;
 
-    // Make persistent copy of event data on heap.
+    // Make persistent copy of event data, in the loop's pool if possible, otherwise on heap.
     if (event_data != NULL && event_data_size != 0) {
-        event_data_copy = calloc(1, event_data_size);
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+        event_data_copy = post_pool_get(loop, event_data_size);
+#endif
+        if (event_data_copy == NULL) {
+            event_data_copy = calloc(1, event_data_size);
+        }
 
         if (event_data_copy == NULL) {
             ESP_LOGE(TAG, "alloc for post data to event %s:%d failed", event_base, event_id);
@@ -395,14 +810,27 @@ static esp_err_t post_instance_create(esp_event_base_t event_base, int32_t event
     post->base = event_base;
     post->id = event_id;
     post->data = event_data_copy;
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+    post->data_isr_set = false;
+#endif
 
     ESP_LOGD(TAG, "created post for event %s:%d", event_base, event_id);
 
     return ESP_OK;
 }
 
-static void post_instance_delete(esp_event_post_instance_t* post)
+static void post_instance_delete(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
 {
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+    if (post->data_isr_set) {
+        return;
+    }
+#endif
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+    if (post_pool_put(loop, post->data)) {
+        return;
+    }
+#endif
     free(post->data);
 }
 
@@ -434,6 +862,8 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
     }
 
 #ifdef CONFIG_EVENT_LOOP_PROFILING
+    vPortCPUInitializeMutex(&(loop->events_spinlock));
+
     loop->profiling_mutex = xSemaphoreCreateMutex();
     if (loop->profiling_mutex == NULL) {
         ESP_LOGE(TAG, "create event loop profiling mutex failed");
@@ -441,6 +871,14 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
     }
 #endif
 
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+    // One buffer for each queued event, and one for the event being dispatched
+    if (post_pool_create(loop, event_loop_args->queue_size + 1) != ESP_OK) {
+        ESP_LOGE(TAG, "alloc for event loop post pool failed");
+        goto on_err;
+    }
+#endif
+
     SLIST_INIT(&(loop->loop_nodes));
 
     // Create the loop task if requested
@@ -492,17 +930,18 @@ on_err:
     }
 #endif
 
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+    free(loop->pool);
+#endif
+
     free(loop);
 
     return err;
 }
 
-// On event lookup performance: The library implements the event list as a linked list, which results to O(n)
-// lookup time. The test comparing this implementation to the O(lg n) performance of rbtrees
-// (https://github.com/freebsd/freebsd/blob/master/sys/sys/tree.h)
-// indicate that the difference is not that substantial, especially considering the additional
-// pointers per node of rbtrees. Code for the rbtree implementation of the event loop library is archived
-// in feature/esp_event_loop_library_rbtrees if needed.
+// On event lookup performance: The library keeps registered handlers in linked lists, which results to O(n)
+// lookup time. Events are instead dispatched using the dispatch index, see dispatch_index_update(), which
+// finds the handlers for an event by hashing its base and id.
 esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
 {
     assert(event_loop);
@@ -519,6 +958,12 @@ esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t tick
 #endif
 
     while(xQueueReceive(loop->queue, &post, ticks_to_run) == pdTRUE) {
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+        if (post.data_isr_set) {
+            post.data = &(post.data_isr);
+        }
+#endif
+
         // The event has already been unqueued, so ensure it gets executed.
         xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
@@ -526,42 +971,55 @@ esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t tick
 
         bool exec = false;
 
-        esp_event_handler_instance_t *handler;
-        esp_event_loop_node_t *loop_node;
-        esp_event_base_node_t *base_node;
-        esp_event_id_node_t *id_node;
+        loop->dispatch_depth++;
 
-        SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
-            // Execute loop level handlers
-            SLIST_FOREACH(handler, &(loop_node->handlers), next) {
-                handler_execute(loop, handler, post);
-                exec |= true;
-            }
+        if (loop->dispatch_index_valid) {
+            esp_event_dispatch_entry_t* entry = dispatch_index_find(loop, post.base, post.id);
+            exec |= dispatch_entry_execute(loop, entry, post);
+        } else {
+            esp_event_handler_instance_t *handler;
+            esp_event_loop_node_t *loop_node;
+            esp_event_base_node_t *base_node;
+            esp_event_id_node_t *id_node;
+
+            SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+                // Execute loop level handlers
+                SLIST_FOREACH(handler, &(loop_node->handlers), next) {
+                    handler_execute(loop, handler, post);
+                    exec |= true;
+                }
 
-            SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
-                if (base_node->base == post.base) {
-                    // Execute base level handlers
-                    SLIST_FOREACH(handler, &(base_node->handlers), next) {
-                        handler_execute(loop, handler, post);
-                        exec |= true;
-                    }
+                SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+                    if (base_node->base == post.base) {
+                        // Execute base level handlers
+                        SLIST_FOREACH(handler, &(base_node->handlers), next) {
+                            handler_execute(loop, handler, post);
+                            exec |= true;
+                        }
 
-                    SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
-                        if(id_node->id == post.id) {
-                            // Execute id level handlers
-                            SLIST_FOREACH(handler, &(id_node->handlers), next) {
-                                handler_execute(loop, handler, post);
-                                exec |= true;
+                        SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                            if(id_node->id == post.id) {
+                                // Execute id level handlers
+                                SLIST_FOREACH(handler, &(id_node->handlers), next) {
+                                    handler_execute(loop, handler, post);
+                                    exec |= true;
+                                }
+                                // Skip to next base node
+                                break;
                             }
-                            // Skip to next base node
-                            break;
                         }
                     }
                 }
             }
         }
 
-        post_instance_delete(&post);
+        loop->dispatch_depth--;
+
+        if (loop->dispatch_index_dirty) {
+            dispatch_index_update(loop, NULL, ESP_EVENT_ANY_ID);
+        }
+
+        post_instance_delete(loop, &post);
 
         if (ticks_to_run != portMAX_DELAY) {
             end = xTaskGetTickCount();
@@ -620,14 +1078,21 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
         free(it);
     }
 
+    dispatch_index_remove(loop, NULL, ESP_EVENT_ANY_ID);
+    free(loop->dispatch_any);
+    handler_instances_remove_all(&(loop->handlers_unregistered));
+
     // Drop existing posts on the queue
     esp_event_post_instance_t post;
     while(xQueueReceive(loop->queue, &post, 0) == pdTRUE) {
-        free(post.data);
+        post_instance_delete(loop, &post);
     }
 
     // Cleanup loop
     vQueueDelete(loop->queue);
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+    free(loop->pool);
+#endif
     free(loop);
     // Free loop mutex before deleting
     xSemaphoreGiveRecursive(loop_mutex);
@@ -701,6 +1166,10 @@ esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t event_loop, es
         err = loop_node_add_handler(last_loop_node, event_base, event_id, event_handler, event_handler_arg);
     }
 
+    if (err == ESP_OK) {
+        dispatch_index_update(loop, event_base, event_id);
+    }
+
 on_err:
     xSemaphoreGiveRecursive(loop->mutex);
     return err;
@@ -728,7 +1197,7 @@ esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop,
     esp_event_loop_node_t *it, *temp;
 
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
-        esp_err_t res = loop_node_remove_handler(it, event_base, event_id, event_handler);
+        esp_err_t res = loop_node_remove_handler(loop, it, event_base, event_id, event_handler);
 
         if (res == ESP_OK && SLIST_EMPTY(&(it->base_nodes)) && SLIST_EMPTY(&(it->handlers))) {
             SLIST_REMOVE(&(loop->loop_nodes), it, esp_event_loop_node, next);
@@ -737,6 +1206,8 @@ esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop,
         }
     }
 
+    dispatch_index_update(loop, event_base, event_id);
+
     xSemaphoreGiveRecursive(loop->mutex);
 
     return ESP_OK;
@@ -756,7 +1227,7 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
     esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
 
     esp_event_post_instance_t post;
-    esp_err_t err = post_instance_create(event_base, event_id, event_data, event_data_size, &post);
+    esp_err_t err = post_instance_create(loop, event_base, event_id, event_data, event_data_size, &post);
 
     if (err != ESP_OK) {
         return err;
@@ -789,20 +1260,20 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
     }
 
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
 
 #ifdef CONFIG_EVENT_LOOP_PROFILING
-        xSemaphoreTake(loop->profiling_mutex, portMAX_DELAY);
+        portENTER_CRITICAL(&(loop->events_spinlock));
         loop->events_dropped++;
-        xSemaphoreGive(loop->profiling_mutex);
+        portEXIT_CRITICAL(&(loop->events_spinlock));
 #endif
         return ESP_ERR_TIMEOUT;
     }
 
 #ifdef CONFIG_EVENT_LOOP_PROFILING
-    xSemaphoreTake(loop->profiling_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&(loop->events_spinlock));
     loop->events_recieved++;
-    xSemaphoreGive(loop->profiling_mutex);
+    portEXIT_CRITICAL(&(loop->events_spinlock));
 #endif
 
     ESP_LOGD(TAG, "posted %s:%d to loop %p", post.base, post.id, event_loop);
@@ -810,6 +1281,76 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
     return ESP_OK;
 }
 
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+esp_err_t POST_ISR_ATTR esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                              void* event_data, size_t event_data_size, BaseType_t* task_unblocked)
+{
+    assert(event_loop);
+
+    if (event_base == ESP_EVENT_ANY_BASE || event_id == ESP_EVENT_ANY_ID) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+
+    esp_event_post_instance_t post;
+    post.base = event_base;
+    post.id = event_id;
+    post.data = NULL;
+    post.data_isr_set = false;
+
+    // Nothing can be allocated from the heap here. Data which fits is stored in the post itself,
+    // larger data in a buffer from the loop's pool.
+    if (event_data != NULL && event_data_size != 0) {
+        if (event_data_size <= sizeof(post.data_isr)) {
+            post.data_isr = 0;
+            memcpy(&(post.data_isr), event_data, event_data_size);
+            post.data_isr_set = true;
+        } else {
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+            if (event_data_size > CONFIG_EVENT_LOOP_POST_POOL_DATA_SIZE) {
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            post.data = post_pool_get(loop, event_data_size);
+            if (post.data == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+
+            memcpy(post.data, event_data, event_data_size);
+#else
+            return ESP_ERR_INVALID_ARG;
+#endif
+        }
+    }
+
+    BaseType_t result = xQueueSendToBackFromISR(loop->queue, &post, task_unblocked);
+
+    if (result != pdTRUE) {
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+        if (post.data != NULL) {
+            post_pool_put(loop, post.data);
+        }
+#endif
+
+#ifdef CONFIG_EVENT_LOOP_PROFILING
+        portENTER_CRITICAL_ISR(&(loop->events_spinlock));
+        loop->events_dropped++;
+        portEXIT_CRITICAL_ISR(&(loop->events_spinlock));
+#endif
+        return ESP_FAIL;
+    }
+
+#ifdef CONFIG_EVENT_LOOP_PROFILING
+    portENTER_CRITICAL_ISR(&(loop->events_spinlock));
+    loop->events_recieved++;
+    portEXIT_CRITICAL_ISR(&(loop->events_spinlock));
+#endif
+
+    return ESP_OK;
+}
+#endif
+
 
 esp_err_t esp_event_dump(FILE* file)
 {
@@ -833,8 +1374,14 @@ esp_err_t esp_event_dump(FILE* file)
     portENTER_CRITICAL(&s_event_loops_spinlock);
 
     SLIST_FOREACH(loop_it, &s_event_loops, next) {
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+        PRINT_DUMP_INFO(dst, sz, LOOP_DUMP_FORMAT, loop_it, loop_it->task != NULL ? loop_it->name : "none" ,
+                        loop_it->events_recieved, loop_it->events_dropped, loop_it->pool_used,
+                        loop_it->pool_size, loop_it->pool_used_max, loop_it->pool_misses);
+#else
         PRINT_DUMP_INFO(dst, sz, LOOP_DUMP_FORMAT, loop_it, loop_it->task != NULL ? loop_it->name : "none" ,
                         loop_it->events_recieved, loop_it->events_dropped);
+#endif
 
         int sz_bak = sz;
 
@@ -16,6 +16,7 @@
 #define ESP_EVENT_H_
 
 #include "esp_err.h"
+#include "sdkconfig.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -229,7 +230,7 @@ esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop,
  * @param[in] event_data_size the size of the event data
  * @param[in] ticks_to_wait number of ticks to block on a full event queue
  *
- * @note posting events from an ISR is not supported
+ * @note this function can't be called from an ISR, see esp_event_isr_post
  *
  * @return
  *  - ESP_OK: Success
@@ -258,7 +259,7 @@ esp_err_t esp_event_post(esp_event_base_t event_base,
  * @param[in] event_data_size the size of the event data
  * @param[in] ticks_to_wait number of ticks to block on a full event queue
  *
- * @note posting events from an ISR is not supported
+ * @note this function can't be called from an ISR, see esp_event_isr_post_to
  *
  * @return
  *  - ESP_OK: Success
@@ -273,6 +274,65 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
                             size_t event_data_size,
                             TickType_t ticks_to_wait);
 
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+/**
+ * @brief Special variant of esp_event_post for posting events from interrupt handlers.
+ *
+ * @param[in] event_base the event base that identifies the event
+ * @param[in] event_id the the event id that identifies the event
+ * @param[in] event_data the data, specific to the event occurence, that gets passed to the handler
+ * @param[in] event_data_size the size of the event data
+ * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with
+ *                            higher priority than currently running task has been unblocked by the posted event;
+ *                            a context switch should be requested before the interrupt exits.
+ *
+ * @note this function does not wait for space in the event queue, and doesn't allocate memory
+ * @note event data of up to 4 bytes is stored in the event queue; larger event data requires
+ *       CONFIG_EVENT_LOOP_POST_POOL, and is stored in the event loop's pool
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_FAIL: Event queue for the default event loop full
+ *  - ESP_ERR_INVALID_STATE: Default event loop not created
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id, or event data too large
+ *  - ESP_ERR_NO_MEM: All buffers in the pool are in use
+ */
+esp_err_t esp_event_isr_post(esp_event_base_t event_base,
+                            int32_t event_id,
+                            void* event_data,
+                            size_t event_data_size,
+                            BaseType_t* task_unblocked);
+
+/**
+ * @brief Special variant of esp_event_post_to for posting events from interrupt handlers
+ *
+ * @param[in] event_loop the event loop to post to
+ * @param[in] event_base the event base that identifies the event
+ * @param[in] event_id the the event id that identifies the event
+ * @param[in] event_data the data, specific to the event occurence, that gets passed to the handler
+ * @param[in] event_data_size the size of the event data
+ * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with
+ *                            higher priority than currently running task has been unblocked by the posted event;
+ *                            a context switch should be requested before the interrupt exits.
+ *
+ * @note this function does not wait for space in the event queue, and doesn't allocate memory
+ * @note event data of up to 4 bytes is stored in the event queue; larger event data requires
+ *       CONFIG_EVENT_LOOP_POST_POOL, and is stored in the event loop's pool
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_FAIL: Event queue for the loop full
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id, or event data too large
+ *  - ESP_ERR_NO_MEM: All buffers in the pool are in use
+ */
+esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
+                            esp_event_base_t event_base,
+                            int32_t event_id,
+                            void* event_data,
+                            size_t event_data_size,
+                            BaseType_t* task_unblocked);
+#endif
+
 /**
  * @brief Dumps statistics of all event loops.
  *
@@ -298,6 +358,16 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
            total_recieved - number of successfully posted events
            total_dropped - number of events unsucessfully posted due to queue being full
 
+       with CONFIG_EVENT_LOOP_POST_FROM_ISR enabled, both counts include events posted from ISRs
+
+       with CONFIG_EVENT_LOOP_POST_POOL enabled, the event loop line also shows
+       format: pool:used/size max:used_max miss:total_misses
+       where:
+           used - number of pool buffers holding the data of queued events
+           size - number of buffers in the pool
+           used_max - largest number of pool buffers in use at once
+           total_misses - number of posts whose data was allocated from the heap instead
+
    handler
        format: address ev:base,id inv:total_invoked run:total_runtime
        where:
@@ -16,11 +16,19 @@
 #define ESP_EVENT_INTERNAL_H_
 
 #include "esp_event.h"
+#include "esp_attr.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_IRAM_ISR
+/// Placement of the functions which post events from ISRs, which may run while the flash cache is disabled
+#define POST_ISR_ATTR                 IRAM_ATTR
+#else
+#define POST_ISR_ATTR
+#endif
+
 typedef SLIST_HEAD(base_nodes, base_node) base_nodes_t;
 
 /// Event handler
@@ -66,6 +74,21 @@ typedef struct esp_event_loop_node {
 
 typedef SLIST_HEAD(esp_event_loop_nodes, esp_event_loop_node) esp_event_loop_nodes_t;
 
+/// Handlers executed for an event, in the order they are executed
+typedef struct esp_event_dispatch_entry {
+    esp_event_base_t base;                                          /**< base of the event, NULL for the entry of
+                                                                            events with only loop level handlers */
+    int32_t id;                                                     /**< id of the event, ESP_EVENT_ANY_ID for the entry
+                                                                            of events with no id level handlers */
+    SLIST_ENTRY(esp_event_dispatch_entry) next;                     /**< next entry in the index bucket */
+    uint32_t handlers_num;                                          /**< number of handlers */
+    esp_event_handler_instance_t* handlers[];                       /**< handlers to execute */
+} esp_event_dispatch_entry_t;
+
+typedef SLIST_HEAD(esp_event_dispatch_entries, esp_event_dispatch_entry) esp_event_dispatch_entries_t;
+
+#define ESP_EVENT_DISPATCH_INDEX_BUCKETS    16                      /**< number of buckets in the dispatch index */
+
 /// Event loop
 typedef struct esp_event_loop_instance {
     const char* name;                                               /**< name of this event loop */
@@ -76,12 +99,37 @@ typedef struct esp_event_loop_instance {
     SemaphoreHandle_t mutex;                                        /**< mutex for updating the events linked list */
     esp_event_loop_nodes_t loop_nodes;                              /**< set of linked lists containing the
                                                                             registered handlers for the loop */
+    esp_event_dispatch_entries_t dispatch_index[ESP_EVENT_DISPATCH_INDEX_BUCKETS]; /**< handlers to execute for events with
+                                                                            base or id level handlers, hashed by
+                                                                            base and id */
+    esp_event_dispatch_entry_t* dispatch_any;                       /**< handlers to execute for other events */
+    bool dispatch_index_valid;                                      /**< index matches the registered handlers; if
+                                                                            false, dispatch walks the linked lists */
+    bool dispatch_index_dirty;                                      /**< handlers were (un)registered while
+                                                                            dispatching, index needs to be rebuilt */
+    uint32_t dispatch_depth;                                        /**< number of events being dispatched */
+    uint32_t dispatch_changes;                                      /**< number of times handlers were (un)registered
+                                                                            while dispatching */
+    esp_event_handler_instances_t handlers_unregistered;            /**< handlers unregistered while dispatching,
+                                                                            freed once the index is rebuilt */
 #ifdef CONFIG_EVENT_LOOP_PROFILING
     uint32_t events_recieved;                                       /**< number of events successfully posted to the loop */
     uint32_t events_dropped;                                        /**< number of events dropped due to queue being full */
+    portMUX_TYPE events_spinlock;                                   /**< spinlock for the event counters, which are
+                                                                            also updated from ISRs */
     SemaphoreHandle_t profiling_mutex;                              /**< mutex used for profiliing */
     SLIST_ENTRY(esp_event_loop_instance) next;                      /**< next event loop in the list */
 #endif
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+    uint8_t* pool;                                                  /**< buffers for the data of posted events */
+    void* pool_free;                                                /**< list of unused buffers in the pool */
+    portMUX_TYPE pool_spinlock;                                     /**< spinlock for the pool */
+    uint32_t pool_size;                                             /**< number of buffers in the pool */
+    uint32_t pool_used;                                             /**< number of buffers in use */
+    uint32_t pool_used_max;                                         /**< largest number of buffers in use */
+    uint32_t pool_misses;                                           /**< number of posts whose data had to be
+                                                                            allocated from the heap */
+#endif
 } esp_event_loop_instance_t;
 
 /// Event posted to the event queue
@@ -89,6 +137,11 @@ typedef struct esp_event_post_instance {
     esp_event_base_t base;                                           /**< the event base */
     int32_t id;                                                      /**< the event id */
     void* data;                                                      /**< data associated with the event */
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+    uint32_t data_isr;                                               /**< data of an event posted from an ISR, stored
+                                                                            in the post itself */
+    bool data_isr_set;                                               /**< data_isr holds the event data */
+#endif
 } esp_event_post_instance_t;
 
 #ifdef __cplusplus
@@ -14,6 +14,7 @@
 #include "esp_event_internal.h"
 
 #include "esp_heap_caps.h"
+#include "driver/timer.h"
 
 #include "sdkconfig.h"
 #include "unity.h"
@@ -1111,6 +1112,248 @@ TEST_CASE("events are dispatched in the order they are registered", "[event]")
     TEST_TEARDOWN();
 }
 
+static void test_unregister_other_handler(void* handler_arg, esp_event_base_t base, int32_t id, void* event_arg)
+{
+    esp_event_loop_handle_t* loop = (esp_event_loop_handle_t*) event_arg;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_unregister_with(*loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_2));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(*loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_3, handler_arg));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(*loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID, test_event_simple_handler_1, handler_arg));
+}
+
+TEST_CASE("handlers (un)registered while an event is dispatched apply to it", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create(&loop_args, &loop));
+
+    int count = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_1, &count));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_unregister_other_handler, &count));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_2, &count));
+
+    // test_event_simple_handler_2 is unregistered before it would execute, while test_event_simple_handler_3 and the
+    // loop level handler registered by test_unregister_other_handler execute after it
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &loop, sizeof(&loop), portMAX_DELAY));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_run(loop, pdMS_TO_TICKS(10)));
+    TEST_ASSERT_EQUAL(3, count);
+
+    TEST_ASSERT_FALSE(esp_event_is_handler_registered(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_2));
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_unregister_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_unregister_other_handler));
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &loop, sizeof(&loop), portMAX_DELAY));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_run(loop, pdMS_TO_TICKS(10)));
+    TEST_ASSERT_EQUAL(6, count);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_delete(loop));
+
+    TEST_TEARDOWN();
+}
+
+#define TEST_DISPATCH_BASES         10
+#define TEST_DISPATCH_IDS           15
+#define TEST_DISPATCH_EVENTS        1000
+
+TEST_CASE("dispatch time with many registered handlers", "[event]")
+{
+    TEST_SETUP();
+
+    const char test_base[] = "qwertyuiop";
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create(&loop_args, &loop));
+
+    int count = 0;
+
+    // A few loop and base level handlers, and an id level handler for each event
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID, test_event_simple_handler_1, &count));
+    for (int base = 0; base < TEST_DISPATCH_BASES; base++) {
+        if (base % 3 == 0) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, test_base + base, ESP_EVENT_ANY_ID, test_event_simple_handler_2, &count));
+        }
+        for (int id = 0; id < TEST_DISPATCH_IDS; id++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, test_base + base, id, test_event_simple_handler_3, &count));
+        }
+    }
+
+    esp_event_loop_instance_t* loop_instance = (esp_event_loop_instance_t*) loop;
+    TEST_ASSERT_TRUE(loop_instance->dispatch_index_valid);
+
+    uint32_t dispatch_ns[2];
+    int expected = 0;
+
+    // Compare dispatch using the index with walking the handler lists
+    for (int walk = 0; walk < 2; walk++) {
+        loop_instance->dispatch_index_valid = !walk;
+
+        int64_t elapsed = 0;
+        for (int i = 0; i < TEST_DISPATCH_EVENTS; i++) {
+            int base = i % TEST_DISPATCH_BASES;
+            int id = (i / TEST_DISPATCH_BASES) % TEST_DISPATCH_IDS;
+            expected += (base % 3 == 0) ? 3 : 2;
+
+            TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, test_base + base, id, NULL, 0, portMAX_DELAY));
+
+            // Runs the loop for one event
+            int64_t start = esp_timer_get_time();
+            TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_run(loop, 0));
+            elapsed += esp_timer_get_time() - start;
+        }
+
+        TEST_ASSERT_EQUAL(expected, count);
+        dispatch_ns[walk] = (uint32_t) (elapsed * 1000 / TEST_DISPATCH_EVENTS);
+    }
+
+    loop_instance->dispatch_index_valid = true;
+
+    ESP_LOGI(TAG, "%d handlers: %u ns per event with dispatch index, %u ns walking handler lists",
+             1 + (TEST_DISPATCH_BASES + 2) / 3 + TEST_DISPATCH_BASES * TEST_DISPATCH_IDS, dispatch_ns[0], dispatch_ns[1]);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_delete(loop));
+
+    TEST_TEARDOWN();
+}
+
+typedef struct {
+    int64_t posted;                         // time the event was posted
+    uint32_t seq;
+} test_latency_event_t;
+
+typedef struct {
+    int64_t total;
+    uint32_t count;
+    uint32_t errors;
+    SemaphoreHandle_t done;
+} test_latency_data_t;
+
+#define TEST_LATENCY_EVENTS 1000
+
+static void test_event_latency_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    test_latency_data_t* data = (test_latency_data_t*) event_handler_arg;
+    test_latency_event_t* ev = (test_latency_event_t*) event_data;
+
+    data->total += esp_timer_get_time() - ev->posted;
+    if (ev->seq != data->count) {
+        data->errors++;
+    }
+
+    data->count++;
+    xSemaphoreGive(data->done);
+}
+
+TEST_CASE("post-to-dispatch latency of events with data", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create(&loop_args, &loop));
+
+    test_latency_data_t data = {
+        .done = xSemaphoreCreateBinary()
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_latency_handler, &data));
+
+    // Post one event at a time and wait for it to be dispatched, so that the time spent in the queue
+    // behind other events is not counted
+    for (int i = 0; i < TEST_LATENCY_EVENTS; i++) {
+        test_latency_event_t ev = {
+            .posted = esp_timer_get_time(),
+            .seq = i
+        };
+        TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &ev, sizeof(ev), portMAX_DELAY));
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(data.done, pdMS_TO_TICKS(100)));
+    }
+
+    TEST_ASSERT_EQUAL(TEST_LATENCY_EVENTS, data.count);
+    TEST_ASSERT_EQUAL(0, data.errors);
+
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+    // The data of all events was stored in the pool
+    if (sizeof(test_latency_event_t) <= CONFIG_EVENT_LOOP_POST_POOL_DATA_SIZE) {
+        TEST_ASSERT_EQUAL(0, ((esp_event_loop_instance_t*) loop)->pool_misses);
+    }
+#endif
+
+    ESP_LOGI(TAG, "average post-to-dispatch latency: %d us", (int) (data.total / data.count));
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_delete(loop));
+
+    vSemaphoreDelete(data.done);
+
+    TEST_TEARDOWN();
+}
+
+#ifdef CONFIG_EVENT_LOOP_POST_POOL
+TEST_CASE("can post events with data while the post pool is in use", "[event]")
+{
+    if (sizeof(test_latency_event_t) > CONFIG_EVENT_LOOP_POST_POOL_DATA_SIZE) {
+        TEST_IGNORE_MESSAGE("test event data doesn't fit in the pool");
+    }
+
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+    loop_args.queue_size = 4;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create(&loop_args, &loop));
+
+    esp_event_loop_instance_t* loop_instance = (esp_event_loop_instance_t*) loop;
+
+    test_latency_data_t data = {
+        .done = xSemaphoreCreateBinary()
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, ESP_EVENT_ANY_ID, test_event_latency_handler, &data));
+
+    // Fill the queue, the data of each event is stored in the pool
+    for (int i = 0; i < loop_args.queue_size; i++) {
+        test_latency_event_t ev = {
+            .posted = esp_timer_get_time(),
+            .seq = i
+        };
+        TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &ev, sizeof(ev), 0));
+        TEST_ASSERT_EQUAL(i + 1, loop_instance->pool_used);
+    }
+
+    // Event data which doesn't fit in the pool is allocated from the heap, and freed if the post fails
+    uint8_t large_data[CONFIG_EVENT_LOOP_POST_POOL_DATA_SIZE + 1] = { 0 };
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV2, large_data, sizeof(large_data), 0));
+    TEST_ASSERT_EQUAL(1, loop_instance->pool_misses);
+    TEST_ASSERT_EQUAL(loop_args.queue_size, loop_instance->pool_used);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_run(loop, pdMS_TO_TICKS(10)));
+
+    TEST_ASSERT_EQUAL(loop_args.queue_size, data.count);
+    TEST_ASSERT_EQUAL(0, data.errors);
+    TEST_ASSERT_EQUAL(0, loop_instance->pool_used);
+    TEST_ASSERT_EQUAL(loop_args.queue_size, loop_instance->pool_used_max);
+
+    // Events still in the queue release their pool buffers when the loop is deleted
+    test_latency_event_t ev = { 0 };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &ev, sizeof(ev), 0));
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_delete(loop));
+
+    vSemaphoreDelete(data.done);
+
+    TEST_TEARDOWN();
+}
+#endif
+
 #ifdef CONFIG_EVENT_LOOP_PROFILING
 TEST_CASE("can dump event loop profile", "[event]")
 {
@@ -1164,3 +1407,113 @@ TEST_CASE("can dump event loop profile", "[event]")
     TEST_TEARDOWN();
 }
 #endif
+
+#ifdef CONFIG_EVENT_LOOP_POST_FROM_ISR
+#define TEST_ISR_TIMER_GROUP        0
+#define TEST_ISR_TIMER_NUMBER       0
+#define TEST_ISR_EVENTS             100
+
+typedef struct {
+    esp_event_loop_handle_t loop;
+    uint32_t posted;
+    uint32_t handled;
+    uint32_t failed;
+    SemaphoreHandle_t done;
+} test_isr_post_data_t;
+
+static intr_handle_t s_test_isr_handle;
+
+static void test_event_isr(void* args)
+{
+    TIMERG0.int_clr_timers.t0 = 1;
+    TIMERG0.hw_timer[TEST_ISR_TIMER_NUMBER].config.alarm_en = 1;
+
+    test_isr_post_data_t* data = (test_isr_post_data_t*) args;
+
+    if (data->loop == NULL || data->posted == TEST_ISR_EVENTS) {
+        return;
+    }
+
+    BaseType_t task_unblocked = pdFALSE;
+    if (esp_event_isr_post_to(data->loop, s_test_base1, TEST_EVENT_BASE1_EV1, &(data->posted), sizeof(data->posted),
+            &task_unblocked) == ESP_OK) {
+        data->posted++;
+    } else {
+        data->failed++;
+    }
+
+    if (task_unblocked == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void test_isr_post_handler(void* handler_arg, esp_event_base_t base, int32_t id, void* event_arg)
+{
+    test_isr_post_data_t* data = (test_isr_post_data_t*) handler_arg;
+
+    // Events from the ISR are dispatched in order, with the data they were posted with
+    TEST_ASSERT_EQUAL(data->handled, *((uint32_t*) event_arg));
+    data->handled++;
+
+    if (data->handled == TEST_ISR_EVENTS) {
+        xSemaphoreGive(data->done);
+    }
+}
+
+TEST_CASE("can post events from interrupt handler", "[event]")
+{
+    test_isr_post_data_t data = { 0 };
+
+    // The interrupt allocator keeps some memory after the interrupt is freed, so set up the timer interrupt
+    // before the memory in use is recorded
+    timer_config_t config = {
+        .alarm_en = 1,
+        .auto_reload = 1,
+        .counter_dir = TIMER_COUNT_UP,
+        .divider = 80,                  // 1 us per tick
+        .intr_type = TIMER_INTR_LEVEL,
+        .counter_en = TIMER_PAUSE
+    };
+    TEST_ESP_OK(timer_init(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, &config));
+    TEST_ESP_OK(timer_set_counter_value(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, 0));
+    TEST_ESP_OK(timer_set_alarm_value(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, 500));
+    TEST_ESP_OK(timer_enable_intr(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+    TEST_ESP_OK(timer_isr_register(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, test_event_isr, &data, 0, &s_test_isr_handle));
+
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create(&loop_args, &loop));
+
+    data.loop = loop;
+    data.done = xSemaphoreCreateBinary();
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_isr_post_handler, &data));
+
+    // Larger than the largest pool buffer, and not a specific event
+    uint8_t large_data[257] = { 0 };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_event_isr_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, large_data, sizeof(large_data), NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_event_isr_post_to(loop, ESP_EVENT_ANY_BASE, TEST_EVENT_BASE1_EV1, NULL, 0, NULL));
+
+    TEST_ESP_OK(timer_start(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+
+    TEST_ASSERT_TRUE(xSemaphoreTake(data.done, pdMS_TO_TICKS(1000)));
+
+    TEST_ESP_OK(timer_pause(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+
+    TEST_ASSERT_EQUAL(TEST_ISR_EVENTS, data.posted);
+    TEST_ASSERT_EQUAL(TEST_ISR_EVENTS, data.handled);
+    TEST_ASSERT_EQUAL(0, data.failed);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_delete(loop));
+
+    vSemaphoreDelete(data.done);
+
+    TEST_TEARDOWN();
+
+    TEST_ESP_OK(timer_disable_intr(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+    TEST_ESP_OK(esp_intr_free(s_test_isr_handle));
+}
+#endif
@@ -30,6 +30,17 @@ typedef struct {
     const esp_http_client_config_t *http_config;   /*!< ESP HTTP client configuration */
 } esp_https_ota_config_t;
 
+/**
+ * @brief ESP HTTPS OTA throughput statistics
+ */
+typedef struct {
+    int image_len;              /*!< Bytes of image data written so far */
+    uint32_t elapsed_ms;        /*!< Time since the first call to esp_https_ota_perform(), until all data was received */
+    uint32_t read_ms;           /*!< Time spent reading image data from the HTTP stream */
+    uint32_t write_ms;          /*!< Time spent writing image data to the OTA partition */
+    uint32_t read_wait_ms;      /*!< Time esp_https_ota_perform() waited for image data from the read task (only with CONFIG_OTA_PIPELINE) */
+} esp_https_ota_stats_t;
+
 #define ESP_ERR_HTTPS_OTA_BASE            (0x9000)
 #define ESP_ERR_HTTPS_OTA_IN_PROGRESS     (ESP_ERR_HTTPS_OTA_BASE + 1)  /* OTA operation in progress */
 
@@ -123,6 +134,11 @@ esp_err_t esp_https_ota_begin_with_pos(esp_https_ota_config_t *ota_config, esp_h
  * must be called only if esp_https_ota_begin() returns successfully.
  * This function must be called in a loop since it returns after every HTTP read operation thus 
  * giving you the flexibility to stop OTA operation midway.
+ *
+ * If CONFIG_OTA_PIPELINE is enabled, image data is read from the HTTP stream by a separate task
+ * while this function writes the previously read data, and each call writes one buffer of data.
+ * If no data is received within a second, this function returns ESP_ERR_HTTPS_OTA_IN_PROGRESS
+ * without writing.
  * 
  * @param[in]  https_ota_handle  pointer to esp_https_ota_handle_t structure
  *
@@ -204,6 +220,24 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
 */
 int esp_https_ota_get_image_len_read(esp_https_ota_handle_t https_ota_handle);
 
+/**
+ * @brief   Get throughput statistics of the HTTPS OTA Firmware upgrade
+ *
+ * If reading takes about as long as the whole upgrade, throughput is limited by the network.
+ * If writing does, it is limited by flash.
+ *
+ * @note    This API should be called only if `esp_https_ota_perform()` has been called at least once.
+ *
+ * @param[in]   https_ota_handle   pointer to esp_https_ota_handle_t structure
+ * @param[out]  stats              pointer to an allocated esp_https_ota_stats_t structure
+ *
+ * @return
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_FAIL: OTA upgrade has not started
+ *    - ESP_OK: Successfully read statistics
+ */
+esp_err_t esp_https_ota_get_stats(esp_https_ota_handle_t https_ota_handle, esp_https_ota_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
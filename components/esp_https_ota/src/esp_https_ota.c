@@ -18,7 +18,11 @@
 #include <esp_https_ota.h>
 #include <esp_log.h>
 #include <esp_ota_ops.h>
+#include <esp_timer.h>
 #include <errno.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
 
 #define IMAGE_HEADER_SIZE sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) + 1
 #define DEFAULT_OTA_BUF_SIZE IMAGE_HEADER_SIZE
@@ -31,6 +35,17 @@ typedef enum {
     ESP_HTTPS_OTA_SUCCESS,
 } esp_https_ota_state;
 
+#ifdef CONFIG_OTA_PIPELINE
+/* Longest time esp_https_ota_perform() waits for image data before it returns ESP_ERR_HTTPS_OTA_IN_PROGRESS */
+#define OTA_PIPELINE_WAIT_MS 1000
+
+/* Buffer passed between the read task and esp_https_ota_perform() */
+typedef struct {
+    char *data;
+    int len;    /* Length of image data. If data is NULL, the read task has finished: 0 if all data was received, -1 on error */
+} ota_pipeline_buf_t;
+#endif
+
 struct esp_https_ota_handle {
     esp_ota_handle_t update_handle;
     const esp_partition_t *update_partition;
@@ -39,6 +54,18 @@ struct esp_https_ota_handle {
     size_t ota_upgrade_buf_size;
     int binary_file_len;
     esp_https_ota_state state;
+    int64_t start_time;
+    int64_t end_time;
+    int64_t read_time;
+    int64_t write_time;
+    int64_t read_wait_time;
+#ifdef CONFIG_OTA_PIPELINE
+    char *pipeline_bufs;
+    QueueHandle_t free_queue;       /* buffers to be filled by the read task */
+    QueueHandle_t filled_queue;     /* buffers to be written to flash, and the end marker of the read task */
+    bool read_task_running;
+    volatile bool read_abort;
+#endif
 };
 
 typedef struct esp_https_ota_handle esp_https_ota_t;
@@ -123,7 +150,9 @@ static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffe
     if (buffer == NULL || https_ota_handle == NULL) {
         return ESP_FAIL;
     }
+    int64_t start = esp_timer_get_time();
     esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
+    https_ota_handle->write_time += esp_timer_get_time() - start;
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%d", err);
     } else {
@@ -134,6 +163,126 @@ static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffe
     return err;
 }
 
+static int _http_read(esp_https_ota_t *https_ota_handle, char *buffer, int len)
+{
+    int64_t start = esp_timer_get_time();
+    int data_read = esp_http_client_read(https_ota_handle->http_client, buffer, len);
+    https_ota_handle->read_time += esp_timer_get_time() - start;
+    return data_read;
+}
+
+#ifdef CONFIG_OTA_PIPELINE
+/* Reads image data into free buffers and passes them to esp_https_ota_perform() */
+static void _ota_read_task(void *arg)
+{
+    esp_https_ota_t *handle = (esp_https_ota_t *)arg;
+    ota_pipeline_buf_t buf = { 0 };
+    ota_pipeline_buf_t end = { .data = NULL, .len = -1 };
+
+    while (!handle->read_abort) {
+        if (buf.data == NULL) {
+            xQueueReceive(handle->free_queue, &buf, portMAX_DELAY);
+            continue;
+        }
+        buf.len = _http_read(handle, buf.data, CONFIG_OTA_PIPELINE_BUF_SIZE);
+        if (buf.len > 0) {
+            xQueueSend(handle->filled_queue, &buf, portMAX_DELAY);
+            buf.data = NULL;
+            continue;
+        }
+        /*
+         * esp_http_client_read() has already waited for the configured timeout, so a read without
+         * data before the complete image was received ends the download, whatever the errno is.
+         */
+        if (buf.len == 0 && esp_https_ota_is_complete_data_received(handle)) {
+            ESP_LOGI(TAG, "Connection closed");
+            end.len = 0;
+        } else {
+            ESP_LOGE(TAG, "Connection closed, read returned %d, errno = %d", buf.len, errno);
+        }
+        break;
+    }
+    /* The filled queue has room for all buffers and the end marker, so this doesn't block */
+    xQueueSend(handle->filled_queue, &end, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t _ota_read_task_start(esp_https_ota_t *handle)
+{
+    handle->pipeline_bufs = (char *)malloc(CONFIG_OTA_PIPELINE_BUF_COUNT * CONFIG_OTA_PIPELINE_BUF_SIZE);
+    handle->free_queue = xQueueCreate(CONFIG_OTA_PIPELINE_BUF_COUNT, sizeof(ota_pipeline_buf_t));
+    handle->filled_queue = xQueueCreate(CONFIG_OTA_PIPELINE_BUF_COUNT + 1, sizeof(ota_pipeline_buf_t));
+    if (!handle->pipeline_bufs || !handle->free_queue || !handle->filled_queue) {
+        ESP_LOGE(TAG, "Couldn't allocate memory to upgrade data buffers");
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < CONFIG_OTA_PIPELINE_BUF_COUNT; i++) {
+        ota_pipeline_buf_t buf = { .data = handle->pipeline_bufs + i * CONFIG_OTA_PIPELINE_BUF_SIZE, .len = 0 };
+        xQueueSend(handle->free_queue, &buf, 0);
+    }
+    if (xTaskCreate(_ota_read_task, "ota_read", CONFIG_OTA_PIPELINE_TASK_STACK_SIZE, handle,
+                    CONFIG_OTA_PIPELINE_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Couldn't create OTA read task");
+        return ESP_ERR_NO_MEM;
+    }
+    handle->read_task_running = true;
+    return ESP_OK;
+}
+
+/* Stops the read task, returning the buffers it has filled until it sends the end marker */
+static void _ota_read_task_stop(esp_https_ota_t *handle)
+{
+    if (!handle->read_task_running) {
+        return;
+    }
+    handle->read_abort = true;
+    ota_pipeline_buf_t buf;
+    do {
+        xQueueReceive(handle->filled_queue, &buf, portMAX_DELAY);
+        if (buf.data != NULL) {
+            xQueueSend(handle->free_queue, &buf, 0);
+        }
+    } while (buf.data != NULL);
+    handle->read_task_running = false;
+}
+
+static void _ota_pipeline_free(esp_https_ota_t *handle)
+{
+    if (handle->filled_queue) {
+        vQueueDelete(handle->filled_queue);
+    }
+    if (handle->free_queue) {
+        vQueueDelete(handle->free_queue);
+    }
+    free(handle->pipeline_bufs);
+}
+
+/* Writes the next buffer filled by the read task */
+static esp_err_t _ota_pipeline_write(esp_https_ota_t *handle)
+{
+    ota_pipeline_buf_t buf;
+    int64_t start = esp_timer_get_time();
+    BaseType_t received = xQueueReceive(handle->filled_queue, &buf, pdMS_TO_TICKS(OTA_PIPELINE_WAIT_MS));
+    handle->read_wait_time += esp_timer_get_time() - start;
+    if (received != pdTRUE) {
+        return ESP_ERR_HTTPS_OTA_IN_PROGRESS;
+    }
+
+    if (buf.data == NULL) {
+        handle->read_task_running = false;
+        if (buf.len < 0) {
+            return ESP_FAIL;
+        }
+        handle->end_time = esp_timer_get_time();
+        handle->state = ESP_HTTPS_OTA_SUCCESS;
+        return ESP_OK;
+    }
+    esp_err_t err = _ota_write(handle, (const void *)buf.data, buf.len);
+    xQueueSend(handle->free_queue, &buf, 0);
+    return err;
+}
+#endif // CONFIG_OTA_PIPELINE
+
 esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_handle_t *handle)
 {
     esp_err_t err;
@@ -348,26 +497,43 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
     }
 
     esp_err_t err;
+#ifndef CONFIG_OTA_PIPELINE
     int data_read;
+#endif
     switch (handle->state) {
         case ESP_HTTPS_OTA_BEGIN:
+            handle->start_time = esp_timer_get_time();
+#ifdef CONFIG_OTA_PIPELINE
+            /* Sectors are erased as they are written, while the read task receives the next data */
+            err = esp_ota_begin(handle->update_partition, OTA_WITH_SEQUENTIAL_WRITES, &handle->update_handle);
+#else
             err = esp_ota_begin(handle->update_partition, OTA_SIZE_UNKNOWN, &handle->update_handle);
+#endif
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
                 return err;
             }
             handle->state = ESP_HTTPS_OTA_IN_PROGRESS;
+#ifdef CONFIG_OTA_PIPELINE
+            err = _ota_read_task_start(handle);
+            if (err != ESP_OK) {
+                return err;
+            }
+#endif
             /* In case `esp_https_ota_read_img_desc` was invoked first,
                then the image data read there should be written to OTA partition
                */
             if (handle->binary_file_len) {
-                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, handle->binary_file_len);
+                int header_len = handle->binary_file_len;
+                handle->binary_file_len = 0;
+                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, header_len);
             }
             /* falls through */
         case ESP_HTTPS_OTA_IN_PROGRESS:
-            data_read = esp_http_client_read(handle->http_client,
-                                             handle->ota_upgrade_buf,
-                                             handle->ota_upgrade_buf_size);
+#ifdef CONFIG_OTA_PIPELINE
+            return _ota_pipeline_write(handle);
+#else
+            data_read = _http_read(handle, handle->ota_upgrade_buf, handle->ota_upgrade_buf_size);
             if (data_read == 0) {
                 /*
                  *  esp_https_ota_is_complete_data_received is added to check whether
@@ -391,8 +557,10 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
             } else if (data_read > 0) {
                 return _ota_write(handle, (const void *)handle->ota_upgrade_buf, data_read);
             }
+            handle->end_time = esp_timer_get_time();
             handle->state = ESP_HTTPS_OTA_SUCCESS;
             break;
+#endif
          default:
             ESP_LOGE(TAG, "Invalid ESP HTTPS OTA State");
             return ESP_FAIL;
@@ -417,6 +585,10 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
         return ESP_FAIL;
     }
 
+#ifdef CONFIG_OTA_PIPELINE
+    _ota_read_task_stop(handle);
+#endif
+
     esp_err_t err = ESP_OK;
     switch (handle->state) {
         case ESP_HTTPS_OTA_SUCCESS:
@@ -427,6 +599,9 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
             if (handle->ota_upgrade_buf) {
                 free(handle->ota_upgrade_buf);
             }
+#ifdef CONFIG_OTA_PIPELINE
+            _ota_pipeline_free(handle);
+#endif
             if (handle->http_client) {
                 _http_cleanup(handle->http_client);
             }
@@ -436,6 +611,15 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
             break;
     }
 
+    if (handle->state == ESP_HTTPS_OTA_SUCCESS) {
+        esp_https_ota_stats_t stats;
+        esp_https_ota_get_stats(handle, &stats);
+        ESP_LOGI(TAG, "Received %d bytes in %u ms (%u KB/s), reading %u ms, writing %u ms",
+                 handle->binary_file_len, stats.elapsed_ms,
+                 stats.elapsed_ms ? (uint32_t)((uint64_t)handle->binary_file_len * 1000 / 1024 / stats.elapsed_ms) : 0,
+                 stats.read_ms, stats.write_ms);
+    }
+
     if ((err == ESP_OK) && (handle->state == ESP_HTTPS_OTA_SUCCESS)) {
         esp_err_t err = esp_ota_set_boot_partition(handle->update_partition);
         if (err != ESP_OK) {
@@ -458,6 +642,24 @@ int esp_https_ota_get_image_len_read(esp_https_ota_handle_t https_ota_handle)
     return handle->binary_file_len;
 }
 
+esp_err_t esp_https_ota_get_stats(esp_https_ota_handle_t https_ota_handle, esp_https_ota_stats_t *stats)
+{
+    esp_https_ota_t *handle = (esp_https_ota_t *)https_ota_handle;
+    if (handle == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->state < ESP_HTTPS_OTA_IN_PROGRESS) {
+        return ESP_FAIL;
+    }
+    int64_t end_time = (handle->state == ESP_HTTPS_OTA_SUCCESS) ? handle->end_time : esp_timer_get_time();
+    stats->image_len = handle->binary_file_len;
+    stats->elapsed_ms = (end_time - handle->start_time) / 1000;
+    stats->read_ms = handle->read_time / 1000;
+    stats->write_ms = handle->write_time / 1000;
+    stats->read_wait_ms = handle->read_wait_time / 1000;
+    return ESP_OK;
+}
+
 esp_err_t esp_https_ota(const esp_http_client_config_t *config)
 {
     if (!config) {
@@ -0,0 +1,6 @@
+#define CONFIG_OTA_ALLOW_HTTP 1
+#define CONFIG_OTA_PIPELINE 1
+#define CONFIG_OTA_PIPELINE_BUF_SIZE 4096
+#define CONFIG_OTA_PIPELINE_BUF_COUNT 2
+#define CONFIG_OTA_PIPELINE_TASK_PRIORITY 5
+#define CONFIG_OTA_PIPELINE_TASK_STACK_SIZE 4096
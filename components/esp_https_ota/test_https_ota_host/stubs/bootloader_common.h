@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t bytes[24];
+} esp_image_header_t;
+
+typedef struct {
+    uint32_t load_addr;
+    uint32_t data_len;
+} esp_image_segment_header_t;
+
+typedef struct {
+    uint8_t bytes[256];
+} esp_app_desc_t;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef struct {
+    const char *url;
+    const char *cert_pem;
+    int buffer_size;
+} esp_http_client_config_t;
+
+typedef enum {
+    HttpStatus_Ok               = 200,
+    HttpStatus_MovedPermanently = 301,
+    HttpStatus_Found            = 302,
+    HttpStatus_Unauthorized     = 401,
+} HttpStatus_Code;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client);
+void esp_http_client_add_auth(esp_http_client_handle_t client);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define configTICK_RATE_HZ      1000
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define portMAX_DELAY           0xffffffff
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  pdTRUE
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *TaskHandle_t;
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack_depth, void *arg,
+                       int priority, TaskHandle_t *created_task);
+void vTaskDelete(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,137 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include "catch.hpp"
+#include "esp_https_ota.h"
+#include "test_stubs.h"
+
+static test_ota_config_t image_config(int image_len)
+{
+    test_ota_config_t config = {};
+    config.image_len = image_len;
+    config.close_at = -1;
+    config.write_fail_at = -1;
+    return config;
+}
+
+static esp_https_ota_handle_t begin_ota(const test_ota_config_t &config)
+{
+    test_ota_reset(&config);
+    esp_http_client_config_t http_config = {};
+    http_config.url = "http://example.com/image.bin";
+    esp_https_ota_config_t ota_config = {};
+    ota_config.http_config = &http_config;
+    esp_https_ota_handle_t handle = NULL;
+    REQUIRE(esp_https_ota_begin(&ota_config, &handle) == ESP_OK);
+    return handle;
+}
+
+static esp_err_t perform_ota(esp_https_ota_handle_t handle)
+{
+    esp_err_t err;
+    do {
+        err = esp_https_ota_perform(handle);
+    } while (err == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+    return err;
+}
+
+TEST_CASE("pipelined update writes the image in order", "[https_ota]")
+{
+    const int image_len = 300001;
+    esp_https_ota_handle_t handle = begin_ota(image_config(image_len));
+    CHECK(perform_ota(handle) == ESP_OK);
+    CHECK(esp_https_ota_get_image_len_read(handle) == image_len);
+    CHECK(test_ota_written() == image_len);
+    CHECK(esp_https_ota_finish(handle) == ESP_OK);
+    CHECK(test_ota_wait_tasks_deleted(1000));
+}
+
+TEST_CASE("image description is written before the pipelined data", "[https_ota]")
+{
+    const int image_len = 100000;
+    esp_https_ota_handle_t handle = begin_ota(image_config(image_len));
+    esp_app_desc_t app_desc;
+    CHECK(esp_https_ota_get_img_desc(handle, &app_desc) == ESP_OK);
+    CHECK(perform_ota(handle) == ESP_OK);
+    CHECK(test_ota_written() == image_len);
+    CHECK(esp_https_ota_finish(handle) == ESP_OK);
+    CHECK(test_ota_wait_tasks_deleted(1000));
+}
+
+TEST_CASE("read without data ends the pipelined update whatever the errno is", "[https_ota]")
+{
+    const struct {
+        int result;
+        int err;
+    } closes[] = {
+        { 0, ECONNRESET },
+        { 0, ENOTCONN },
+        { 0, 0 },
+        { 0, EAGAIN },
+        { -1, 0 },
+        { -1, ECONNRESET },
+    };
+    for (auto close : closes) {
+        test_ota_config_t config = image_config(100000);
+        config.close_at = 50000;
+        config.close_result = close.result;
+        config.close_errno = close.err;
+        esp_https_ota_handle_t handle = begin_ota(config);
+        CHECK(perform_ota(handle) == ESP_FAIL);
+        CHECK(test_ota_written() == 50000);
+        CHECK(esp_https_ota_finish(handle) != ESP_OK);
+        CHECK(test_ota_wait_tasks_deleted(1000));
+    }
+}
+
+TEST_CASE("write failure stops the read task", "[https_ota]")
+{
+    test_ota_config_t config = image_config(100000);
+    config.write_fail_at = 20000;
+    esp_https_ota_handle_t handle = begin_ota(config);
+    CHECK(perform_ota(handle) == ESP_FAIL);
+    CHECK(test_ota_written() < 20000);
+    CHECK(esp_https_ota_finish(handle) != ESP_OK);
+    CHECK(test_ota_wait_tasks_deleted(1000));
+}
+
+TEST_CASE("finish during the pipelined update stops the read task", "[https_ota]")
+{
+    test_ota_config_t config = image_config(1024 * 1024);
+    config.read_delay_ms = 1;
+    esp_https_ota_handle_t handle = begin_ota(config);
+    for (int i = 0; i < 3; i++) {
+        CHECK(esp_https_ota_perform(handle) == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+    }
+    CHECK(esp_https_ota_finish(handle) != ESP_OK);
+    CHECK(test_ota_wait_tasks_deleted(1000));
+}
+
+TEST_CASE("pipelined perform returns while waiting for image data", "[https_ota]")
+{
+    const int image_len = 4096;
+    test_ota_config_t config = image_config(image_len);
+    config.read_delay_ms = 1200;
+    esp_https_ota_handle_t handle = begin_ota(config);
+    CHECK(esp_https_ota_perform(handle) == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+    CHECK(esp_https_ota_get_image_len_read(handle) == 0);
+    CHECK(perform_ota(handle) == ESP_OK);
+    CHECK(test_ota_written() == image_len);
+    esp_https_ota_stats_t stats;
+    CHECK(esp_https_ota_get_stats(handle, &stats) == ESP_OK);
+    CHECK(stats.read_wait_ms >= 1000);
+    CHECK(esp_https_ota_finish(handle) == ESP_OK);
+    CHECK(test_ota_wait_tasks_deleted(1000));
+}
@@ -0,0 +1,321 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "test_stubs.h"
+
+/* Reads of a closed connection after which the reader is considered to spin */
+#define MAX_READS_AFTER_CLOSE 1000
+
+static test_ota_config_t s_config;
+static int s_sent;
+static int s_reads_after_close;
+static int s_written;
+static int s_tasks;
+
+static char image_byte(int offset)
+{
+    return (char)(offset * 7 + offset / 251);
+}
+
+void test_ota_reset(const test_ota_config_t *config)
+{
+    s_config = *config;
+    s_sent = 0;
+    s_reads_after_close = 0;
+    s_written = 0;
+}
+
+int test_ota_written(void)
+{
+    return s_written;
+}
+
+bool test_ota_wait_tasks_deleted(int timeout_ms)
+{
+    for (int i = 0; i < timeout_ms && __atomic_load_n(&s_tasks, __ATOMIC_SEQ_CST) > 0; i++) {
+        usleep(1000);
+    }
+    return __atomic_load_n(&s_tasks, __ATOMIC_SEQ_CST) == 0;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return "ERROR";
+}
+
+/* Queues and tasks on top of pthreads, one tick is a millisecond */
+
+struct queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    int length;
+    int item_size;
+    int head;
+    int count;
+    char *items;
+};
+
+QueueHandle_t xQueueCreate(int length, int item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct queue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->items = malloc(length * item_size);
+    return queue;
+}
+
+static bool queue_wait(QueueHandle_t queue, bool for_space, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (ticks_to_wait != portMAX_DELAY) {
+        deadline.tv_sec += ticks_to_wait / 1000;
+        deadline.tv_nsec += (ticks_to_wait % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    while (for_space ? queue->count == queue->length : queue->count == 0) {
+        if (ticks_to_wait == 0) {
+            return false;
+        }
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&queue->changed, &queue->mutex);
+        } else if (pthread_cond_timedwait(&queue->changed, &queue->mutex, &deadline) == ETIMEDOUT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!queue_wait(queue, true, ticks_to_wait)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!queue_wait(queue, false, ticks_to_wait)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+    free(queue);
+}
+
+typedef struct {
+    void (*task)(void *);
+    void *arg;
+} task_start_t;
+
+static void *task_thread(void *arg)
+{
+    task_start_t start = *(task_start_t *)arg;
+    free(arg);
+    start.task(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack_depth, void *arg,
+                       int priority, TaskHandle_t *created_task)
+{
+    pthread_t thread;
+    task_start_t *start = malloc(sizeof(task_start_t));
+    start->task = task;
+    start->arg = arg;
+    __atomic_add_fetch(&s_tasks, 1, __ATOMIC_SEQ_CST);
+    if (pthread_create(&thread, NULL, task_thread, start) != 0) {
+        __atomic_sub_fetch(&s_tasks, 1, __ATOMIC_SEQ_CST);
+        free(start);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    __atomic_sub_fetch(&s_tasks, 1, __ATOMIC_SEQ_CST);
+    pthread_exit(NULL);
+}
+
+/* HTTP server sending the test image */
+
+struct esp_http_client {
+    bool open;
+};
+
+static struct esp_http_client s_client;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    return &s_client;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    client->open = true;
+    return ESP_OK;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    return s_config.image_len;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return HttpStatus_Ok;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+void esp_http_client_add_auth(esp_http_client_handle_t client)
+{
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    return ESP_OK;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    usleep(s_config.read_delay_ms * 1000);
+    errno = 0;
+    if (s_config.close_at >= 0 && s_sent >= s_config.close_at) {
+        if (++s_reads_after_close > MAX_READS_AFTER_CLOSE) {
+            printf("Connection closed at %d, but reading goes on\n", s_sent);
+            abort();
+        }
+        errno = s_config.close_errno;
+        return s_config.close_result;
+    }
+    int read_len = s_config.image_len - s_sent;
+    if (s_config.close_at >= 0 && s_config.close_at - s_sent < read_len) {
+        read_len = s_config.close_at - s_sent;
+    }
+    if (read_len > len) {
+        read_len = len;
+    }
+    for (int i = 0; i < read_len; i++) {
+        buffer[i] = image_byte(s_sent + i);
+    }
+    s_sent += read_len;
+    return read_len;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return s_sent == s_config.image_len;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    client->open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+/* OTA partition checking the written data */
+
+static const esp_partition_t s_partition = { .subtype = 0x10, .address = 0x110000 };
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return &s_partition;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (s_config.write_fail_at >= 0 && s_written + (int)size > s_config.write_fail_at) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (((const char *)data)[i] != image_byte(s_written + i)) {
+            printf("Wrong image data written at %d\n", s_written + (int)i);
+            return ESP_FAIL;
+        }
+    }
+    s_written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    return (s_written == s_config.image_len) ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,44 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Behaviour of the HTTP server and the OTA partition seen by esp_https_ota */
+typedef struct {
+    int image_len;          /* Length of the image sent by the server */
+    int read_delay_ms;      /* Time each esp_http_client_read() call takes */
+    int close_at;           /* Offset after which reads return close_result and set errno to close_errno, -1 for none */
+    int close_result;
+    int close_errno;
+    int write_fail_at;      /* Offset at which esp_ota_write() fails, -1 for none */
+} test_ota_config_t;
+
+/* Starts a new update with the given server and partition behaviour */
+void test_ota_reset(const test_ota_config_t *config);
+
+/* Number of image bytes written to the OTA partition, all of them checked against the sent data */
+int test_ota_written(void);
+
+/* Waits until all tasks created by esp_https_ota are deleted, returns false on timeout */
+bool test_ota_wait_tasks_deleted(int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
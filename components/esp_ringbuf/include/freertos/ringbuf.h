@@ -81,6 +81,30 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
  */
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum);
 
+/**
+ * @brief       Create a single producer, single consumer ring buffer
+ *
+ * This API is similar to xRingbufferCreate(), but creates a ring buffer which
+ * is accessed without a critical section. Sending and receiving items do not
+ * take the ring buffer's spinlock, and only give a semaphore when the other
+ * side is blocked waiting for space or for items.
+ *
+ * All items must be sent by the same task or ISR (the producer), and all items
+ * must be retrieved and returned by the same task or ISR (the consumer).
+ *
+ * @param[in]   xBufferSize Size of the buffer in bytes. Note that items require
+ *              space for overhead in no-split buffers
+ * @param[in]   xBufferType Type of ring buffer, RINGBUF_TYPE_NOSPLIT or RINGBUF_TYPE_BYTEBUF.
+ *
+ * @note    The ring buffer allocates one extra byte (byte buffers) or 4 extra bytes (no-split buffers)
+ *          of storage, so that it can hold xBufferSize bytes.
+ * @note    The ring buffer can't be added to a queue set.
+ *
+ * @return  A handle to the created ring buffer, or NULL in case of error or
+ *          if the type is RINGBUF_TYPE_ALLOWSPLIT.
+ */
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, ringbuf_type_t xBufferType);
+
 /**
  * @brief       Insert an item into the ring buffer
  *
@@ -103,6 +127,30 @@ RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum);
  */
 BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait);
 
+/**
+ * @brief       Insert multiple items into the ring buffer
+ *
+ * Attempt to insert xItemNum items into the ring buffer, in order. Each time
+ * this function obtains access to the ring buffer, it copies as many of the
+ * remaining items as currently fit, and then wakes up a waiting receiver once.
+ * This is cheaper than calling xRingbufferSend() for each item. This function
+ * will block until all items are sent or until it timesout.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to insert the items into
+ * @param[in]   ppvItems        Array of pointers to data to insert. NULL is allowed for items of size 0.
+ * @param[in]   pxItemSizes     Array of sizes of data to insert
+ * @param[in]   xItemNum        Number of items to insert
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note    Other tasks sending to the same ring buffer may insert their items
+ *          in between the items of this call.
+ *
+ * @return  Number of items which were sent. Items are sent in order, so this
+ *          is less than xItemNum on time-out. 0 if any item is larger than the
+ *          maximum permissible size of the buffer.
+ */
+size_t xRingbufferSendMultiple(RingbufHandle_t xRingbuffer, const void * const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait);
+
 /**
  * @brief       Insert an item into the ring buffer in an ISR
  *
@@ -255,6 +303,27 @@ void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer, size_t *pxItemSize, Ti
  */
 void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize, size_t xMaxSize);
 
+/**
+ * @brief   Retrieve multiple items from a no-split ring buffer
+ *
+ * Attempt to retrieve up to xMaxItems items from the ring buffer at once. This
+ * function will block until at least one item is available or until it
+ * timesout, and then retrieve all available items up to xMaxItems.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to retrieve the items from
+ * @param[out]  ppvItems        Array of at least xMaxItems elements, to which pointers to the retrieved items will be written.
+ * @param[out]  pxItemSizes     Array of at least xMaxItems elements, to which the sizes of the retrieved items will be written.
+ * @param[in]   xMaxItems       Maximum number of items to retrieve.
+ * @param[in]   xTicksToWait    Ticks to wait for items in the ring buffer.
+ *
+ * @note    The retrieved items must be returned with vRingbufferReturnMultiple() or vRingbufferReturnItem().
+ * @note    This function should only be called on no-split buffers. Byte buffers can retrieve any
+ *          amount of data with a single call to xRingbufferReceiveUpTo().
+ *
+ * @return  Number of items retrieved, 0 on timeout.
+ */
+size_t xRingbufferReceiveMultiple(RingbufHandle_t xRingbuffer, void **ppvItems, size_t *pxItemSizes, size_t xMaxItems, TickType_t xTicksToWait);
+
 /**
  * @brief   Return a previously-retrieved item to the ring buffer
  *
@@ -277,6 +346,18 @@ void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
  */
 void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief   Return multiple previously-retrieved items to the ring buffer
+ *
+ * Equivalent to calling vRingbufferReturnItem() for each item, but only
+ * accesses the ring buffer and wakes up waiting senders once.
+ *
+ * @param[in]   xRingbuffer Ring buffer the items were retrieved from
+ * @param[in]   ppvItems    Array of items that were received earlier
+ * @param[in]   xItemNum    Number of items to return
+ */
+void vRingbufferReturnMultiple(RingbufHandle_t xRingbuffer, void * const *ppvItems, size_t xItemNum);
+
 /**
  * @brief   Delete a ring buffer
  *
@@ -323,6 +404,8 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer);
  * @param[in]   xRingbuffer     Ring buffer to add to the queue set
  * @param[in]   xQueueSet       Queue set to add the ring buffer's read semaphore to
  *
+ * @note    Ring buffers created by xRingbufferCreateSPSC() can't be added to a queue set.
+ *
  * @return
  *      - pdTRUE on success, pdFALSE otherwise
  */
@@ -27,6 +27,7 @@
 #define rbALLOW_SPLIT_FLAG          ( ( UBaseType_t ) 1 )   //The ring buffer allows items to be split
 #define rbBYTE_BUFFER_FLAG          ( ( UBaseType_t ) 2 )   //The ring buffer is a byte buffer
 #define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (write pointer == free pointer)
+#define rbSPSC_FLAG                 ( ( UBaseType_t ) 8 )   //The ring buffer has a single producer and a single consumer, and is accessed without locking
 
 //Item flags
 #define rbITEM_FREE_FLAG            ( ( UBaseType_t ) 1 )   //Item has been retrieved and returned by application, free to overwrite
@@ -40,6 +41,10 @@ typedef struct {
 } ItemHeader_t;
 
 #define rbHEADER_SIZE     sizeof(ItemHeader_t)
+
+//Access to the pointers shared between the producer and the consumer of SPSC ring buffers
+#define rbLOAD_ACQUIRE( xVar )              __atomic_load_n( &( xVar ), __ATOMIC_ACQUIRE )
+#define rbSTORE_RELEASE( xVar, xValue )     __atomic_store_n( &( xVar ), ( xValue ), __ATOMIC_RELEASE )
 typedef struct Ringbuffer_t Ringbuffer_t;
 typedef BaseType_t (*CheckItemFitsFunction_t)(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 typedef void (*CopyItemFunction_t)(Ringbuffer_t *pxRingbuffer, const uint8_t *pcItem, size_t xItemSize);
@@ -69,8 +74,24 @@ struct Ringbuffer_t {
     SemaphoreHandle_t xFreeSpaceSemaphore;      //Binary semaphore, wakes up writing threads when more free space becomes available or when another thread times out attempting to write
     SemaphoreHandle_t xItemsBufferedSemaphore;  //Binary semaphore, indicates there are new packets in the circular buffer. See remark.
     portMUX_TYPE mux;                           //Spinlock required for SMP
+
+    UBaseType_t uxItemsSent;                    //SPSC only: Number of items/bytes(for byte buffers) sent. Only written by the producer
+    UBaseType_t uxItemsReceived;                //SPSC only: Number of items/bytes(for byte buffers) retrieved. Only written by the consumer
+    BaseType_t xWriterWaiting;                  //SPSC only: Producer is about to block on xFreeSpaceSemaphore
+    BaseType_t xReaderWaiting;                  //SPSC only: Consumer is about to block on xItemsBufferedSemaphore
 };
 
+/*
+SPSC ring buffers: With a single producer and a single consumer, the producer is the only writer of pucWrite
+and the consumer is the only writer of pucRead and pucFree. Neither side needs the spinlock. The producer copies
+an item before publishing the new write pointer, and the consumer reads its items and marks them free before
+publishing the new free pointer. The write pointer never catches up with the free pointer (a gap of one byte
+or one aligned word is left), so pucWrite == pucFree always means the buffer is empty and rbBUFFER_FULL_FLAG
+and xItemsWaiting, which both sides would have to update, are not used.
+
+The semaphores are only given when the peer has set its waiting flag, i.e. when it is about to block.
+*/
+
 /*
 Remark: A counting semaphore for items_buffered_sem would be more logical, but counting semaphores in
 FreeRTOS need a maximum count, and allocate more memory the larger the maximum count is. Here, we
@@ -138,6 +159,74 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1,
 //Generic function used to retrieve an item/data from ring buffers in an ISR
 static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize);
 
+/**
+ * Generic function used to send items to ring buffers. As many items as fit are copied
+ * in each critical section, and waiting tasks are woken once for each critical section.
+ * Returns the number of items sent. The item sizes must already have been checked.
+ */
+static size_t prvSendGeneric(Ringbuffer_t *pxRingbuffer, const void * const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait);
+
+//Generic function used to retrieve up to xMaxItems items from no-split ring buffers in a single critical section
+static size_t prvReceiveMultipleGeneric(Ringbuffer_t *pxRingbuffer, void **ppvItems, size_t *pxItemSizes, size_t xMaxItems, TickType_t xTicksToWait);
+
+//Generic function used to create ring buffers. If xSPSC is pdTRUE, a SPSC ring buffer is created
+static RingbufHandle_t prvCreateGeneric(size_t xBufferSize, ringbuf_type_t xBufferType, BaseType_t xSPSC);
+
+/*
+ * The following static functions implement SPSC ring buffers. They do not require a
+ * critical section, but must only be called by the producer (send functions) or by
+ * the consumer (receive and return functions) of the ring buffer
+ */
+
+//Checks if an item will currently fit in a SPSC no-split ring buffer
+static BaseType_t prvCheckItemFitsNoSplitSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
+//Checks if an item will currently fit in a SPSC byte buffer
+static BaseType_t prvCheckItemFitsByteBufSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
+//Copies an item to a SPSC no-split ring buffer and publishes it to the consumer
+static void prvCopyItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+
+//Copies an item to a SPSC byte buffer and publishes it to the consumer
+static void prvCopyItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+
+//Checks if an item/data is currently available for retrieval from a SPSC ring buffer
+static BaseType_t prvCheckItemAvailSPSC(Ringbuffer_t *pxRingbuffer);
+
+//Retrieve item from a SPSC no-split ring buffer
+static void *prvGetItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xUnusedParam, size_t *pxItemSize);
+
+//Retrieve data from a SPSC byte buffer. If xMaxSize is 0, all continuous data is retrieved
+static void *prvGetItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxUnusedParam, size_t xMaxSize, size_t *pxItemSize);
+
+//Return an item to a SPSC no-split ring buffer and publish the freed space to the producer
+static void prvReturnItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Return data to a SPSC byte buffer and publish the freed space to the producer
+static void prvReturnItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Get the maximum size an item that can currently have if sent to a SPSC no-split ring buffer
+static size_t prvGetCurMaxSizeNoSplitSPSC(Ringbuffer_t *pxRingbuffer);
+
+//Get the maximum size an item that can currently have if sent to a SPSC byte buffer
+static size_t prvGetCurMaxSizeByteBufSPSC(Ringbuffer_t *pxRingbuffer);
+
+/**
+ * Wait for the peer of a SPSC ring buffer to set free space/items. The first call only sets
+ * *pxWaiting, after which the caller must check the ring buffer again before calling this
+ * function again to block. Returns pdFALSE on timeout.
+ */
+static BaseType_t prvWaitSPSC(BaseType_t *pxWaiting, SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait);
+
+//Give the semaphore of a SPSC ring buffer if its peer is waiting. pxHigherPriorityTaskWoken is only used in an ISR
+static void prvWakeSPSC(BaseType_t *pxWaiting, SemaphoreHandle_t xSemaphore, BaseType_t xInISR, BaseType_t *pxHigherPriorityTaskWoken);
+
+//Send items to a SPSC ring buffer. Returns the number of items sent. The item sizes must already have been checked
+static size_t prvSendSPSC(Ringbuffer_t *pxRingbuffer, const void * const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait);
+
+//Retrieve up to xMaxItems items/data from a SPSC ring buffer. Returns the number of items retrieved
+static size_t prvReceiveSPSC(Ringbuffer_t *pxRingbuffer, void **ppvItems, size_t *pxItemSizes, size_t xMaxItems, size_t xMaxSize, TickType_t xTicksToWait);
+
 /* ------------------------------------------------ Static Definitions ------------------------------------------- */
 
 static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
@@ -554,6 +643,11 @@ static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer)
 
 static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait)
 {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        //SPSC buffers never split items
+        return (prvReceiveSPSC(pxRingbuffer, pvItem1, xItemSize1, 1, xMaxSize, xTicksToWait) == 1) ? pdTRUE : pdFALSE;
+    }
+
     BaseType_t xReturn = pdFALSE;
     BaseType_t xReturnSemaphore = pdFALSE;
     TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
@@ -613,6 +707,10 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1,
 
 static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize)
 {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return (prvReceiveSPSC(pxRingbuffer, pvItem1, xItemSize1, 1, xMaxSize, 0) == 1) ? pdTRUE : pdFALSE;
+    }
+
     BaseType_t xReturn = pdFALSE;
     BaseType_t xReturnSemaphore = pdFALSE;
 
@@ -649,9 +747,413 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pv
     return xReturn;
 }
 
-/* ------------------------------------------------- Public Definitions -------------------------------------------- */
+static size_t prvSendGeneric(Ringbuffer_t *pxRingbuffer, const void * const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait)
+{
+    size_t xSent = 0;
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until more free space becomes available or timeout
+        if (xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE) {
+            break;
+        }
+        //Semaphore obtained, copy as many of the remaining items as fit
+        size_t xCopied = 0;
+        portENTER_CRITICAL(&pxRingbuffer->mux);
+        while (xSent + xCopied < xItemNum) {
+            size_t xItemSize = pxItemSizes[xSent + xCopied];
+            //Sending 0 bytes to byte buffer has no effect
+            if (xItemSize > 0 || (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) == 0) {
+                if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+                    break;
+                }
+                pxRingbuffer->vCopyItem(pxRingbuffer, ppvItems[xSent + xCopied], xItemSize);
+            }
+            xCopied++;
+        }
+        if (xSent + xCopied == xItemNum) {
+            //Check if the free semaphore should be returned to allow other tasks to send
+            if (prvGetFreeSize(pxRingbuffer) > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+        } else if (xTicksToWait != portMAX_DELAY) {
+            //Remaining items don't fit, adjust ticks and take the semaphore again
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        portEXIT_CRITICAL(&pxRingbuffer->mux);
 
-RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType)
+        if (xCopied > 0) {
+            //Indicate items were successfully sent
+            xSent += xCopied;
+            xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+        }
+        if (xSent == xItemNum) {
+            break;
+        }
+        /*
+         * Gap between critical section and re-acquiring of the semaphore. If
+         * semaphore is given now, priority inversion might occur (see docs)
+         */
+    }
+
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);  //Give back semaphore so other tasks can send
+    }
+    return xSent;
+}
+
+static size_t prvReceiveMultipleGeneric(Ringbuffer_t *pxRingbuffer, void **ppvItems, size_t *pxItemSizes, size_t xMaxItems, TickType_t xTicksToWait)
+{
+    size_t xReceived = 0;
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until more items become available or timeout
+        if (xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining) != pdTRUE) {
+            break;
+        }
+
+        //Semaphore obtained, retrieve as many items as are available
+        portENTER_CRITICAL(&pxRingbuffer->mux);
+        while (xReceived < xMaxItems && prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+            BaseType_t xIsSplit;
+            ppvItems[xReceived] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItemSizes[xReceived]);
+            xReceived++;
+        }
+        if (xReceived > 0) {
+            if (pxRingbuffer->xItemsWaiting > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+            portEXIT_CRITICAL(&pxRingbuffer->mux);
+            break;
+        }
+        //No item available for retrieval, adjust ticks and take the semaphore again
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        portEXIT_CRITICAL(&pxRingbuffer->mux);
+    }
+
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);  //Give semaphore back so other tasks can retrieve
+    }
+    return xReceived;
+}
+
+static BaseType_t prvCheckItemFitsNoSplitSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    uint8_t *pucWrite = pxRingbuffer->pucWrite;
+    uint8_t *pucFree = rbLOAD_ACQUIRE(pxRingbuffer->pucFree);
+    configASSERT(rbCHECK_ALIGNED(pucWrite));        //pucWrite is always aligned in no-split ring buffers
+    configASSERT(pucWrite >= pxRingbuffer->pucHead && pucWrite < pxRingbuffer->pucTail);    //Check write pointer is within bounds
+
+    size_t xTotalItemSize = rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE;    //Rounded up aligned item size with header
+    if (pucFree > pucWrite) {
+        //Free space does not wrap around. The write pointer must stay behind the free pointer
+        return (xTotalItemSize < pucFree - pucWrite) ? pdTRUE : pdFALSE;
+    }
+    //Free space wraps around (or buffer is empty)
+    if (xTotalItemSize <= pxRingbuffer->pucTail - pucWrite) {
+        //Item fits without wrapping around, unless the write pointer would then wrap around onto the free pointer
+        if (pxRingbuffer->pucTail - (pucWrite + xTotalItemSize) >= rbHEADER_SIZE || pucFree != pxRingbuffer->pucHead) {
+            return pdTRUE;
+        }
+    }
+    //Check if item fits by wrapping
+    return (xTotalItemSize < pucFree - pxRingbuffer->pucHead) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t prvCheckItemFitsByteBufSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    return (xItemSize <= prvGetCurMaxSizeByteBufSPSC(pxRingbuffer)) ? pdTRUE : pdFALSE;
+}
+
+static void prvCopyItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);  //Rounded up aligned item size
+    uint8_t *pucWrite = pxRingbuffer->pucWrite;
+
+    //If remaining length can't fit item, set as dummy data and wrap around
+    if (pxRingbuffer->pucTail - pucWrite < xAlignedItemSize + rbHEADER_SIZE) {
+        ItemHeader_t *pxDummy = (ItemHeader_t *)pucWrite;
+        pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;      //Set remaining length as dummy data
+        pxDummy->xItemLen = 0;                              //Dummy data should have no length
+        pucWrite = pxRingbuffer->pucHead;                   //Reset write pointer to wrap around
+    }
+
+    //Item should be guaranteed to fit at this point. Set item header and copy data
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pucWrite;
+    pxHeader->xItemLen = xItemSize;
+    pxHeader->uxItemFlags = 0;
+    memcpy(pucWrite + rbHEADER_SIZE, pucItem, xItemSize);
+    pucWrite += rbHEADER_SIZE + xAlignedItemSize;       //Advance past item to next aligned address
+
+    //If current remaining length can't fit a header, wrap around write pointer
+    if (pxRingbuffer->pucTail - pucWrite < rbHEADER_SIZE) {
+        pucWrite = pxRingbuffer->pucHead;
+    }
+    pxRingbuffer->uxItemsSent++;
+    //Publish the item (and any dummy data) to the consumer
+    rbSTORE_RELEASE(pxRingbuffer->pucWrite, pucWrite);
+}
+
+static void prvCopyItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    uint8_t *pucWrite = pxRingbuffer->pucWrite;
+    size_t xRemLen = pxRingbuffer->pucTail - pucWrite;  //Length from pucWrite until end of buffer
+
+    pxRingbuffer->uxItemsSent += xItemSize;
+    if (xRemLen <= xItemSize) {
+        //Copy as much as possible into remaining length, then wrap around
+        memcpy(pucWrite, pucItem, xRemLen);
+        pucItem += xRemLen;
+        xItemSize -= xRemLen;
+        pucWrite = pxRingbuffer->pucHead;
+    }
+    //Copy all or remaining portion of the item
+    memcpy(pucWrite, pucItem, xItemSize);
+    pucWrite += xItemSize;
+    //Publish the data to the consumer
+    rbSTORE_RELEASE(pxRingbuffer->pucWrite, pucWrite);
+}
+
+static BaseType_t prvCheckItemAvailSPSC(Ringbuffer_t *pxRingbuffer)
+{
+    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && pxRingbuffer->pucRead != pxRingbuffer->pucFree) {
+        return pdFALSE;     //Byte buffers do not allow multiple retrievals before return
+    }
+    return (pxRingbuffer->pucRead != rbLOAD_ACQUIRE(pxRingbuffer->pucWrite)) ? pdTRUE : pdFALSE;
+}
+
+static void *prvGetItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xUnusedParam, size_t *pxItemSize)
+{
+    //Check arguments and buffer state
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
+    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucRead));           //pucRead is always aligned in no-split ring buffers
+    configASSERT(pxRingbuffer->pucRead >= pxRingbuffer->pucHead && pxRingbuffer->pucRead < pxRingbuffer->pucTail);      //Check read pointer is within bounds
+
+    //Wrap around if dummy data (dummy data indicates wrap around in no-split buffers)
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        pxRingbuffer->pucRead = pxRingbuffer->pucHead;
+        pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
+    }
+    configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    uint8_t *pcReturn = pxRingbuffer->pucRead + rbHEADER_SIZE;    //Get pointer to part of item containing data (point past the header)
+    *pxItemSize = pxHeader->xItemLen;
+    *pxIsSplit = pdFALSE;
+    pxRingbuffer->uxItemsReceived++;
+
+    pxRingbuffer->pucRead += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);   //Update pucRead
+    //Check if pucRead requires wrap around
+    if ((pxRingbuffer->pucTail - pxRingbuffer->pucRead) < rbHEADER_SIZE) {
+        pxRingbuffer->pucRead = pxRingbuffer->pucHead;
+    }
+    return (void *)pcReturn;
+}
+
+static void *prvGetItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxUnusedParam, size_t xMaxSize, size_t *pxItemSize)
+{
+    uint8_t *pucWrite = rbLOAD_ACQUIRE(pxRingbuffer->pucWrite);
+    uint8_t *ret = pxRingbuffer->pucRead;
+    size_t xSize;
+    if (pucWrite > pxRingbuffer->pucRead) {
+        xSize = pucWrite - pxRingbuffer->pucRead;               //Available data is contiguous between read and write pointer
+    } else {
+        xSize = pxRingbuffer->pucTail - pxRingbuffer->pucRead;  //Available data wraps around, return data until buffer tail
+    }
+    if (xMaxSize != 0 && xSize > xMaxSize) {
+        xSize = xMaxSize;
+    }
+    *pxItemSize = xSize;
+    pxRingbuffer->uxItemsReceived += xSize;
+    pxRingbuffer->pucRead += xSize;
+    if (pxRingbuffer->pucRead == pxRingbuffer->pucTail) {
+        pxRingbuffer->pucRead = pxRingbuffer->pucHead;  //Wrap around read pointer
+    }
+    return (void *)ret;
+}
+
+static void prvReturnItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    //Check arguments and buffer state
+    configASSERT(rbCHECK_ALIGNED(pucItem));
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem <= pxRingbuffer->pucTail);     //Inclusive of pucTail in the case of zero length item at the very end
+
+    //Get and check header of the item
+    ItemHeader_t *pxCurHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+    configASSERT(pxCurHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    configASSERT((pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) == 0); //Dummy items should never have been read
+    configASSERT((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) == 0);       //Indicates item has already been returned before
+    pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;                           //Mark as free
+
+    /*
+     * Move the free pointer up to the next item that has not been returned, or up to the
+     * read pointer (see prvReturnItemDefault()). The items between the free pointer and the
+     * read pointer belong to the consumer, so they can be checked without a critical section
+     */
+    uint8_t *pucFree = pxRingbuffer->pucFree;
+    pxCurHeader = (ItemHeader_t *)pucFree;
+    while (pucFree != pxRingbuffer->pucRead && (pxCurHeader->uxItemFlags & (rbITEM_FREE_FLAG | rbITEM_DUMMY_DATA_FLAG))) {
+        if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+            pucFree = pxRingbuffer->pucHead;    //Wrap around due to dummy data
+        } else {
+            pucFree += rbALIGN_SIZE(pxCurHeader->xItemLen) + rbHEADER_SIZE;
+            configASSERT(pucFree <= pxRingbuffer->pucTail);
+        }
+        if ((pxRingbuffer->pucTail - pucFree) < rbHEADER_SIZE) {
+            pucFree = pxRingbuffer->pucHead;
+        }
+        pxCurHeader = (ItemHeader_t *)pucFree;
+    }
+    //Publish the freed space to the producer
+    rbSTORE_RELEASE(pxRingbuffer->pucFree, pucFree);
+}
+
+static void prvReturnItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    //Check pointer points to address inside buffer
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem < pxRingbuffer->pucTail);
+    //Free the read memory and publish it to the producer
+    rbSTORE_RELEASE(pxRingbuffer->pucFree, pxRingbuffer->pucRead);
+}
+
+static size_t prvGetCurMaxSizeNoSplitSPSC(Ringbuffer_t *pxRingbuffer)
+{
+    uint8_t *pucWrite = rbLOAD_ACQUIRE(pxRingbuffer->pucWrite);
+    uint8_t *pucFree = rbLOAD_ACQUIRE(pxRingbuffer->pucFree);
+    BaseType_t xFreeSize;
+    //Same conditions as prvCheckItemFitsNoSplitSPSC(), for the largest aligned item with its header
+    if (pucWrite < pucFree) {
+        xFreeSize = pucFree - pucWrite - rbALIGN_SIZE(1);
+    } else {
+        BaseType_t xSize1 = pxRingbuffer->pucTail - pucWrite;
+        BaseType_t xSize2 = pucFree - pxRingbuffer->pucHead - rbALIGN_SIZE(1);
+        if (pucFree == pxRingbuffer->pucHead) {
+            xSize1 -= rbHEADER_SIZE;        //Write pointer must not wrap around onto the free pointer
+        }
+        xFreeSize = (xSize1 > xSize2) ? xSize1 : xSize2;
+    }
+
+    //No-split ring buffer items need space for a header
+    xFreeSize -= rbHEADER_SIZE;
+    //Limit free size to be within bounds
+    if (xFreeSize > (BaseType_t)pxRingbuffer->xMaxItemSize) {
+        xFreeSize = pxRingbuffer->xMaxItemSize;
+    } else if (xFreeSize < 0) {
+        xFreeSize = 0;
+    }
+    return xFreeSize;
+}
+
+static size_t prvGetCurMaxSizeByteBufSPSC(Ringbuffer_t *pxRingbuffer)
+{
+    uint8_t *pucWrite = rbLOAD_ACQUIRE(pxRingbuffer->pucWrite);
+    uint8_t *pucFree = rbLOAD_ACQUIRE(pxRingbuffer->pucFree);
+    //One byte is always left free, so that a full buffer is not mistaken for an empty one
+    BaseType_t xFreeSize = pucFree - pucWrite - 1;
+    if (xFreeSize < 0) {
+        xFreeSize += pxRingbuffer->xSize;
+    }
+    return xFreeSize;
+}
+
+static BaseType_t prvWaitSPSC(BaseType_t *pxWaiting, SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait)
+{
+    if (__atomic_load_n(pxWaiting, __ATOMIC_RELAXED) == pdFALSE) {
+        /*
+         * Set the flag, then let the caller check the ring buffer again. Together with the
+         * barrier in prvWakeSPSC(), either the caller sees what the peer has just done, or the
+         * peer sees the flag and gives the semaphore.
+         */
+        __atomic_store_n(pxWaiting, pdTRUE, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        return pdTRUE;
+    }
+    //The semaphore may also have been given for an earlier wait, so the caller always checks again
+    return xSemaphoreTake(xSemaphore, xTicksToWait);
+}
+
+static void prvWakeSPSC(BaseType_t *pxWaiting, SemaphoreHandle_t xSemaphore, BaseType_t xInISR, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(pxWaiting, __ATOMIC_RELAXED) == pdTRUE) {
+        __atomic_store_n(pxWaiting, pdFALSE, __ATOMIC_RELAXED);
+        if (xInISR) {
+            xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken);
+        } else {
+            xSemaphoreGive(xSemaphore);
+        }
+    }
+}
+
+static size_t prvSendSPSC(Ringbuffer_t *pxRingbuffer, const void * const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait)
+{
+    size_t xSent = 0;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Copy as many of the remaining items as fit
+        size_t xCopied = 0;
+        while (xSent + xCopied < xItemNum) {
+            size_t xItemSize = pxItemSizes[xSent + xCopied];
+            if (xItemSize > 0 || (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) == 0) {
+                if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+                    break;
+                }
+                pxRingbuffer->vCopyItem(pxRingbuffer, ppvItems[xSent + xCopied], xItemSize);
+            }
+            xCopied++;
+        }
+        if (xCopied > 0) {
+            xSent += xCopied;
+            prvWakeSPSC(&pxRingbuffer->xReaderWaiting, pxRingbuffer->xItemsBufferedSemaphore, pdFALSE, NULL);
+        }
+        if (xSent == xItemNum) {
+            break;
+        }
+        //Remaining items don't fit, wait for the consumer to return items
+        if (xTicksToWait == 0 || prvWaitSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE) {
+            break;
+        }
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+    __atomic_store_n(&pxRingbuffer->xWriterWaiting, pdFALSE, __ATOMIC_RELAXED);
+    return xSent;
+}
+
+static size_t prvReceiveSPSC(Ringbuffer_t *pxRingbuffer, void **ppvItems, size_t *pxItemSizes, size_t xMaxItems, size_t xMaxSize, TickType_t xTicksToWait)
+{
+    size_t xReceived = 0;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        while (xReceived < xMaxItems && prvCheckItemAvailSPSC(pxRingbuffer) == pdTRUE) {
+            BaseType_t xIsSplit;
+            ppvItems[xReceived] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, xMaxSize, &pxItemSizes[xReceived]);
+            xReceived++;
+        }
+        if (xReceived > 0) {
+            break;
+        }
+        //No item available for retrieval, wait for the producer to send one
+        if (xTicksToWait == 0 || prvWaitSPSC(&pxRingbuffer->xReaderWaiting, pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining) != pdTRUE) {
+            break;
+        }
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+    __atomic_store_n(&pxRingbuffer->xReaderWaiting, pdFALSE, __ATOMIC_RELAXED);
+    return xReceived;
+}
+
+static RingbufHandle_t prvCreateGeneric(size_t xBufferSize, ringbuf_type_t xBufferType, BaseType_t xSPSC)
 {
     //Allocate memory
     Ringbuffer_t *pxRingbuffer = calloc(1, sizeof(Ringbuffer_t));
@@ -661,14 +1163,19 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
     if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
         xBufferSize = rbALIGN_SIZE(xBufferSize);    //xBufferSize is rounded up for no-split/allow-split buffers
     }
-    pxRingbuffer->pucHead = malloc(xBufferSize);
+    size_t xStorageSize = xBufferSize;
+    if (xSPSC == pdTRUE) {
+        //Storage for the gap which SPSC buffers leave between the write and free pointers (one byte or one aligned word)
+        xStorageSize += (xBufferType == RINGBUF_TYPE_BYTEBUF) ? 1 : rbALIGN_SIZE(1);
+    }
+    pxRingbuffer->pucHead = malloc(xStorageSize);
     if (pxRingbuffer->pucHead == NULL) {
         goto err;
     }
 
     //Initialize values
-    pxRingbuffer->xSize = xBufferSize;
-    pxRingbuffer->pucTail = pxRingbuffer->pucHead + xBufferSize;
+    pxRingbuffer->xSize = xStorageSize;
+    pxRingbuffer->pucTail = pxRingbuffer->pucHead + xStorageSize;
     pxRingbuffer->pucFree = pxRingbuffer->pucHead;
     pxRingbuffer->pucRead = pxRingbuffer->pucHead;
     pxRingbuffer->pucWrite = pxRingbuffer->pucHead;
@@ -678,7 +1185,24 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
     pxRingbuffer->uxRingbufferFlags = 0;
 
     //Initialize type dependent values and function pointers
-    if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
+    if (xSPSC == pdTRUE && xBufferType == RINGBUF_TYPE_NOSPLIT) {
+        pxRingbuffer->uxRingbufferFlags |= rbSPSC_FLAG;
+        pxRingbuffer->xCheckItemFits = prvCheckItemFitsNoSplitSPSC;
+        pxRingbuffer->vCopyItem = prvCopyItemNoSplitSPSC;
+        pxRingbuffer->pvGetItem = prvGetItemNoSplitSPSC;
+        pxRingbuffer->vReturnItem = prvReturnItemNoSplitSPSC;
+        //Same as for other no-split buffers, the gap is not included in the maximum item size
+        pxRingbuffer->xMaxItemSize = rbALIGN_SIZE(xBufferSize / 2) - rbHEADER_SIZE;
+        pxRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeNoSplitSPSC;
+    } else if (xSPSC == pdTRUE && xBufferType == RINGBUF_TYPE_BYTEBUF) {
+        pxRingbuffer->uxRingbufferFlags |= rbSPSC_FLAG | rbBYTE_BUFFER_FLAG;
+        pxRingbuffer->xCheckItemFits = prvCheckItemFitsByteBufSPSC;
+        pxRingbuffer->vCopyItem = prvCopyItemByteBufSPSC;
+        pxRingbuffer->pvGetItem = prvGetItemByteBufSPSC;
+        pxRingbuffer->vReturnItem = prvReturnItemByteBufSPSC;
+        pxRingbuffer->xMaxItemSize = xBufferSize;
+        pxRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeByteBufSPSC;
+    } else if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
         pxRingbuffer->xCheckItemFits = prvCheckItemFitsDefault;
         pxRingbuffer->vCopyItem = prvCopyItemNoSplit;
         pxRingbuffer->pvGetItem = prvGetItemDefault;
@@ -716,7 +1240,10 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
     if (pxRingbuffer->xFreeSpaceSemaphore == NULL || pxRingbuffer->xItemsBufferedSemaphore == NULL) {
         goto err;
     }
-    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    if (xSPSC == pdFALSE) {
+        //SPSC buffers only give the semaphore to wake up a blocked producer
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    }
     vPortCPUInitializeMutex(&pxRingbuffer->mux);
 
     return (RingbufHandle_t)pxRingbuffer;
@@ -736,11 +1263,26 @@ err:
     return NULL;
 }
 
+/* ------------------------------------------------- Public Definitions -------------------------------------------- */
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType)
+{
+    return prvCreateGeneric(xBufferSize, xBufferType, pdFALSE);
+}
+
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum)
 {
     return xRingbufferCreate((rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE) * xItemNum, RINGBUF_TYPE_NOSPLIT);
 }
 
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, ringbuf_type_t xBufferType)
+{
+    if (xBufferType != RINGBUF_TYPE_NOSPLIT && xBufferType != RINGBUF_TYPE_BYTEBUF) {
+        return NULL;    //Allow-split buffers are not supported
+    }
+    return prvCreateGeneric(xBufferSize, xBufferType, pdTRUE);
+}
+
 BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait)
 {
     //Check arguments
@@ -755,48 +1297,36 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size
     }
 
     //Attempt to send an item
-    BaseType_t xReturn = pdFALSE;
-    BaseType_t xReturnSemaphore = pdFALSE;
-    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
-    TickType_t xTicksRemaining = xTicksToWait;
-    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
-        //Block until more free space becomes available or timeout
-        if (xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE) {
-            xReturn = pdFALSE;
-            break;
-        }
-        //Semaphore obtained, check if item can fit
-        portENTER_CRITICAL(&pxRingbuffer->mux);
-        if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
-            //Item will fit, copy item
-            pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
-            xReturn = pdTRUE;
-            //Check if the free semaphore should be returned to allow other tasks to send
-            if (prvGetFreeSize(pxRingbuffer) > 0) {
-                xReturnSemaphore = pdTRUE;
-            }
-            portEXIT_CRITICAL(&pxRingbuffer->mux);
-            break;
-        }
-        //Item doesn't fit, adjust ticks and take the semaphore again
-        if (xTicksToWait != portMAX_DELAY) {
-            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
-        }
-        portEXIT_CRITICAL(&pxRingbuffer->mux);
-        /*
-         * Gap between critical section and re-acquiring of the semaphore. If
-         * semaphore is given now, priority inversion might occur (see docs)
-         */
+    size_t xSent;
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        xSent = prvSendSPSC(pxRingbuffer, &pvItem, &xItemSize, 1, xTicksToWait);
+    } else {
+        xSent = prvSendGeneric(pxRingbuffer, &pvItem, &xItemSize, 1, xTicksToWait);
     }
+    return (xSent == 1) ? pdTRUE : pdFALSE;
+}
 
-    if (xReturn == pdTRUE) {
-        //Indicate item was successfully sent
-        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+size_t xRingbufferSendMultiple(RingbufHandle_t xRingbuffer, const void * const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL && pxItemSizes != NULL);
+    for (size_t i = 0; i < xItemNum; i++) {
+        configASSERT(ppvItems[i] != NULL || pxItemSizes[i] == 0);
+        if (pxItemSizes[i] > pxRingbuffer->xMaxItemSize) {
+            return 0;       //Data will never ever fit in the queue.
+        }
     }
-    if (xReturnSemaphore == pdTRUE) {
-        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);  //Give back semaphore so other tasks can send
+    if (xItemNum == 0) {
+        return 0;
     }
-    return xReturn;
+
+    //Attempt to send the items
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSendSPSC(pxRingbuffer, ppvItems, pxItemSizes, xItemNum, xTicksToWait);
+    }
+    return prvSendGeneric(pxRingbuffer, ppvItems, pxItemSizes, xItemNum, xTicksToWait);
 }
 
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken)
@@ -812,6 +1342,15 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvIte
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+            return pdFALSE;
+        }
+        pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
+        prvWakeSPSC(&pxRingbuffer->xReaderWaiting, pxRingbuffer->xItemsBufferedSemaphore, pdTRUE, pxHigherPriorityTaskWoken);
+        return pdTRUE;
+    }
+
     //Attempt to send an item
     BaseType_t xReturn;
     BaseType_t xReturnSemaphore = pdFALSE;
@@ -991,12 +1530,36 @@ void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemS
     }
 }
 
+size_t xRingbufferReceiveMultiple(RingbufHandle_t xRingbuffer, void **ppvItems, size_t *pxItemSizes, size_t xMaxItems, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbBYTE_BUFFER_FLAG)) == 0);    //This function should only be called for no-split buffers
+    configASSERT(ppvItems != NULL && pxItemSizes != NULL);
+    if (xMaxItems == 0) {
+        return 0;
+    }
+
+    //Attempt to retrieve up to xMaxItems items
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvReceiveSPSC(pxRingbuffer, ppvItems, pxItemSizes, xMaxItems, 0, xTicksToWait);
+    }
+    return prvReceiveMultipleGeneric(pxRingbuffer, ppvItems, pxItemSizes, xMaxItems, xTicksToWait);
+}
+
 void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        prvWakeSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, pdFALSE, NULL);
+        return;
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     portEXIT_CRITICAL(&pxRingbuffer->mux);
@@ -1009,12 +1572,45 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        prvWakeSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, pdTRUE, pxHigherPriorityTaskWoken);
+        return;
+    }
+
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
     xSemaphoreGiveFromISR(pxRingbuffer->xFreeSpaceSemaphore, pxHigherPriorityTaskWoken);
 }
 
+void vRingbufferReturnMultiple(RingbufHandle_t xRingbuffer, void * const *ppvItems, size_t xItemNum)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL || xItemNum == 0);
+    if (xItemNum == 0) {
+        return;
+    }
+
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        for (size_t i = 0; i < xItemNum; i++) {
+            configASSERT(ppvItems[i] != NULL);
+            pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+        }
+        prvWakeSPSC(&pxRingbuffer->xWriterWaiting, pxRingbuffer->xFreeSpaceSemaphore, pdFALSE, NULL);
+        return;
+    }
+
+    portENTER_CRITICAL(&pxRingbuffer->mux);
+    for (size_t i = 0; i < xItemNum; i++) {
+        configASSERT(ppvItems[i] != NULL);
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+    }
+    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+}
+
 void vRingbufferDelete(RingbufHandle_t xRingbuffer)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
@@ -1056,6 +1652,10 @@ BaseType_t xRingbufferAddToQueueSetRead(RingbufHandle_t xRingbuffer, QueueSetHan
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return pdFALSE;     //SPSC buffers only give the semaphore when the consumer is blocked
+    }
+
     BaseType_t xReturn;
     portENTER_CRITICAL(&pxRingbuffer->mux);
     //Cannot add semaphore to queue set if semaphore is not empty. Temporarily hold semaphore
@@ -1111,7 +1711,11 @@ void vRingbufferGetInfo(RingbufHandle_t xRingbuffer, UBaseType_t *uxFree, UBaseT
         *uxWrite = (UBaseType_t)(pxRingbuffer->pucWrite - pxRingbuffer->pucHead);
     }
     if (uxItemsWaiting != NULL) {
-        *uxItemsWaiting = (UBaseType_t)(pxRingbuffer->xItemsWaiting);
+        if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+            *uxItemsWaiting = pxRingbuffer->uxItemsSent - pxRingbuffer->uxItemsReceived;
+        } else {
+            *uxItemsWaiting = (UBaseType_t)(pxRingbuffer->xItemsWaiting);
+        }
     }
     portEXIT_CRITICAL(&pxRingbuffer->mux);
 }
@@ -7,6 +7,7 @@
 #include "freertos/ringbuf.h"
 #include "driver/timer.h"
 #include "esp_spi_flash.h"
+#include "esp_timer.h"
 #include "unity.h"
 #include "test_utils.h"
 
@@ -258,6 +259,72 @@ TEST_CASE("Test ring buffer Byte Buffer", "[freertos]")
     vRingbufferDelete(buffer_handle);
 }
 
+/* ---------------------- Batched send and receive test ------------------------
+ * The following test case will test sending, receiving, and returning multiple
+ * items per call. The test case will do the following...
+ * 1) Send a batch of alternating small and large items to a No-Split buffer
+ *    (default and SPSC), several times so that the buffer wraps around
+ * 2) Receive the whole batch with one call, check the items, and return them
+ * 3) Send more items than fit without blocking, and check that only some are sent
+ * 4) Send a batch of items to a Byte Buffer and check that they are received in order
+ */
+
+#define BATCH_ITEMS     6
+
+TEST_CASE("Test ring buffer batched send and receive", "[freertos]")
+{
+    const void *items[BATCH_ITEMS * 2];
+    size_t item_sizes[BATCH_ITEMS * 2];
+    for (int i = 0; i < BATCH_ITEMS * 2; i++) {
+        items[i] = (i % 2) ? large_item : small_item;
+        item_sizes[i] = (i % 2) ? LARGE_ITEM_SIZE : SMALL_ITEM_SIZE;
+    }
+
+    for (int spsc = 0; spsc < 2; spsc++) {
+        RingbufHandle_t buffer_handle = spsc ? xRingbufferCreateSPSC(BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT)
+                                             : xRingbufferCreate(BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+        TEST_ASSERT_MESSAGE(buffer_handle != NULL, "Failed to create ring buffer");
+
+        for (int iter = 0; iter < 4; iter++) {
+            TEST_ASSERT_EQUAL(BATCH_ITEMS, xRingbufferSendMultiple(buffer_handle, items, item_sizes, BATCH_ITEMS, TIMEOUT_TICKS));
+            void *rec_items[BATCH_ITEMS + 1];
+            size_t rec_sizes[BATCH_ITEMS + 1];
+            TEST_ASSERT_EQUAL(BATCH_ITEMS, xRingbufferReceiveMultiple(buffer_handle, rec_items, rec_sizes, BATCH_ITEMS + 1, TIMEOUT_TICKS));
+            for (int i = 0; i < BATCH_ITEMS; i++) {
+                TEST_ASSERT_EQUAL(item_sizes[i], rec_sizes[i]);
+                TEST_ASSERT_EQUAL_MEMORY(items[i], rec_items[i], rec_sizes[i]);
+            }
+            vRingbufferReturnMultiple(buffer_handle, rec_items, BATCH_ITEMS);
+        }
+
+        //More items than fit in the buffer. Only some are sent, in order
+        size_t sent = xRingbufferSendMultiple(buffer_handle, items, item_sizes, BATCH_ITEMS * 2, 0);
+        TEST_ASSERT(sent > 0 && sent < BATCH_ITEMS * 2);
+        for (size_t i = 0; i < sent; i++) {
+            receive_check_and_return_item_no_split(buffer_handle, items[i], item_sizes[i], TIMEOUT_TICKS, false);
+        }
+        //Nothing left to receive
+        void *rec_item;
+        size_t rec_size;
+        TEST_ASSERT_EQUAL(0, xRingbufferReceiveMultiple(buffer_handle, &rec_item, &rec_size, 1, 0));
+
+        vRingbufferDelete(buffer_handle);
+    }
+
+    //Byte buffer stores the items as one sequence of bytes
+    RingbufHandle_t buffer_handle = xRingbufferCreate(BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF);
+    TEST_ASSERT_MESSAGE(buffer_handle != NULL, "Failed to create ring buffer");
+    TEST_ASSERT_EQUAL(2, xRingbufferSendMultiple(buffer_handle, items, item_sizes, 2, TIMEOUT_TICKS));
+    size_t rec_size;
+    uint8_t *rec_data = (uint8_t *)xRingbufferReceive(buffer_handle, &rec_size, TIMEOUT_TICKS);
+    TEST_ASSERT_NOT_NULL(rec_data);
+    TEST_ASSERT_EQUAL(SMALL_ITEM_SIZE + LARGE_ITEM_SIZE, rec_size);
+    TEST_ASSERT_EQUAL_MEMORY(small_item, rec_data, SMALL_ITEM_SIZE);
+    TEST_ASSERT_EQUAL_MEMORY(large_item, rec_data + SMALL_ITEM_SIZE, LARGE_ITEM_SIZE);
+    vRingbufferReturnItem(buffer_handle, rec_data);
+    vRingbufferDelete(buffer_handle);
+}
+
 /* ----------------------- Ring buffer queue sets test ------------------------
  * The following test case will test receiving from ring buffers that have been
  * added to a queue set. The test case will do the following...
@@ -607,6 +674,164 @@ TEST_CASE("Test ring buffer SMP", "[freertos]")
     vSemaphoreDelete(tasks_done);
 }
 
+TEST_CASE("Test SPSC ring buffer SMP", "[freertos]")
+{
+    tx_done = xSemaphoreCreateBinary();
+    rx_done = xSemaphoreCreateBinary();
+    tasks_done = xSemaphoreCreateBinary();
+    srand(SRAND_SEED);
+
+    TEST_ASSERT_NULL(xRingbufferCreateSPSC(CONT_DATA_TEST_BUFF_LEN, RINGBUF_TYPE_ALLOWSPLIT));
+
+    ringbuf_type_t types[] = {RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_BYTEBUF};
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        //Same as the SMP test above, with one sending and one receiving task
+        task_args_t task_args;
+        task_args.buffer = xRingbufferCreateSPSC(CONT_DATA_TEST_BUFF_LEN, types[i]);
+        task_args.type = types[i];
+        TEST_ASSERT_NOT_NULL(task_args.buffer);
+        TEST_ASSERT_EQUAL(xRingbufferGetMaxItemSize(task_args.buffer), xRingbufferGetCurFreeSize(task_args.buffer));
+
+        for (int prior_mod = -1; prior_mod < 2; prior_mod++) {
+            for (int send_core = 0; send_core < portNUM_PROCESSORS; send_core++) {
+                for (int rec_core = 0; rec_core < portNUM_PROCESSORS; rec_core ++) {
+                    ets_printf("Type: %d, PM: %d, SC: %d, RC: %d\n", types[i], prior_mod, send_core, rec_core);
+                    xTaskCreatePinnedToCore(send_task, "send tsk", 2048, (void *)&task_args, 10 + prior_mod, NULL, send_core);
+                    xTaskCreatePinnedToCore(rec_task, "rec tsk", 2048, (void *)&task_args, 10, NULL, rec_core);
+                    xSemaphoreTake(tasks_done, portMAX_DELAY);
+                    vTaskDelay(5);  //Allow idle to clean up
+                }
+            }
+        }
+
+        //All items were returned
+        UBaseType_t items_waiting;
+        vRingbufferGetInfo(task_args.buffer, NULL, NULL, NULL, &items_waiting);
+        TEST_ASSERT_EQUAL(0, items_waiting);
+        TEST_ASSERT_EQUAL(xRingbufferGetMaxItemSize(task_args.buffer), xRingbufferGetCurFreeSize(task_args.buffer));
+        vRingbufferDelete(task_args.buffer);
+        vTaskDelay(10);
+    }
+
+    vSemaphoreDelete(tx_done);
+    vSemaphoreDelete(rx_done);
+    vSemaphoreDelete(tasks_done);
+}
+
+/* --------------------------- Ring buffer throughput ------------------------------ */
+
+#define THROUGHPUT_BUFF_LEN             1024
+#define THROUGHPUT_ITEM_LEN             16
+#define THROUGHPUT_ITEMS                20000
+#define THROUGHPUT_BATCH                8
+
+static bool throughput_batched;
+
+static void throughput_send_task(void *args)
+{
+    RingbufHandle_t buffer = (RingbufHandle_t)args;
+    uint8_t items[THROUGHPUT_BATCH][THROUGHPUT_ITEM_LEN] = { 0 };
+    const void *item_ptrs[THROUGHPUT_BATCH];
+    size_t item_sizes[THROUGHPUT_BATCH];
+    for (int i = 0; i < THROUGHPUT_BATCH; i++) {
+        item_ptrs[i] = items[i];
+        item_sizes[i] = THROUGHPUT_ITEM_LEN;
+    }
+    for (int i = 0; i < THROUGHPUT_ITEMS; i += THROUGHPUT_BATCH) {
+        for (int j = 0; j < THROUGHPUT_BATCH; j++) {
+            items[j][0] = (uint8_t)(i + j);
+        }
+        if (throughput_batched) {
+            TEST_ASSERT_EQUAL(THROUGHPUT_BATCH, xRingbufferSendMultiple(buffer, item_ptrs, item_sizes, THROUGHPUT_BATCH, portMAX_DELAY));
+        } else {
+            for (int j = 0; j < THROUGHPUT_BATCH; j++) {
+                TEST_ASSERT(xRingbufferSend(buffer, items[j], THROUGHPUT_ITEM_LEN, portMAX_DELAY) == pdTRUE);
+            }
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+static void throughput_rec_task(void *args)
+{
+    RingbufHandle_t buffer = (RingbufHandle_t)args;
+    int i = 0;
+    while (i < THROUGHPUT_ITEMS) {
+        void *items[THROUGHPUT_BATCH];
+        size_t item_sizes[THROUGHPUT_BATCH];
+        size_t received;
+        if (throughput_batched) {
+            received = xRingbufferReceiveMultiple(buffer, items, item_sizes, THROUGHPUT_BATCH, portMAX_DELAY);
+        } else {
+            items[0] = xRingbufferReceive(buffer, &item_sizes[0], portMAX_DELAY);
+            received = (items[0] != NULL) ? 1 : 0;
+        }
+        TEST_ASSERT_NOT_EQUAL(0, received);
+        for (size_t j = 0; j < received; j++, i++) {
+            TEST_ASSERT_EQUAL(THROUGHPUT_ITEM_LEN, item_sizes[j]);
+            TEST_ASSERT_EQUAL((uint8_t)i, ((uint8_t *)items[j])[0]);
+        }
+        if (throughput_batched) {
+            vRingbufferReturnMultiple(buffer, items, received);
+        } else {
+            vRingbufferReturnItem(buffer, items[0]);
+        }
+    }
+    xSemaphoreGive(tasks_done);
+    vTaskDelete(NULL);
+}
+
+static uint32_t measure_throughput(RingbufHandle_t buffer, int send_core, int rec_core, bool batched)
+{
+    throughput_batched = batched;
+    int64_t start = esp_timer_get_time();
+    xTaskCreatePinnedToCore(throughput_rec_task, "rec tsk", 2048, buffer, 10, NULL, rec_core);
+    xTaskCreatePinnedToCore(throughput_send_task, "send tsk", 2048, buffer, 10, NULL, send_core);
+    xSemaphoreTake(tasks_done, portMAX_DELAY);
+    int64_t elapsed = esp_timer_get_time() - start;
+    vTaskDelay(5);  //Allow idle to clean up
+    return (uint32_t)(elapsed * 1000 / THROUGHPUT_ITEMS);
+}
+
+TEST_CASE("Test ring buffer throughput, SPSC compared with default", "[freertos]")
+{
+    tasks_done = xSemaphoreCreateBinary();
+    for (int send_core = 0; send_core < portNUM_PROCESSORS; send_core++) {
+        for (int rec_core = 0; rec_core < portNUM_PROCESSORS; rec_core++) {
+            RingbufHandle_t buffer = xRingbufferCreate(THROUGHPUT_BUFF_LEN, RINGBUF_TYPE_NOSPLIT);
+            uint32_t default_ns = measure_throughput(buffer, send_core, rec_core, false);
+            vRingbufferDelete(buffer);
+
+            buffer = xRingbufferCreateSPSC(THROUGHPUT_BUFF_LEN, RINGBUF_TYPE_NOSPLIT);
+            uint32_t spsc_ns = measure_throughput(buffer, send_core, rec_core, false);
+            vRingbufferDelete(buffer);
+
+            printf("SC: %d, RC: %d, %d byte items: %u ns/item default, %u ns/item SPSC\n",
+                   send_core, rec_core, THROUGHPUT_ITEM_LEN, default_ns, spsc_ns);
+        }
+    }
+    vSemaphoreDelete(tasks_done);
+}
+
+TEST_CASE("Test ring buffer throughput, batched compared with single items", "[freertos]")
+{
+    tasks_done = xSemaphoreCreateBinary();
+    for (int spsc = 0; spsc < 2; spsc++) {
+        for (int rec_core = 0; rec_core < portNUM_PROCESSORS; rec_core++) {
+            uint32_t ns[2];
+            for (int batched = 0; batched < 2; batched++) {
+                RingbufHandle_t buffer = spsc ? xRingbufferCreateSPSC(THROUGHPUT_BUFF_LEN, RINGBUF_TYPE_NOSPLIT)
+                                              : xRingbufferCreate(THROUGHPUT_BUFF_LEN, RINGBUF_TYPE_NOSPLIT);
+                ns[batched] = measure_throughput(buffer, 0, rec_core, batched);
+                vRingbufferDelete(buffer);
+            }
+            printf("%s, SC: 0, RC: %d, %d byte items: %u ns/item single, %u ns/item batches of %d\n",
+                   spsc ? "SPSC" : "default", rec_core, THROUGHPUT_ITEM_LEN, ns[0], ns[1], THROUGHPUT_BATCH);
+        }
+    }
+    vSemaphoreDelete(tasks_done);
+}
+
 static IRAM_ATTR __attribute__((noinline)) bool iram_ringbuf_test()
 {
     bool result = true;
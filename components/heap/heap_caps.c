@@ -86,6 +86,17 @@ IRAM_ATTR void *heap_caps_malloc( size_t size, uint32_t caps )
         size = (size + 3) & (~3); // int overflow checked above
     }
 
+#ifdef CONFIG_HEAP_CACHE
+    if (heap_caps_cache_usable(size, caps)) {
+        ret = heap_caps_cache_get(size);
+        if (ret != NULL) {
+            return ret;
+        }
+        // round up to a size class, so the block can go into the cache when it is freed
+        size = heap_caps_cache_round_size(size);
+    }
+#endif
+
     for (int prio = 0; prio < SOC_MEMORY_TYPE_NO_PRIOS; prio++) {
         //Iterate over heaps and check capabilities at this priority
         heap_t *heap;
@@ -237,7 +248,7 @@ IRAM_ATTR void *heap_caps_calloc_prefer( size_t n, size_t size, size_t num, ...
    (This confirms if ptr is inside the heap's region, doesn't confirm if 'ptr'
    is an allocated block or is some other random address inside the heap.)
 */
-IRAM_ATTR static heap_t *find_containing_heap(void *ptr )
+IRAM_ATTR heap_t *find_containing_heap(void *ptr )
 {
     intptr_t p = (intptr_t)ptr;
     heap_t *heap;
@@ -265,6 +276,11 @@ IRAM_ATTR void heap_caps_free( void *ptr)
 
     heap_t *heap = find_containing_heap(ptr);
     assert(heap != NULL && "free() target pointer is outside heap areas");
+#ifdef CONFIG_HEAP_CACHE
+    if (heap_caps_cache_put(heap, ptr)) {
+        return;
+    }
+#endif
     multi_heap_free(heap->heap, ptr);
 }
 
@@ -336,6 +352,11 @@ size_t heap_caps_get_free_size( uint32_t caps )
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
             ret += multi_heap_free_size(heap->heap);
+#ifdef CONFIG_HEAP_CACHE
+            size_t cached_bytes, cached_blocks;
+            heap_caps_cache_get_heap_usage(heap, &cached_bytes, &cached_blocks);
+            ret += cached_bytes;
+#endif
         }
     }
     return ret;
@@ -360,6 +381,20 @@ size_t heap_caps_get_largest_free_block( uint32_t caps )
     return info.largest_free_block;
 }
 
+/* Get info for a single heap, counting blocks held in the small block cache as free */
+static void get_heap_info(heap_t *heap, multi_heap_info_t *info)
+{
+    multi_heap_get_info(heap->heap, info);
+#ifdef CONFIG_HEAP_CACHE
+    size_t cached_bytes, cached_blocks;
+    heap_caps_cache_get_heap_usage(heap, &cached_bytes, &cached_blocks);
+    info->total_free_bytes += cached_bytes;
+    info->total_allocated_bytes -= cached_bytes;
+    info->free_blocks += cached_blocks;
+    info->allocated_blocks -= cached_blocks;
+#endif
+}
+
 void heap_caps_get_info( multi_heap_info_t *info, uint32_t caps )
 {
     bzero(info, sizeof(multi_heap_info_t));
@@ -368,7 +403,7 @@ void heap_caps_get_info( multi_heap_info_t *info, uint32_t caps )
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
             multi_heap_info_t hinfo;
-            multi_heap_get_info(heap->heap, &hinfo);
+            get_heap_info(heap, &hinfo);
 
             info->total_free_bytes += hinfo.total_free_bytes;
             info->total_allocated_bytes += hinfo.total_allocated_bytes;
@@ -389,7 +424,7 @@ void heap_caps_print_heap_info( uint32_t caps )
     heap_t *heap;
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
-            multi_heap_get_info(heap->heap, &info);
+            get_heap_info(heap, &info);
 
             printf("  At 0x%08x len %d free %d allocated %d min_free %d\n",
                    heap->start, heap->end - heap->start, info.total_free_bytes, info.total_allocated_bytes, info.minimum_free_bytes);
@@ -0,0 +1,192 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <assert.h>
+#include <sdkconfig.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "multi_heap.h"
+
+#include "heap_private.h"
+
+/*
+ Per-core cache of small free blocks, in front of heap_caps_malloc() and heap_caps_free().
+
+ Each core keeps a short stack of free blocks for each size class. Blocks freed on a core are pushed onto the
+ stack of that core, and small allocations on that core pop a block of the right class, so most small
+ allocations and frees don't need to search a heap or take its lock. The cache of a core is protected by its
+ own spinlock, which is only contended while heap_caps_cache_drain() or the info functions run.
+
+ Cached blocks are still allocated as far as their heap is concerned. Only blocks from heaps with the
+ MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL capabilities are cached, so a cached block can be returned for any
+ request whose capabilities are a subset of HEAP_CACHE_CAPS.
+*/
+#ifdef CONFIG_HEAP_CACHE
+
+#define HEAP_CACHE_HEAP_CAPS (MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL)
+#define HEAP_CACHE_CAPS (HEAP_CACHE_HEAP_CAPS | MALLOC_CAP_8BIT | MALLOC_CAP_32BIT)
+
+/* Size classes are multiples of HEAP_CACHE_GRANULE bytes */
+#define HEAP_CACHE_GRANULE 16
+#define HEAP_CACHE_CLASSES (CONFIG_HEAP_CACHE_MAX_SIZE / HEAP_CACHE_GRANULE)
+#define HEAP_CACHE_MAX_SIZE (HEAP_CACHE_CLASSES * HEAP_CACHE_GRANULE)
+#define HEAP_CACHE_DEPTH CONFIG_HEAP_CACHE_DEPTH
+
+typedef struct {
+    portMUX_TYPE lock;
+    uint8_t count[HEAP_CACHE_CLASSES];
+    void *blocks[HEAP_CACHE_CLASSES][HEAP_CACHE_DEPTH];
+    size_t hits;
+    size_t misses;
+    size_t cached_frees;
+    size_t overflow_frees;
+} heap_cache_t;
+
+static heap_cache_t caches[portNUM_PROCESSORS] = {
+    [0 ... portNUM_PROCESSORS - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED }
+};
+
+IRAM_ATTR bool heap_caps_cache_usable(size_t size, uint32_t caps)
+{
+    return size != 0 && size <= HEAP_CACHE_MAX_SIZE && (caps & ~HEAP_CACHE_CAPS) == 0;
+}
+
+IRAM_ATTR size_t heap_caps_cache_round_size(size_t size)
+{
+    return (size + HEAP_CACHE_GRANULE - 1) & ~(HEAP_CACHE_GRANULE - 1);
+}
+
+IRAM_ATTR void *heap_caps_cache_get(size_t size)
+{
+    void *ret = NULL;
+    size_t class = (size - 1) / HEAP_CACHE_GRANULE;
+    heap_cache_t *cache = &caches[xPortGetCoreID()];
+
+    portENTER_CRITICAL(&cache->lock);
+    if (cache->count[class] > 0) {
+        ret = cache->blocks[class][--cache->count[class]];
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    portEXIT_CRITICAL(&cache->lock);
+    return ret;
+}
+
+IRAM_ATTR bool heap_caps_cache_put(heap_t *heap, void *ptr)
+{
+    if ((get_all_caps(heap) & HEAP_CACHE_HEAP_CAPS) != HEAP_CACHE_HEAP_CAPS) {
+        return false;
+    }
+    /* a block is cached in the largest class it can hold */
+    size_t size = multi_heap_get_allocated_size(heap->heap, ptr);
+    if (size < HEAP_CACHE_GRANULE || size > HEAP_CACHE_MAX_SIZE) {
+        return false;
+    }
+    size_t class = size / HEAP_CACHE_GRANULE - 1;
+    heap_cache_t *cache = &caches[xPortGetCoreID()];
+    bool cached = false;
+
+    portENTER_CRITICAL(&cache->lock);
+    if (cache->count[class] < HEAP_CACHE_DEPTH) {
+        cache->blocks[class][cache->count[class]++] = ptr;
+        cache->cached_frees++;
+        cached = true;
+    } else {
+        cache->overflow_frees++;
+    }
+    portEXIT_CRITICAL(&cache->lock);
+    return cached;
+}
+
+void heap_caps_cache_get_heap_usage(const heap_t *heap, size_t *bytes, size_t *blocks)
+{
+    *bytes = 0;
+    *blocks = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        heap_cache_t *cache = &caches[core];
+        portENTER_CRITICAL(&cache->lock);
+        for (int class = 0; class < HEAP_CACHE_CLASSES; class++) {
+            for (int i = 0; i < cache->count[class]; i++) {
+                intptr_t p = (intptr_t)cache->blocks[class][i];
+                if (p >= heap->start && p < heap->end) {
+                    *bytes += multi_heap_get_allocated_size(heap->heap, (void *)p);
+                    (*blocks)++;
+                }
+            }
+        }
+        portEXIT_CRITICAL(&cache->lock);
+    }
+}
+
+#endif // CONFIG_HEAP_CACHE
+
+esp_err_t heap_caps_cache_get_stats(heap_caps_cache_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(stats, 0, sizeof(heap_caps_cache_stats_t));
+#ifndef CONFIG_HEAP_CACHE
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        heap_cache_t *cache = &caches[core];
+        portENTER_CRITICAL(&cache->lock);
+        stats->hits += cache->hits;
+        stats->misses += cache->misses;
+        stats->cached_frees += cache->cached_frees;
+        stats->overflow_frees += cache->overflow_frees;
+        for (int class = 0; class < HEAP_CACHE_CLASSES; class++) {
+            stats->cached_blocks += cache->count[class];
+        }
+        portEXIT_CRITICAL(&cache->lock);
+    }
+    heap_t *heap;
+    SLIST_FOREACH(heap, &registered_heaps, next) {
+        size_t bytes, blocks;
+        heap_caps_cache_get_heap_usage(heap, &bytes, &blocks);
+        stats->cached_bytes += bytes;
+    }
+    return ESP_OK;
+#endif
+}
+
+void heap_caps_cache_drain(void)
+{
+#ifdef CONFIG_HEAP_CACHE
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        heap_cache_t *cache = &caches[core];
+        for (int class = 0; class < HEAP_CACHE_CLASSES; class++) {
+            while (true) {
+                void *p = NULL;
+                /* blocks are freed one at a time, to keep the critical section short */
+                portENTER_CRITICAL(&cache->lock);
+                if (cache->count[class] > 0) {
+                    p = cache->blocks[class][--cache->count[class]];
+                }
+                portEXIT_CRITICAL(&cache->lock);
+                if (p == NULL) {
+                    break;
+                }
+                heap_t *heap = find_containing_heap(p);
+                assert(heap != NULL);
+                multi_heap_free(heap->heap, p);
+            }
+        }
+    }
+#endif
+}
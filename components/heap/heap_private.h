@@ -63,6 +63,26 @@ inline static IRAM_ATTR uint32_t get_all_caps(const heap_t *heap)
     return all_caps;
 }
 
+/* Find the heap which contains ptr, or NULL if it's not in any heap */
+heap_t *find_containing_heap(void *ptr);
+
+/* Per-core small block cache, see heap_caps_cache.c. Only present if CONFIG_HEAP_CACHE is set. */
+
+/* return true if an allocation of this size and caps can come from the cache */
+bool heap_caps_cache_usable(size_t size, uint32_t caps);
+
+/* return size rounded up to a cache size class, for allocations which heap_caps_cache_usable() accepts */
+size_t heap_caps_cache_round_size(size_t size);
+
+/* return a cached block for an allocation which heap_caps_cache_usable() accepts, or NULL */
+void *heap_caps_cache_get(size_t size);
+
+/* try to put a block which is being freed into the cache, return false if the block needs to be freed */
+bool heap_caps_cache_put(heap_t *heap, void *ptr);
+
+/* total size & number of the cached blocks which belong to this heap */
+void heap_caps_cache_get_heap_usage(const heap_t *heap, size_t *bytes, size_t *blocks);
+
 /*
  Because we don't want to add _another_ known allocation method to the stack of functions to trace wrt memory tracing,
  these are declared private. The newlib malloc()/realloc() implementation also calls these, so they are declared 
@@ -24,20 +24,57 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "soc/soc_memory_layout.h"
+#include "rom/queue.h"
 
 #include "heap_private.h"
 
 #define STACK_DEPTH CONFIG_HEAP_TRACING_STACK_DEPTH
 
+#ifdef CONFIG_HEAP_TRACING_HASH_BUCKETS
+#define HASH_BUCKETS CONFIG_HEAP_TRACING_HASH_BUCKETS
+#else
+#define HASH_BUCKETS 1
+#endif
+
 static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
 static bool tracing;
 static heap_trace_mode_t mode;
 
-/* Buffer used for records, starting at offset 0
+/* Buffer used for records. Records aren't kept in any particular order in the buffer, but each one is
+   in either the 'records' or the 'unused' list.
 */
 static heap_trace_record_t *buffer;
 static size_t total_records;
 
+/* List links of the records in 'buffer', links[i] belongs to buffer[i]. They are kept out of
+   heap_trace_record_t, which is part of the public API.
+*/
+typedef struct record_links_t {
+    TAILQ_ENTRY(record_links_t) tailq;  /* Position in 'records' or 'unused' */
+    LIST_ENTRY(record_links_t) hash;    /* Position in 'hash_map', le_prev is NULL if not in it */
+} record_links_t;
+
+static record_links_t *links;
+
+/* Records logged, in the order they were allocated */
+static TAILQ_HEAD(heap_trace_record_list, record_links_t) records;
+
+/* Records in 'buffer' which are available */
+static struct heap_trace_record_list unused;
+
+/* Records which haven't been freed yet, hashed by address so that a free can find its record quickly */
+static LIST_HEAD(heap_trace_hash_bucket, record_links_t) hash_map[HASH_BUCKETS];
+
+/* Last record returned by heap_trace_get() and its index, so that reading records in order doesn't need to
+   walk the whole list each time. Reset whenever a record is removed from the list. */
+static record_links_t *cursor;
+static size_t cursor_index;
+
+static inline IRAM_ATTR heap_trace_record_t *record_of(const record_links_t *rec_links)
+{
+    return &buffer[rec_links - links];
+}
+
 /* Count of entries logged in the buffer.
 
    Maximum total_records
@@ -53,6 +90,21 @@ static size_t total_frees;
 /* Has the buffer overflowed and lost trace entries? */
 static bool has_overflowed = false;
 
+/* Empty the trace, making all records in the buffer available */
+static void clear_records(void)
+{
+    TAILQ_INIT(&records);
+    TAILQ_INIT(&unused);
+    for (int i = 0; i < HASH_BUCKETS; i++) {
+        LIST_INIT(&hash_map[i]);
+    }
+    for (size_t i = 0; i < total_records; i++) {
+        TAILQ_INSERT_TAIL(&unused, &links[i], tailq);
+    }
+    cursor = NULL;
+    count = 0;
+}
+
 esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t num_records)
 {
 #ifndef CONFIG_HEAP_TRACING
@@ -62,9 +114,23 @@ esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t
     if (tracing) {
         return ESP_ERR_INVALID_STATE;
     }
+    record_links_t *new_links = NULL;
+    if (record_buffer != NULL && num_records > 0) {
+        /* Accessed while recording, so it has to be in internal memory like the record buffer */
+        new_links = heap_caps_calloc(num_records, sizeof(record_links_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (new_links == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    heap_caps_free(links);
+    links = new_links;
     buffer = record_buffer;
-    total_records = num_records;
-    memset(buffer, 0, num_records * sizeof(heap_trace_record_t));
+    total_records = 0;
+    if (links != NULL) {
+        total_records = num_records;
+        memset(buffer, 0, num_records * sizeof(heap_trace_record_t));
+    }
+    clear_records();
     return ESP_OK;
 }
 
@@ -81,7 +147,7 @@ esp_err_t heap_trace_start(heap_trace_mode_t mode_param)
 
     tracing = false;
     mode = mode_param;
-    count = 0;
+    clear_records();
     total_allocations = 0;
     total_frees = 0;
     has_overflowed = false;
@@ -132,7 +198,14 @@ esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record)
     if (index >= count) {
         result = ESP_ERR_INVALID_ARG; /* out of range for 'count' */
     } else {
-        memcpy(record, &buffer[index], sizeof(heap_trace_record_t));
+        if (cursor == NULL || cursor_index > index) {
+            cursor = TAILQ_FIRST(&records);
+            cursor_index = 0;
+        }
+        for (; cursor_index < index; cursor_index++) {
+            cursor = TAILQ_NEXT(cursor, tailq);
+        }
+        memcpy(record, record_of(cursor), sizeof(heap_trace_record_t));
     }
     portEXIT_CRITICAL(&trace_mux);
     return result;
@@ -150,8 +223,9 @@ void heap_trace_dump(void)
     printf("%u allocations trace (%u entry buffer)\n",
            count, total_records);
     size_t start_count = count;
-    for (int i = 0; i < count; i++) {
-        heap_trace_record_t *rec = &buffer[i];
+    heap_trace_record_t r;
+    for (int i = 0; heap_trace_get(i, &r) == ESP_OK; i++) {
+        heap_trace_record_t *rec = &r;
 
         if (rec->address != NULL) {
             printf("%d bytes (@ %p) allocated CPU %d ccount 0x%08x caller ",
@@ -189,34 +263,65 @@ void heap_trace_dump(void)
     }
 }
 
+static inline IRAM_ATTR struct heap_trace_hash_bucket *hash_bucket(void *p)
+{
+    return &hash_map[(((uint32_t)p >> 2) * 2654435761U) % HASH_BUCKETS];
+}
+
+static inline IRAM_ATTR void hash_remove(record_links_t *rec_links)
+{
+    if (rec_links->hash.le_prev != NULL) {
+        LIST_REMOVE(rec_links, hash);
+        rec_links->hash.le_prev = NULL;
+    }
+}
+
+/* Find the links of the record of the allocation at 'p' which hasn't been freed yet, or NULL */
+static IRAM_ATTR record_links_t *find_record(void *p)
+{
+    record_links_t *rec_links;
+    LIST_FOREACH(rec_links, hash_bucket(p), hash) {
+        if (record_of(rec_links)->address == p) {
+            return rec_links;
+        }
+    }
+    return NULL;
+}
+
+/* remove a record from the trace, making its slot in the buffer available */
+static IRAM_ATTR void remove_record(record_links_t *rec_links)
+{
+    hash_remove(rec_links);
+    TAILQ_REMOVE(&records, rec_links, tailq);
+    memset(record_of(rec_links), 0, sizeof(heap_trace_record_t));
+    TAILQ_INSERT_TAIL(&unused, rec_links, tailq);
+    cursor = NULL;
+    count--;
+}
+
 /* Add a new allocation to the heap trace records */
 static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 {
     portENTER_CRITICAL(&trace_mux);
     if (tracing) {
-        if (count == total_records) {
+        if (TAILQ_EMPTY(&unused)) {
             has_overflowed = true;
-            /* Move the whole buffer back one slot.
-
-               This is a bit slow, compared to treating this buffer as a ringbuffer and rotating a head pointer.
-
-               However, ringbuffer code gets tricky when we remove elements in mid-buffer (for leak trace mode) while
-               trying to keep track of an item count that may overflow.
-            */
-            memmove(&buffer[0], &buffer[1], sizeof(heap_trace_record_t) * (total_records -1));
-            count--;
+            /* Drop the oldest record */
+            remove_record(TAILQ_FIRST(&records));
         }
         // Copy new record into place
-        memcpy(&buffer[count], record, sizeof(heap_trace_record_t));
+        record_links_t *rec_links = TAILQ_FIRST(&unused);
+        TAILQ_REMOVE(&unused, rec_links, tailq);
+        memcpy(record_of(rec_links), record, sizeof(heap_trace_record_t));
+        TAILQ_INSERT_TAIL(&records, rec_links, tailq);
+        /* insert at the head, so an address which is allocated again finds its newest record first */
+        LIST_INSERT_HEAD(hash_bucket(record->address), rec_links, hash);
         count++;
         total_allocations++;
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-// remove a record, used when freeing
-static void remove_record(int index);
-
 /* record a free event in the heap trace log
 
    For HEAP_TRACE_ALL, this means filling in the freed_by pointer.
@@ -227,40 +332,22 @@ static IRAM_ATTR void record_free(void *p, void **callers)
     portENTER_CRITICAL(&trace_mux);
     if (tracing && count > 0) {
         total_frees++;
-        /* search backwards for the allocation record matching this free */
-        int i;
-        for (i = count - 1; i >= 0; i--) {
-            if (buffer[i].address == p) {
-                break;
-            }
-        }
+        record_links_t *rec_links = find_record(p);
 
-        if (i >= 0) {
+        if (rec_links != NULL) {
             if (mode == HEAP_TRACE_ALL) {
-                memcpy(buffer[i].freed_by, callers, sizeof(void *) * STACK_DEPTH);
+                memcpy(record_of(rec_links)->freed_by, callers, sizeof(void *) * STACK_DEPTH);
+                // A freed allocation keeps its record, but a later free of the same address can't match it
+                hash_remove(rec_links);
             } else { // HEAP_TRACE_LEAKS
                 // Leak trace mode, once an allocation is freed we remove it from the list
-                remove_record(i);
+                remove_record(rec_links);
             }
         }
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-/* remove the entry at 'index' from the ringbuffer of saved records */
-static IRAM_ATTR void remove_record(int index)
-{
-    if (index < count - 1) {
-        // Remove the buffer entry from the list
-        memmove(&buffer[index], &buffer[index+1],
-                sizeof(heap_trace_record_t) * (total_records - index - 1));
-    } else {
-        // For last element, just zero it out to avoid ambiguity
-        memset(&buffer[index], 0, sizeof(heap_trace_record_t));
-    }
-    count--;
-}
-
 /* Encode the CPU ID in the LSB of the ccount value */
 inline static uint32_t get_ccount(void)
 {
@@ -16,6 +16,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "multi_heap.h"
+#include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -310,6 +311,42 @@ void heap_caps_dump(uint32_t caps);
  */
 void heap_caps_dump_all();
 
+/**
+ * @brief Statistics of the small allocation cache
+ */
+typedef struct {
+    size_t hits;            ///< Allocations served from the cache
+    size_t misses;          ///< Allocations which could use the cache, but found it empty
+    size_t cached_frees;    ///< Frees which put the block into the cache
+    size_t overflow_frees;  ///< Frees which could use the cache, but found it full
+    size_t cached_blocks;   ///< Blocks in the cache now
+    size_t cached_bytes;    ///< Usable size of the blocks in the cache now
+} heap_caps_cache_stats_t;
+
+/**
+ * @brief Get statistics of the per-core small allocation cache
+ *
+ * Counts are totals across all cores, since startup.
+ *
+ * @param stats Structure filled with the statistics
+ *
+ * @return
+ *  - ESP_OK on success
+ *  - ESP_ERR_INVALID_ARG if stats is NULL
+ *  - ESP_ERR_NOT_SUPPORTED if the cache is disabled in menuconfig
+ */
+esp_err_t heap_caps_cache_get_stats(heap_caps_cache_stats_t *stats);
+
+/**
+ * @brief Return all blocks held in the per-core small allocation caches to their heaps
+ *
+ * Cached blocks are counted as free memory, but can't be merged with adjacent free memory until they
+ * are returned. Call this before a large allocation which may need the space, or before checking for leaks.
+ *
+ * Does nothing if the cache is disabled in menuconfig.
+ */
+void heap_caps_cache_drain(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -56,9 +56,11 @@ typedef struct {
  * @param record_buffer Provide a buffer to use for heap trace data. Must remain valid any time heap tracing is enabled, meaning
  * it must be allocated from internal memory not in PSRAM.
  * @param num_records Size of the heap trace buffer, as number of record structures.
+ * Heap tracing also allocates 16 bytes of internal memory per record, to keep the records in order.
  * @return
  *  - ESP_ERR_NOT_SUPPORTED Project was compiled without heap tracing enabled in menuconfig.
  *  - ESP_ERR_INVALID_STATE Heap tracing is currently in progress.
+ *  - ESP_ERR_NO_MEM Not enough internal memory to keep the records in order.
  *  - ESP_OK Heap tracing initialised successfully.
  */
 esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t num_records);
@@ -28,6 +28,9 @@
 /* Defines compile-time configuration macros */
 #include "multi_heap_config.h"
 
+/* Best-fit implementation of the multi_heap API. See multi_heap_tlsf.c for the alternative. */
+#ifndef MULTI_HEAP_TLSF
+
 #ifndef MULTI_HEAP_POISONING
 /* if no heap poisoning, public API aliases directly to these implementations */
 void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
@@ -748,3 +751,5 @@ void multi_heap_get_info_impl(multi_heap_handle_t heap, multi_heap_info_t *info)
     multi_heap_internal_unlock(heap);
 
 }
+
+#endif // MULTI_HEAP_TLSF
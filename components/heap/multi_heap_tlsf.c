@@ -0,0 +1,774 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <multi_heap.h>
+#include "multi_heap_internal.h"
+
+/* Note: Keep platform-specific parts in this header, this source
+   file should depend on libc only */
+#include "multi_heap_platform.h"
+
+/* Defines compile-time configuration macros */
+#include "multi_heap_config.h"
+
+/* Two-level segregated fit ("TLSF") implementation of the multi_heap API.
+
+   Used instead of the implementation in multi_heap.c if MULTI_HEAP_TLSF is defined.
+   malloc and free take a bounded number of steps, regardless of the number of free blocks.
+*/
+#ifdef MULTI_HEAP_TLSF
+
+#ifndef MULTI_HEAP_POISONING
+/* if no heap poisoning, public API aliases directly to these implementations */
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
+    __attribute__((alias("multi_heap_malloc_impl")));
+
+void multi_heap_free(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_free_impl")));
+
+void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size)
+    __attribute__((alias("multi_heap_realloc_impl")));
+
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_get_allocated_size_impl")));
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size)
+    __attribute__((alias("multi_heap_register_impl")));
+
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
+    __attribute__((alias("multi_heap_get_info_impl")));
+
+size_t multi_heap_free_size(multi_heap_handle_t heap)
+    __attribute__((alias("multi_heap_free_size_impl")));
+
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
+    __attribute__((alias("multi_heap_minimum_free_size_impl")));
+
+void *multi_heap_get_block_address(multi_heap_block_handle_t block)
+    __attribute__((alias("multi_heap_get_block_address_impl")));
+
+void *multi_heap_get_block_owner(multi_heap_block_handle_t block)
+{
+    return NULL;
+}
+
+#endif
+
+#define ALIGN(X) ((X) & ~(sizeof(void *)-1))
+#define ALIGN_UP(X) ALIGN((X)+sizeof(void *)-1)
+
+/* log2 of the allocation granularity */
+#define ALIGN_LOG2 ((sizeof(void *) == 8) ? 3 : 2)
+
+/* Upper limit of log2 of the number of second level lists per first level size class.
+   Smaller heaps use fewer second level lists, see multi_heap_register_impl(). */
+#define SL_LOG2_MAX 4
+
+/* Block in the heap
+
+   Blocks follow each other in memory. 'header' holds the data size of the block, ORed with the free flag
+   of the block and the free flag of the previous block.
+
+   'prev_phys' is a pointer to the previous block in memory. It is only valid if the previous block is free,
+   in which case it occupies the last word of that block's data. A used block can use this word for data, so
+   the overhead of a used block is only the 'header' word.
+
+   'next_free' and 'prev_free' link the block into the free list of its size class, valid if the block is free.
+*/
+typedef struct heap_block {
+    struct heap_block *prev_phys;      /* Previous block in memory, valid if PREV_FREE_FLAG is set */
+    size_t header;                     /* Data size of the block, and the flags below */
+    union {
+        uint8_t data[1];               /* First byte of data, valid if block is used. Actual size of data is 'block_data_size(block)' */
+        struct {
+            struct heap_block *next_free;  /* Next block in the same free list, valid if block is free */
+            struct heap_block *prev_free;  /* Previous block in the same free list, valid if block is free */
+        };
+    };
+} heap_block_t;
+
+/* These masks apply to the 'header' field of heap_block_t */
+#define BLOCK_FREE_FLAG 0x1     /* If set, this block is free & in a free list */
+#define PREV_FREE_FLAG 0x2      /* If set, the previous block is free & 'prev_phys' is valid */
+#define BLOCK_SIZE_MASK (~(size_t)3)
+
+/* Data of a free block has to hold the free list pointers and the next block's 'prev_phys' */
+#define BLOCK_MIN_SIZE (3 * sizeof(void *))
+
+/* Metadata header for the heap, stored at the beginning of heap space.
+
+   It is followed by the array of free list heads, with (1 << sl_log2) lists per first level size class,
+   and by one word per first level class with a bit set for each of its lists which isn't empty.
+
+   'first_block' follows these tables. It never has PREV_FREE_FLAG set, so nothing is merged into it from below.
+
+   'last_block' is a used block with zero size, placed at the end of the heap when it is registered.
+   It is never allocated or merged into an adjacent block.
+ */
+typedef struct multi_heap_info {
+    void *lock;
+    size_t free_bytes;
+    size_t minimum_free_bytes;
+    heap_block_t *first_block;
+    heap_block_t *last_block;
+    uint32_t fl_bitmap;         /* bit N is set if a list of first level class N is not empty */
+    uint8_t sl_log2;            /* log2 of the number of second level lists per first level class */
+    uint8_t fl_count;           /* number of first level classes */
+} heap_t;
+
+static inline size_t fls_size(size_t size)
+{
+    return sizeof(unsigned long) * 8 - 1 - __builtin_clzl(size);
+}
+
+static inline size_t block_data_size(const heap_block_t *block)
+{
+    return block->header & BLOCK_SIZE_MASK;
+}
+
+static inline bool is_free(const heap_block_t *block)
+{
+    return block->header & BLOCK_FREE_FLAG;
+}
+
+static inline bool is_prev_free(const heap_block_t *block)
+{
+    return block->header & PREV_FREE_FLAG;
+}
+
+static inline bool is_last_block(const heap_t *heap, const heap_block_t *block)
+{
+    return block == heap->last_block;
+}
+
+static inline void set_data_size(heap_block_t *block, size_t size)
+{
+    block->header = size | (block->header & ~BLOCK_SIZE_MASK);
+}
+
+/* Given a pointer to the 'data' field of a block (ie the previous malloc/realloc result), return a pointer to the
+   containing block.
+*/
+static inline heap_block_t *get_block(const void *data_ptr)
+{
+    return (heap_block_t *)((char *)data_ptr - offsetof(heap_block_t, data));
+}
+
+/* Return the next sequential block in the heap. Its 'header' follows the data of 'block'. */
+static inline heap_block_t *get_next_block(const heap_block_t *block)
+{
+    return (heap_block_t *)((char *)block->data + block_data_size(block) - offsetof(heap_block_t, header));
+}
+
+/* Mark block as free, which also sets 'prev_phys' of the next block */
+static inline void mark_free(heap_block_t *block)
+{
+    heap_block_t *next = get_next_block(block);
+    next->prev_phys = block;
+    next->header |= PREV_FREE_FLAG;
+    block->header |= BLOCK_FREE_FLAG;
+}
+
+static inline void mark_used(heap_block_t *block)
+{
+    heap_block_t *next = get_next_block(block);
+    next->header &= ~PREV_FREE_FLAG;
+    block->header &= ~BLOCK_FREE_FLAG;
+}
+
+/* Find the free list for a block of 'size' bytes */
+static inline void mapping_insert(const heap_t *heap, size_t size, size_t *fl, size_t *sl)
+{
+    const size_t shift = heap->sl_log2 + ALIGN_LOG2;
+    if (size < ((size_t)1 << shift)) {
+        *fl = 0;
+        *sl = size >> ALIGN_LOG2;
+    } else {
+        size_t t = fls_size(size);
+        *sl = (size >> (t - heap->sl_log2)) - ((size_t)1 << heap->sl_log2);
+        *fl = t - shift + 1;
+    }
+}
+
+/* Find the first free list whose blocks are all at least 'size' bytes */
+static inline void mapping_search(const heap_t *heap, size_t size, size_t *fl, size_t *sl)
+{
+    if (size >= ((size_t)1 << (heap->sl_log2 + ALIGN_LOG2))) {
+        size += ((size_t)1 << (fls_size(size) - heap->sl_log2)) - 1;
+    }
+    mapping_insert(heap, size, fl, sl);
+}
+
+static inline heap_block_t **free_list(heap_t *heap, size_t fl, size_t sl)
+{
+    return (heap_block_t **)(heap + 1) + (fl << heap->sl_log2) + sl;
+}
+
+static inline uint32_t *sl_bitmap(heap_t *heap, size_t fl)
+{
+    return (uint32_t *)((heap_block_t **)(heap + 1) + (heap->fl_count << heap->sl_log2)) + fl;
+}
+
+/* Return a free block of at least 'size' bytes, or NULL.
+
+   The first block in the list for 'size' is used if it is large enough. Otherwise the block
+   comes from the first non-empty list whose blocks are all large enough. Neither step depends
+   on the number of free blocks.
+*/
+static heap_block_t *find_suitable_block(heap_t *heap, size_t size)
+{
+    size_t fl, sl;
+    mapping_insert(heap, size, &fl, &sl);
+    if (fl < heap->fl_count) {
+        heap_block_t *head = *free_list(heap, fl, sl);
+        if (head != NULL && block_data_size(head) >= size) {
+            return head;
+        }
+    }
+
+    mapping_search(heap, size, &fl, &sl);
+    if (fl >= heap->fl_count) {
+        return NULL;
+    }
+    uint32_t sl_map = *sl_bitmap(heap, fl) & (~0U << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = heap->fl_bitmap & (~0U << (fl + 1));
+        if (fl_map == 0) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = *sl_bitmap(heap, fl);
+    }
+    sl = __builtin_ctz(sl_map);
+    return *free_list(heap, fl, sl);
+}
+
+static void insert_free_block(heap_t *heap, heap_block_t *block)
+{
+    size_t fl, sl;
+    mapping_insert(heap, block_data_size(block), &fl, &sl);
+    heap_block_t **head = free_list(heap, fl, sl);
+    block->next_free = *head;
+    block->prev_free = NULL;
+    if (*head != NULL) {
+        (*head)->prev_free = block;
+    }
+    *head = block;
+    heap->fl_bitmap |= 1U << fl;
+    *sl_bitmap(heap, fl) |= 1U << sl;
+    heap->free_bytes += block_data_size(block);
+}
+
+static void remove_free_block(heap_t *heap, heap_block_t *block)
+{
+    size_t fl, sl;
+    mapping_insert(heap, block_data_size(block), &fl, &sl);
+    heap_block_t **head = free_list(heap, fl, sl);
+    MULTI_HEAP_ASSERT(is_free(block), block); // block should be free
+    if (block->prev_free != NULL) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        MULTI_HEAP_ASSERT(*head == block, head); // block should be head of its free list
+        *head = block->next_free;
+        if (*head == NULL) {
+            *sl_bitmap(heap, fl) &= ~(1U << sl);
+            if (*sl_bitmap(heap, fl) == 0) {
+                heap->fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+    if (block->next_free != NULL) {
+        block->next_free->prev_free = block->prev_free;
+    }
+    heap->free_bytes -= block_data_size(block);
+}
+
+/* Merge block 'b', which follows 'a' in memory, into 'a'. Neither block may be in a free list. */
+static void absorb_next(heap_block_t *a, heap_block_t *b)
+{
+    set_data_size(a, block_data_size(a) + sizeof(a->header) + block_data_size(b));
+#ifdef MULTI_HEAP_POISONING_SLOW
+    /* b's former block header needs to be replaced with a fill pattern */
+    multi_heap_internal_poison_fill_region(b, sizeof(heap_block_t), true /* free */);
+#endif
+}
+
+/* Make 'block' free, merge it with free neighbours and put the result into a free list */
+static void free_block(heap_t *heap, heap_block_t *block)
+{
+    if (is_prev_free(block)) {
+        heap_block_t *prev = block->prev_phys;
+        MULTI_HEAP_ASSERT(is_free(prev) && get_next_block(prev) == block, &block->prev_phys); // prev_phys should be valid
+        remove_free_block(heap, prev);
+        absorb_next(prev, block);
+        block = prev;
+    }
+    heap_block_t *next = get_next_block(block);
+    if (is_free(next)) {
+        remove_free_block(heap, next);
+        absorb_next(block, next);
+    }
+    mark_free(block);
+    insert_free_block(heap, block);
+}
+
+/* Shrink used 'block' to 'size' bytes of data, making any spare space into a new free block. */
+static void split_if_necessary(heap_t *heap, heap_block_t *block, size_t size)
+{
+    const size_t block_size = block_data_size(block);
+    MULTI_HEAP_ASSERT(!is_free(block), block); // split block shouldn't be free
+    MULTI_HEAP_ASSERT(size <= block_size, block); // size should be valid
+
+    if (block_size < size + sizeof(block->header) + BLOCK_MIN_SIZE) {
+        /* Can't split 'block' if we're not going to get a usable free block afterwards */
+        return;
+    }
+    set_data_size(block, size);
+    heap_block_t *new_block = get_next_block(block);
+    new_block->header = block_size - size - sizeof(block->header);
+    free_block(heap, new_block);
+}
+
+/* Check a block is valid for this heap. Used to verify parameters. */
+static void assert_valid_block(const heap_t *heap, const heap_block_t *block)
+{
+    MULTI_HEAP_ASSERT(block >= heap->first_block && block <= heap->last_block,
+                      block); // block not in heap
+    if (!is_last_block(heap, block)) {
+        const heap_block_t *next = get_next_block(block);
+        MULTI_HEAP_ASSERT(next > block && next <= heap->last_block, block); // Next block not in heap
+    }
+}
+
+void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block)
+{
+    return ((char *)block + offsetof(heap_block_t, data));
+}
+
+size_t multi_heap_get_allocated_size_impl(multi_heap_handle_t heap, void *p)
+{
+    heap_block_t *pb = get_block(p);
+
+    assert_valid_block(heap, pb);
+    MULTI_HEAP_ASSERT(!is_free(pb), pb); // block shouldn't be free
+    return block_data_size(pb);
+}
+
+multi_heap_handle_t multi_heap_register_impl(void *start_ptr, size_t size)
+{
+    uintptr_t start = ALIGN_UP((uintptr_t)start_ptr);
+    uintptr_t end = ALIGN((uintptr_t)start_ptr + size);
+    heap_t *heap = (heap_t *)start;
+    size = end - start;
+
+    if (end < start || size < sizeof(heap_t)) {
+        return NULL; /* 'size' is too small to fit a heap here */
+    }
+
+    /* Use as many second level lists as the heap can afford, keeping the tables within 1/16 of the heap */
+    size_t sl_log2 = SL_LOG2_MAX;
+    size_t fl_count;
+    size_t tables_size;
+    while (true) {
+        fl_count = fls_size(size) - (sl_log2 + ALIGN_LOG2) + 2;
+        tables_size = fl_count * ((sizeof(heap_block_t *) << sl_log2) + sizeof(uint32_t));
+        if (sl_log2 == 0 || tables_size * 16 <= size) {
+            break;
+        }
+        sl_log2--;
+    }
+    tables_size = ALIGN_UP(tables_size);
+
+    /* heap_t, tables, the data size word and data of the first block, and the data size word of last_block */
+    if (size < sizeof(heap_t) + tables_size + sizeof(size_t) + BLOCK_MIN_SIZE + sizeof(size_t)) {
+        return NULL;
+    }
+
+    heap->lock = NULL;
+    heap->sl_log2 = sl_log2;
+    heap->fl_count = fl_count;
+    heap->fl_bitmap = 0;
+    memset(heap + 1, 0, tables_size);
+
+    /* first block takes the whole heap after the tables, its header is the first word after them
+       ('prev_phys' of the first block is never valid, so it can overlap the tables) */
+    heap->first_block = (heap_block_t *)(start + sizeof(heap_t) + tables_size - offsetof(heap_block_t, header));
+
+    /* last block is used and has no data, its header is the last word of the heap */
+    heap->last_block = (heap_block_t *)(end - offsetof(heap_block_t, data));
+    heap->last_block->header = 0;
+
+    heap->first_block->header = (intptr_t)&heap->last_block->header - (intptr_t)heap->first_block->data;
+
+    heap->free_bytes = 0;
+    mark_free(heap->first_block);
+    insert_free_block(heap, heap->first_block);
+    heap->minimum_free_bytes = heap->free_bytes;
+
+    return heap;
+}
+
+void multi_heap_set_lock(multi_heap_handle_t heap, void *lock)
+{
+    heap->lock = lock;
+}
+
+void inline multi_heap_internal_lock(multi_heap_handle_t heap)
+{
+    MULTI_HEAP_LOCK(heap->lock);
+}
+
+void inline multi_heap_internal_unlock(multi_heap_handle_t heap)
+{
+    MULTI_HEAP_UNLOCK(heap->lock);
+}
+
+multi_heap_block_handle_t multi_heap_get_first_block(multi_heap_handle_t heap)
+{
+    return heap->first_block;
+}
+
+multi_heap_block_handle_t multi_heap_get_next_block(multi_heap_handle_t heap, multi_heap_block_handle_t block)
+{
+    heap_block_t *next = get_next_block(block);
+    if (is_last_block(heap, next)) {
+        return NULL;
+    }
+    assert_valid_block(heap, next);
+    return next;
+}
+
+bool multi_heap_is_free(multi_heap_block_handle_t block)
+{
+    return is_free(block);
+}
+
+void *multi_heap_malloc_impl(multi_heap_handle_t heap, size_t size)
+{
+    size = ALIGN_UP(size);
+
+    if (size == 0 || heap == NULL) {
+        return NULL;
+    }
+    if (size < BLOCK_MIN_SIZE) {
+        size = BLOCK_MIN_SIZE;
+    }
+
+    multi_heap_internal_lock(heap);
+
+    if (heap->free_bytes < size) {
+        multi_heap_internal_unlock(heap);
+        return NULL;
+    }
+
+    heap_block_t *block = find_suitable_block(heap, size);
+    if (block == NULL) {
+        multi_heap_internal_unlock(heap);
+        return NULL; /* No room in heap */
+    }
+    MULTI_HEAP_ASSERT(block_data_size(block) >= size, block); // block from the free list should be big enough
+
+    remove_free_block(heap, block);
+    mark_used(block);
+#ifdef MULTI_HEAP_POISONING_SLOW
+    /* free list pointers and the next block's prev_phys are now data, which needs the fill pattern */
+    multi_heap_internal_poison_fill_region(block->data, 2 * sizeof(void *), true);
+    multi_heap_internal_poison_fill_region(&get_next_block(block)->prev_phys, sizeof(void *), true);
+#endif
+
+    split_if_necessary(heap, block, size);
+
+    if (heap->free_bytes < heap->minimum_free_bytes) {
+        heap->minimum_free_bytes = heap->free_bytes;
+    }
+
+    multi_heap_internal_unlock(heap);
+
+    return block->data;
+}
+
+void multi_heap_free_impl(multi_heap_handle_t heap, void *p)
+{
+    heap_block_t *pb = get_block(p);
+
+    if (heap == NULL || p == NULL) {
+        return;
+    }
+
+    multi_heap_internal_lock(heap);
+
+    assert_valid_block(heap, pb);
+    MULTI_HEAP_ASSERT(!is_free(pb), pb); // block should not be free
+    MULTI_HEAP_ASSERT(!is_last_block(heap, pb), pb); // block should not be last block
+
+    free_block(heap, pb);
+
+    multi_heap_internal_unlock(heap);
+}
+
+void *multi_heap_realloc_impl(multi_heap_handle_t heap, void *p, size_t size)
+{
+    heap_block_t *pb = get_block(p);
+    void *result;
+    size = ALIGN_UP(size);
+
+    assert(heap != NULL);
+
+    if (p == NULL) {
+        return multi_heap_malloc_impl(heap, size);
+    }
+
+    assert_valid_block(heap, pb);
+    // non-null realloc arg should be allocated
+    MULTI_HEAP_ASSERT(!is_free(pb), pb);
+
+    if (size == 0) {
+        /* note: calling multi_free_impl() here as we've already been
+           through any poison-unwrapping */
+        multi_heap_free_impl(heap, p);
+        return NULL;
+    }
+    if (size < BLOCK_MIN_SIZE) {
+        size = BLOCK_MIN_SIZE;
+    }
+
+    multi_heap_internal_lock(heap);
+    result = NULL;
+
+    size_t orig_size = block_data_size(pb);
+    if (size <= orig_size) {
+        // Shrinking....
+        split_if_necessary(heap, pb, size);
+        result = pb->data;
+    } else {
+        // Growing, see if the next block is free and big enough to grow into
+        heap_block_t *next = get_next_block(pb);
+        if (is_free(next) && orig_size + sizeof(pb->header) + block_data_size(next) >= size) {
+            remove_free_block(heap, next);
+            set_data_size(pb, orig_size + sizeof(pb->header) + block_data_size(next));
+            mark_used(pb);
+            split_if_necessary(heap, pb, size);
+            result = pb->data;
+        }
+    }
+
+    if (result == NULL) {
+        // Need to allocate elsewhere and copy data over
+        //
+        // (Calling _impl versions here as we've already been through any
+        // unwrapping for heap poisoning features.)
+        result = multi_heap_malloc_impl(heap, size);
+        if (result != NULL) {
+            memcpy(result, pb->data, orig_size);
+            multi_heap_free_impl(heap, pb->data);
+        }
+    }
+
+    if (heap->free_bytes < heap->minimum_free_bytes) {
+        heap->minimum_free_bytes = heap->free_bytes;
+    }
+
+    multi_heap_internal_unlock(heap);
+    return result;
+}
+
+#define FAIL_PRINT(MSG, ...) do {                                       \
+        if (print_errors) {                                             \
+            MULTI_HEAP_STDERR_PRINTF(MSG, __VA_ARGS__);                 \
+        }                                                               \
+        valid = false;                                                  \
+    }                                                                   \
+    while(0)
+
+bool multi_heap_check(multi_heap_handle_t heap, bool print_errors)
+{
+    bool valid = true;
+    size_t total_free_bytes = 0;
+    size_t free_blocks = 0;
+    assert(heap != NULL);
+
+    multi_heap_internal_lock(heap);
+
+    heap_block_t *prev = NULL;
+
+    /* note: not using get_next_block() in loop, so that assertions aren't checked here */
+    for(heap_block_t *b = heap->first_block; b != NULL; b = is_last_block(heap, b) ? NULL : get_next_block(b)) {
+        if (b <= prev) {
+            FAIL_PRINT("CORRUPT HEAP: Block %p is not after prev block %p\n", b, prev);
+            goto done;
+        }
+        if (b > heap->last_block || b < heap->first_block) {
+            FAIL_PRINT("CORRUPT HEAP: Block %p is outside heap (last valid block %p)\n", b, prev);
+            goto done;
+        }
+        if (prev == NULL && is_prev_free(b)) {
+            FAIL_PRINT("CORRUPT HEAP: First block %p has prev free flag set\n", b);
+        }
+        if (prev != NULL) {
+            if (is_prev_free(b) != is_free(prev)) {
+                FAIL_PRINT("CORRUPT HEAP: Block %p has wrong prev free flag for block %p\n", b, prev);
+            }
+            if (is_free(b) && is_free(prev)) {
+                FAIL_PRINT("CORRUPT HEAP: Two adjacent free blocks found, %p and %p\n", prev, b);
+            }
+            if (is_prev_free(b) && b->prev_phys != prev) {
+                FAIL_PRINT("CORRUPT HEAP: Block %p points to prev block %p, expected %p\n", b, b->prev_phys, prev);
+            }
+        }
+        if (is_free(b)) {
+            total_free_bytes += block_data_size(b);
+            free_blocks++;
+        }
+        prev = b;
+
+#ifdef MULTI_HEAP_POISONING
+        if (!is_last_block(heap, b)) {
+            /* For slow heap poisoning, any block should contain correct poisoning patterns and/or fills */
+            bool poison_ok;
+            if (is_free(b)) {
+                /* skip the free list pointers and prev_phys of the next block */
+                poison_ok = multi_heap_internal_check_block_poisoning(b->data + 2 * sizeof(void *),
+                                                                      block_data_size(b) - BLOCK_MIN_SIZE, true, print_errors);
+            }
+            else {
+                poison_ok = multi_heap_internal_check_block_poisoning(b->data, block_data_size(b), false, print_errors);
+            }
+            valid = poison_ok && valid;
+        }
+#endif
+
+    } /* for(heap_block_t b = ... */
+
+    if (prev != heap->last_block) {
+        FAIL_PRINT("CORRUPT HEAP: Last block %p not %p\n", prev, heap->last_block);
+    }
+    if (block_data_size(heap->last_block) != 0 || is_free(heap->last_block)) {
+        FAIL_PRINT("CORRUPT HEAP: Expected last block %p to be used and empty\n", heap->last_block);
+    }
+
+    /* Every free block should be in the free list of its size, and nothing else should */
+    size_t listed_blocks = 0;
+    for (size_t fl = 0; fl < heap->fl_count; fl++) {
+        bool fl_used = false;
+        for (size_t sl = 0; sl < ((size_t)1 << heap->sl_log2); sl++) {
+            heap_block_t *head = *free_list(heap, fl, sl);
+            if ((head != NULL) != ((*sl_bitmap(heap, fl) & (1U << sl)) != 0)) {
+                FAIL_PRINT("CORRUPT HEAP: Bitmap doesn't match free list %u/%u\n", (unsigned)fl, (unsigned)sl);
+            }
+            fl_used = fl_used || (head != NULL);
+            heap_block_t *prev_free = NULL;
+            for (heap_block_t *b = head; b != NULL && listed_blocks <= free_blocks; b = b->next_free) {
+                size_t b_fl, b_sl;
+                if (b < heap->first_block || b >= heap->last_block || !is_free(b)) {
+                    FAIL_PRINT("CORRUPT HEAP: Block %p in free list %u/%u is not a free block\n", b, (unsigned)fl, (unsigned)sl);
+                    goto done;
+                }
+                mapping_insert(heap, block_data_size(b), &b_fl, &b_sl);
+                if (b_fl != fl || b_sl != sl || b->prev_free != prev_free) {
+                    FAIL_PRINT("CORRUPT HEAP: Block %p is in wrong place in free list %u/%u\n", b, (unsigned)fl, (unsigned)sl);
+                }
+                prev_free = b;
+                listed_blocks++;
+            }
+        }
+        if (fl_used != ((heap->fl_bitmap & (1U << fl)) != 0)) {
+            FAIL_PRINT("CORRUPT HEAP: Bitmap doesn't match first level class %u\n", (unsigned)fl);
+        }
+    }
+    if (listed_blocks != free_blocks) {
+        FAIL_PRINT("CORRUPT HEAP: Expected %u free blocks in free lists, found %u\n", (unsigned)free_blocks, (unsigned)listed_blocks);
+    }
+
+    if (heap->free_bytes != total_free_bytes) {
+        FAIL_PRINT("CORRUPT HEAP: Expected %u free bytes counted %u\n", (unsigned)heap->free_bytes, (unsigned)total_free_bytes);
+    }
+
+ done:
+    multi_heap_internal_unlock(heap);
+
+    return valid;
+}
+
+void multi_heap_dump(multi_heap_handle_t heap)
+{
+    assert(heap != NULL);
+
+    multi_heap_internal_lock(heap);
+    MULTI_HEAP_STDERR_PRINTF("Heap start %p end %p\nFree list bitmap 0x%08x\n", heap->first_block, heap->last_block, heap->fl_bitmap);
+    for(heap_block_t *b = heap->first_block; !is_last_block(heap, b); b = get_next_block(b)) {
+        MULTI_HEAP_STDERR_PRINTF("Block %p data size 0x%08x bytes next block %p", b, block_data_size(b), get_next_block(b));
+        if (is_free(b)) {
+            MULTI_HEAP_STDERR_PRINTF(" FREE. Next free %p\n", b->next_free);
+        } else {
+            MULTI_HEAP_STDERR_PRINTF("%s", "\n"); /* C macros & optional __VA_ARGS__ */
+        }
+    }
+    multi_heap_internal_unlock(heap);
+}
+
+size_t multi_heap_free_size_impl(multi_heap_handle_t heap)
+{
+    if (heap == NULL) {
+        return 0;
+    }
+    return heap->free_bytes;
+}
+
+size_t multi_heap_minimum_free_size_impl(multi_heap_handle_t heap)
+{
+    if (heap == NULL) {
+        return 0;
+    }
+    return heap->minimum_free_bytes;
+}
+
+void multi_heap_get_info_impl(multi_heap_handle_t heap, multi_heap_info_t *info)
+{
+    memset(info, 0, sizeof(multi_heap_info_t));
+
+    if (heap == NULL) {
+        return;
+    }
+
+    multi_heap_internal_lock(heap);
+    for(heap_block_t *b = heap->first_block; !is_last_block(heap, b); b = get_next_block(b)) {
+        info->total_blocks++;
+        if (is_free(b)) {
+            size_t s = block_data_size(b);
+            info->total_free_bytes += s;
+            if (s > info->largest_free_block) {
+                info->largest_free_block = s;
+            }
+            info->free_blocks++;
+        } else {
+            info->total_allocated_bytes += block_data_size(b);
+            info->allocated_blocks++;
+        }
+    }
+
+    info->minimum_free_bytes = heap->minimum_free_bytes;
+    // heap has wrong total size (address printed here is not indicative of the real error)
+    MULTI_HEAP_ASSERT(info->total_free_bytes == heap->free_bytes, heap);
+
+    multi_heap_internal_unlock(heap);
+
+}
+
+#endif // MULTI_HEAP_TLSF
@@ -0,0 +1,53 @@
+/*
+ Tests for the per-core small allocation cache.
+
+ Only compiled in if CONFIG_HEAP_CACHE is set
+*/
+
+#include <stdlib.h>
+#include "unity.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef CONFIG_HEAP_CACHE
+
+#define CACHE_CAPS (MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL)
+
+TEST_CASE("small allocation cache reuses freed blocks", "[heap]")
+{
+    heap_caps_cache_stats_t before, after;
+
+    heap_caps_cache_drain();
+    TEST_ESP_OK(heap_caps_cache_get_stats(&before));
+    size_t free_before = heap_caps_get_free_size(CACHE_CAPS);
+
+    /* stay on one core, so the block goes to the cache of the core which allocates next */
+    vTaskSuspendAll();
+    void *a = malloc(40);
+    free(a);
+    void *b = malloc(33); /* same size class as 40 bytes */
+    xTaskResumeAll();
+
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_EQUAL_PTR(a, b);
+    TEST_ESP_OK(heap_caps_cache_get_stats(&after));
+    /* (other tasks may use the cache at the same time) */
+    TEST_ASSERT(after.hits > before.hits);
+    TEST_ASSERT(after.cached_frees > before.cached_frees);
+
+    /* a cached block counts as free memory */
+    free(b);
+    TEST_ASSERT_UINT32_WITHIN(32, free_before, heap_caps_get_free_size(CACHE_CAPS));
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, CACHE_CAPS);
+    TEST_ASSERT_UINT32_WITHIN(32, free_before, info.total_free_bytes);
+
+    heap_caps_cache_drain();
+    TEST_ASSERT(heap_caps_check_integrity_all(true));
+    TEST_ASSERT_UINT32_WITHIN(32, free_before, heap_caps_get_free_size(CACHE_CAPS));
+}
+
+#endif
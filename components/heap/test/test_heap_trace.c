@@ -59,11 +59,53 @@ TEST_CASE("heap trace leak check", "[heap]")
     heap_trace_get(0, &trace_b);
     TEST_ASSERT_EQUAL_PTR(b, trace_b.address);
 
-    /* buffer deletes trace_a when freed,
-       so trace_b at head of buffer */
-    TEST_ASSERT_EQUAL_PTR(recs[0].address, trace_b.address);
+    /* buffer slot of trace_a is cleared when freed,
+       trace_b stays where it is */
+    TEST_ASSERT_NULL(recs[0].address);
+    TEST_ASSERT_EQUAL_PTR(recs[1].address, trace_b.address);
+
+    heap_trace_stop();
+}
 
+TEST_CASE("heap trace leak check with many records", "[heap]")
+{
+    const size_t N = 256;
+    heap_trace_record_t *recs = calloc(N, sizeof(heap_trace_record_t));
+    TEST_ASSERT_NOT_NULL(recs);
+    heap_trace_init_standalone(recs, N);
+
+    void *ptrs[N / 2];
+
+    heap_trace_start(HEAP_TRACE_LEAKS);
+    for (int i = 0; i < N / 2; i++) {
+        ptrs[i] = malloc(i + 1);
+    }
+    /* free every other allocation, newest first */
+    for (int i = N / 2 - 2; i >= 0; i -= 2) {
+        free(ptrs[i]);
+    }
     heap_trace_stop();
+
+    /* remaining allocations are reported in the order they were made */
+    int next = 1;
+    for (int i = 0; i < heap_trace_get_count(); i++) {
+        heap_trace_record_t rec;
+        TEST_ESP_OK(heap_trace_get(i, &rec));
+        for (int j = 0; j < N / 2; j += 2) {
+            TEST_ASSERT_NOT_EQUAL(ptrs[j], rec.address);
+        }
+        if (next < N / 2 && rec.address == ptrs[next]) {
+            TEST_ASSERT_EQUAL(next + 1, rec.size);
+            next += 2;
+        }
+    }
+    TEST_ASSERT_EQUAL(N / 2 + 1, next);
+
+    for (int i = 1; i < N / 2; i += 2) {
+        free(ptrs[i]);
+    }
+    heap_trace_init_standalone(NULL, 0);
+    free(recs);
 }
 
 TEST_CASE("heap trace wrapped buffer check", "[heap]")
@@ -0,0 +1,15 @@
+#!/bin/bash
+#
+# Run the allocator benchmark with each heap allocator implementation
+#
+
+FAIL=0
+
+for FLAGS in "CONFIG_HEAP_ALLOCATOR_BEST_FIT" "CONFIG_HEAP_ALLOCATOR_TLSF"; do
+    echo "==== Benchmark with config: ${FLAGS} ===="
+    (CPPFLAGS="-D${FLAGS}" make clean test_multi_heap && ./test_multi_heap "[benchmark]") || FAIL=1
+done
+
+make clean
+
+exit $FAIL
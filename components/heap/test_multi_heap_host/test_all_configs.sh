@@ -5,9 +5,11 @@
 
 FAIL=0
 
-for FLAGS in "CONFIG_HEAP_POISONING_NONE" "CONFIG_HEAP_POISONING_LIGHT" "CONFIG_HEAP_POISONING_COMPREHENSIVE"; do
-    echo "==== Testing with config: ${FLAGS} ===="
-    CPPFLAGS="-D${FLAGS}" make clean test || FAIL=1
+for ALLOCATOR in "CONFIG_HEAP_ALLOCATOR_BEST_FIT" "CONFIG_HEAP_ALLOCATOR_TLSF"; do
+    for FLAGS in "CONFIG_HEAP_POISONING_NONE" "CONFIG_HEAP_POISONING_LIGHT" "CONFIG_HEAP_POISONING_COMPREHENSIVE"; do
+        echo "==== Testing with config: ${ALLOCATOR} ${FLAGS} ===="
+        CPPFLAGS="-D${ALLOCATOR} -D${FLAGS}" make clean test || FAIL=1
+    done
 done
 
 make clean
@@ -5,6 +5,9 @@
 
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
 
 /* Insurance against accidentally using libc heap functions in tests */
 #undef free
@@ -57,6 +60,8 @@ TEST_CASE("multi_heap simple allocations", "[multi_heap]")
 }
 
 
+#ifndef MULTI_HEAP_TLSF
+/* TLSF serves allocations from size class lists, so placement of blocks is only predictable for best fit */
 TEST_CASE("multi_heap fragmentation", "[multi_heap]")
 {
     uint8_t small_heap[256];
@@ -104,6 +109,7 @@ TEST_CASE("multi_heap fragmentation", "[multi_heap]")
     REQUIRE( p[0] == big ); /* big should now go where p[0] was freed from */
     multi_heap_free(heap, big);
 }
+#endif
 
 /* Test that malloc/free does not leave free space fragmented */
 TEST_CASE("multi_heap defrag", "[multi_heap]")
@@ -457,6 +463,11 @@ TEST_CASE("corrupt heap block", "[multi_heap]")
 TEST_CASE("unaligned heaps", "[multi_heap]")
 {
     const size_t CHUNK_LEN = 256;
+#ifdef MULTI_HEAP_TLSF
+    const size_t HEAP_OVERHEAD_MAX = 128; /* free list table is stored in the heap */
+#else
+    const size_t HEAP_OVERHEAD_MAX = 64;
+#endif
     const size_t CANARY_LEN = 16;
     const uint8_t CANARY_BYTE = 0x3E;
     uint8_t heap_chunk[CHUNK_LEN + CANARY_LEN * 2];
@@ -475,8 +486,8 @@ TEST_CASE("unaligned heaps", "[multi_heap]")
 
         multi_heap_get_info(heap, &info);
 
-        REQUIRE( info.total_free_bytes > CHUNK_LEN - 64 - i );
-        REQUIRE( info.largest_free_block > CHUNK_LEN - 64 - i );
+        REQUIRE( info.total_free_bytes > CHUNK_LEN - HEAP_OVERHEAD_MAX - i );
+        REQUIRE( info.largest_free_block > CHUNK_LEN - HEAP_OVERHEAD_MAX - i );
 
         void *a = multi_heap_malloc(heap, info.largest_free_block);
         REQUIRE( a != NULL );
@@ -494,3 +505,70 @@ TEST_CASE("unaligned heaps", "[multi_heap]")
         }
     }
 }
+
+/* Timing of malloc & free under a random workload, and fragmentation of the heap afterwards.
+
+   Not run by default, run ./test_multi_heap "[benchmark]" or benchmark_allocators.sh to compare the
+   allocator implementations.
+*/
+TEST_CASE("multi_heap allocator benchmark", "[multi_heap][.][benchmark]")
+{
+    static uint8_t heap_mem[64 * 1024];
+    const int NUM_POINTERS = 256;
+    const int ITERATIONS = 200000;
+
+    multi_heap_handle_t heap = multi_heap_register(heap_mem, sizeof(heap_mem));
+    REQUIRE( heap != NULL );
+
+    void *p[NUM_POINTERS] = { 0 };
+    std::vector<uint32_t> malloc_ns, free_ns;
+    malloc_ns.reserve(ITERATIONS);
+    free_ns.reserve(ITERATIONS);
+    int failed = 0;
+    uint32_t seed = 0x12345678;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        seed ^= seed << 13; /* xorshift32, same sequence on every run */
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        int n = seed % NUM_POINTERS;
+
+        if (p[n] != NULL) {
+            auto start = std::chrono::steady_clock::now();
+            multi_heap_free(heap, p[n]);
+            auto end = std::chrono::steady_clock::now();
+            free_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            p[n] = NULL;
+            continue;
+        }
+
+        /* mostly small allocations, with the occasional large buffer */
+        size_t size = (seed >> 8) % 16 ? 8 + (seed >> 12) % 248 : 256 + (seed >> 12) % 3840;
+        auto start = std::chrono::steady_clock::now();
+        p[n] = multi_heap_malloc(heap, size);
+        auto end = std::chrono::steady_clock::now();
+        malloc_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        if (p[n] == NULL) {
+            failed++;
+        }
+    }
+
+    multi_heap_info_t info;
+    multi_heap_get_info(heap, &info);
+    REQUIRE( multi_heap_check(heap, true) );
+
+    for (int i = 0; i < NUM_POINTERS; i++) {
+        multi_heap_free(heap, p[i]);
+    }
+
+    for (auto *v : { &malloc_ns, &free_ns }) {
+        std::sort(v->begin(), v->end());
+        printf("%s: %zu calls, ns p50 %u p90 %u p99 %u p99.9 %u max %u\n",
+               v == &malloc_ns ? "malloc" : "free", v->size(),
+               (*v)[v->size() / 2], (*v)[v->size() * 9 / 10], (*v)[v->size() * 99 / 100],
+               (*v)[v->size() * 999 / 1000], v->back());
+    }
+    printf("failed mallocs %d, free %zu bytes in %zu blocks, largest free block %zu (%u%%), minimum free %zu\n",
+           failed, info.total_free_bytes, info.free_blocks, info.largest_free_block,
+           (unsigned)(info.largest_free_block * 100 / info.total_free_bytes), info.minimum_free_bytes);
+}
@@ -22,6 +22,8 @@
 // events dispatched per second by event loop library
 #define IDF_PERFORMANCE_MIN_EVENT_DISPATCH                                      25000
 #define IDF_PERFORMANCE_MIN_EVENT_DISPATCH_PSRAM                                21000
+// cycles taken by ESP_LOGx to store a message with CONFIG_LOG_DEFERRED
+#define IDF_PERFORMANCE_MAX_LOG_DEFERRED_CYCLES_PER_MESSAGE                     800
 // esp_sha() time to process 32KB of input data from RAM
 #define IDF_PERFORMANCE_MAX_ESP32_TIME_SHA1_32KB 5000
 #define IDF_PERFORMANCE_MAX_ESP32_TIME_SHA512_32KB 4500
@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include "sdkconfig.h"
 #include <rom/ets_sys.h>
 
@@ -106,6 +107,87 @@ uint32_t esp_log_early_timestamp(void);
  */
 void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) __attribute__ ((format (printf, 3, 4)));
 
+/**
+ * @brief Output all log messages buffered for output by the log task
+ *
+ * With CONFIG_LOG_DEFERRED enabled, log messages are output by a low priority task.
+ * This function outputs the messages which are still buffered in the calling task,
+ * using the function set by esp_log_set_vprintf. It is called before a restart by
+ * esp_restart.
+ *
+ * This function does nothing if CONFIG_LOG_DEFERRED is disabled.
+ */
+void esp_log_flush(void);
+
+/**
+ * @brief Output all log messages buffered for output by the log task, without locking
+ *
+ * Same as esp_log_flush, but the messages are output with ets_printf and without taking
+ * any locks, so this function can be used after a crash. It is called by the panic handler.
+ *
+ * This function does nothing if CONFIG_LOG_DEFERRED is disabled.
+ */
+void esp_log_flush_nolock(void);
+
+/**
+ * @brief Function which writes binary log frames, see esp_log_binary_set_output
+ *
+ * @param data frame, or text of a message which can't be stored in a frame
+ * @param size size of the data in bytes
+ *
+ * @return number of bytes written, or a negative value in case of an error
+ */
+typedef int (*esp_log_binary_output_t)(const void* data, size_t size);
+
+/**
+ * @brief vprintf-like function which outputs log messages as binary frames
+ *
+ * Pass this function to esp_log_set_vprintf to output log messages as frames holding
+ * the address of the format string and the values of the arguments, instead of formatted
+ * text. This saves the time to format messages and most of the output size. The frames
+ * are decoded on the host by components/log/log_binary_decode.py, which needs the ELF
+ * file of the app.
+ *
+ * Messages with a format string which is not in flash, or with arguments which don't fit
+ * into a frame, are output as text, which the decoder passes through.
+ *
+ * Only available if CONFIG_LOG_BINARY is enabled.
+ *
+ * @param format format string
+ * @param args arguments
+ *
+ * @return number of bytes written, or a negative value in case of an error
+ */
+int esp_log_binary_vprintf(const char* format, va_list args);
+
+/**
+ * @brief Set function used to write binary log frames
+ *
+ * By default, esp_log_binary_vprintf writes frames to the console UART. This function
+ * can be used to send them some other way, e.g. to the host using esp_apptrace_write.
+ * The function is called once for each frame, and never by two tasks at the same time.
+ *
+ * Only available if CONFIG_LOG_BINARY is enabled.
+ *
+ * @param func new function used to write frames
+ *
+ * @return old function used to write frames
+ */
+esp_log_binary_output_t esp_log_binary_set_output(esp_log_binary_output_t func);
+
+/**
+ * @brief Tag with a cached log level
+ *
+ * Variables of this type are defined with ESP_LOG_TAG_DEFINE and used with the
+ * ESP_LOGE_TAG, ESP_LOGW_TAG, ESP_LOGI_TAG, ESP_LOGD_TAG and ESP_LOGV_TAG macros.
+ * They cache the level set for the tag with esp_log_level_set, so messages which are
+ * not output are skipped without calling esp_log_write.
+ */
+typedef struct {
+    const char* name;           /*!< Tag of the log entries */
+    volatile uint32_t state;    /*!< Cached level of the tag, for internal use */
+} esp_log_tag_t;
+
 /** @cond */
 
 #include "esp_log_internal.h"
@@ -311,6 +393,43 @@ void esp_log_write(esp_log_level_t level, const char* tag, const char* format, .
         if ( LOG_LOCAL_LEVEL >= level ) ESP_LOG_LEVEL(level, tag, format, ##__VA_ARGS__); \
     } while(0)
 
+/**
+ * Define a static tag variable to be used with the ``ESP_LOGx_TAG`` macros, e.g.
+ * ``ESP_LOG_TAG_DEFINE(s_tag, "MyModule");``
+ *
+ * @param var name of the variable.
+ * @param tag_name tag of the log, which can be used to change the log level by ``esp_log_level_set`` at runtime.
+ */
+#define ESP_LOG_TAG_DEFINE(var, tag_name) static esp_log_tag_t var = { (tag_name), 0 }
+
+#ifndef BOOTLOADER_BUILD
+/** runtime macro to output logs at a specified level, with a tag variable defined by ``ESP_LOG_TAG_DEFINE``.
+ * Unlike ``ESP_LOG_LEVEL_LOCAL``, esp_log_write is not called if the level of the tag is lower.
+ *
+ * @see ``printf``, ``ESP_LOG_LEVEL_LOCAL``
+ */
+#define ESP_LOG_TAG_LEVEL_LOCAL(level, tag_var, format, ...) do {       \
+        if ( LOG_LOCAL_LEVEL >= level && esp_log_tag_enabled(&(tag_var), level) ) ESP_LOG_LEVEL(level, (tag_var).name, format, ##__VA_ARGS__); \
+    } while(0)
+
+/// macro to output logs at ``ESP_LOG_ERROR`` level, with a tag variable defined by ``ESP_LOG_TAG_DEFINE``.  @see ``ESP_LOGE``
+#define ESP_LOGE_TAG( tag_var, format, ... ) ESP_LOG_TAG_LEVEL_LOCAL(ESP_LOG_ERROR,   tag_var, format, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_WARN`` level.  @see ``ESP_LOGE_TAG``
+#define ESP_LOGW_TAG( tag_var, format, ... ) ESP_LOG_TAG_LEVEL_LOCAL(ESP_LOG_WARN,    tag_var, format, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_INFO`` level.  @see ``ESP_LOGE_TAG``
+#define ESP_LOGI_TAG( tag_var, format, ... ) ESP_LOG_TAG_LEVEL_LOCAL(ESP_LOG_INFO,    tag_var, format, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_DEBUG`` level.  @see ``ESP_LOGE_TAG``
+#define ESP_LOGD_TAG( tag_var, format, ... ) ESP_LOG_TAG_LEVEL_LOCAL(ESP_LOG_DEBUG,   tag_var, format, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_VERBOSE`` level.  @see ``ESP_LOGE_TAG``
+#define ESP_LOGV_TAG( tag_var, format, ... ) ESP_LOG_TAG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag_var, format, ##__VA_ARGS__)
+#else
+#define ESP_LOGE_TAG( tag_var, format, ... ) ESP_EARLY_LOGE((tag_var).name, format, ##__VA_ARGS__)
+#define ESP_LOGW_TAG( tag_var, format, ... ) ESP_EARLY_LOGW((tag_var).name, format, ##__VA_ARGS__)
+#define ESP_LOGI_TAG( tag_var, format, ... ) ESP_EARLY_LOGI((tag_var).name, format, ##__VA_ARGS__)
+#define ESP_LOGD_TAG( tag_var, format, ... ) ESP_EARLY_LOGD((tag_var).name, format, ##__VA_ARGS__)
+#define ESP_LOGV_TAG( tag_var, format, ... ) ESP_EARLY_LOGV((tag_var).name, format, ##__VA_ARGS__)
+#endif  // BOOTLOADER_BUILD
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,5 +20,32 @@ void esp_log_buffer_hex_internal(const char *tag, const void *buffer, uint16_t b
 void esp_log_buffer_char_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level);
 void esp_log_buffer_hexdump_internal( const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t log_level);
 
+#ifndef BOOTLOADER_BUILD
+#include <stdbool.h>
+
+//incremented each time a log level changes, in steps which keep the level bits of esp_log_tag_t::state clear
+extern volatile uint32_t esp_log_level_generation;
+
+//looks up the level of the tag and caches it in the variable, returns the new state
+uint32_t esp_log_tag_update(esp_log_tag_t* tag);
+
+//checks the level cached in a tag variable, used by the ESP_LOGx_TAG macros
+static inline bool esp_log_tag_enabled(esp_log_tag_t* tag, esp_log_level_t level)
+{
+    uint32_t state = tag->state;
+    if ((state & ~7) != esp_log_level_generation) {
+        state = esp_log_tag_update(tag);
+    }
+    return level <= (esp_log_level_t) (state & 7);
+}
+#endif
+
+#ifdef CONFIG_LOG_DEFERRED
+#include "esp_err.h"
+
+//starts the task which outputs log messages, called during startup
+esp_err_t esp_log_deferred_init(void);
+#endif
+
 #endif
 
@@ -16,23 +16,32 @@
  * Log library implementation notes.
  *
  * Log library stores all tags provided to esp_log_level_set as a linked
- * list. See uncached_tag_entry_t structure.
+ * list. See uncached_tag_entry_t structure. Entries are never removed from
+ * the list, and a new entry is only linked in once it is complete, so the
+ * list can be walked without a lock while esp_log_level_set updates it.
+ * esp_log_level_set("*", ...) marks all entries as using the default level.
  *
  * To avoid looking up log level for given tag each time message is
  * printed, this library caches pointers to tags. Because the suggested
  * way of creating tags uses one 'TAG' constant per file, this caching
- * should be effective. Cache is a binary min-heap of cached_tag_entry_t
- * items, ordering is done on 'generation' member. In this context,
- * generation is an integer which is incremented each time an operation
- * with cache is performed. When cache is full, new item is inserted in
- * place of an oldest item (that is, with smallest 'generation' value).
- * After that, bubble-down operation is performed to fix ordering in the
- * min-heap.
+ * should be effective. Each CPU has its own cache, indexed by a hash of
+ * the tag pointer, which is only accessed with interrupts disabled on that
+ * CPU. A cached level is stored together with the value of
+ * esp_log_level_generation when it was looked up. Each change of a level
+ * increments the generation after the new level has been stored, which
+ * invalidates all cached levels, so no lock is taken to check the level of
+ * a message. Levels cached in esp_log_tag_t variables (see
+ * ESP_LOG_TAG_DEFINE) work the same way, and can be checked without calling
+ * esp_log_write at all.
  *
- * The potential problem with wrap-around of cache generation counter is
- * ignored for now. This will happen if someone happens to output more
- * than 4 billion log entries, at which point wrap-around will not be
- * the biggest problem.
+ * The generation counter wraps around after 2**29 changes of log levels,
+ * at which point a stale cached level may be used once.
+ *
+ * With CONFIG_LOG_DEFERRED, messages which pass the level check are not
+ * formatted by esp_log_write. Instead, the format string pointer and the
+ * arguments are stored as a record in a ring buffer of the current CPU,
+ * and a low priority task formats and outputs the records. See the
+ * "Deferred logging" section below.
  *
  */
 
@@ -44,6 +53,7 @@
 #endif
 
 #include "esp_attr.h"
+#include "esp_err.h"
 #include "xtensa/hal.h"
 #include "soc/soc.h"
 #include <stdbool.h>
@@ -57,6 +67,7 @@
 #include "esp_log.h"
 
 #include "rom/queue.h"
+#include "rom/uart.h"
 #include "soc/soc_memory_layout.h"
 
 //print number of bytes per line for esp_log_buffer_char and esp_log_buffer_hex
@@ -64,47 +75,42 @@
 
 #ifndef BOOTLOADER_BUILD
 
-// Number of tags to be cached. Must be 2**n - 1, n >= 2.
-#define TAG_CACHE_SIZE 31
+// Number of tags to be cached on each CPU. Must be a power of 2.
+#define TAG_CACHE_SIZE 32
 
-// Maximum time to wait for the mutex in a logging statement.
-#define MAX_MUTEX_WAIT_MS 10
-#define MAX_MUTEX_WAIT_TICKS ((MAX_MUTEX_WAIT_MS + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
+// Level of a tag entry which uses the default level
+#define LOG_LEVEL_DEFAULT 0xff
 
-// Uncomment this to enable consistency checks and cache statistics in this file.
-// #define LOG_BUILTIN_CHECKS
+// Bits of esp_log_tag_t::state and cached_tag_entry_t::state holding the level,
+// the other bits hold the generation
+#define LOG_STATE_LEVEL_MASK 7
 
 typedef struct {
     const char* tag;
-    uint32_t level : 3;
-    uint32_t generation : 29;
+    uint32_t state;
 } cached_tag_entry_t;
 
 typedef struct uncached_tag_entry_{
     SLIST_ENTRY(uncached_tag_entry_) entries; 
-    uint8_t level;  // esp_log_level_t as uint8_t
+    volatile uint8_t level;  // esp_log_level_t as uint8_t, or LOG_LEVEL_DEFAULT
     char tag[0];    // beginning of a zero-terminated string
 } uncached_tag_entry_t;
 
-static esp_log_level_t s_log_default_level = ESP_LOG_VERBOSE;
+static volatile esp_log_level_t s_log_default_level = ESP_LOG_VERBOSE;
 static SLIST_HEAD(log_tags_head , uncached_tag_entry_) s_log_tags = SLIST_HEAD_INITIALIZER(s_log_tags);
-static cached_tag_entry_t s_log_cache[TAG_CACHE_SIZE];
-static uint32_t s_log_cache_max_generation = 0;
-static uint32_t s_log_cache_entry_count = 0;
+static cached_tag_entry_t s_log_cache[portNUM_PROCESSORS][TAG_CACHE_SIZE];
 static vprintf_like_t s_log_print_func = &vprintf;
 static SemaphoreHandle_t s_log_mutex = NULL;
 
-#ifdef LOG_BUILTIN_CHECKS
-static uint32_t s_log_cache_misses = 0;
-#endif
+volatile uint32_t esp_log_level_generation = LOG_STATE_LEVEL_MASK + 1;
 
-static inline bool get_cached_log_level(const char* tag, esp_log_level_t* level);
-static inline bool get_uncached_log_level(const char* tag, esp_log_level_t* level);
-static inline void add_to_cache(const char* tag, esp_log_level_t level);
-static void heap_bubble_down(int index);
-static inline void heap_swap(int i, int j);
+static inline uint32_t get_log_level_state(const char* tag);
+static inline uint32_t get_uncached_log_level_state(const char* tag);
 static inline bool should_output(esp_log_level_t level_for_message, esp_log_level_t level_for_tag);
-static inline void clear_log_level_list();
+static void log_level_changed(void);
+#ifdef CONFIG_LOG_DEFERRED
+static bool log_deferred_write(const char* format, va_list args);
+#endif
 
 vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
 {
@@ -127,16 +133,19 @@ void esp_log_level_set(const char* tag, esp_log_level_t level)
     }
     xSemaphoreTake(s_log_mutex, portMAX_DELAY);
 
-    // for wildcard tag, remove all linked list items and clear the cache
+    uncached_tag_entry_t *it = NULL;
+    // for wildcard tag, set the default level and make all linked list items use it
     if (strcmp(tag, "*") == 0) {
         s_log_default_level = level;
-        clear_log_level_list();
+        SLIST_FOREACH( it, &s_log_tags, entries ) {
+            it->level = LOG_LEVEL_DEFAULT;
+        }
+        log_level_changed();
         xSemaphoreGive(s_log_mutex);
         return;
     }
 
     //searching exist tag
-    uncached_tag_entry_t *it = NULL;
     SLIST_FOREACH( it, &s_log_tags, entries ) {
         if ( strcmp(it->tag, tag)==0 ) {
             //one tag in the linked list match, update the level
@@ -156,136 +165,103 @@ void esp_log_level_set(const char* tag, esp_log_level_t level)
         }
         new_entry->level = (uint8_t) level;
         strcpy(new_entry->tag, tag);
-        SLIST_INSERT_HEAD( &s_log_tags, new_entry, entries );
+        SLIST_NEXT(new_entry, entries) = SLIST_FIRST(&s_log_tags);
+        // the entry may be found by esp_log_write as soon as it is linked in
+        __sync_synchronize();
+        SLIST_FIRST(&s_log_tags) = new_entry;
     }
 
-    //search in the cache and update it if exist         
-    for (int i = 0; i < s_log_cache_entry_count; ++i) {
-#ifdef LOG_BUILTIN_CHECKS
-        assert(i == 0 || s_log_cache[(i - 1) / 2].generation < s_log_cache[i].generation);
-#endif
-        if (strcmp(s_log_cache[i].tag,tag) == 0) {
-            s_log_cache[i].level = level;
-            break;
-        }
-    }
+    log_level_changed();
     xSemaphoreGive(s_log_mutex);
 }
 
-void clear_log_level_list()
+static void log_level_changed(void)
 {
-    while( !SLIST_EMPTY(&s_log_tags)) {
-        SLIST_REMOVE_HEAD(&s_log_tags, entries );
+    // the new levels must be visible before the cached levels become invalid
+    __sync_synchronize();
+    uint32_t generation = esp_log_level_generation + LOG_STATE_LEVEL_MASK + 1;
+    if (generation == 0) {
+        // never matches esp_log_tag_t variables which haven't been used yet
+        generation += LOG_STATE_LEVEL_MASK + 1;
     }
-    s_log_cache_entry_count = 0;
-    s_log_cache_max_generation = 0;
-#ifdef LOG_BUILTIN_CHECKS
-    s_log_cache_misses = 0;
-#endif
+    esp_log_level_generation = generation;
 }
 
 void IRAM_ATTR esp_log_write(esp_log_level_t level,
         const char* tag,
         const char* format, ...)
 {
-    if (!s_log_mutex) {
-        s_log_mutex = xSemaphoreCreateMutex();
-    }
-    if (xSemaphoreTake(s_log_mutex, MAX_MUTEX_WAIT_TICKS) == pdFALSE) {
-        return;
-    }
-    esp_log_level_t level_for_tag;
-    // Look for the tag in cache first, then in the linked list of all tags
-    if (!get_cached_log_level(tag, &level_for_tag)) {
-        if (!get_uncached_log_level(tag, &level_for_tag)) {
-            level_for_tag = s_log_default_level;
-        }
-        add_to_cache(tag, level_for_tag);
-#ifdef LOG_BUILTIN_CHECKS
-        ++s_log_cache_misses;
-#endif
-    }
-    xSemaphoreGive(s_log_mutex);
+    esp_log_level_t level_for_tag = get_log_level_state(tag) & LOG_STATE_LEVEL_MASK;
     if (!should_output(level, level_for_tag)) {
         return;
     }
 
     va_list list;
     va_start(list, format);
+#ifdef CONFIG_LOG_DEFERRED
+    if (log_deferred_write(format, list)) {
+        va_end(list);
+        return;
+    }
+#endif
     (*s_log_print_func)(format, list);
     va_end(list);
 }
 
-static inline bool get_cached_log_level(const char* tag, esp_log_level_t* level)
+uint32_t esp_log_tag_update(esp_log_tag_t* tag)
 {
-    // Look for `tag` in cache
-    int i;
-    for (i = 0; i < s_log_cache_entry_count; ++i) {
-#ifdef LOG_BUILTIN_CHECKS
-        assert(i == 0 || s_log_cache[(i - 1) / 2].generation < s_log_cache[i].generation);
-#endif
-        if (s_log_cache[i].tag == tag) {
-            break;
-        }
-    }
-    if (i == s_log_cache_entry_count) { // Not found in cache
-        return false;
-    }
-    // Return level from cache
-    *level = (esp_log_level_t) s_log_cache[i].level;
-    // If cache has been filled, start taking ordering into account
-    // (other options are: dynamically resize cache, add "dummy" entries
-    //  to the cache; this option was chosen because code is much simpler,
-    //  and the unfair behavior of cache will show it self at most once, when
-    //  it has just been filled)
-    if (s_log_cache_entry_count == TAG_CACHE_SIZE) {
-        // Update item generation
-        s_log_cache[i].generation = s_log_cache_max_generation++;
-        // Restore heap ordering
-        heap_bubble_down(i);
-    }
-    return true;
+    uint32_t state = get_log_level_state(tag->name);
+    tag->state = state;
+    return state;
 }
 
-static inline void add_to_cache(const char* tag, esp_log_level_t level)
+static inline uint32_t get_log_level_state(const char* tag)
 {
-    uint32_t generation = s_log_cache_max_generation++;
-    // First consider the case when cache is not filled yet.
-    // In this case, just add new entry at the end.
-    // This happens to satisfy binary min-heap ordering.
-    if (s_log_cache_entry_count < TAG_CACHE_SIZE) {
-        s_log_cache[s_log_cache_entry_count] = (cached_tag_entry_t) {
-            .generation = generation,
-            .level = level,
-            .tag = tag
-        };
-        ++s_log_cache_entry_count;
-        return;
+    uintptr_t index = ((uintptr_t) tag ^ ((uintptr_t) tag >> 5)) % TAG_CACHE_SIZE;
+    uint32_t generation = esp_log_level_generation;
+
+    // Look for `tag` in the cache of the current CPU first
+    unsigned irq_state = portENTER_CRITICAL_NESTED();
+    cached_tag_entry_t* entry = &s_log_cache[xPortGetCoreID()][index];
+    uint32_t state = entry->state;
+    bool found = entry->tag == tag && (state & ~LOG_STATE_LEVEL_MASK) == generation;
+    portEXIT_CRITICAL_NESTED(irq_state);
+    if (found) {
+        return state;
     }
 
-    // Cache is full, so we replace the oldest entry (which is at index 0
-    // because this is a min-heap) with the new one, and do bubble-down
-    // operation to restore min-heap ordering.
-    s_log_cache[0] = (cached_tag_entry_t) {
-        .tag = tag,
-        .level = level,
-        .generation = generation
-    };
-    heap_bubble_down(0);
+    // Then in the linked list of all tags
+    state = get_uncached_log_level_state(tag);
+
+    // The task may have moved to the other CPU in the meantime
+    irq_state = portENTER_CRITICAL_NESTED();
+    entry = &s_log_cache[xPortGetCoreID()][index];
+    entry->tag = tag;
+    entry->state = state;
+    portEXIT_CRITICAL_NESTED(irq_state);
+    return state;
 }
 
-static inline bool get_uncached_log_level(const char* tag, esp_log_level_t* level)
+static inline uint32_t get_uncached_log_level_state(const char* tag)
 {
+    // A level found after reading the generation is at least as new as the generation
+    uint32_t generation = esp_log_level_generation;
+    __sync_synchronize();
+
     // Walk the linked list of all tags and see if given tag is present in the list.
     // This is slow because tags are compared as strings.
+    uint8_t level = LOG_LEVEL_DEFAULT;
     uncached_tag_entry_t *it;
     SLIST_FOREACH( it, &s_log_tags, entries ) {
         if (strcmp(tag, it->tag) == 0) {
-            *level = it->level;
-            return true;
+            level = it->level;
+            break;
         }
     }
-    return false;
+    if (level == LOG_LEVEL_DEFAULT) {
+        level = s_log_default_level;
+    }
+    return generation | level;
 }
 
 static inline bool should_output(esp_log_level_t level_for_message, esp_log_level_t level_for_tag)
@@ -293,22 +269,858 @@ static inline bool should_output(esp_log_level_t level_for_message, esp_log_leve
     return level_for_message <= level_for_tag;
 }
 
-static void heap_bubble_down(int index)
+#if defined(CONFIG_LOG_DEFERRED) || defined(CONFIG_LOG_BINARY)
+
+/*
+ * Arguments of deferred and binary log messages.
+ *
+ * The arguments of a message are stored in the order in which the format
+ * string consumes them. Each argument is stored by value in a multiple of
+ * 4 bytes. String arguments in flash are stored as pointers; other strings
+ * may be gone or changed by the time the message is output, so they are
+ * copied after the other arguments and stored as their offset from the first
+ * argument, which is never 0.
+ */
+
+// Messages whose records or frames would be larger are output as text immediately
+#define LOG_RECORD_MAX_SIZE     256
+#define LOG_ARG_SIZE(size)      (((size) + 3) & ~3)
+
+// Value of a '*' precision or width
+#define LOG_PRECISION_ARG       (-2)
+
+typedef enum {
+    LOG_ARG_NONE,               // conversion without an argument, "%%"
+    LOG_ARG_INVALID,            // not a conversion, output as it is
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE_T,
+    LOG_ARG_INTMAX,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LDOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+} log_arg_type_t;
+
+typedef struct {
+    const char* start;          // '%' starting the conversion specification
+    const char* end;            // first character after the specification
+    log_arg_type_t type;        // type of the argument
+    uint8_t stars;              // number of int arguments for '*' width and precision, before the argument
+    int precision;              // precision, -1 if none, LOG_PRECISION_ARG if taken from an argument
+} log_conversion_t;
+
+// Finds the next conversion specification in a format string, starting at p.
+// Returns a pointer to its '%', or NULL if there are no more conversions.
+static const char* log_format_next(const char* p, log_conversion_t* conv)
+{
+    enum { LENGTH_NONE, LENGTH_L, LENGTH_LL, LENGTH_J, LENGTH_Z, LENGTH_LD } length = LENGTH_NONE;
+
+    while (*p != '%') {
+        if (*p == '\0') {
+            return NULL;
+        }
+        p++;
+    }
+
+    conv->start = p++;
+    conv->stars = 0;
+    conv->precision = -1;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    if (*p == '*') {
+        conv->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            conv->stars++;
+            conv->precision = LOG_PRECISION_ARG;
+            p++;
+        } else {
+            conv->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                conv->precision = conv->precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+
+    switch (*p) {
+    case 'h':
+        p += (p[1] == 'h') ? 2 : 1;
+        break;
+    case 'l':
+        if (p[1] == 'l') {
+            length = LENGTH_LL;
+            p += 2;
+        } else {
+            length = LENGTH_L;
+            p++;
+        }
+        break;
+    case 'q':
+        length = LENGTH_LL;
+        p++;
+        break;
+    case 'j':
+        length = LENGTH_J;
+        p++;
+        break;
+    case 'z':
+    case 't':
+        length = LENGTH_Z;
+        p++;
+        break;
+    case 'L':
+        length = LENGTH_LD;
+        p++;
+        break;
+    }
+
+    conv->end = (*p != '\0') ? p + 1 : p;
+
+    switch (*p) {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        switch (length) {
+        case LENGTH_L:
+            conv->type = LOG_ARG_LONG;
+            break;
+        case LENGTH_LL:
+            conv->type = LOG_ARG_LLONG;
+            break;
+        case LENGTH_J:
+            conv->type = LOG_ARG_INTMAX;
+            break;
+        case LENGTH_Z:
+            conv->type = LOG_ARG_SIZE_T;
+            break;
+        default:
+            conv->type = LOG_ARG_INT;
+            break;
+        }
+        break;
+    case 'c':
+        conv->type = LOG_ARG_INT;
+        break;
+    case 's':
+        // Wide strings are not copied
+        conv->type = (length == LENGTH_L) ? LOG_ARG_PTR : LOG_ARG_STR;
+        break;
+    case 'p':
+    case 'n':
+        conv->type = LOG_ARG_PTR;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        conv->type = (length == LENGTH_LD) ? LOG_ARG_LDOUBLE : LOG_ARG_DOUBLE;
+        break;
+    case '%':
+        conv->type = LOG_ARG_NONE;
+        break;
+    default:
+        conv->type = LOG_ARG_INVALID;
+        break;
+    }
+
+    return conv->start;
+}
+
+// Number of bytes of a string argument copied into a record, including the terminating zero
+static size_t log_string_size(const char* str, int precision)
+{
+    if (str == NULL || esp_ptr_in_drom(str)) {
+        return 0;
+    }
+    // A longer string makes the record too large anyway
+    size_t max_len = LOG_RECORD_MAX_SIZE;
+    if (precision >= 0 && (size_t) precision < max_len) {
+        max_len = precision;
+    }
+    return strnlen(str, max_len) + 1;
+}
+
+#define LOG_RECORD_STORE(type) do {                 \
+        type value = va_arg(args, type);            \
+        if (args_buf != NULL) {                     \
+            memcpy(args_buf + size, &value, sizeof(type)); \
+        }                                           \
+        size += LOG_ARG_SIZE(sizeof(type));         \
+    } while (0)
+
+// Stores the arguments of a message in args_buf, with copied strings following
+// the args_size bytes of the other arguments, as computed by a previous call with
+// args_buf set to NULL. strings_size is the space for copied strings.
+// Returns the size of the arguments, not including copied strings.
+static size_t log_record_args(uint8_t* args_buf, size_t args_size, size_t* strings_size,
+                              const char* format, va_list args)
 {
-    while (index < TAG_CACHE_SIZE / 2) {
-        int left_index = index * 2 + 1;
-        int right_index = left_index + 1;
-        int next = (s_log_cache[left_index].generation < s_log_cache[right_index].generation) ? left_index : right_index;
-        heap_swap(index, next);
-        index = next;
+    size_t size = 0;
+    size_t strings = 0;
+    log_conversion_t conv;
+
+    while ((format = log_format_next(format, &conv)) != NULL) {
+        format = conv.end;
+        int precision = conv.precision;
+
+        for (int i = 0; i < conv.stars; i++) {
+            int value = va_arg(args, int);
+            if (args_buf != NULL) {
+                memcpy(args_buf + size, &value, sizeof(value));
+            }
+            size += LOG_ARG_SIZE(sizeof(value));
+            if (precision == LOG_PRECISION_ARG) {
+                // The precision is the last '*'
+                precision = value;
+            }
+        }
+
+        switch (conv.type) {
+        case LOG_ARG_INT:
+            LOG_RECORD_STORE(int);
+            break;
+        case LOG_ARG_LONG:
+            LOG_RECORD_STORE(long);
+            break;
+        case LOG_ARG_LLONG:
+            LOG_RECORD_STORE(long long);
+            break;
+        case LOG_ARG_SIZE_T:
+            LOG_RECORD_STORE(size_t);
+            break;
+        case LOG_ARG_INTMAX:
+            LOG_RECORD_STORE(intmax_t);
+            break;
+        case LOG_ARG_DOUBLE:
+            LOG_RECORD_STORE(double);
+            break;
+        case LOG_ARG_LDOUBLE:
+            LOG_RECORD_STORE(long double);
+            break;
+        case LOG_ARG_PTR:
+            LOG_RECORD_STORE(void*);
+            break;
+        case LOG_ARG_STR: {
+            const char* str = va_arg(args, const char*);
+            size_t str_size = log_string_size(str, precision);
+            uintptr_t value = (uintptr_t) str;
+            if (args_buf != NULL && str_size > 0) {
+                // The string may have changed since its size was computed
+                if (str_size > *strings_size - strings) {
+                    str_size = *strings_size - strings;
+                }
+                value = args_size + strings;
+                memcpy(args_buf + args_size + strings, str, str_size - 1);
+                args_buf[args_size + strings + str_size - 1] = '\0';
+            }
+            if (args_buf != NULL) {
+                memcpy(args_buf + size, &value, sizeof(value));
+            }
+            size += LOG_ARG_SIZE(sizeof(value));
+            strings += str_size;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (args_buf == NULL) {
+        *strings_size = strings;
     }
+    return size;
 }
 
-static inline void heap_swap(int i, int j)
+static volatile uint32_t s_log_seq;
+
+// Sequence number of a message, across CPUs
+static uint32_t log_next_seq(void)
 {
-    cached_tag_entry_t tmp = s_log_cache[i];
-    s_log_cache[i] = s_log_cache[j];
-    s_log_cache[j] = tmp;
+    uint32_t seq, next;
+    do {
+        seq = s_log_seq;
+        next = seq + 1;
+        uxPortCompareSet(&s_log_seq, seq, &next);
+    } while (next != seq);
+    return seq;
+}
+
+#endif // CONFIG_LOG_DEFERRED || CONFIG_LOG_BINARY
+
+#ifdef CONFIG_LOG_BINARY
+
+/*
+ * Binary log encoding.
+ *
+ * esp_log_binary_vprintf outputs a message as a frame holding a sequence
+ * number, the address of the format string and the arguments, stored as
+ * described above. Frames start with a byte which never occurs in text, so
+ * they can be told apart from text output by other means, e.g. by the ROM or
+ * the panic handler. Messages which can't be stored in a frame are output as
+ * text. log_binary_decode.py formats the frames on the host, reading the
+ * format strings and string arguments in flash from the ELF file of the app.
+ */
+
+#define LOG_BINARY_MARKER       0xff
+#define LOG_BINARY_VERSION      1
+
+typedef struct {
+    uint8_t marker;             // LOG_BINARY_MARKER
+    uint8_t version;            // LOG_BINARY_VERSION
+    uint16_t size;              // size of the frame, including this header
+    uint32_t seq;               // sequence number, across CPUs
+    uint32_t format;            // address of the format string
+    uint8_t args[];             // arguments, then copied strings
+} log_binary_frame_t;
+
+typedef union {
+    log_binary_frame_t frame;
+    uint32_t words[LOG_RECORD_MAX_SIZE / sizeof(uint32_t)];
+    char text[LOG_RECORD_MAX_SIZE];
+} log_binary_buf_t;
+
+static int log_binary_uart_output(const void* data, size_t size);
+
+static esp_log_binary_output_t s_log_binary_output = &log_binary_uart_output;
+static SemaphoreHandle_t s_log_binary_mutex = NULL;
+
+static int log_binary_uart_output(const void* data, size_t size)
+{
+    // Not written to stdout, which may change line endings
+    const uint8_t* bytes = (const uint8_t*) data;
+    for (size_t i = 0; i < size; i++) {
+        uart_tx_one_char(bytes[i]);
+    }
+    return size;
+}
+
+// Writes a frame or text, so that writes from different tasks don't interleave
+static int log_binary_write(const void* data, size_t size)
+{
+    if (!s_log_binary_mutex) {
+        s_log_binary_mutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(s_log_binary_mutex, portMAX_DELAY);
+    int ret = (*s_log_binary_output)(data, size);
+    xSemaphoreGive(s_log_binary_mutex);
+    return ret;
+}
+
+static int log_binary_write_text(log_binary_buf_t* buf, const char* format, va_list args)
+{
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = vsnprintf(buf->text, sizeof(buf->text), format, args_copy);
+    va_end(args_copy);
+    if (len < 0) {
+        return len;
+    }
+    if ((size_t) len < sizeof(buf->text)) {
+        return log_binary_write(buf->text, len);
+    }
+
+    char* text = malloc(len + 1);
+    if (text == NULL) {
+        return log_binary_write(buf->text, sizeof(buf->text) - 1);
+    }
+    vsnprintf(text, len + 1, format, args);
+    int ret = log_binary_write(text, len);
+    free(text);
+    return ret;
+}
+
+// Writes a frame with arguments stored by log_record_args, args_size bytes including copied strings
+static int log_binary_write_frame(log_binary_buf_t* buf, uint32_t seq, const char* format, size_t args_size)
+{
+    size_t size = (sizeof(log_binary_frame_t) + args_size + 3) & ~3;
+    memset(buf->frame.args + args_size, 0, size - sizeof(log_binary_frame_t) - args_size);
+    buf->frame.marker = LOG_BINARY_MARKER;
+    buf->frame.version = LOG_BINARY_VERSION;
+    buf->frame.size = size;
+    buf->frame.seq = seq;
+    buf->frame.format = (uintptr_t) format;
+    return log_binary_write(&buf->frame, size);
+}
+
+int esp_log_binary_vprintf(const char* format, va_list args)
+{
+    log_binary_buf_t buf;
+
+    if (!esp_ptr_in_drom(format)) {
+        return log_binary_write_text(&buf, format, args);
+    }
+
+    size_t strings_size;
+    va_list args_copy;
+    va_copy(args_copy, args);
+    size_t args_size = log_record_args(NULL, 0, &strings_size, format, args_copy);
+    va_end(args_copy);
+
+    if (sizeof(log_binary_frame_t) + args_size + strings_size > sizeof(buf)) {
+        return log_binary_write_text(&buf, format, args);
+    }
+
+    log_record_args(buf.frame.args, args_size, &strings_size, format, args);
+    return log_binary_write_frame(&buf, log_next_seq(), format, args_size + strings_size);
+}
+
+esp_log_binary_output_t esp_log_binary_set_output(esp_log_binary_output_t func)
+{
+    if (!s_log_binary_mutex) {
+        s_log_binary_mutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(s_log_binary_mutex, portMAX_DELAY);
+
+    esp_log_binary_output_t orig_func = s_log_binary_output;
+    s_log_binary_output = func;
+
+    xSemaphoreGive(s_log_binary_mutex);
+    return orig_func;
+}
+
+#endif // CONFIG_LOG_BINARY
+
+#ifdef CONFIG_LOG_DEFERRED
+
+/*
+ * Deferred logging.
+ *
+ * Each CPU has a ring buffer of records. A record holds a sequence number,
+ * the format string pointer and the arguments of one message.
+ *
+ * A record is reserved with interrupts disabled on the current CPU, so tasks
+ * and interrupts on one CPU can't reserve the same space and the CPUs never
+ * write to the same buffer. Only the record header is written with interrupts
+ * disabled, then the head of the buffer is advanced past the record. The
+ * arguments and copied strings are written with interrupts enabled, after
+ * which the record is committed by setting its type. The log task outputs
+ * the records of both buffers in the order of their sequence numbers, then
+ * advances the tail of the buffer. It stops at the oldest record if that one
+ * isn't committed yet; the task committing it then wakes the log task up.
+ */
+
+// Size of the buffer messages are formatted into, longer messages are truncated
+#define LOG_LINE_SIZE           384
+// Size of the buffer for one conversion specification of a format string, with '*' replaced by values
+#define LOG_SPEC_SIZE           48
+
+#define LOG_BUFFER_SIZE         (CONFIG_LOG_DEFERRED_BUFFER_SIZE & ~7)
+#define LOG_RECORD_ALIGN        __alignof__(log_record_t)
+
+typedef enum {
+    LOG_RECORD_MESSAGE,
+    LOG_RECORD_PADDING,         // unused space at the end of the buffer, next record is at its start
+    LOG_RECORD_RESERVED,        // message whose arguments are still being written
+} log_record_type_t;
+
+typedef struct {
+    uint16_t size;              // size of the record, including this header
+    volatile uint16_t type;     // log_record_type_t
+    uint32_t seq;               // sequence number, across CPUs
+    const char* format;         // format string, in flash
+    uint8_t args[];             // arguments, then copied strings
+} log_record_t;
+
+typedef struct {
+    volatile uint32_t head;     // offset of the next record to write
+    volatile uint32_t tail;     // offset of the next record to output
+    uint32_t dropped;           // number of messages dropped because the buffer was full
+    uint32_t dropped_reported;  // number of dropped messages reported by the log task
+    uint8_t buf[LOG_BUFFER_SIZE] __attribute__((aligned(8)));
+} log_ring_t;
+
+typedef void (*log_output_t)(const char* line);
+
+static void log_output(const char* line);
+static void log_output_nolock(const char* line);
+
+static log_ring_t s_log_rings[portNUM_PROCESSORS];
+static TaskHandle_t s_log_task;
+static SemaphoreHandle_t s_log_output_mutex;
+static char s_log_line[LOG_LINE_SIZE];
+
+// Reserves size bytes for a record. Returns the offset of the record, or -1 if the buffer is full,
+// and the head of the buffer after the record in new_head.
+static int log_ring_reserve(log_ring_t* ring, size_t size, uint32_t* new_head)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
+
+    // The record before the tail can't end at the tail, so that a full buffer can be told apart
+    // from an empty one
+    if (head >= tail) {
+        uint32_t end = (tail == 0) ? LOG_BUFFER_SIZE - LOG_RECORD_ALIGN : LOG_BUFFER_SIZE;
+        if (head + size <= end) {
+            *new_head = (head + size) % LOG_BUFFER_SIZE;
+            return head;
+        }
+        // Continue at the start of the buffer
+        if (size + LOG_RECORD_ALIGN > tail) {
+            return -1;
+        }
+        log_record_t* padding = (log_record_t*) &ring->buf[head];
+        padding->size = LOG_BUFFER_SIZE - head;
+        padding->type = LOG_RECORD_PADDING;
+        *new_head = size;
+        return 0;
+    }
+
+    if (head + size + LOG_RECORD_ALIGN > tail) {
+        return -1;
+    }
+    *new_head = head + size;
+    return head;
+}
+
+// Stores a message to be output by the log task.
+// Returns false if the message has to be output immediately.
+static bool log_deferred_write(const char* format, va_list args)
+{
+    if (s_log_task == NULL || !esp_ptr_in_drom(format)) {
+        return false;
+    }
+
+    size_t strings_size;
+    va_list args_copy;
+    va_copy(args_copy, args);
+    size_t args_size = log_record_args(NULL, 0, &strings_size, format, args_copy);
+    va_end(args_copy);
+
+    size_t size = sizeof(log_record_t) + args_size + strings_size;
+    if (size > LOG_RECORD_MAX_SIZE) {
+        return false;
+    }
+    size = (size + LOG_RECORD_ALIGN - 1) & ~(LOG_RECORD_ALIGN - 1);
+
+    unsigned state = portENTER_CRITICAL_NESTED();
+
+    log_ring_t* ring = &s_log_rings[xPortGetCoreID()];
+    uint32_t head = ring->head;
+    uint32_t new_head;
+    int offset = log_ring_reserve(ring, size, &new_head);
+    if (offset < 0) {
+        ring->dropped++;
+        portEXIT_CRITICAL_NESTED(state);
+        return true;
+    }
+
+    log_record_t* record = (log_record_t*) &ring->buf[offset];
+    record->size = size;
+    record->type = LOG_RECORD_RESERVED;
+    record->seq = log_next_seq();
+    record->format = format;
+
+    // The log task doesn't output the record, nor let it be overwritten, until it is committed
+    __sync_synchronize();
+    ring->head = new_head;
+
+    portEXIT_CRITICAL_NESTED(state);
+
+    log_record_args(record->args, args_size, &strings_size, format, args);
+
+    // Commit the record, then wake up the log task if the record is the oldest one in the buffer: either the
+    // buffer was empty, or the log task has stopped at the record
+    __sync_synchronize();
+    record->type = LOG_RECORD_MESSAGE;
+    __sync_synchronize();
+    uint32_t tail = ring->tail;
+    if (tail == head || tail == (uint32_t) offset) {
+        if (xPortInIsrContext()) {
+            BaseType_t higher_priority_task_woken = pdFALSE;
+            vTaskNotifyGiveFromISR(s_log_task, &higher_priority_task_woken);
+            if (higher_priority_task_woken == pdTRUE) {
+                portYIELD_FROM_ISR();
+            }
+        } else {
+            xTaskNotifyGive(s_log_task);
+        }
+    }
+    return true;
+}
+
+#define LOG_FORMAT_ARG(type) do {                   \
+        type value;                                 \
+        memcpy(&value, arg, sizeof(type));          \
+        arg += LOG_ARG_SIZE(sizeof(type));          \
+        n = snprintf(line + len, size - len, spec, value); \
+    } while (0)
+
+// Size of an argument in a record
+static size_t log_arg_size(log_arg_type_t type)
+{
+    switch (type) {
+    case LOG_ARG_INT:
+        return LOG_ARG_SIZE(sizeof(int));
+    case LOG_ARG_LONG:
+        return LOG_ARG_SIZE(sizeof(long));
+    case LOG_ARG_LLONG:
+        return LOG_ARG_SIZE(sizeof(long long));
+    case LOG_ARG_SIZE_T:
+        return LOG_ARG_SIZE(sizeof(size_t));
+    case LOG_ARG_INTMAX:
+        return LOG_ARG_SIZE(sizeof(intmax_t));
+    case LOG_ARG_DOUBLE:
+        return LOG_ARG_SIZE(sizeof(double));
+    case LOG_ARG_LDOUBLE:
+        return LOG_ARG_SIZE(sizeof(long double));
+    case LOG_ARG_PTR:
+        return LOG_ARG_SIZE(sizeof(void*));
+    case LOG_ARG_STR:
+        return LOG_ARG_SIZE(sizeof(uintptr_t));
+    default:
+        return 0;
+    }
+}
+
+// Formats a record into line
+static void log_record_format(const log_record_t* record, char* line, size_t size)
+{
+    const char* format = record->format;
+    const uint8_t* arg = record->args;
+    char spec[LOG_SPEC_SIZE];
+    size_t len = 0;
+    log_conversion_t conv;
+
+    while (len < size - 1) {
+        const char* start = log_format_next(format, &conv);
+        size_t literal_len = (start != NULL) ? start - format : strlen(format);
+        if (literal_len > size - 1 - len) {
+            literal_len = size - 1 - len;
+        }
+        memcpy(line + len, format, literal_len);
+        len += literal_len;
+        if (start == NULL || len == size - 1) {
+            break;
+        }
+        format = conv.end;
+
+        // Copy the specification, with the values of '*' width and precision, which take up to 11 characters
+        size_t spec_len = 0;
+        if (conv.type == LOG_ARG_INVALID || conv.end - conv.start + conv.stars * 11 >= LOG_SPEC_SIZE) {
+            // Not a valid conversion or too long to format, output it as it is
+            arg += conv.stars * LOG_ARG_SIZE(sizeof(int)) + log_arg_size(conv.type);
+            conv.type = LOG_ARG_INVALID;
+        }
+        for (const char* p = conv.start; conv.type != LOG_ARG_INVALID && p < conv.end; p++) {
+            if (*p != '*') {
+                spec[spec_len++] = *p;
+                continue;
+            }
+            int value;
+            memcpy(&value, arg, sizeof(value));
+            arg += LOG_ARG_SIZE(sizeof(value));
+            if (value < 0 && p[-1] == '.') {
+                // A negative precision is taken as if it was omitted
+                spec_len--;
+            } else {
+                spec_len += sprintf(spec + spec_len, "%d", value);
+            }
+        }
+        spec[spec_len] = '\0';
+
+        int n = 0;
+        switch (conv.type) {
+        case LOG_ARG_NONE:
+            n = snprintf(line + len, size - len, "%%");
+            break;
+        case LOG_ARG_INT:
+            LOG_FORMAT_ARG(int);
+            break;
+        case LOG_ARG_LONG:
+            LOG_FORMAT_ARG(long);
+            break;
+        case LOG_ARG_LLONG:
+            LOG_FORMAT_ARG(long long);
+            break;
+        case LOG_ARG_SIZE_T:
+            LOG_FORMAT_ARG(size_t);
+            break;
+        case LOG_ARG_INTMAX:
+            LOG_FORMAT_ARG(intmax_t);
+            break;
+        case LOG_ARG_DOUBLE:
+            LOG_FORMAT_ARG(double);
+            break;
+        case LOG_ARG_LDOUBLE:
+            LOG_FORMAT_ARG(long double);
+            break;
+        case LOG_ARG_PTR:
+            if (conv.end[-1] == 'n') {
+                // Nothing is written through pointers
+                arg += log_arg_size(LOG_ARG_PTR);
+            } else {
+                LOG_FORMAT_ARG(void*);
+            }
+            break;
+        case LOG_ARG_STR: {
+            uintptr_t value;
+            memcpy(&value, arg, sizeof(value));
+            arg += LOG_ARG_SIZE(sizeof(value));
+            const char* str = (const char*) value;
+            if (value != 0 && value < record->size - offsetof(log_record_t, args)) {
+                str = (const char*) record->args + value;
+            }
+            n = snprintf(line + len, size - len, spec, str);
+            break;
+        }
+        default:
+            n = snprintf(line + len, size - len, "%.*s", (int) (conv.end - conv.start), conv.start);
+            break;
+        }
+        if (n > 0) {
+            len += ((size_t) n < size - len) ? (size_t) n : size - 1 - len;
+        }
+    }
+    line[len] = '\0';
+}
+
+static void log_output_record(const log_record_t* record, log_output_t output)
+{
+#ifdef CONFIG_LOG_BINARY
+    if (output == &log_output && s_log_print_func == &esp_log_binary_vprintf) {
+        // Records store the arguments the same way as frames, so they don't need to be formatted
+        log_binary_buf_t buf;
+        size_t args_size = record->size - offsetof(log_record_t, args);
+        memcpy(buf.frame.args, record->args, args_size);
+        log_binary_write_frame(&buf, record->seq, record->format, args_size);
+        return;
+    }
+#endif
+    log_record_format(record, s_log_line, sizeof(s_log_line));
+    output(s_log_line);
+}
+
+// Outputs the buffered messages, oldest first
+static void log_deferred_output(log_output_t output)
+{
+    while (true) {
+        log_ring_t* ring = NULL;
+        log_record_t* record = NULL;
+
+        for (int i = 0; i < portNUM_PROCESSORS; i++) {
+            log_ring_t* it = &s_log_rings[i];
+            uint32_t tail = it->tail;
+            if (tail == it->head) {
+                continue;
+            }
+            __sync_synchronize();
+            log_record_t* it_record = (log_record_t*) &it->buf[tail];
+            if (it_record->type == LOG_RECORD_PADDING) {
+                it->tail = 0;
+                i--;
+                continue;
+            }
+            if (record == NULL || (int32_t) (it_record->seq - record->seq) < 0) {
+                ring = it;
+                record = it_record;
+            }
+        }
+
+        if (record == NULL) {
+            break;
+        }
+
+        if (record->type == LOG_RECORD_MESSAGE) {
+            log_output_record(record, output);
+        } else if (output != &log_output_nolock) {
+            // Wait until the record is committed, so that messages are output in order
+            break;
+        }
+        // else the panic handler can't wait for the record, which is left out
+
+        __sync_synchronize();
+        ring->tail = (ring->tail + record->size) % LOG_BUFFER_SIZE;
+        __sync_synchronize();
+    }
+
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        log_ring_t* ring = &s_log_rings[i];
+        uint32_t dropped = ring->dropped;
+        if (dropped != ring->dropped_reported) {
+            snprintf(s_log_line, sizeof(s_log_line), LOG_FORMAT(W, "%u messages dropped, log buffer full"),
+                     esp_log_timestamp(), "log", dropped - ring->dropped_reported);
+            output(s_log_line);
+            ring->dropped_reported = dropped;
+        }
+    }
+}
+
+static int log_printf(const char* format, ...)
+{
+    va_list list;
+    va_start(list, format);
+    int ret = (*s_log_print_func)(format, list);
+    va_end(list);
+    return ret;
+}
+
+static void log_output(const char* line)
+{
+    log_printf("%s", line);
+}
+
+static void log_output_nolock(const char* line)
+{
+    ets_printf("%s", line);
+}
+
+static void log_deferred_task(void* arg)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(s_log_output_mutex, portMAX_DELAY);
+        log_deferred_output(&log_output);
+        xSemaphoreGive(s_log_output_mutex);
+    }
+}
+
+esp_err_t esp_log_deferred_init(void)
+{
+    if (s_log_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_log_output_mutex = xSemaphoreCreateMutex();
+    if (s_log_output_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(&log_deferred_task, "log", CONFIG_LOG_DEFERRED_TASK_STACK_SIZE, NULL,
+                    CONFIG_LOG_DEFERRED_TASK_PRIORITY, &s_log_task) != pdPASS) {
+        vSemaphoreDelete(s_log_output_mutex);
+        s_log_output_mutex = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+#endif // CONFIG_LOG_DEFERRED
+
+void esp_log_flush(void)
+{
+#ifdef CONFIG_LOG_DEFERRED
+    if (s_log_task == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_log_output_mutex, portMAX_DELAY);
+    log_deferred_output(&log_output);
+    xSemaphoreGive(s_log_output_mutex);
+#endif
+}
+
+void esp_log_flush_nolock(void)
+{
+#ifdef CONFIG_LOG_DEFERRED
+    log_deferred_output(&log_output_nolock);
+#endif
 }
 #endif //BOOTLOADER_BUILD
 
@@ -0,0 +1,252 @@
+#!/usr/bin/env python
+#
+# ESP32 binary log decoder
+#
+# Converts log messages output by esp_log_binary_vprintf() back to text, reading
+# format strings and string arguments from the ELF file of the app.
+#
+# Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from __future__ import print_function, division
+from __future__ import unicode_literals
+import argparse
+import os
+import re
+import struct
+import sys
+
+# Frame header, see log_binary_frame_t in log.c
+FRAME_MARKER = 0xff
+FRAME_VERSION = 1
+FRAME_HEADER_FMT = '<BBHLL'
+FRAME_HEADER_SIZE = struct.calcsize(FRAME_HEADER_FMT)
+FRAME_MAX_SIZE = 256
+
+# Conversion specification, as parsed by log_format_next() in log.c
+CONVERSION_RE = re.compile(r'%([-+ #0]*)(\*|[0-9]*)(?:\.(\*|[0-9]*))?(hh|h|ll|l|q|j|z|t|L)?(.?)', re.DOTALL)
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+class LogDecodeError(RuntimeError):
+    pass
+
+
+class ElfStrings(object):
+    """Reads zero-terminated strings at given addresses from the loadable sections of an ELF file"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or bytearray(data)[4] != 1:
+            raise LogDecodeError('%s is not a 32-bit ELF file' % path)
+        (e_shoff, ) = struct.unpack_from('<L', data, 0x20)
+        (e_shentsize, e_shnum) = struct.unpack_from('<HH', data, 0x2e)
+        self.sections = []
+        for i in range(e_shnum):
+            (sh_type, sh_flags, sh_addr, sh_offset, sh_size) = struct.unpack_from('<LLLLL', data, e_shoff + i * e_shentsize + 4)
+            if sh_flags & SHF_ALLOC and sh_type != SHT_NOBITS and sh_addr != 0:
+                self.sections.append((sh_addr, data[sh_offset:sh_offset + sh_size]))
+
+    def get(self, addr):
+        for (sh_addr, sh_data) in self.sections:
+            if sh_addr <= addr < sh_addr + len(sh_data):
+                start = addr - sh_addr
+                end = sh_data.find(b'\0', start)
+                return sh_data[start:end if end >= 0 else len(sh_data)].decode('utf-8', 'replace')
+        return None
+
+
+class FrameDecoder(object):
+    """Formats the messages of binary log frames"""
+
+    def __init__(self, elf):
+        self.elf = elf
+
+    def decode(self, frame):
+        (_, _, size, _, fmt_addr) = struct.unpack_from(FRAME_HEADER_FMT, frame)
+        args = frame[FRAME_HEADER_SIZE:size]
+        fmt = self.elf.get(fmt_addr)
+        if fmt is None:
+            return '<unknown format string at 0x%08x>\n' % fmt_addr
+        self.args = args
+        self.offset = 0
+        try:
+            return CONVERSION_RE.sub(self._convert, fmt)
+        except struct.error:
+            return '<not enough arguments for format string "%s">\n' % fmt.rstrip('\n')
+
+    def _take(self, fmt):
+        (value, ) = struct.unpack_from(fmt, self.args, self.offset)
+        self.offset += (struct.calcsize(fmt) + 3) & ~3
+        return value
+
+    def _string(self, value):
+        if value == 0:
+            return '(null)'
+        if value < len(self.args):
+            # copied into the frame, as an offset from the first argument
+            end = self.args.find(b'\0', value)
+            return self.args[value:end if end >= 0 else len(self.args)].decode('utf-8', 'replace')
+        string = self.elf.get(value)
+        if string is None:
+            return '<0x%08x>' % value
+        return string
+
+    def _convert(self, match):
+        (flags, width, precision, length, conversion) = match.groups()
+        if conversion == '':
+            # '%' at the end of the format string
+            return match.group(0)
+        if width == '*':
+            width = self._take('<l')
+            if width < 0:
+                flags += '-'
+                width = -width
+            width = str(width)
+        if precision == '*':
+            precision = self._take('<l')
+            precision = str(precision) if precision >= 0 else None
+        elif precision == '':
+            precision = '0'
+
+        spec = '%' + flags + width + ('.' + precision if precision is not None else '')
+        if conversion in 'di':
+            if length in ('ll', 'q', 'j'):
+                value = self._take('<q')
+            else:
+                value = self._take('<l')
+                if length == 'hh':
+                    value = struct.unpack('<b', struct.pack('<B', value & 0xff))[0]
+                elif length == 'h':
+                    value = struct.unpack('<h', struct.pack('<H', value & 0xffff))[0]
+            return (spec + 'd') % value
+        if conversion in 'ouxX':
+            if length in ('ll', 'q', 'j'):
+                value = self._take('<Q')
+            else:
+                value = self._take('<L')
+                if length == 'hh':
+                    value &= 0xff
+                elif length == 'h':
+                    value &= 0xffff
+            if conversion == 'u':
+                return (spec + 'd') % value
+            if conversion == 'o' and '#' in flags:
+                # C prefixes octal numbers with '0' only
+                return (spec.replace('#', '') + 's') % ('0%o' % value if value else '0')
+            return (spec + conversion) % value
+        if conversion == 'c':
+            return (spec + 'c') % chr(self._take('<l') & 0xff)
+        if conversion in 'fFeEgG':
+            return (spec + conversion) % self._take('<d')
+        if conversion in 'aA':
+            text = float.hex(self._take('<d'))
+            return ('%' + flags.replace('#', '').replace('0', '') + width + 's') % (text if conversion == 'a' else text.upper())
+        if conversion == 's':
+            value = self._take('<L')
+            if length == 'l':
+                return ('%' + flags + width + 's') % ('<0x%08x>' % value)
+            return (spec + 's') % self._string(value)
+        if conversion == 'p':
+            return ('%' + flags + width + 's') % ('0x%x' % self._take('<L'))
+        if conversion == 'n':
+            self._take('<L')
+            return ''
+        if conversion == '%':
+            return '%'
+        # not a conversion, output as it is
+        return match.group(0)
+
+
+def decode_stream(read, write, decoder):
+    """Decodes data returned by read() until it returns no data, passing text outside of frames through"""
+    data = bytearray()
+    eof = False
+    while not eof:
+        chunk = read()
+        if chunk:
+            data += chunk
+        else:
+            eof = True
+        pos = 0
+        while pos < len(data):
+            start = data.find(bytearray([FRAME_MARKER]), pos)
+            if start < 0:
+                start = len(data)
+            if start > pos:
+                write(bytes(data[pos:start]))
+                pos = start
+                continue
+            if len(data) - pos < FRAME_HEADER_SIZE:
+                if eof:
+                    write(bytes(data[pos:]))
+                    pos = len(data)
+                break
+            (_, version, size, _, _) = struct.unpack_from(FRAME_HEADER_FMT, bytes(data[pos:pos + FRAME_HEADER_SIZE]))
+            if version != FRAME_VERSION or size < FRAME_HEADER_SIZE or size > FRAME_MAX_SIZE or size % 4 != 0:
+                # not the start of a frame, e.g. corrupted output
+                write(bytes(data[pos:pos + 1]))
+                pos += 1
+                continue
+            if len(data) - pos < size:
+                if eof:
+                    write(bytes(data[pos:]))
+                    pos = len(data)
+                break
+            write(decoder.decode(bytes(data[pos:pos + size])).encode('utf-8'))
+            pos += size
+        del data[:pos]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='ESP32 binary log decoder')
+    parser.add_argument('elf_file', help='ELF file of the app which output the log')
+    parser.add_argument('input', help='File with the binary log output, "-" for standard input (default)', nargs='?', default='-')
+    parser.add_argument('--port', '-p', help='Read the log output from this serial port instead')
+    parser.add_argument('--baud', '-b', help='Baud rate of the serial port', type=int, default=115200)
+    args = parser.parse_args()
+
+    try:
+        decoder = FrameDecoder(ElfStrings(args.elf_file))
+    except (IOError, OSError, struct.error) as e:
+        raise LogDecodeError('Failed to read %s (%s)' % (args.elf_file, e))
+
+    output = getattr(sys.stdout, 'buffer', sys.stdout)
+
+    def write(data):
+        output.write(data)
+        output.flush()
+
+    if args.port is not None:
+        import serial
+        port = serial.serial_for_url(args.port, args.baud)
+        decode_stream(lambda: port.read(max(1, port.in_waiting)), write, decoder)
+    elif args.input == '-':
+        fd = sys.stdin.fileno()
+        decode_stream(lambda: os.read(fd, 4096), write, decoder)
+    else:
+        with open(args.input, 'rb') as f:
+            decode_stream(lambda: f.read(4096), write, decoder)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except LogDecodeError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
+    except KeyboardInterrupt:
+        pass
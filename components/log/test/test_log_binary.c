@@ -0,0 +1,185 @@
+/*
+ Tests of binary log frames (CONFIG_LOG_BINARY)
+
+ The frames checked here are decoded back to text by test_log_binary_host/log_binary_decode_tests.py
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "esp_log.h"
+#include "soc/soc_memory_layout.h"
+#include "unity.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_LOG_BINARY
+
+// Header of a frame, see log_binary_frame_t in log.c
+typedef struct {
+    uint8_t marker;
+    uint8_t version;
+    uint16_t size;
+    uint32_t seq;
+    uint32_t format;
+} test_binary_frame_t;
+
+static uint8_t s_output[512];
+static size_t s_output_size;
+static int s_output_calls;
+
+static int test_binary_output(const void* data, size_t size)
+{
+    size_t len = size < sizeof(s_output) - s_output_size ? size : sizeof(s_output) - s_output_size;
+    memcpy(s_output + s_output_size, data, len);
+    s_output_size += len;
+    s_output_calls++;
+    return size;
+}
+
+static int test_binary_printf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = esp_log_binary_vprintf(format, args);
+    va_end(args);
+    return ret;
+}
+
+static esp_log_binary_output_t test_binary_start(void)
+{
+    s_output_size = 0;
+    s_output_calls = 0;
+    return esp_log_binary_set_output(&test_binary_output);
+}
+
+// Checks the header of the single frame output since test_binary_start, returns its arguments
+static const uint8_t* test_binary_check_frame(const char* format, size_t size)
+{
+    test_binary_frame_t frame;
+    TEST_ASSERT_EQUAL(1, s_output_calls);
+    TEST_ASSERT_EQUAL(size, s_output_size);
+    memcpy(&frame, s_output, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(0xff, frame.marker);
+    TEST_ASSERT_EQUAL(1, frame.version);
+    TEST_ASSERT_EQUAL(size, frame.size);
+    TEST_ASSERT_EQUAL_HEX32((uintptr_t) format, frame.format);
+    return s_output + sizeof(frame);
+}
+
+static uint32_t test_binary_frame_seq(void)
+{
+    test_binary_frame_t frame;
+    memcpy(&frame, s_output, sizeof(frame));
+    return frame.seq;
+}
+
+TEST_CASE("binary log frames hold integer arguments", "[log]")
+{
+    static const char format[] = "ints %d %u %x %hhd %ld\n";
+    const int32_t expected[] = { -5, 7, 0xabcd, -3, 123456 };
+    TEST_ASSERT_TRUE(esp_ptr_in_drom(format));
+
+    esp_log_binary_output_t orig_output = test_binary_start();
+    int ret = test_binary_printf(format, -5, 7u, 0xabcd, (signed char) -3, 123456L);
+    esp_log_binary_set_output(orig_output);
+
+    const uint8_t* args = test_binary_check_frame(format, 12 + sizeof(expected));
+    TEST_ASSERT_EQUAL(12 + sizeof(expected), ret);
+    TEST_ASSERT_EQUAL_MEMORY(expected, args, sizeof(expected));
+}
+
+TEST_CASE("binary log frames hold 64-bit arguments", "[log]")
+{
+    static const char format[] = "longs %lld %llu %llx %d\n";
+
+    esp_log_binary_output_t orig_output = test_binary_start();
+    test_binary_printf(format, -1234567890123LL, 18446744073709551615ULL, 0x123456789abcdefULL, 9);
+    esp_log_binary_set_output(orig_output);
+
+    const uint8_t* args = test_binary_check_frame(format, 12 + 8 + 8 + 8 + 4);
+    int64_t value;
+    memcpy(&value, args, sizeof(value));
+    TEST_ASSERT_TRUE(value == -1234567890123LL);
+    memcpy(&value, args + 8, sizeof(value));
+    TEST_ASSERT_TRUE(value == -1LL);
+    memcpy(&value, args + 16, sizeof(value));
+    TEST_ASSERT_TRUE(value == 0x123456789abcdefLL);
+    int32_t last;
+    memcpy(&last, args + 24, sizeof(last));
+    TEST_ASSERT_EQUAL(9, last);
+}
+
+TEST_CASE("binary log frames copy strings which are not in flash", "[log]")
+{
+    static const char format[] = "strings %s %s %s %d\n";
+    static const char flash_str[] = "in flash";
+    char ram_str[16];
+    strcpy(ram_str, "in ram");
+    TEST_ASSERT_TRUE(esp_ptr_in_drom(flash_str));
+
+    esp_log_binary_output_t orig_output = test_binary_start();
+    test_binary_printf(format, flash_str, ram_str, NULL, 1);
+    // The frame holds the string as it was when the message was logged
+    strcpy(ram_str, "changed");
+    esp_log_binary_set_output(orig_output);
+
+    // Arguments take 16 bytes, followed by "in ram" and padding
+    const uint8_t* args = test_binary_check_frame(format, 12 + 16 + 8);
+    uint32_t words[4];
+    memcpy(words, args, sizeof(words));
+    TEST_ASSERT_EQUAL_HEX32((uintptr_t) flash_str, words[0]);
+    TEST_ASSERT_EQUAL(16, words[1]);
+    TEST_ASSERT_EQUAL(0, words[2]);
+    TEST_ASSERT_EQUAL(1, words[3]);
+    TEST_ASSERT_EQUAL_MEMORY("in ram\0\0", args + 16, 8);
+}
+
+TEST_CASE("binary log frames have increasing sequence numbers", "[log]")
+{
+    static const char format[] = "seq %d\n";
+
+    esp_log_binary_output_t orig_output = test_binary_start();
+    test_binary_printf(format, 0);
+    uint32_t seq = test_binary_frame_seq();
+    for (int i = 1; i < 10; i++) {
+        s_output_size = 0;
+        s_output_calls = 0;
+        test_binary_printf(format, i);
+        test_binary_check_frame(format, 12 + 4);
+        // Other tasks may log in between, the sequence is common to all messages
+        TEST_ASSERT_TRUE((int32_t) (test_binary_frame_seq() - seq) > 0);
+        seq = test_binary_frame_seq();
+    }
+    esp_log_binary_set_output(orig_output);
+}
+
+TEST_CASE("binary log falls back to text for messages which can't be framed", "[log]")
+{
+    char format[16];
+    strcpy(format, "ram format %d\n");
+    char long_str[300];
+    memset(long_str, 'x', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = '\0';
+
+    // Format string not in flash
+    esp_log_binary_output_t orig_output = test_binary_start();
+    int ret = test_binary_printf(format, 5);
+    TEST_ASSERT_EQUAL(1, s_output_calls);
+    TEST_ASSERT_EQUAL(strlen("ram format 5\n"), ret);
+    TEST_ASSERT_EQUAL(strlen("ram format 5\n"), s_output_size);
+    TEST_ASSERT_EQUAL_MEMORY("ram format 5\n", s_output, s_output_size);
+
+    // Arguments larger than a frame, output in full
+    s_output_size = 0;
+    s_output_calls = 0;
+    ret = test_binary_printf("long %s|\n", long_str);
+    esp_log_binary_set_output(orig_output);
+    TEST_ASSERT_EQUAL(1, s_output_calls);
+    TEST_ASSERT_EQUAL(strlen("long ") + strlen(long_str) + 2, ret);
+    TEST_ASSERT_EQUAL(ret, s_output_size);
+    TEST_ASSERT_EQUAL_MEMORY("long xxx", s_output, 8);
+    TEST_ASSERT_EQUAL_MEMORY("x|\n", s_output + s_output_size - 3, 3);
+}
+
+#endif // CONFIG_LOG_BINARY
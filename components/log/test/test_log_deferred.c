@@ -0,0 +1,345 @@
+/*
+ Tests of deferred logging (CONFIG_LOG_DEFERRED)
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_intr_alloc.h"
+#include "driver/timer.h"
+#include "soc/cpu.h"
+#include "unity.h"
+#include "test_utils.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_LOG_DEFERRED
+
+static const char* TAG = "test_log";
+
+#define TEST_PAYLOAD_SIZE       40
+
+// Checks messages "<name> <index> |<payload>|" as they are output: each message has to follow the one before it
+typedef struct {
+    const char* name;           // name the checked messages start with
+    bool check_payload;         // messages have a payload which depends on their index
+    volatile int received;      // number of messages received
+    volatile int errors;        // number of messages out of order or with a wrong payload
+    volatile uint32_t dropped;  // number of messages reported as dropped
+} test_log_check_t;
+
+static test_log_check_t s_check;
+static vprintf_like_t s_orig_vprintf;
+static SemaphoreHandle_t s_gate;
+static SemaphoreHandle_t s_held;
+static volatile bool s_hold;
+
+static void test_log_payload(int index, char* payload)
+{
+    int len = index % (TEST_PAYLOAD_SIZE - 1);
+    memset(payload, 'a' + index % 26, len);
+    payload[len] = '\0';
+}
+
+static void test_log_check_line(const char* line)
+{
+    const char* p = strstr(line, "messages dropped");
+    if (p != NULL) {
+        p = strstr(line, "log: ");
+        s_check.dropped += (p != NULL) ? strtoul(p + strlen("log: "), NULL, 10) : 0;
+        return;
+    }
+
+    size_t name_len = strlen(s_check.name);
+    for (p = strstr(line, s_check.name); p != NULL && p[name_len] != ' '; p = strstr(p + 1, s_check.name)) {
+    }
+    if (p == NULL) {
+        return;
+    }
+
+    char* end;
+    int index = strtol(p + name_len + 1, &end, 10);
+    if (index != s_check.received) {
+        ESP_EARLY_LOGE(TAG, "got message %d, expected %d", index, s_check.received);
+        s_check.errors++;
+    }
+    if (s_check.check_payload) {
+        char payload[TEST_PAYLOAD_SIZE];
+        test_log_payload(index, payload);
+        size_t len = strlen(payload);
+        if (strncmp(end, " |", 2) != 0 || strncmp(end + 2, payload, len) != 0 || end[2 + len] != '|') {
+            ESP_EARLY_LOGE(TAG, "wrong payload of message %d", index);
+            s_check.errors++;
+        }
+    }
+    s_check.received = index + 1;
+}
+
+// Output function which checks the messages, and holds back the output when asked to
+static int test_log_vprintf(const char* format, va_list args)
+{
+    char line[128];
+    int len = vsnprintf(line, sizeof(line), format, args);
+
+    if (s_hold) {
+        s_hold = false;
+        xSemaphoreGive(s_held);
+        xSemaphoreTake(s_gate, portMAX_DELAY);
+    }
+
+    test_log_check_line(line);
+    return len;
+}
+
+static void test_log_start(const char* name, bool check_payload)
+{
+    esp_log_flush();
+    memset(&s_check, 0, sizeof(s_check));
+    s_check.name = name;
+    s_check.check_payload = check_payload;
+    s_gate = xSemaphoreCreateBinary();
+    s_held = xSemaphoreCreateBinary();
+    s_orig_vprintf = esp_log_set_vprintf(&test_log_vprintf);
+}
+
+static void test_log_end(void)
+{
+    esp_log_flush();
+    esp_log_set_vprintf(s_orig_vprintf);
+    vSemaphoreDelete(s_gate);
+    vSemaphoreDelete(s_held);
+}
+
+// Makes the log task wait in the output function, so that messages stay in the buffer
+static void test_log_hold(void)
+{
+    s_hold = true;
+    ESP_LOGI(TAG, "holding back the output");
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_held, pdMS_TO_TICKS(1000)));
+}
+
+static void test_log_release(void)
+{
+    xSemaphoreGive(s_gate);
+}
+
+static void test_log_message(const char* name, int index)
+{
+    char payload[TEST_PAYLOAD_SIZE];
+    test_log_payload(index, payload);
+    ESP_LOGI(TAG, "%s %d |%s|", name, index, payload);
+}
+
+TEST_CASE("deferred log messages wrap around the buffer", "[log]")
+{
+    // Records take between 32 and 72 bytes, so each batch fits in the buffer
+    const int batch = CONFIG_LOG_DEFERRED_BUFFER_SIZE / 80;
+    const int messages = 8 * CONFIG_LOG_DEFERRED_BUFFER_SIZE / 32;
+
+    test_log_start("wrap", true);
+
+    for (int i = 0; i < messages; i++) {
+        test_log_message("wrap", i);
+        if (i % batch == batch - 1) {
+            esp_log_flush();
+        }
+    }
+    esp_log_flush();
+
+    TEST_ASSERT_EQUAL(messages, s_check.received);
+    TEST_ASSERT_EQUAL(0, s_check.errors);
+    TEST_ASSERT_EQUAL(0, s_check.dropped);
+
+    test_log_end();
+}
+
+TEST_CASE("deferred log messages are dropped with a count when the buffer is full", "[log]")
+{
+    // Records take at least 32 bytes, so the buffer can't hold all of them
+    const int messages = CONFIG_LOG_DEFERRED_BUFFER_SIZE / 16;
+
+    test_log_start("drop", false);
+    test_log_hold();
+
+    // All records have the same size, so once a message is dropped, all later ones are
+    for (int i = 0; i < messages; i++) {
+        ESP_LOGI(TAG, "drop %d", i);
+    }
+
+    test_log_release();
+    esp_log_flush();
+
+    printf("%d messages output, %d dropped\n", s_check.received, s_check.dropped);
+    TEST_ASSERT_EQUAL(0, s_check.errors);
+    TEST_ASSERT_NOT_EQUAL(0, s_check.received);
+    TEST_ASSERT_NOT_EQUAL(0, s_check.dropped);
+    TEST_ASSERT_EQUAL(messages, s_check.received + s_check.dropped);
+
+    test_log_end();
+}
+
+#define TEST_ISR_TIMER_GROUP    0
+#define TEST_ISR_TIMER_NUMBER   0
+#define TEST_ISR_MESSAGES       50
+
+static volatile int s_isr_messages;
+
+static void test_log_isr(void* arg)
+{
+    TIMERG0.int_clr_timers.t0 = 1;
+    TIMERG0.hw_timer[TEST_ISR_TIMER_NUMBER].config.alarm_en = 1;
+
+    if (s_isr_messages < TEST_ISR_MESSAGES) {
+        test_log_message("isr", s_isr_messages++);
+    }
+}
+
+TEST_CASE("deferred log messages can be logged from an interrupt handler", "[log]")
+{
+    timer_config_t config = {
+        .alarm_en = 1,
+        .auto_reload = 1,
+        .counter_dir = TIMER_COUNT_UP,
+        .divider = 80,                  // 1 us per tick
+        .intr_type = TIMER_INTR_LEVEL,
+        .counter_en = TIMER_PAUSE
+    };
+    intr_handle_t isr_handle;
+    TEST_ESP_OK(timer_init(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, &config));
+    TEST_ESP_OK(timer_set_counter_value(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, 0));
+    TEST_ESP_OK(timer_set_alarm_value(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, 1000));
+    TEST_ESP_OK(timer_enable_intr(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+    TEST_ESP_OK(timer_isr_register(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER, test_log_isr, NULL, 0, &isr_handle));
+
+    test_log_start("isr", true);
+    s_isr_messages = 0;
+
+    TEST_ESP_OK(timer_start(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+
+    // The messages are output without flushing, the log task is woken up from the interrupt handler
+    for (int i = 0; i < 100 && s_check.received < TEST_ISR_MESSAGES; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    TEST_ESP_OK(timer_pause(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+    TEST_ESP_OK(timer_disable_intr(TEST_ISR_TIMER_GROUP, TEST_ISR_TIMER_NUMBER));
+    TEST_ESP_OK(esp_intr_free(isr_handle));
+
+    TEST_ASSERT_EQUAL(TEST_ISR_MESSAGES, s_isr_messages);
+    TEST_ASSERT_EQUAL(TEST_ISR_MESSAGES, s_check.received);
+    TEST_ASSERT_EQUAL(0, s_check.errors);
+    TEST_ASSERT_EQUAL(0, s_check.dropped);
+
+    test_log_end();
+}
+
+#define TEST_ORDER_MESSAGES     40
+
+typedef struct {
+    SemaphoreHandle_t turn[2];
+    SemaphoreHandle_t done;
+    int next;
+} test_order_t;
+
+typedef struct {
+    test_order_t* order;
+    int self;
+} test_order_task_arg_t;
+
+static void test_log_order_task(void* arg)
+{
+    test_order_t* order = ((test_order_task_arg_t*) arg)->order;
+    int self = ((test_order_task_arg_t*) arg)->self;
+
+    while (true) {
+        xSemaphoreTake(order->turn[self], portMAX_DELAY);
+        if (order->next == TEST_ORDER_MESSAGES) {
+            break;
+        }
+        test_log_message("order", order->next++);
+        xSemaphoreGive(order->turn[!self]);
+    }
+
+    xSemaphoreGive(order->turn[!self]);
+    xSemaphoreGive(order->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("deferred log messages from both CPUs are output in order", "[log]")
+{
+    test_order_t order = {
+        .turn = { xSemaphoreCreateBinary(), xSemaphoreCreateBinary() },
+        .done = xSemaphoreCreateCounting(2, 0),
+        .next = 0
+    };
+
+    test_order_task_arg_t args[2] = { { &order, 0 }, { &order, 1 } };
+
+    test_log_start("order", true);
+    test_log_hold();
+
+    // Messages are logged by both CPUs in turns, into the buffers of both CPUs
+    for (int i = 0; i < 2; i++) {
+        xTaskCreatePinnedToCore(&test_log_order_task, "log_order", 2048, &args[i], UNITY_FREERTOS_PRIORITY + 1, NULL,
+                                i % portNUM_PROCESSORS);
+    }
+    xSemaphoreGive(order.turn[0]);
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_TRUE(xSemaphoreTake(order.done, pdMS_TO_TICKS(1000)));
+    }
+
+    TEST_ASSERT_EQUAL(0, s_check.received);
+
+    test_log_release();
+    esp_log_flush();
+
+    TEST_ASSERT_EQUAL(TEST_ORDER_MESSAGES, s_check.received);
+    TEST_ASSERT_EQUAL(0, s_check.errors);
+    TEST_ASSERT_EQUAL(0, s_check.dropped);
+
+    vSemaphoreDelete(order.turn[0]);
+    vSemaphoreDelete(order.turn[1]);
+    vSemaphoreDelete(order.done);
+
+    test_log_end();
+}
+
+#define TEST_CYCLES_MESSAGES    33
+
+TEST_CASE("deferred log message takes few cycles to log", "[log]")
+{
+    uint32_t cycles[TEST_CYCLES_MESSAGES];
+
+    test_log_start("cycles", false);
+    // The log task doesn't run while the messages are logged
+    test_log_hold();
+
+    for (int i = 0; i < TEST_CYCLES_MESSAGES; i++) {
+        uint32_t start, end;
+        RSR(CCOUNT, start);
+        ESP_LOGI(TAG, "cycles %d", i);
+        RSR(CCOUNT, end);
+
+        // Insert sorted
+        int j = i;
+        for (; j > 0 && cycles[j - 1] > end - start; j--) {
+            cycles[j] = cycles[j - 1];
+        }
+        cycles[j] = end - start;
+    }
+
+    test_log_release();
+    esp_log_flush();
+
+    TEST_ASSERT_EQUAL(TEST_CYCLES_MESSAGES, s_check.received);
+    TEST_ASSERT_EQUAL(0, s_check.errors);
+
+    test_log_end();
+
+    TEST_PERFORMANCE_LESS_THAN(LOG_DEFERRED_CYCLES_PER_MESSAGE, "%d cycles", cycles[TEST_CYCLES_MESSAGES / 2]);
+}
+
+#endif // CONFIG_LOG_DEFERRED
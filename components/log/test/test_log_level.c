@@ -0,0 +1,172 @@
+/*
+ Tests of log level changes, which have to invalidate the levels cached on each CPU and in tag variables
+*/
+
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "unity.h"
+#include "test_utils.h"
+#include "sdkconfig.h"
+
+static const char* TAG = "test_level";
+
+ESP_LOG_TAG_DEFINE(s_tag, "test_level_var");
+
+static vprintf_like_t s_orig_vprintf;
+static volatile int s_received;
+
+// Output function which counts the messages logged with the tags of these tests
+static int test_level_vprintf(const char* format, va_list args)
+{
+    char line[128];
+    int len = vsnprintf(line, sizeof(line), format, args);
+    if (strstr(line, " test_level") != NULL) {
+        s_received++;
+    }
+    return len;
+}
+
+static void test_level_start(void)
+{
+    esp_log_flush();
+    s_received = 0;
+    s_orig_vprintf = esp_log_set_vprintf(&test_level_vprintf);
+}
+
+static void test_level_end(void)
+{
+    esp_log_flush();
+    esp_log_set_vprintf(s_orig_vprintf);
+    esp_log_level_set("*", CONFIG_LOG_DEFAULT_LEVEL);
+}
+
+// Number of messages received since the previous call
+static int test_level_received(void)
+{
+    esp_log_flush();
+    int received = s_received;
+    s_received = 0;
+    return received;
+}
+
+typedef struct {
+    void (*func)(void);
+    SemaphoreHandle_t done;
+} test_level_task_arg_t;
+
+static void test_level_task(void* arg)
+{
+    test_level_task_arg_t* task_arg = (test_level_task_arg_t*) arg;
+    task_arg->func();
+    xSemaphoreGive(task_arg->done);
+    vTaskDelete(NULL);
+}
+
+// Calls func from a task on each CPU in turn
+static void test_level_run_on_each_cpu(void (*func)(void))
+{
+    test_level_task_arg_t arg = {
+        .func = func,
+        .done = xSemaphoreCreateBinary()
+    };
+    for (int cpu = 0; cpu < portNUM_PROCESSORS; cpu++) {
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(&test_level_task, "test_level", 2048, &arg,
+                                                          UNITY_FREERTOS_PRIORITY + 1, NULL, cpu));
+        TEST_ASSERT_TRUE(xSemaphoreTake(arg.done, pdMS_TO_TICKS(1000)));
+    }
+    vSemaphoreDelete(arg.done);
+}
+
+static void test_level_log_info(void)
+{
+    ESP_LOGI(TAG, "info from CPU %d", xPortGetCoreID());
+}
+
+static void test_level_log_info_tag(void)
+{
+    ESP_LOGI_TAG(s_tag, "info from CPU %d", xPortGetCoreID());
+}
+
+static void test_level_log_warn_tag(void)
+{
+    ESP_LOGW_TAG(s_tag, "warning from CPU %d", xPortGetCoreID());
+}
+
+TEST_CASE("log level changes apply to levels cached on each CPU", "[log]")
+{
+    test_level_start();
+
+    // Logging caches the level of the tag on each CPU
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    esp_log_level_set(TAG, ESP_LOG_WARN);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(0, test_level_received());
+
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    // Setting the default level resets the level of every tag
+    esp_log_level_set("*", ESP_LOG_WARN);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(0, test_level_received());
+
+    esp_log_level_set("*", ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    esp_log_level_set(TAG, ESP_LOG_WARN);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(0, test_level_received());
+
+    esp_log_level_set("*", ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    test_level_end();
+}
+
+TEST_CASE("log level changes apply to tag variables after the first message", "[log]")
+{
+    test_level_start();
+
+    esp_log_level_set(s_tag.name, ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info_tag);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    esp_log_level_set(s_tag.name, ESP_LOG_WARN);
+    test_level_run_on_each_cpu(&test_level_log_info_tag);
+    TEST_ASSERT_EQUAL(0, test_level_received());
+    test_level_run_on_each_cpu(&test_level_log_warn_tag);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    // The level of another tag does not change the level of this one
+    esp_log_level_set(TAG, ESP_LOG_NONE);
+    test_level_run_on_each_cpu(&test_level_log_warn_tag);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    esp_log_level_set(s_tag.name, ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info_tag);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    test_level_run_on_each_cpu(&test_level_log_warn_tag);
+    TEST_ASSERT_EQUAL(0, test_level_received());
+
+    esp_log_level_set("*", ESP_LOG_INFO);
+    test_level_run_on_each_cpu(&test_level_log_info_tag);
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, test_level_received());
+
+    test_level_end();
+}
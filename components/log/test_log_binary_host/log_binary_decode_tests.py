@@ -0,0 +1,133 @@
+#!/usr/bin/env python
+#
+# Tests of log_binary_decode.py, with the frames checked on the chip by
+# components/log/test/test_log_binary.c
+#
+from __future__ import print_function, division
+from __future__ import unicode_literals
+import unittest
+import struct
+import sys
+import os
+import tempfile
+
+try:
+    import log_binary_decode
+except ImportError:
+    sys.path.append("..")
+    import log_binary_decode
+
+DROM_ADDR = 0x3f400020
+
+# Format strings and string arguments in flash, in the order they are placed in DROM
+FLASH_STRINGS = [
+    "ints %d %u %x %hhd %ld\n",
+    "longs %lld %llu %llx %d\n",
+    "strings %s %s %s %d\n",
+    "in flash",
+    "seq %d\n",
+]
+
+
+def make_elf(strings):
+    """ Returns a 32-bit ELF file with the strings in a loadable section at DROM_ADDR, and their addresses """
+    data = b""
+    addrs = {}
+    for s in strings:
+        addrs[s] = DROM_ADDR + len(data)
+        data += s.encode("utf-8") + b"\0"
+    data += b"\0" * (-len(data) % 4)
+
+    ehdr_size = 52
+    shdr_size = 40
+    shoff = ehdr_size + len(data)
+    ehdr = b"\x7fELF" + bytes(bytearray([1, 1, 1])) + b"\0" * 9
+    ehdr += struct.pack("<HHLLLLLHHHHHH", 2, 94, 1, DROM_ADDR, 0, shoff, 0, ehdr_size, 0, 0, shdr_size, 2, 0)
+    null_shdr = b"\0" * shdr_size
+    # PROGBITS, ALLOC
+    drom_shdr = struct.pack("<LLLLLLLLLL", 0, 1, 0x2, DROM_ADDR, ehdr_size, len(data), 0, 0, 4, 0)
+    return ehdr + data + null_shdr + drom_shdr, addrs
+
+
+def make_frame(seq, fmt_addr, args, strings=b""):
+    """ Returns a frame as output by esp_log_binary_vprintf(), see log_binary_frame_t in log.c """
+    payload = args + strings
+    payload += b"\0" * (-len(payload) % 4)
+    return struct.pack("<BBHLL", 0xff, 1, 12 + len(payload), seq, fmt_addr) + payload
+
+
+class BinaryLogDecodeTests(unittest.TestCase):
+
+    def setUp(self):
+        elf, self.addrs = make_elf(FLASH_STRINGS)
+        with tempfile.NamedTemporaryFile(delete=False) as f:
+            f.write(elf)
+            self.elf_path = f.name
+        self.decoder = log_binary_decode.FrameDecoder(log_binary_decode.ElfStrings(self.elf_path))
+
+    def tearDown(self):
+        os.remove(self.elf_path)
+
+    def decode(self, data, chunk_size=4096):
+        chunks = [data[i:i + chunk_size] for i in range(0, len(data), chunk_size)]
+        output = []
+        log_binary_decode.decode_stream(lambda: chunks.pop(0) if chunks else b"", output.append, self.decoder)
+        return b"".join(output).decode("utf-8")
+
+    def ints_frame(self, seq=0):
+        args = struct.pack("<lLLll", -5, 7, 0xabcd, -3, 123456)
+        return make_frame(seq, self.addrs["ints %d %u %x %hhd %ld\n"], args)
+
+    def longs_frame(self, seq=0):
+        args = struct.pack("<qQQl", -1234567890123, 18446744073709551615, 0x123456789abcdef, 9)
+        return make_frame(seq, self.addrs["longs %lld %llu %llx %d\n"], args)
+
+    def strings_frame(self, seq=0):
+        # "in ram" is copied after the 16 bytes of arguments, NULL stays 0
+        args = struct.pack("<LLLl", self.addrs["in flash"], 16, 0, 1)
+        return make_frame(seq, self.addrs["strings %s %s %s %d\n"], args, b"in ram\0")
+
+    def test_int_arguments(self):
+        self.assertEqual(self.decode(self.ints_frame()), "ints -5 7 abcd -3 123456\n")
+
+    def test_64bit_arguments(self):
+        self.assertEqual(self.decode(self.longs_frame()),
+                         "longs -1234567890123 18446744073709551615 123456789abcdef 9\n")
+
+    def test_string_arguments(self):
+        frame = self.strings_frame()
+        self.assertEqual(len(frame), 12 + 16 + 8)
+        self.assertEqual(self.decode(frame), "strings in flash in ram (null) 1\n")
+
+    def test_text_fallback(self):
+        long_text = "long " + "x" * 299 + "|\n"
+        data = (b"ram format 5\n" + self.ints_frame(1) + long_text.encode("utf-8") +
+                self.longs_frame(2) + self.strings_frame(3))
+        expected = ("ram format 5\n" + "ints -5 7 abcd -3 123456\n" + long_text +
+                    "longs -1234567890123 18446744073709551615 123456789abcdef 9\n" +
+                    "strings in flash in ram (null) 1\n")
+        self.assertEqual(self.decode(data), expected)
+        # frames split across reads
+        self.assertEqual(self.decode(data, chunk_size=1), expected)
+        self.assertEqual(self.decode(data, chunk_size=7), expected)
+
+    def test_sequence_of_frames(self):
+        fmt_addr = self.addrs["seq %d\n"]
+        data = b"".join(make_frame(seq, fmt_addr, struct.pack("<l", seq)) for seq in range(10))
+        self.assertEqual(self.decode(data), "".join("seq %d\n" % seq for seq in range(10)))
+
+    def test_unknown_format(self):
+        frame = make_frame(0, 0x3f7ffff0, struct.pack("<l", 1))
+        self.assertEqual(self.decode(frame), "<unknown format string at 0x3f7ffff0>\n")
+
+    def test_corrupted_frame(self):
+        # a marker byte which doesn't start a valid frame is passed through
+        data = b"\xff\x02" + self.ints_frame()
+        output = []
+        chunks = [data]
+        log_binary_decode.decode_stream(lambda: chunks.pop(0) if chunks else b"", output.append, self.decoder)
+        self.assertEqual(b"".join(output), b"\xff\x02ints -5 7 abcd -3 123456\n")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -28,6 +28,11 @@ extern "C" {
  */
 typedef uint32_t nvs_handle;
 
+/**
+ * Opaque pointer type representing a blob opened with nvs_blob_open_read or nvs_blob_open_write
+ */
+typedef struct nvs_blob_stream* nvs_blob_stream_t;
+
 #define ESP_ERR_NVS_BASE                    0x1100                     /*!< Starting number of error codes */
 #define ESP_ERR_NVS_NOT_INITIALIZED         (ESP_ERR_NVS_BASE + 0x01)  /*!< The storage driver is not initialized */
 #define ESP_ERR_NVS_NOT_FOUND               (ESP_ERR_NVS_BASE + 0x02)  /*!< Id namespace doesn’t exist yet and mode is NVS_READONLY */
@@ -62,7 +67,8 @@ typedef uint32_t nvs_handle;
  */
 typedef enum {
 	NVS_READONLY,  /*!< Read only */
-	NVS_READWRITE  /*!< Read and write */
+	NVS_READWRITE, /*!< Read and write */
+	NVS_READWRITE_TRANSACTION  /*!< Read and write; changes are kept in RAM until nvs_commit writes them all at once */
 } nvs_open_mode;
 
 typedef enum {
@@ -91,9 +97,12 @@ typedef enum {
  * @param[in]  name        Namespace name. Maximal length is determined by the
  *                         underlying implementation, but is guaranteed to be
  *                         at least 15 characters. Shouldn't be empty.
- * @param[in]  open_mode   NVS_READWRITE or NVS_READONLY. If NVS_READONLY, will
- *                         open a handle for reading only. All write requests will
- *			   be rejected for this handle.
+ * @param[in]  open_mode   NVS_READWRITE, NVS_READWRITE_TRANSACTION or NVS_READONLY.
+ *                         If NVS_READONLY, will open a handle for reading only.
+ *                         All write requests will be rejected for this handle.
+ *                         If NVS_READWRITE_TRANSACTION, set and erase requests are
+ *                         staged in RAM and written to flash by nvs_commit. Reads
+ *                         through this handle see the staged values.
  * @param[out] out_handle  If successful (return code is zero), handle will be
  *                         returned in this argument.
  *
@@ -104,6 +113,7 @@ typedef enum {
  *             - ESP_ERR_NVS_NOT_FOUND id namespace doesn't exist yet and
  *               mode is NVS_READONLY
  *             - ESP_ERR_NVS_INVALID_NAME if namespace name doesn't satisfy constraints
+ *             - ESP_ERR_NO_MEM if memory for the handle could not be allocated
  *             - other error codes from the underlying storage driver
  */
 esp_err_t nvs_open(const char* name, nvs_open_mode open_mode, nvs_handle *out_handle);
@@ -132,6 +142,7 @@ esp_err_t nvs_open(const char* name, nvs_open_mode open_mode, nvs_handle *out_ha
  *             - ESP_ERR_NVS_NOT_FOUND id namespace doesn't exist yet and
  *               mode is NVS_READONLY
  *             - ESP_ERR_NVS_INVALID_NAME if namespace name doesn't satisfy constraints
+ *             - ESP_ERR_NO_MEM if memory for the handle could not be allocated
  *             - other error codes from the underlying storage driver
  */
 esp_err_t nvs_open_from_partition(const char *part_name, const char* name, nvs_open_mode open_mode, nvs_handle *out_handle);
@@ -188,7 +199,8 @@ esp_err_t nvs_set_str (nvs_handle handle, const char* key, const char* value);
  * @param[in]  value   The value to set.
  * @param[in]  length  length of binary value to set, in bytes; Maximum length is
  *                     508000 bytes or (97.6% of the partition size - 4000) bytes
- *                     whichever is lower.
+ *                     whichever is lower. For handles opened with
+ *                     NVS_READWRITE_TRANSACTION, maximum length is 3968 bytes.
  *
  * @return
  *             - ESP_OK if value was set successfully
@@ -314,6 +326,139 @@ esp_err_t nvs_get_str (nvs_handle handle, const char* key, char* out_value, size
 esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_value, size_t* length);
 /**@}*/
 
+/**
+ * @brief      Open a blob for reading it in parts
+ *
+ * Unlike nvs_get_blob, this doesn't need a buffer for the whole value: nvs_blob_read copies
+ * the requested part of the blob from flash directly into the caller's buffer.
+ * The blob shouldn't be modified while the stream is open. Streams stay usable after
+ * the handle has been closed, but not after the partition has been deinitialized.
+ *
+ * @param[in]  handle      Handle obtained from nvs_open function.
+ *                         Handles opened with NVS_READWRITE_TRANSACTION can't be used.
+ * @param[in]  key         Key name. Maximal length is 15 characters. Shouldn't be empty.
+ * @param[out] out_stream  If successful, set to the stream, which has to be closed with nvs_blob_close.
+ * @param[out] out_size    If not NULL, set to the size of the blob.
+ *
+ * @return
+ *             - ESP_OK if the blob has been opened
+ *             - ESP_ERR_NVS_NOT_FOUND if the requested key doesn't exist
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NOT_SUPPORTED if handle has been opened with NVS_READWRITE_TRANSACTION
+ *             - ESP_ERR_INVALID_ARG if out_stream is NULL
+ */
+esp_err_t nvs_blob_open_read(nvs_handle handle, const char* key, nvs_blob_stream_t* out_stream, size_t* out_size);
+
+/**
+ * @brief      Open a blob for writing it in parts
+ *
+ * Data passed to nvs_blob_write is collected in a buffer of about 4 kB, which is allocated
+ * by this function, and is stored in flash whenever it fills the rest of the current page.
+ * The new value replaces the previous value of the blob when nvs_blob_close is called. Until then, reads of the key return the previous value. If power is lost before
+ * that, the data written so far is erased on next nvs_flash_init.
+ *
+ * Setting, erasing or opening the same key for writing again while the stream is open aborts
+ * the stream, and the data written through it is discarded.
+ *
+ * @param[in]  handle      Handle obtained from nvs_open function. Handles that were opened read
+ *                         only or with NVS_READWRITE_TRANSACTION can't be used.
+ * @param[in]  key         Key name. Maximal length is 15 characters. Shouldn't be empty.
+ * @param[out] out_stream  If successful, set to the stream, which has to be closed with
+ *                         nvs_blob_close or nvs_blob_abort.
+ *
+ * @return
+ *             - ESP_OK if the blob has been opened
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *             - ESP_ERR_NOT_SUPPORTED if handle has been opened with NVS_READWRITE_TRANSACTION
+ *             - ESP_ERR_NVS_KEY_TOO_LONG if key name is too long
+ *             - ESP_ERR_NO_MEM if memory for the stream could not be allocated
+ *             - ESP_ERR_INVALID_ARG if out_stream is NULL
+ */
+esp_err_t nvs_blob_open_write(nvs_handle handle, const char* key, nvs_blob_stream_t* out_stream);
+
+/**
+ * @brief      Read part of a blob opened with nvs_blob_open_read
+ *
+ * Reading the blob from start to end in consecutive parts is the most efficient. The integrity
+ * of each chunk of the blob is checked when it is accessed for the first time, which reads
+ * the whole chunk from flash.
+ *
+ * @param[in]  stream    Stream obtained from nvs_blob_open_read.
+ * @param[in]  offset    Offset of the first byte to read within the blob.
+ * @param[out] out_data  Buffer of at least length bytes.
+ * @param[in]  length    Number of bytes to read.
+ *
+ * @return
+ *             - ESP_OK if the data has been read
+ *             - ESP_ERR_NVS_INVALID_LENGTH if offset + length is larger than the size of the blob
+ *             - ESP_ERR_NVS_NOT_FOUND if the blob has been modified or erased since it has been opened,
+ *               or if its data is corrupted
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the partition has been deinitialized
+ *             - ESP_ERR_INVALID_STATE if the stream has been opened for writing
+ *             - ESP_ERR_INVALID_ARG if stream or out_data is NULL
+ */
+esp_err_t nvs_blob_read(nvs_blob_stream_t stream, size_t offset, void* out_data, size_t length);
+
+/**
+ * @brief      Append data to a blob opened with nvs_blob_open_write
+ *
+ * Data is buffered until it fills the rest of the current page, and is then stored as one
+ * chunk, so the size of the parts doesn't matter. The remaining data is stored by
+ * nvs_blob_close. If this function fails with an error other than ESP_ERR_INVALID_ARG, the stream is aborted:
+ * the data written so far is erased, and the stream should be closed.
+ *
+ * @param[in]  stream  Stream obtained from nvs_blob_open_write.
+ * @param[in]  offset  Offset of the data within the blob. Has to be equal to the number of
+ *                     bytes written through the stream so far.
+ * @param[in]  data    Data to write.
+ * @param[in]  length  Number of bytes to write.
+ *
+ * @return
+ *             - ESP_OK if the data has been written
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space in the
+ *               underlying storage to save the value
+ *             - ESP_ERR_NVS_VALUE_TOO_LONG if the blob grows larger than the partition allows,
+ *               or consists of too many chunks
+ *             - ESP_ERR_INVALID_STATE if the stream has been opened for reading or has been aborted
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the partition has been deinitialized
+ *             - ESP_ERR_INVALID_ARG if stream or data is NULL, or offset is not equal
+ *               to the number of bytes written so far
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_write(nvs_blob_stream_t stream, size_t offset, const void* data, size_t length);
+
+/**
+ * @brief      Close a blob stream
+ *
+ * For a stream opened with nvs_blob_open_write, the data written through it becomes
+ * the value of the blob, and the previous value is erased. The stream is freed in any case,
+ * and must not be used after this call.
+ *
+ * @param[in]  stream  Stream obtained from nvs_blob_open_read or nvs_blob_open_write.
+ *
+ * @return
+ *             - ESP_OK if the stream has been closed and written data has been stored
+ *             - ESP_ERR_INVALID_STATE if writing has been aborted, the new value hasn't been stored
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the partition has been deinitialized before
+ *               the stream opened for writing has been closed
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space to store the
+ *               buffered data, the new value hasn't been stored
+ *             - ESP_ERR_NVS_REMOVE_FAILED if the new value has been stored, but the previous
+ *               one couldn't be erased. It will be erased after re-initialization of nvs.
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_close(nvs_blob_stream_t stream);
+
+/**
+ * @brief      Close a blob stream, discarding data written through it
+ *
+ * The blob keeps its previous value. The stream is freed and must not be used after this call.
+ *
+ * @param[in]  stream  Stream obtained from nvs_blob_open_read or nvs_blob_open_write.
+ */
+void nvs_blob_abort(nvs_blob_stream_t stream);
+
 /**
  * @brief      Erase key-value pair with given key name.
  *
@@ -331,6 +476,7 @@ esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_value, size
  *              - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
  *              - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
  *              - ESP_ERR_NVS_NOT_FOUND if the requested key doesn't exist
+ *              - ESP_ERR_NOT_SUPPORTED if handle was opened with NVS_READWRITE_TRANSACTION
  *              - other error codes from the underlying storage driver
  */
 esp_err_t nvs_erase_key(nvs_handle handle, const char* key);
@@ -347,6 +493,7 @@ esp_err_t nvs_erase_key(nvs_handle handle, const char* key);
  *              - ESP_OK if erase operation was successful
  *              - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
  *              - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *              - ESP_ERR_NOT_SUPPORTED if handle was opened with NVS_READWRITE_TRANSACTION
  *              - other error codes from the underlying storage driver
  */
 esp_err_t nvs_erase_all(nvs_handle handle);
@@ -358,12 +505,25 @@ esp_err_t nvs_erase_all(nvs_handle handle);
  * to non-volatile storage. Individual implementations may write to storage at other times,
  * but this is not guaranteed.
  *
+ * For handles opened with NVS_READWRITE_TRANSACTION, all values staged since the last
+ * commit are written to one page with a single flash write and become valid at once:
+ * if power is lost during the commit, after re-initialization either all of them or none
+ * of them are present. The old values are removed after that point. All staged values together have to fit into one page
+ * (126 entries of 32 bytes). The staged changes are dropped once the new values are
+ * written, even if removing the old ones fails.
+ *
  * @param[in]  handle  Storage handle obtained with nvs_open.
  *                     Handles that were opened read only cannot be used.
  *
  * @return
  *             - ESP_OK if the changes have been written successfully
  *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if the staged values don't fit into
+ *               one page or there is not enough space in the underlying storage.
+ *               The staged changes are kept.
+ *             - ESP_ERR_NVS_REMOVE_FAILED if the new values were written, but removing
+ *               old values failed. The removal will be finished after
+ *               re-initialization of nvs.
  *             - other error codes from the underlying storage driver
  */
 esp_err_t nvs_commit(nvs_handle handle);
@@ -375,6 +535,8 @@ esp_err_t nvs_commit(nvs_handle handle);
  * the handle is not in use any more. Closing the handle may not automatically
  * write the changes to nonvolatile storage. This has to be done explicitly using
  * nvs_commit function.
+ * Changes staged on a handle opened with NVS_READWRITE_TRANSACTION which have not
+ * been committed are discarded.
  * Once this function is called on a handle, the handle should no longer be used.
  *
  * @param[in]  handle  Storage handle to close
@@ -426,6 +588,78 @@ typedef struct {
  */
 esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats);
 
+/**
+ * @note Info about the read cache of an NVS partition.
+ */
+typedef struct {
+    size_t used_bytes;        /**< Amount of memory taken by cached values. */
+    size_t total_bytes;       /**< Memory budget of the cache, 0 if the cache is disabled. */
+    size_t entry_count;       /**< Amount of cached values. */
+    uint32_t hits;            /**< Amount of reads served from the cache. */
+    uint32_t misses;          /**< Amount of reads which had to read the value from flash. */
+} nvs_cache_stats_t;
+
+/**
+ * @brief      Fill structure nvs_cache_stats_t. It provides info about the read cache of the partition.
+ *
+ * The read cache is enabled with CONFIG_NVS_READ_CACHE. It keeps copies of recently read
+ * values in RAM, so that reading them again doesn't access flash. Counters of hits and misses
+ * are reset when the partition is initialized.
+ *
+ * \code{c}
+ * // Example of nvs_get_cache_stats() to get the share of reads served from the cache:
+ * nvs_cache_stats_t cache_stats;
+ * nvs_get_cache_stats(NULL, &cache_stats);
+ * printf("Cache: Hits = (%d), Misses = (%d), UsedBytes = (%d)\n",
+ *        cache_stats.hits, cache_stats.misses, cache_stats.used_bytes);
+ * \endcode
+ *
+ * @param[in]   part_name     Partition name NVS in the partition table.
+ *                            If pass a NULL than will use NVS_DEFAULT_PART_NAME ("nvs").
+ *
+ * @param[out]  cache_stats   Returns filled structure nvs_cache_stats_t.
+ *
+ * @return
+ *             - ESP_OK if the structure has been filled. If the read cache is disabled,
+ *               all fields are 0.
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the storage driver is not initialized.
+ *               Return param cache_stats will be filled 0.
+ *             - ESP_ERR_INVALID_ARG if cache_stats equal to NULL.
+ */
+esp_err_t nvs_get_cache_stats(const char* part_name, nvs_cache_stats_t* cache_stats);
+
+/**
+ * @brief      Reclaim space taken by erased entries ahead of time.
+ *
+ * When the active page fills up and there is only one free page left, the write which
+ * needed the space copies the items of another page and erases a flash sector, which makes
+ * it take much longer than usual. Each call to this function frees one page by moving its
+ * items to the active page, as long as the partition has less than CONFIG_NVS_GC_FREE_PAGES
+ * free pages. While two or more pages are free, writes don't have to erase anything.
+ *
+ * The work done by one call is bounded by copying the items of one page and erasing one
+ * sector. Other operations on the partition wait while it is in progress, so call this
+ * function from a low priority task or when the application is idle.
+ *
+ * \code{c}
+ * // Example of nvs_gc_step() called from a low priority task:
+ * while (nvs_gc_step(NULL) == ESP_OK) {
+ *     vTaskDelay(1);
+ * }
+ * \endcode
+ *
+ * @param[in]   part_name     Partition name NVS in the partition table.
+ *                            If pass a NULL than will use NVS_DEFAULT_PART_NAME ("nvs").
+ *
+ * @return
+ *             - ESP_OK if a page has been freed. Calling the function again may free another one.
+ *             - ESP_ERR_NVS_NOT_FOUND if there is nothing to do: enough pages are free already,
+ *               or no page holds erased entries whose items would fit into the active page.
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the storage driver is not initialized.
+ *             - other error codes from the underlying storage driver.
+ */
+esp_err_t nvs_gc_step(const char* part_name);
+
 /**
  * @brief      Calculate all entries in a namespace.
  *
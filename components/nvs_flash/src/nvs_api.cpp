@@ -16,21 +16,21 @@
 #include "nvs_storage.hpp"
 #include "intrusive_list.h"
 #include "nvs_platform.hpp"
+#include "nvs_handle_table.hpp"
+#include "nvs_blob_stream.hpp"
 #include "esp_partition.h"
+#include "esp_crc.h"
 #include "sdkconfig.h"
 #ifdef CONFIG_NVS_ENCRYPTION
 #include "nvs_encr.hpp"
 #endif
 
 #ifdef ESP_PLATFORM
-#include <rom/crc.h>
-
 // Uncomment this line to force output from this module
 // #define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 #include "esp_log.h"
 static const char* TAG = "nvs";
 #else
-#include "crc.h"
 #define ESP_LOGD(...)
 #endif
 
@@ -41,35 +41,15 @@ extern "C" esp_err_t nvs_flash_init_custom(const char *partName, uint32_t baseSe
 extern "C" esp_err_t nvs_flash_secure_init_custom(const char *partName, uint32_t baseSector, uint32_t sectorCount, nvs_sec_cfg_t* cfg);
 #endif
 
-class HandleEntry : public intrusive_list_node<HandleEntry>
-{
-    static uint32_t s_nvs_next_handle;
-public:
-    HandleEntry() {}
-
-    HandleEntry(bool readOnly, uint8_t nsIndex, nvs::Storage* StoragePtr) :
-        mHandle(++s_nvs_next_handle),  // Begin the handle value with 1
-        mReadOnly(readOnly),
-        mNsIndex(nsIndex),
-        mStoragePtr(StoragePtr)
-    {
-    }
-
-    nvs_handle mHandle;
-    uint8_t mReadOnly;
-    uint8_t mNsIndex;
-    nvs::Storage* mStoragePtr;
+struct nvs_blob_stream : public nvs::BlobStream {
 };
 
-#ifdef ESP_PLATFORM
-SemaphoreHandle_t nvs::Lock::mSemaphore = NULL;
-#endif
+nvs::ReadWriteLock nvs::Lock::sLock;
 
 using namespace std;
 using namespace nvs;
 
-static intrusive_list<HandleEntry> s_nvs_handles;
-uint32_t HandleEntry::s_nvs_next_handle;
+static HandleTable s_nvs_handles;
 static intrusive_list<nvs::Storage> s_nvs_storage_list;
 
 static nvs::Storage* lookup_storage_from_name(const char *name)
@@ -86,7 +66,7 @@ static nvs::Storage* lookup_storage_from_name(const char *name)
 
 extern "C" void nvs_dump(const char *partName)
 {
-    Lock lock;
+    SharedLock lock;
     nvs::Storage* pStorage;
 
     pStorage = lookup_storage_from_name(partName);
@@ -94,6 +74,7 @@ extern "C" void nvs_dump(const char *partName)
         return;
     }
 
+    ReadLock storageLock(pStorage->getLock());
     pStorage->debugDump();
     return;
 }
@@ -228,17 +209,14 @@ extern "C" esp_err_t nvs_flash_deinit_partition(const char* partition_name)
 #endif
 
     /* Clean up handles related to the storage being deinitialized */
-    auto it = s_nvs_handles.begin();
-    auto next = it;
-    while(it != s_nvs_handles.end()) {
-        next++;
-        if (it->mStoragePtr == storage) {
+    for (size_t i = 0; i < s_nvs_handles.capacity(); ++i) {
+        HandleEntry& entry = s_nvs_handles[i];
+        if (entry.mHandle != 0 && entry.mStoragePtr == storage) {
             ESP_LOGD(TAG, "Deleting handle %d (ns=%d) related to partition \"%s\" (missing call to nvs_close?)",
-                     it->mHandle, it->mNsIndex, partition_name);
-            s_nvs_handles.erase(it);
-            delete static_cast<HandleEntry*>(it);
+                     entry.mHandle, entry.mNsIndex, partition_name);
+            delete entry.mTransaction;
+            s_nvs_handles.remove(&entry);
         }
-        it = next;
     }
 
     /* Finally delete the storage itself */
@@ -255,13 +233,11 @@ extern "C" esp_err_t nvs_flash_deinit(void)
 
 static esp_err_t nvs_find_ns_handle(nvs_handle handle, HandleEntry& entry)
 {
-    auto it = find_if(begin(s_nvs_handles), end(s_nvs_handles), [=](HandleEntry& e) -> bool {
-        return e.mHandle == handle;
-    });
-    if (it == end(s_nvs_handles)) {
+    auto found = s_nvs_handles.find(handle);
+    if (found == nullptr) {
         return ESP_ERR_NVS_INVALID_HANDLE;
     }
-    entry = *it;
+    entry = *found;
     return ESP_OK;
 }
 
@@ -277,13 +253,21 @@ extern "C" esp_err_t nvs_open_from_partition(const char *part_name, const char*
         return ESP_ERR_NVS_PART_NOT_FOUND;
     }
 
-    esp_err_t err = sHandle->createOrOpenNamespace(name, open_mode == NVS_READWRITE, nsIndex);
+    esp_err_t err = sHandle->createOrOpenNamespace(name, open_mode != NVS_READONLY, nsIndex);
     if (err != ESP_OK) {
         return err;
     }
 
-    HandleEntry *handle_entry = new HandleEntry(open_mode==NVS_READONLY, nsIndex, sHandle);
-    s_nvs_handles.push_back(handle_entry);
+    HandleEntry *handle_entry = s_nvs_handles.add();
+    if (handle_entry == nullptr) {
+        return ESP_ERR_NO_MEM;
+    }
+    handle_entry->mReadOnly = (open_mode == NVS_READONLY);
+    handle_entry->mNsIndex = nsIndex;
+    handle_entry->mStoragePtr = sHandle;
+    if (open_mode == NVS_READWRITE_TRANSACTION) {
+        handle_entry->mTransaction = new Transaction;
+    }
 
     *out_handle = handle_entry->mHandle;
 
@@ -303,59 +287,70 @@ extern "C" void nvs_close(nvs_handle handle)
 {
     Lock lock;
     ESP_LOGD(TAG, "%s %d", __func__, handle);
-    auto it = find_if(begin(s_nvs_handles), end(s_nvs_handles), [=](HandleEntry& e) -> bool {
-        return e.mHandle == handle;
-    });
-    if (it == end(s_nvs_handles)) {
+    auto entry = s_nvs_handles.find(handle);
+    if (entry == nullptr) {
         return;
     }
-    s_nvs_handles.erase(it);
-    delete static_cast<HandleEntry*>(it);
+    delete entry->mTransaction;
+    s_nvs_handles.remove(entry);
 }
 
 extern "C" esp_err_t nvs_erase_key(nvs_handle handle, const char* key)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s %s\r\n", __func__, key);
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
     if (entry.mReadOnly) {
         return ESP_ERR_NVS_READ_ONLY;
     }
+    if (entry.mTransaction) {
+        // erasures can't be made part of the atomic commit, see nvs_commit
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     return entry.mStoragePtr->eraseItem(entry.mNsIndex, key);
 }
 
 extern "C" esp_err_t nvs_erase_all(nvs_handle handle)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s\r\n", __func__);
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
     if (entry.mReadOnly) {
         return ESP_ERR_NVS_READ_ONLY;
     }
+    if (entry.mTransaction) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     return entry.mStoragePtr->eraseNamespace(entry.mNsIndex);
 }
 
 template<typename T>
 static esp_err_t nvs_set(nvs_handle handle, const char* key, T value)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s %s %d %d", __func__, key, sizeof(T), (uint32_t) value);
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
     if (entry.mReadOnly) {
         return ESP_ERR_NVS_READ_ONLY;
     }
+    if (entry.mTransaction) {
+        return entry.mTransaction->set(itemTypeOf(value), key, &value, sizeof(value));
+    }
     return entry.mStoragePtr->writeItem(entry.mNsIndex, key, value);
 }
 
@@ -401,33 +396,48 @@ extern "C" esp_err_t nvs_set_u64 (nvs_handle handle, const char* key, uint64_t v
 
 extern "C" esp_err_t nvs_commit(nvs_handle handle)
 {
-    Lock lock;
-    // no-op for now, to be used when intermediate cache is added
+    SharedLock lock;
     HandleEntry entry;
-    return nvs_find_ns_handle(handle, entry);
+    auto err = nvs_find_ns_handle(handle, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
+    if (entry.mTransaction) {
+        return entry.mStoragePtr->writeTransaction(entry.mNsIndex, *entry.mTransaction);
+    }
+    return ESP_OK;
 }
 
 extern "C" esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char* value)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s %s %s", __func__, key, value);
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
+    if (entry.mTransaction) {
+        return entry.mTransaction->set(nvs::ItemType::SZ, key, value, strlen(value) + 1);
+    }
     return entry.mStoragePtr->writeItem(entry.mNsIndex, nvs::ItemType::SZ, key, value, strlen(value) + 1);
 }
 
 extern "C" esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void* value, size_t length)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s %s %d", __func__, key, length);
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
+    if (entry.mTransaction) {
+        return entry.mTransaction->set(nvs::ItemType::BLOB, key, value, length);
+    }
     return entry.mStoragePtr->writeItem(entry.mNsIndex, nvs::ItemType::BLOB, key, value, length);
 }
 
@@ -435,13 +445,22 @@ extern "C" esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void
 template<typename T>
 static esp_err_t nvs_get(nvs_handle handle, const char* key, T* out_value)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s %s %d", __func__, key, sizeof(T));
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    ReadLock storageLock(entry.mStoragePtr->getLock());
+    if (entry.mTransaction) {
+        // values staged with another type don't replace this one, same as in storage
+        auto record = entry.mTransaction->find(key);
+        if (record && record->datatype == itemTypeOf<T>()) {
+            memcpy(out_value, record->data, sizeof(T));
+            return ESP_OK;
+        }
+    }
     return entry.mStoragePtr->readItem(entry.mNsIndex, key, *out_value);
 }
 
@@ -487,18 +506,31 @@ extern "C" esp_err_t nvs_get_u64 (nvs_handle handle, const char* key, uint64_t*
 
 static esp_err_t nvs_get_str_or_blob(nvs_handle handle, nvs::ItemType type, const char* key, void* out_value, size_t* length)
 {
-    Lock lock;
+    SharedLock lock;
     ESP_LOGD(TAG, "%s %s", __func__, key);
     HandleEntry entry;
     auto err = nvs_find_ns_handle(handle, entry);
     if (err != ESP_OK) {
         return err;
     }
+    ReadLock storageLock(entry.mStoragePtr->getLock());
+
+    Transaction::Record* record = nullptr;
+    if (entry.mTransaction) {
+        record = entry.mTransaction->find(key);
+        if (record && record->datatype != type) {
+            record = nullptr;
+        }
+    }
 
     size_t dataSize;
-    err = entry.mStoragePtr->getItemDataSize(entry.mNsIndex, type, key, dataSize);
-    if (err != ESP_OK) {
-        return err;
+    if (record) {
+        dataSize = record->dataSize;
+    } else {
+        err = entry.mStoragePtr->getItemDataSize(entry.mNsIndex, type, key, dataSize);
+        if (err != ESP_OK) {
+            return err;
+        }
     }
 
     if (length == nullptr) {
@@ -512,6 +544,12 @@ static esp_err_t nvs_get_str_or_blob(nvs_handle handle, nvs::ItemType type, cons
     }
 
     *length = dataSize;
+    if (record) {
+        if (dataSize > 0) {
+            memcpy(out_value, record->data, dataSize);
+        }
+        return ESP_OK;
+    }
     return entry.mStoragePtr->readItem(entry.mNsIndex, type, key, out_value, dataSize);
 }
 
@@ -525,9 +563,133 @@ extern "C" esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_
     return nvs_get_str_or_blob(handle, nvs::ItemType::BLOB, key, out_value, length);
 }
 
+extern "C" esp_err_t nvs_blob_open_read(nvs_handle handle, const char* key, nvs_blob_stream_t* out_stream, size_t* out_size)
+{
+    SharedLock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    if (out_stream == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HandleEntry entry;
+    auto err = nvs_find_ns_handle(handle, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (entry.mTransaction) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    ReadLock storageLock(entry.mStoragePtr->getLock());
+    auto stream = new nvs_blob_stream;
+    err = entry.mStoragePtr->openBlobRead(entry.mNsIndex, key, *stream);
+    if (err != ESP_OK) {
+        delete stream;
+        return err;
+    }
+    if (out_size) {
+        *out_size = stream->getSize();
+    }
+    *out_stream = stream;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_blob_open_write(nvs_handle handle, const char* key, nvs_blob_stream_t* out_stream)
+{
+    SharedLock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    if (out_stream == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HandleEntry entry;
+    auto err = nvs_find_ns_handle(handle, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (entry.mReadOnly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (entry.mTransaction) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    WriteLock storageLock(entry.mStoragePtr->getLock());
+    auto stream = new nvs_blob_stream;
+    err = entry.mStoragePtr->openBlobWrite(entry.mNsIndex, key, *stream);
+    if (err != ESP_OK) {
+        delete stream;
+        return err;
+    }
+    *out_stream = stream;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_blob_read(nvs_blob_stream_t stream, size_t offset, void* out_data, size_t length)
+{
+    SharedLock lock;
+    if (stream == nullptr || (out_data == nullptr && length > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    Storage* storage = stream->getStorage();
+    if (storage == nullptr) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    ReadLock storageLock(storage->getLock());
+    return storage->readBlob(*stream, offset, out_data, length);
+}
+
+extern "C" esp_err_t nvs_blob_write(nvs_blob_stream_t stream, size_t offset, const void* data, size_t length)
+{
+    SharedLock lock;
+    if (stream == nullptr || (data == nullptr && length > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    Storage* storage = stream->getStorage();
+    if (storage == nullptr) {
+        return (stream->getMode() == BlobStream::Mode::READ) ? ESP_ERR_INVALID_STATE : ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    WriteLock storageLock(storage->getLock());
+    return storage->writeBlob(*stream, offset, data, length);
+}
+
+extern "C" esp_err_t nvs_blob_close(nvs_blob_stream_t stream)
+{
+    SharedLock lock;
+    if (stream == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    Storage* storage = stream->getStorage();
+    if (storage && stream->getMode() == BlobStream::Mode::READ) {
+        ReadLock storageLock(storage->getLock());
+        err = storage->closeBlob(*stream);
+    } else if (storage) {
+        WriteLock storageLock(storage->getLock());
+        err = storage->closeBlob(*stream);
+    } else if (stream->getMode() != BlobStream::Mode::READ) {
+        err = ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    delete stream;
+    return err;
+}
+
+extern "C" void nvs_blob_abort(nvs_blob_stream_t stream)
+{
+    SharedLock lock;
+    if (stream == nullptr) {
+        return;
+    }
+    Storage* storage = stream->getStorage();
+    if (storage && stream->getMode() == BlobStream::Mode::READ) {
+        ReadLock storageLock(storage->getLock());
+        storage->abortBlob(*stream);
+    } else if (storage) {
+        WriteLock storageLock(storage->getLock());
+        storage->abortBlob(*stream);
+    }
+    delete stream;
+}
+
 extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats)
 {
-    Lock lock;
+    SharedLock lock;
     nvs::Storage* pStorage;
 
     if (nvs_stats == NULL) {
@@ -542,6 +704,7 @@ extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats
     if (pStorage == NULL) {
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
+    ReadLock storageLock(pStorage->getLock());
 
     if(!pStorage->isValid()){
         return ESP_ERR_NVS_INVALID_STATE;
@@ -550,9 +713,43 @@ extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats
     return pStorage->fillStats(*nvs_stats);
 }
 
+extern "C" esp_err_t nvs_get_cache_stats(const char* part_name, nvs_cache_stats_t* cache_stats)
+{
+    SharedLock lock;
+    nvs::Storage* pStorage;
+
+    if (cache_stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(cache_stats, 0, sizeof(*cache_stats));
+
+    pStorage = lookup_storage_from_name((part_name == NULL) ? NVS_DEFAULT_PART_NAME : part_name);
+    if (pStorage == NULL) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    ReadLock storageLock(pStorage->getLock());
+
+    pStorage->fillCacheStats(*cache_stats);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_gc_step(const char* part_name)
+{
+    SharedLock lock;
+    nvs::Storage* pStorage;
+
+    pStorage = lookup_storage_from_name((part_name == NULL) ? NVS_DEFAULT_PART_NAME : part_name);
+    if (pStorage == NULL) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    WriteLock storageLock(pStorage->getLock());
+
+    return pStorage->gcStep();
+}
+
 extern "C" esp_err_t nvs_get_used_entry_count(nvs_handle handle, size_t* used_entries)
 {
-    Lock lock;
+    SharedLock lock;
     if(used_entries == NULL){
         return ESP_ERR_INVALID_ARG;
     }
@@ -563,6 +760,7 @@ extern "C" esp_err_t nvs_get_used_entry_count(nvs_handle handle, size_t* used_en
     if (err != ESP_OK) {
         return err;
     }
+    ReadLock storageLock(entry.mStoragePtr->getLock());
 
     size_t used_entry_count;
     err = entry.mStoragePtr->calcEntriesInNamespace(entry.mNsIndex, used_entry_count);
@@ -606,8 +804,8 @@ extern "C" esp_err_t nvs_flash_generate_keys(const esp_partition_t* partition, n
         return err;
     }
 
-    uint32_t crc_calc = crc32_le(0xffffffff, cfg->eky, NVS_KEY_SIZE);
-    crc_calc = crc32_le(crc_calc, cfg->tky, NVS_KEY_SIZE);
+    uint32_t crc_calc = esp_crc32_le(0xffffffff, cfg->eky, NVS_KEY_SIZE);
+    crc_calc = esp_crc32_le(crc_calc, cfg->tky, NVS_KEY_SIZE);
 
     uint8_t crc_wr[16];
     memset(crc_wr, 0xff, sizeof(crc_wr));
@@ -675,8 +873,8 @@ extern "C" esp_err_t nvs_flash_read_security_cfg(const esp_partition_t* partitio
         return err;
     }
     
-    crc_calc = crc32_le(0xffffffff, cfg->eky, NVS_KEY_SIZE);
-    crc_calc = crc32_le(crc_calc, cfg->tky, NVS_KEY_SIZE);
+    crc_calc = esp_crc32_le(0xffffffff, cfg->eky, NVS_KEY_SIZE);
+    crc_calc = esp_crc32_le(crc_calc, cfg->tky, NVS_KEY_SIZE);
 
     if(crc_calc != crc_read) {
         if(!check_if_initialized(cfg->eky, cfg->tky, crc_read)) {
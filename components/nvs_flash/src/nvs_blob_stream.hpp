@@ -0,0 +1,104 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_blob_stream_hpp
+#define nvs_blob_stream_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include "intrusive_list.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+class Storage;
+
+/**
+ * State of a blob which is read or written in parts.
+ *
+ * Streams are opened and operated on through Storage, which keeps a list of the open ones.
+ * Data written through a stream is collected in a buffer until it fills the rest of the
+ * current page, and is then stored as a chunk of the version which the blob doesn't use
+ * at the moment. The index which makes these chunks valid is written when
+ * the stream is closed, so until then the previous value of the blob stays in place, and
+ * chunks left behind by a reset are erased on next init.
+ */
+class BlobStream : public intrusive_list_node<BlobStream>
+{
+    friend class Storage;
+
+public:
+    BlobStream() {}
+
+    ~BlobStream()
+    {
+        delete[] mBuffer;
+    }
+
+    enum class Mode : uint8_t {
+        READ,
+        WRITE,
+        ABORTED,    // write which has been discarded, because the blob was modified by other means or writing failed
+    };
+
+    /* Storage the stream belongs to, nullptr after it has been closed or the storage has been deinitialized */
+    Storage* getStorage() const
+    {
+        return mStorage;
+    }
+
+    Mode getMode() const
+    {
+        return mMode;
+    }
+
+    /* Size of the blob being read, or the number of bytes written so far, including buffered ones */
+    size_t getSize() const
+    {
+        return mSize;
+    }
+
+protected:
+    uint8_t getChunkIndex(uint8_t chunkNum) const
+    {
+        return (mChunkType == ItemType::BLOB) ? Item::CHUNK_ANY : static_cast<uint8_t>(mChunkStart) + chunkNum;
+    }
+
+    Storage* mStorage = nullptr;
+    Mode mMode = Mode::READ;
+    uint8_t mNsIndex = 0;
+    char mKey[Item::MAX_KEY_LENGTH + 1];
+    ItemType mChunkType = ItemType::BLOB_DATA;   // ItemType::BLOB if the blob has been stored as a single item without index
+    VerOffset mChunkStart = VerOffset::VER_0_OFFSET;
+    uint8_t mChunkCount = 0;
+    size_t mSize = 0;
+
+    /* Writing: version of the blob which is replaced when the stream is closed */
+    bool mReplace = false;
+    VerOffset mPrevStart = VerOffset::VER_0_OFFSET;
+
+    /* Writing: data which hasn't been stored as a chunk yet, Page::CHUNK_MAX_SIZE bytes */
+    uint8_t* mBuffer = nullptr;
+    size_t mBuffered = 0;
+
+    /* Reading: chunk which holds the last bytes read and its offset within the blob */
+    uint8_t mCursorChunk = 0;
+    size_t mCursorOffset = 0;
+    uint8_t mVerifiedChunk = Item::CHUNK_ANY;    // chunk whose data CRC has been checked already
+};
+
+} // namespace nvs
+
+#endif /* nvs_blob_stream_hpp */
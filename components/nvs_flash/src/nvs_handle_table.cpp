@@ -0,0 +1,99 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "nvs_handle_table.hpp"
+
+namespace nvs
+{
+
+const size_t HandleTable::SLOT_BITS;
+const size_t HandleTable::MAX_SLOTS;
+const size_t HandleTable::INITIAL_SLOTS;
+
+HandleTable::~HandleTable()
+{
+    delete[] mSlots;
+    delete[] mFreeSlots;
+}
+
+bool HandleTable::grow()
+{
+    size_t capacity = (mCapacity == 0) ? INITIAL_SLOTS : mCapacity * 2;
+    if (capacity > MAX_SLOTS) {
+        capacity = MAX_SLOTS;
+    }
+    if (capacity == mCapacity) {
+        return false;
+    }
+    Slot* slots = new (std::nothrow) Slot[capacity];
+    uint16_t* freeSlots = new (std::nothrow) uint16_t[capacity];
+    if (slots == nullptr || freeSlots == nullptr) {
+        delete[] slots;
+        delete[] freeSlots;
+        return false;
+    }
+    for (size_t i = 0; i < mCapacity; ++i) {
+        slots[i] = mSlots[i];
+    }
+    // only called when all slots are in use, so the new slots are the only free ones
+    for (size_t i = mCapacity; i < capacity; ++i) {
+        freeSlots[i - mCapacity] = static_cast<uint16_t>(i);
+    }
+    delete[] mSlots;
+    delete[] mFreeSlots;
+    mSlots = slots;
+    mFreeSlots = freeSlots;
+    mCapacity = capacity;
+    mFreeHead = 0;
+    return true;
+}
+
+HandleEntry* HandleTable::add()
+{
+    if (mCount == mCapacity && !grow()) {
+        return nullptr;
+    }
+    size_t index = mFreeSlots[mFreeHead];
+    mFreeHead = (mFreeHead + 1) % mCapacity;
+    ++mCount;
+    Slot& slot = mSlots[index];
+    slot.entry = HandleEntry();
+    slot.entry.mHandle = (slot.generation << SLOT_BITS) | static_cast<uint32_t>(index + 1);
+    return &slot.entry;
+}
+
+HandleEntry* HandleTable::find(nvs_handle handle)
+{
+    size_t index = (handle & ((1 << SLOT_BITS) - 1));
+    if (index == 0 || index > mCapacity) {
+        return nullptr;
+    }
+    HandleEntry& entry = mSlots[index - 1].entry;
+    if (entry.mHandle != handle) {
+        return nullptr;
+    }
+    return &entry;
+}
+
+void HandleTable::remove(HandleEntry* entry)
+{
+    size_t index = (entry->mHandle & ((1 << SLOT_BITS) - 1)) - 1;
+    Slot& slot = mSlots[index];
+    slot.entry.mHandle = 0;
+    slot.generation = (slot.generation + 1) & (UINT32_MAX >> SLOT_BITS);
+    // free slots occupy mCapacity - mCount positions of the ring, starting at mFreeHead
+    mFreeSlots[(mFreeHead + mCapacity - mCount) % mCapacity] = static_cast<uint16_t>(index);
+    --mCount;
+}
+
+} // namespace nvs
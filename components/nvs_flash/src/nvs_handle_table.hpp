@@ -0,0 +1,115 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_handle_table_hpp
+#define nvs_handle_table_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include "nvs.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_NVS_HANDLE_TABLE_SIZE
+#define NVS_HANDLE_TABLE_SIZE CONFIG_NVS_HANDLE_TABLE_SIZE
+#else
+#define NVS_HANDLE_TABLE_SIZE 32
+#endif
+
+namespace nvs
+{
+
+class Storage;
+class Transaction;
+
+class HandleEntry
+{
+public:
+    nvs_handle mHandle = 0;    // 0 if the slot is free
+    uint8_t mReadOnly = 0;
+    uint8_t mNsIndex = 0;
+    Storage* mStoragePtr = nullptr;
+    Transaction* mTransaction = nullptr;  // staged changes if opened in NVS_READWRITE_TRANSACTION mode
+};
+
+/**
+ * Table of open handles.
+ *
+ * A handle value holds the index of its slot in the lowest SLOT_BITS bits and the generation
+ * of the slot in the remaining bits. The generation is incremented whenever the slot is freed,
+ * so a handle which has been closed doesn't match the slot any more, even after the slot has
+ * been reused. Handle values are never 0.
+ *
+ * Free slots are reused in the order in which they were freed, which keeps generations of
+ * all slots advancing at a similar pace.
+ *
+ * The table is allocated with INITIAL_SLOTS slots when the first handle is added, and doubles
+ * in size when all slots are in use, up to MAX_SLOTS. Adding a handle may therefore move
+ * the entries of other handles.
+ */
+class HandleTable
+{
+public:
+    static const size_t SLOT_BITS = 16;
+    static const size_t MAX_SLOTS = (1 << SLOT_BITS) - 1;
+    static const size_t INITIAL_SLOTS = NVS_HANDLE_TABLE_SIZE;
+
+    static_assert(INITIAL_SLOTS > 0 && INITIAL_SLOTS <= MAX_SLOTS, "slot index + 1 must fit into SLOT_BITS");
+
+    HandleTable() {}
+    ~HandleTable();
+
+    /* Take a free slot and assign it a new handle value. Returns nullptr if the table
+     * can't be grown. */
+    HandleEntry* add();
+
+    /* Entry of an open handle, or nullptr if the handle is not open */
+    HandleEntry* find(nvs_handle handle);
+
+    void remove(HandleEntry* entry);
+
+    size_t size() const
+    {
+        return mCount;
+    }
+
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+    /* Entry in the given slot, which may be free (mHandle == 0) */
+    HandleEntry& operator[](size_t index)
+    {
+        return mSlots[index].entry;
+    }
+
+protected:
+    struct Slot {
+        HandleEntry entry;
+        uint32_t generation = 0;
+    };
+
+    bool grow();
+
+    Slot* mSlots = nullptr;
+    uint16_t* mFreeSlots = nullptr; // ring buffer of free slot indices
+    size_t mCapacity = 0;
+    size_t mFreeHead = 0;
+    size_t mCount = 0;
+}; // class HandleTable
+
+} // namespace nvs
+
+#endif /* nvs_handle_table_hpp */
@@ -17,18 +17,28 @@
 namespace nvs
 {
 
+const uint8_t HashList::EMPTY_SLOT;
+
 HashList::HashList()
 {
 }
     
 void HashList::clear()
 {
-    for (auto it = mBlockList.begin(); it != mBlockList.end();) {
-        auto tmp = it;
-        ++it;
-        mBlockList.erase(tmp);
-        delete static_cast<HashListBlock*>(tmp);
+    if (!mSlots) {
+        return;
     }
+    if (mItemIndex) {
+        for (size_t i = 0; i < mSlotCount; ++i) {
+            if (mSlots[i].mIndex != EMPTY_SLOT) {
+                mItemIndex->erase(mSlots[i].mHash, mPage, mSlots[i].mIndex);
+            }
+        }
+    }
+    delete[] mSlots;
+    mSlots = nullptr;
+    mSlotCount = 0;
+    mCount = 0;
 }
     
 HashList::~HashList()
@@ -36,82 +46,117 @@ HashList::~HashList()
     clear();
 }
 
-HashList::HashListBlock::HashListBlock()
+void HashList::setItemIndex(ItemIndex* itemIndex, Page* page)
+{
+    mItemIndex = itemIndex;
+    mPage = page;
+    if (!mItemIndex) {
+        return;
+    }
+    for (size_t i = 0; i < mSlotCount; ++i) {
+        if (mSlots[i].mIndex != EMPTY_SLOT) {
+            mItemIndex->insert(mSlots[i].mHash, mPage, mSlots[i].mIndex);
+        }
+    }
+}
+
+size_t HashList::findSlot(size_t index) const
+{
+    for (size_t slot = 0; slot < mSlotCount; ++slot) {
+        if (mSlots[slot].mIndex == index) {
+            return slot;
+        }
+    }
+    return SIZE_MAX;
+}
+
+void HashList::placeNode(const HashListNode& node)
+{
+    size_t slot = getHomeSlot(node.mHash);
+    while (mSlots[slot].mIndex != EMPTY_SLOT) {
+        slot = getNextSlot(slot);
+    }
+    mSlots[slot] = node;
+}
+
+void HashList::resize(size_t slotCount)
 {
-    static_assert(sizeof(HashListBlock) == HashListBlock::BYTE_SIZE,
-                  "cache block size calculation incorrect");
+    HashListNode* oldSlots = mSlots;
+    size_t oldSlotCount = mSlotCount;
+    mSlots = new HashListNode[slotCount];
+    mSlotCount = slotCount;
+    for (size_t i = 0; i < oldSlotCount; ++i) {
+        if (oldSlots[i].mIndex != EMPTY_SLOT) {
+            placeNode(oldSlots[i]);
+        }
+    }
+    delete[] oldSlots;
 }
 
 void HashList::insert(const Item& item, size_t index)
 {
+    assert(index < MAX_ITEMS);
     const uint32_t hash_24 = item.calculateCrc32WithoutValue() & 0xffffff;
-    // add entry to the end of last block if possible
-    if (mBlockList.size()) {
-        auto& block = mBlockList.back();
-        if (block.mCount < HashListBlock::ENTRY_COUNT) {
-            block.mNodes[block.mCount++] = HashListNode(hash_24, index);
-            return;
-        }
+    if (findSlot(index) != SIZE_MAX) {
+        // entry is reused, drop the stale hash first
+        erase(index);
+    }
+    if (getSlotCount(mCount + 1) > mSlotCount) {
+        resize(getSlotCount(mCount + 1));
     }
-    // if the above failed, create a new block and add entry to it
-    HashListBlock* newBlock = new HashListBlock;
-    mBlockList.push_back(newBlock);
-    newBlock->mNodes[0] = HashListNode(hash_24, index);
-    newBlock->mCount++;
+    if (mItemIndex) {
+        mItemIndex->insert(hash_24, mPage, index);
+    }
+    placeNode(HashListNode(hash_24, index));
+    ++mCount;
 }
 
 void HashList::erase(size_t index, bool itemShouldExist)
 {
-    for (auto it = mBlockList.begin(); it != mBlockList.end();) {
-        bool haveEntries = false;
-        bool foundIndex = false;
-        for (size_t i = 0; i < it->mCount; ++i) {
-            if (it->mNodes[i].mIndex == index) {
-                it->mNodes[i].mIndex = 0xff;
-                foundIndex = true;
-                /* found the item and removed it */
-            }
-            if (it->mNodes[i].mIndex != 0xff) {
-                haveEntries = true;
-            }
-            if (haveEntries && foundIndex) {
-                /* item was found, and HashListBlock still has some items */
-                return;
-            }
+    size_t slot = findSlot(index);
+    if (slot == SIZE_MAX) {
+        if (itemShouldExist) {
+            assert(false && "item should have been present in cache");
         }
-        /* no items left in HashListBlock, can remove */
-        if (!haveEntries) {
-            auto tmp = it;
-            ++it;
-            mBlockList.erase(tmp);
-            delete static_cast<HashListBlock*>(tmp);
-        } else {
-            ++it;
-        }
-        if (foundIndex) {
-            /* item was found and empty HashListBlock was removed */
-            return;
+        return;
+    }
+    if (mItemIndex) {
+        mItemIndex->erase(mSlots[slot].mHash, mPage, index);
+    }
+    // move back the following items of the probe sequence into the hole, so that no tombstones are needed
+    size_t hole = slot;
+    for (size_t next = getNextSlot(hole); mSlots[next].mIndex != EMPTY_SLOT; next = getNextSlot(next)) {
+        size_t home = getHomeSlot(mSlots[next].mHash);
+        bool canMove = (hole <= next) ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (canMove) {
+            mSlots[hole] = mSlots[next];
+            hole = next;
         }
     }
-    if (itemShouldExist) {
-        assert(false && "item should have been present in cache");
+    mSlots[hole] = HashListNode();
+    if (--mCount == 0) {
+        /* no items left, release the table */
+        clear();
+    } else if (getSlotCount(mCount) + SLOT_STEP < mSlotCount) {
+        resize(getSlotCount(mCount));
     }
 }
 
 size_t HashList::find(size_t start, const Item& item)
 {
+    if (!mSlots) {
+        return SIZE_MAX;
+    }
     const uint32_t hash_24 = item.calculateCrc32WithoutValue() & 0xffffff;
-    for (auto it = mBlockList.begin(); it != mBlockList.end(); ++it) {
-        for (size_t index = 0; index < it->mCount; ++index) {
-            HashListNode& e = it->mNodes[index];
-            if (e.mIndex >= start &&
-                    e.mHash == hash_24 &&
-                    e.mIndex != 0xff) {
-                return e.mIndex;
-            }
+    // items are searched in order of their index, so return the lowest matching index
+    size_t result = SIZE_MAX;
+    for (size_t slot = getHomeSlot(hash_24); mSlots[slot].mIndex != EMPTY_SLOT; slot = getNextSlot(slot)) {
+        const HashListNode& node = mSlots[slot];
+        if (node.mIndex >= start && node.mIndex < result && node.mHash == hash_24) {
+            result = node.mIndex;
         }
     }
-    return SIZE_MAX;
+    return result;
 }
 
 
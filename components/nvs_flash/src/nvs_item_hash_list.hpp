@@ -17,7 +17,7 @@
 
 #include "nvs.h"
 #include "nvs_types.hpp"
-#include "intrusive_list.h"
+#include "nvs_item_index.hpp"
 
 namespace nvs
 {
@@ -25,6 +25,9 @@ namespace nvs
 class HashList
 {
 public:
+    /* Maximum number of items, equal to the number of entries in a page */
+    static const size_t MAX_ITEMS = 126;
+
     HashList();
     ~HashList();
     
@@ -32,6 +35,9 @@ public:
     void erase(const size_t index, bool itemShouldExist=true);
     size_t find(size_t start, const Item& item);
     void clear();
+
+    /* Forward all insertions and removals to a partition-wide index */
+    void setItemIndex(ItemIndex* itemIndex, Page* page);
     
 private:
     HashList(const HashList& other);
@@ -39,9 +45,16 @@ private:
     
 protected:
 
+    /* Open addressing table with linear probing. Each slot holds the index of
+     * an item together with its 24-bit hash. The table is allocated when the
+     * first item is added and is resized in steps of SLOT_STEP slots as items
+     * are added and erased, so that it is never more than 7/8 full. */
+    static const size_t SLOT_STEP = 16;
+    static const uint8_t EMPTY_SLOT = 0xff;
+
     struct HashListNode {
         HashListNode() :
-            mIndex(0xff), mHash(0)
+            mIndex(EMPTY_SLOT), mHash(0)
         {
         }
 
@@ -54,18 +67,33 @@ protected:
         uint32_t mHash  : 24;
     };
 
-    struct HashListBlock : public intrusive_list_node<HashList::HashListBlock> {
-        HashListBlock();
+    static_assert(MAX_ITEMS < EMPTY_SLOT, "item index must fit into a slot");
 
-        static const size_t BYTE_SIZE = 128;
-        static const size_t ENTRY_COUNT = (BYTE_SIZE - sizeof(intrusive_list_node<HashListBlock>) - sizeof(size_t)) / 4;
+    static size_t getSlotCount(size_t itemCount)
+    {
+        size_t slots = (itemCount * 8 + 6) / 7;
+        return (slots + SLOT_STEP - 1) / SLOT_STEP * SLOT_STEP;
+    }
 
-        size_t mCount = 0;
-        HashListNode mNodes[ENTRY_COUNT];
-    };
+    size_t getHomeSlot(uint32_t hash) const
+    {
+        return hash % mSlotCount;
+    }
+
+    size_t getNextSlot(size_t slot) const
+    {
+        return (slot + 1 == mSlotCount) ? 0 : slot + 1;
+    }
+
+    size_t findSlot(size_t index) const;
+    void placeNode(const HashListNode& node);
+    void resize(size_t slotCount);
 
-    typedef intrusive_list<HashListBlock> TBlockList;
-    TBlockList mBlockList;
+    HashListNode* mSlots = nullptr;
+    size_t mSlotCount = 0;
+    size_t mCount = 0;
+    ItemIndex* mItemIndex = nullptr;
+    Page* mPage = nullptr;
 }; // class HashList
 
 } // namespace nvs
@@ -0,0 +1,158 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_item_index.hpp"
+#include <cstdlib>
+#include <cstdint>
+
+namespace nvs
+{
+
+ItemIndex::~ItemIndex()
+{
+    disable();
+}
+
+void ItemIndex::reset(size_t maxItems)
+{
+    disable();
+    mMaxItems = maxItems;
+    if (mMaxItems == 0) {
+        return;
+    }
+    if (!resize(MIN_SLOT_COUNT)) {
+        disable();
+    }
+}
+
+void ItemIndex::disable()
+{
+    free(mSlots);
+    mSlots = nullptr;
+    mSlotCount = 0;
+    mCount = 0;
+}
+
+bool ItemIndex::resize(size_t slotCount)
+{
+    Slot* slots = static_cast<Slot*>(calloc(slotCount, sizeof(Slot)));
+    if (!slots) {
+        return false;
+    }
+    Slot* oldSlots = mSlots;
+    size_t oldSlotCount = mSlotCount;
+    mSlots = slots;
+    mSlotCount = slotCount;
+    for (size_t i = 0; i < oldSlotCount; ++i) {
+        if (oldSlots[i].mPage == nullptr) {
+            continue;
+        }
+        size_t pos = getSlot(oldSlots[i].mHash);
+        while (mSlots[pos].mPage != nullptr) {
+            pos = (pos + 1) & (mSlotCount - 1);
+        }
+        mSlots[pos] = oldSlots[i];
+    }
+    free(oldSlots);
+    return true;
+}
+
+void ItemIndex::insert(uint32_t hash, Page* page, size_t index)
+{
+    if (!isActive()) {
+        return;
+    }
+    if (mCount + 1 > mMaxItems) {
+        // over the RAM budget, searches fall back to iterating over pages
+        disable();
+        return;
+    }
+    // keep load factor under 3/4
+    if ((mCount + 1) * 4 > mSlotCount * 3 && !resize(mSlotCount * 2)) {
+        disable();
+        return;
+    }
+    size_t pos = getSlot(hash);
+    while (mSlots[pos].mPage != nullptr) {
+        pos = (pos + 1) & (mSlotCount - 1);
+    }
+    mSlots[pos].mPage = page;
+    mSlots[pos].mHash = hash;
+    mSlots[pos].mIndex = index;
+    ++mCount;
+}
+
+void ItemIndex::erase(uint32_t hash, Page* page, size_t index)
+{
+    if (!isActive()) {
+        return;
+    }
+    const size_t mask = mSlotCount - 1;
+    size_t pos = getSlot(hash);
+    for (; mSlots[pos].mPage != nullptr; pos = (pos + 1) & mask) {
+        if (mSlots[pos].mPage == page && mSlots[pos].mIndex == index && mSlots[pos].mHash == hash) {
+            break;
+        }
+    }
+    if (mSlots[pos].mPage == nullptr) {
+        return;
+    }
+    // shift back the following slots of the probe sequence, so that no tombstones are needed
+    size_t hole = pos;
+    for (size_t next = (hole + 1) & mask; mSlots[next].mPage != nullptr; next = (next + 1) & mask) {
+        size_t home = getSlot(mSlots[next].mHash);
+        bool canMove = (hole <= next) ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (canMove) {
+            mSlots[hole] = mSlots[next];
+            hole = next;
+        }
+    }
+    mSlots[hole].mPage = nullptr;
+    --mCount;
+}
+
+size_t ItemIndex::find(uint32_t hash, Candidate* dst, size_t maxCount) const
+{
+    size_t count = 0;
+    if (!isActive()) {
+        return 0;
+    }
+    for (size_t pos = getSlot(hash); mSlots[pos].mPage != nullptr; pos = (pos + 1) & (mSlotCount - 1)) {
+        const Slot& slot = mSlots[pos];
+        if (slot.mHash != hash) {
+            continue;
+        }
+        size_t i;
+        for (i = 0; i < count; ++i) {
+            if (dst[i].page == slot.mPage) {
+                if (slot.mIndex < dst[i].index) {
+                    dst[i].index = slot.mIndex;
+                }
+                break;
+            }
+        }
+        if (i < count) {
+            continue;
+        }
+        if (count == maxCount) {
+            return SIZE_MAX;
+        }
+        dst[count].page = slot.mPage;
+        dst[count].index = slot.mIndex;
+        ++count;
+    }
+    return count;
+}
+
+} // namespace nvs
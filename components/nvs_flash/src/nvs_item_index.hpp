@@ -0,0 +1,112 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_item_index_hpp
+#define nvs_item_index_hpp
+
+#include <cstdint>
+#include <cstddef>
+
+namespace nvs
+{
+
+class Page;
+
+/**
+ * Partition-wide index of items, mapping item hash to (page, entry index).
+ *
+ * The index mirrors the contents of the hash lists of all pages of one partition:
+ * each HashList attached to the index forwards its insertions and removals here.
+ * Hashes are the same 24-bit values as used by HashList, so different items may
+ * share a hash; callers have to verify candidates by reading the item from the page.
+ *
+ * The table uses open addressing with linear probing. It grows on demand up to
+ * the maximum number of items given to reset(). If that limit is exceeded,
+ * the index disables itself until the next reset() and callers have to fall back
+ * to searching the pages one by one.
+ */
+class ItemIndex
+{
+public:
+    struct Candidate {
+        Page* page;
+        size_t index;
+    };
+
+    ItemIndex() {}
+    ~ItemIndex();
+
+    /* Drop all items and set the limit on number of indexed items; 0 disables the index */
+    void reset(size_t maxItems);
+
+    bool isActive() const
+    {
+        return mSlots != nullptr;
+    }
+
+    size_t size() const
+    {
+        return mCount;
+    }
+
+    size_t getCapacity() const
+    {
+        return mSlotCount;
+    }
+
+    void insert(uint32_t hash, Page* page, size_t index);
+
+    void erase(uint32_t hash, Page* page, size_t index);
+
+    /**
+     * Find the pages which contain an item with given hash.
+     *
+     * For each page, the lowest entry index with this hash is returned.
+     * Returns the number of pages written into dst, or SIZE_MAX if there are
+     * more than maxCount such pages.
+     */
+    size_t find(uint32_t hash, Candidate* dst, size_t maxCount) const;
+
+private:
+    ItemIndex(const ItemIndex& other);
+    const ItemIndex& operator= (const ItemIndex& rhs);
+
+protected:
+    struct Slot {
+        Page* mPage;            // nullptr if slot is empty
+        uint32_t mHash  : 24;
+        uint32_t mIndex : 8;
+    };
+
+    static const size_t MIN_SLOT_COUNT = 64;
+
+    size_t getSlot(uint32_t hash) const
+    {
+        // low bits of a CRC are well distributed already
+        return hash & (mSlotCount - 1);
+    }
+
+    bool resize(size_t slotCount);
+
+    void disable();
+
+    Slot* mSlots = nullptr;
+    size_t mSlotCount = 0;
+    size_t mCount = 0;
+    size_t mMaxItems = 0;
+}; // class ItemIndex
+
+} // namespace nvs
+
+#endif /* nvs_item_index_hpp */
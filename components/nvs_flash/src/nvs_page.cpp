@@ -12,13 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "nvs_page.hpp"
-#if defined(ESP_PLATFORM)
-#include <rom/crc.h>
-#else
-#include "crc.h"
-#endif
+#include "esp_crc.h"
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 
 #include "nvs_ops.hpp"
 
@@ -27,12 +24,12 @@ namespace nvs
 
 uint32_t Page::Header::calculateCrc32()
 {
-    return crc32_le(0xffffffff,
-                    reinterpret_cast<uint8_t*>(this) + offsetof(Header, mSeqNumber),
-                    offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
+    return esp_crc32_le(0xffffffff,
+                        reinterpret_cast<uint8_t*>(this) + offsetof(Header, mSeqNumber),
+                        offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
 }
 
-esp_err_t Page::load(uint32_t sectorNumber)
+esp_err_t Page::load(uint32_t sectorNumber, LoadListener* listener)
 {
     mBaseAddress = sectorNumber * SEC_SIZE;
     mUsedEntryCount = 0;
@@ -83,7 +80,7 @@ esp_err_t Page::load(uint32_t sectorNumber)
     case PageState::FULL:
     case PageState::ACTIVE:
     case PageState::FREEING:
-        mLoadEntryTable();
+        mLoadEntryTable(listener);
         break;
 
     default:
@@ -257,7 +254,96 @@ esp_err_t Page::writeItem(uint8_t nsIndex, ItemType datatype, const char* key, c
     return ESP_OK;
 }
 
+size_t Page::getItemEntryCount(ItemType datatype, size_t dataSize)
+{
+    if (!isVariableLengthType(datatype)) {
+        return 1;
+    }
+    return 1 + (dataSize + ENTRY_SIZE - 1) / ENTRY_SIZE;
+}
+
+void Page::fillItemEntries(Item* entries, uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx)
+{
+    const size_t span = getItemEntryCount(datatype, dataSize);
+    Item& item = entries[0];
+    item = Item(nsIndex, datatype, span, key, chunkIdx);
+    if (!isVariableLengthType(datatype)) {
+        assert(dataSize <= sizeof(item.data));
+        memcpy(item.data, data, dataSize);
+    } else {
+        item.varLength.dataCrc32 = Item::calculateCrc32(static_cast<const uint8_t*>(data), dataSize);
+        item.varLength.dataSize = dataSize;
+        item.varLength.reserved = 0xffff;
+        uint8_t* dst = entries[1].rawData;
+        memcpy(dst, data, dataSize);
+        std::fill_n(dst + dataSize, (span - 1) * ENTRY_SIZE - dataSize, 0xff);
+    }
+    item.crc32 = item.calculateCrc32();
+}
+
+esp_err_t Page::writeItems(const Item* entries, size_t count)
+{
+    esp_err_t err;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    if (mState == PageState::UNINITIALIZED) {
+        err = initialize();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (mState == PageState::FULL) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    assert(count > 0);
+    if (mNextFreeEntry == INVALID_ENTRY || mNextFreeEntry + count > ENTRY_COUNT) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    const size_t first = mNextFreeEntry;
+    err = nvs_flash_write(getEntryAddress(first), entries, count * ENTRY_SIZE);
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
+    }
+
+    // Entry state words are written starting from the last one. Until the word which holds
+    // the first entry is written, mLoadEntryTable treats all of these entries as half-written.
+    err = alterEntryRangeState(first, first + count, EntryState::WRITTEN);
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
+    }
+
+    for (size_t i = 0; i < count; i += entries[i].span) {
+        assert(entries[i].span > 0);
+        mHashList.insert(entries[i], first + i);
+    }
+
+    if (mFirstUsedEntry == INVALID_ENTRY) {
+        mFirstUsedEntry = first;
+    }
+    mUsedEntryCount += count;
+    mNextFreeEntry += count;
+    return ESP_OK;
+}
+
 esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    return readItemImpl(nsIndex, datatype, key, data, dataSize, chunkIdx, chunkStart, true);
+}
+
+esp_err_t Page::readItemNoRepair(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    return readItemImpl(nsIndex, datatype, key, data, dataSize, chunkIdx, chunkStart, false);
+}
+
+esp_err_t Page::readItemImpl(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart, bool repair)
 {
     size_t index = 0;
     Item item;
@@ -266,7 +352,7 @@ esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, vo
         return ESP_ERR_NVS_INVALID_STATE;
     }
 
-    esp_err_t rc = findItem(nsIndex, datatype, key, index, item, chunkIdx, chunkStart);
+    esp_err_t rc = findItemImpl(nsIndex, datatype, key, index, item, chunkIdx, chunkStart, repair);
     if (rc != ESP_OK) {
         return rc;
     }
@@ -299,10 +385,67 @@ esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, vo
         dst += willCopy;
     }
     if (Item::calculateCrc32(reinterpret_cast<uint8_t*>(data), item.varLength.dataSize) != item.varLength.dataCrc32) {
-        rc = eraseEntryAndSpan(index);
+        if (repair) {
+            rc = eraseEntryAndSpan(index);
+            if (rc != ESP_OK) {
+                return rc;
+            }
+        }
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Page::readItemData(uint8_t nsIndex, ItemType datatype, const char* key, size_t offset, void* data, size_t dataSize, bool verifyCrc, uint8_t chunkIdx)
+{
+    size_t index = 0;
+    Item item;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    if (!isVariableLengthType(datatype)) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+
+    esp_err_t rc = findItemImpl(nsIndex, datatype, key, index, item, chunkIdx, VerOffset::VER_ANY, false);
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
+    const size_t valueSize = item.varLength.dataSize;
+    if (offset > valueSize || dataSize > valueSize - offset) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    size_t first = offset / ENTRY_SIZE;
+    size_t last = (offset + dataSize + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    if (verifyCrc) {
+        first = 0;
+        last = (valueSize + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    }
+
+    uint8_t* dst = reinterpret_cast<uint8_t*>(data);
+    uint32_t crc = 0xffffffff;
+    for (size_t i = first; i < last; ++i) {
+        Item ditem;
+        rc = readEntry(index + 1 + i, ditem);
         if (rc != ESP_OK) {
             return rc;
         }
+        const size_t entryStart = i * ENTRY_SIZE;
+        const size_t entryEnd = std::min(entryStart + ENTRY_SIZE, valueSize);
+        if (verifyCrc) {
+            crc = esp_crc32_le(crc, ditem.rawData, entryEnd - entryStart);
+        }
+        const size_t copyStart = std::max(entryStart, offset);
+        const size_t copyEnd = std::min(entryEnd, offset + dataSize);
+        if (copyStart < copyEnd) {
+            memcpy(dst + (copyStart - offset), ditem.rawData + (copyStart - entryStart), copyEnd - copyStart);
+        }
+    }
+    if (verifyCrc && crc != item.varLength.dataCrc32) {
         return ESP_ERR_NVS_NOT_FOUND;
     }
     return ESP_OK;
@@ -404,13 +547,6 @@ esp_err_t Page::copyItems(Page& other)
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
-    if (other.mState == PageState::UNINITIALIZED) {
-        auto err = other.initialize();
-        if (err != ESP_OK) {
-            return err;
-        }
-    }
-
     Item entry;
     size_t readEntryIndex = mFirstUsedEntry;
 
@@ -426,30 +562,45 @@ esp_err_t Page::copyItems(Page& other)
             return err;
         }
 
-        other.mHashList.insert(entry, other.mNextFreeEntry);
-        err = other.writeEntry(entry);
+        err = copyItem(readEntryIndex, entry, other);
         if (err != ESP_OK) {
             return err;
         }
-        size_t span = entry.span;
-        size_t end = readEntryIndex + span;
-
-        assert(end <= ENTRY_COUNT);
+        readEntryIndex += entry.span;
+    }
+    return ESP_OK;
+}
 
-        for (size_t i = readEntryIndex + 1; i < end; ++i) {
-            readEntry(i, entry);
-            err = other.writeEntry(entry);
-            if (err != ESP_OK) {
-                return err;
-            }
+esp_err_t Page::copyItem(size_t index, const Item& header, Page& other)
+{
+    if (other.mState == PageState::UNINITIALIZED) {
+        auto err = other.initialize();
+        if (err != ESP_OK) {
+            return err;
         }
-        readEntryIndex = end;
+    }
+
+    other.mHashList.insert(header, other.mNextFreeEntry);
+    auto err = other.writeEntry(header);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t end = index + header.span;
+
+    assert(end <= ENTRY_COUNT);
 
+    Item entry;
+    for (size_t i = index + 1; i < end; ++i) {
+        readEntry(i, entry);
+        err = other.writeEntry(entry);
+        if (err != ESP_OK) {
+            return err;
+        }
     }
     return ESP_OK;
 }
 
-esp_err_t Page::mLoadEntryTable()
+esp_err_t Page::mLoadEntryTable(LoadListener* listener)
 {
     // for states where we actually care about data in the page, read entry state table
     if (mState == PageState::ACTIVE ||
@@ -486,6 +637,7 @@ esp_err_t Page::mLoadEntryTable()
                 break;
             }
         }
+        const size_t firstFreeEntry = mNextFreeEntry;
 
         // however, if power failed after some data was written into the entry.
         // but before the entry state table was altered, the entry locacted via
@@ -517,6 +669,17 @@ esp_err_t Page::mLoadEntryTable()
             }
         }
 
+        // Items committed by writeItems may contain data entries which start with a blank word,
+        // so the loop above can stop in the middle of such a group of entries. If it has dropped
+        // a half-written entry, discard everything which was written after it as well.
+        if (mNextFreeEntry != firstFreeEntry && mNextFreeEntry < ENTRY_COUNT) {
+            auto err = eraseHalfWrittenTail();
+            if (err != ESP_OK) {
+                mState = PageState::INVALID;
+                return err;
+            }
+        }
+
         // check that all variable-length items are written or erased fully
         Item item;
         size_t lastItemIndex = INVALID_ENTRY;
@@ -577,6 +740,10 @@ esp_err_t Page::mLoadEntryTable()
             if (duplicateIndex < i) {
                 eraseEntryAndSpan(duplicateIndex);
             }
+
+            if (listener) {
+                listener->itemLoaded(*this, i, item);
+            }
         }
 
         // check that last item is not duplicate
@@ -622,16 +789,22 @@ esp_err_t Page::mLoadEntryTable()
             mHashList.insert(item, i);
 
             size_t span = item.span;
+            bool erased = false;
 
             if (isVariableLengthType(item.datatype)) {
                 for (size_t j = i + 1; j < i + span; ++j) {
                     if (mEntryTable.get(j) != EntryState::WRITTEN) {
                         eraseEntryAndSpan(i);
+                        erased = true;
                         break;
                     }
                 }
             }
 
+            if (listener && !erased) {
+                listener->itemLoaded(*this, i, item);
+            }
+
             i += span - 1;
         }
 
@@ -641,6 +814,36 @@ esp_err_t Page::mLoadEntryTable()
 }
 
 
+esp_err_t Page::eraseHalfWrittenTail()
+{
+    uint32_t words[ENTRY_SIZE / sizeof(uint32_t)];
+    size_t end = mNextFreeEntry;
+    for (size_t i = mNextFreeEntry; i < ENTRY_COUNT; ++i) {
+        auto rc = spi_flash_read(getEntryAddress(i), words, sizeof(words));
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        if (std::any_of(std::begin(words), std::end(words), [](uint32_t w) { return w != 0xffffffff; })) {
+            end = i + 1;
+        }
+    }
+    if (end == mNextFreeEntry) {
+        return ESP_OK;
+    }
+    for (size_t i = mNextFreeEntry; i < end; ++i) {
+        if (mEntryTable.get(i) == EntryState::WRITTEN) {
+            --mUsedEntryCount;
+        }
+        ++mErasedEntryCount;
+    }
+    auto err = alterEntryRangeState(mNextFreeEntry, end, EntryState::ERASED);
+    if (err != ESP_OK) {
+        return err;
+    }
+    mNextFreeEntry = end;
+    return ESP_OK;
+}
+
 esp_err_t Page::initialize()
 {
     assert(mState == PageState::UNINITIALIZED);
@@ -725,6 +928,16 @@ esp_err_t Page::readEntry(size_t index, Item& dst) const
 }
 
 esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    return findItemImpl(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart, true);
+}
+
+esp_err_t Page::findItemNoRepair(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    return findItemImpl(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart, false);
+}
+
+esp_err_t Page::findItemImpl(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart, bool repair)
 {
     if (mState == PageState::CORRUPT || mState == PageState::INVALID || mState == PageState::UNINITIALIZED) {
         return ESP_ERR_NVS_NOT_FOUND;
@@ -763,12 +976,17 @@ esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, si
 
         auto rc = readEntry(i, item);
         if (rc != ESP_OK) {
-            mState = PageState::INVALID;
+            if (repair) {
+                mState = PageState::INVALID;
+            }
             return rc;
         }
 
         auto crc32 = item.calculateCrc32();
         if (item.crc32 != crc32) {
+            if (!repair) {
+                continue;
+            }
             rc = eraseEntryAndSpan(i);
             if (rc != ESP_OK) {
                 mState = PageState::INVALID;
@@ -895,6 +1113,16 @@ size_t Page::getVarDataTailroom() const
     return ((mNextFreeEntry < (ENTRY_COUNT-1)) ? ((ENTRY_COUNT - mNextFreeEntry - 1) * ENTRY_SIZE): 0);
 }
 
+size_t Page::getFreeEntryCount() const
+{
+    if (mState == PageState::UNINITIALIZED) {
+        return ENTRY_COUNT;
+    } else if (mState != PageState::ACTIVE || mNextFreeEntry > ENTRY_COUNT) {
+        return 0;
+    }
+    return ENTRY_COUNT - mNextFreeEntry;
+}
+
 const char* Page::pageStateToName(PageState ps)
 {
     switch (ps) {
@@ -28,6 +28,23 @@
 namespace nvs
 {
 
+class Page;
+
+/**
+ * Receives the items of pages while they are being loaded, so that information
+ * about all items can be collected without scanning the pages again.
+ *
+ * Only items which passed the checks done while loading are reported. An item
+ * may still be erased later during loading, e.g. when it turns out to be a
+ * stale copy of an item which was being updated when power went off.
+ */
+class LoadListener
+{
+public:
+    virtual ~LoadListener() {}
+
+    virtual void itemLoaded(Page& page, size_t index, const Item& item) = 0;
+};
 
 class Page : public intrusive_list_node<Page>
 {
@@ -82,7 +99,7 @@ public:
         return mState;
     }
 
-    esp_err_t load(uint32_t sectorNumber);
+    esp_err_t load(uint32_t sectorNumber, LoadListener* listener = nullptr);
 
     esp_err_t getSeqNumber(uint32_t& seqNumber) const;
 
@@ -100,6 +117,27 @@ public:
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    /* Variants of findItem and readItem which don't modify the page, so that several tasks may call
+     * them at the same time. Items which fail the CRC check are skipped instead of being erased. */
+    esp_err_t findItemNoRepair(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+
+    esp_err_t readItemNoRepair(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+
+    /* Read dataSize bytes starting at offset from the value of a variable length item, without
+     * modifying the page. Only the entries which hold these bytes are read, unless verifyCrc is
+     * set, in which case all entries of the item are read to check the CRC of the whole value. */
+    esp_err_t readItemData(uint8_t nsIndex, ItemType datatype, const char* key, size_t offset, void* data, size_t dataSize, bool verifyCrc, uint8_t chunkIdx = CHUNK_ANY);
+
+    /* Write entries prepared with fillItemEntries using a single flash write. The items become
+     * valid at once, when the entry state word holding the first entry is written. */
+    esp_err_t writeItems(const Item* entries, size_t count);
+
+    /* Number of entries taken by an item, including the header entry */
+    static size_t getItemEntryCount(ItemType datatype, size_t dataSize);
+
+    /* Fill getItemEntryCount(datatype, dataSize) entries, formatted the same way as by writeItem */
+    static void fillItemEntries(Item* entries, uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY);
+
     template<typename T>
     esp_err_t writeItem(uint8_t nsIndex, const char* key, const T& value)
     {
@@ -129,18 +167,28 @@ public:
     }
     size_t getVarDataTailroom() const ;
 
+    size_t getFreeEntryCount() const;
+
     esp_err_t markFull();
 
     esp_err_t markFreeing();
 
     esp_err_t copyItems(Page& other);
 
+    /* Append the item whose header entry is at the given index to the other page */
+    esp_err_t copyItem(size_t index, const Item& header, Page& other);
+
     esp_err_t erase();
 
     void debugDump() const;
 
     esp_err_t calcEntries(nvs_stats_t &nvsStats);
 
+    void setItemIndex(ItemIndex* itemIndex)
+    {
+        mHashList.setItemIndex(itemIndex, this);
+    }
+
 protected:
 
     class Header
@@ -167,7 +215,13 @@ protected:
         INVALID = 0x4 // entry is in inconsistent state (write started but ESB_WRITTEN has not been set yet)
     };
 
-    esp_err_t mLoadEntryTable();
+    esp_err_t mLoadEntryTable(LoadListener* listener);
+
+    esp_err_t findItemImpl(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart, bool repair);
+
+    esp_err_t readItemImpl(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart, bool repair);
+
+    esp_err_t eraseHalfWrittenTail();
 
     esp_err_t initialize();
 
@@ -222,6 +276,7 @@ protected:
     static_assert(sizeof(Header) == 32, "header size must be 32 bytes");
     static_assert(ENTRY_TABLE_OFFSET % 32 == 0, "entry table offset should be aligned");
     static_assert(ENTRY_DATA_OFFSET % 32 == 0, "entry data offset should be aligned");
+    static_assert(ENTRY_COUNT == HashList::MAX_ITEMS, "hash list should fit all entries of a page");
 
 }; // class Page
 
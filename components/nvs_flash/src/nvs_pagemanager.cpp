@@ -15,7 +15,7 @@
 
 namespace nvs
 {
-esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
+esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount, ItemIndex* index, LoadListener* listener)
 {
     mBaseSector = baseSector;
     mPageCount = sectorCount;
@@ -23,8 +23,11 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
     mFreePageList.clear();
     mPages.reset(new Page[sectorCount]);
 
+    std::unique_ptr<Page*[]> usedPages(new Page*[sectorCount]);
+    size_t usedPageCount = 0;
     for (uint32_t i = 0; i < sectorCount; ++i) {
-        auto err = mPages[i].load(baseSector + i);
+        mPages[i].setItemIndex(index);
+        auto err = mPages[i].load(baseSector + i, listener);
         if (err != ESP_OK) {
             return err;
         }
@@ -32,18 +35,21 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
         if (mPages[i].getSeqNumber(seqNumber) != ESP_OK) {
             mFreePageList.push_back(&mPages[i]);
         } else {
-            auto pos = std::find_if(std::begin(mPageList), std::end(mPageList), [=](const Page& page) -> bool {
-                uint32_t otherSeqNumber;
-                return page.getSeqNumber(otherSeqNumber) == ESP_OK && otherSeqNumber > seqNumber;
-            });
-            if (pos == mPageList.end()) {
-                mPageList.push_back(&mPages[i]);
-            } else {
-                mPageList.insert(pos, &mPages[i]);
-            }
+            usedPages[usedPageCount++] = &mPages[i];
         }
     }
 
+    // order pages by sequence number; stable sort keeps sector order for equal numbers
+    std::stable_sort(usedPages.get(), usedPages.get() + usedPageCount, [](const Page* a, const Page* b) -> bool {
+        uint32_t seqA, seqB;
+        a->getSeqNumber(seqA);
+        b->getSeqNumber(seqB);
+        return seqA < seqB;
+    });
+    for (size_t i = 0; i < usedPageCount; ++i) {
+        mPageList.push_back(usedPages[i]);
+    }
+
     if (mPageList.empty()) {
         mSeqNumber = 0;
         return activatePage();
@@ -54,18 +60,16 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
     }
 
     // if power went out after a new item for the given key was written,
-    // but before the old one was erased, we end up with a duplicate item
+    // but before the old one was erased, we end up with a duplicate item.
+    // New items are always written to the last page. Normally only the last item
+    // there can have a stale copy, but after an interrupted transaction commit
+    // any of them can, so check all items of the last page.
     Page& lastPage = back();
-    size_t lastItemIndex = SIZE_MAX;
+    auto last = PageManager::TPageListIterator(&lastPage);
     Item item;
     size_t itemIndex = 0;
     while (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
         itemIndex += item.span;
-        lastItemIndex = itemIndex;
-    }
-
-    if (lastItemIndex != SIZE_MAX) {
-        auto last = PageManager::TPageListIterator(&lastPage);
         TPageListIterator it;
 
         for (it = begin(); it != last; ++it) {
@@ -85,40 +89,16 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
                     break;
                 }
             }
-        } 
+        }
     }
 
     // check if power went out while page was being freed
     for (auto it = begin(); it!= end(); ++it) {
         if (it->state() == Page::PageState::FREEING) {
-            Page* newPage = &mPageList.back();
-            if (newPage->state() == Page::PageState::ACTIVE) {
-                auto err = newPage->erase();
-                if (err != ESP_OK) {
-                    return err;
-                }
-                mPageList.erase(newPage);
-                mFreePageList.push_back(newPage);
-            }
-            auto err = activatePage();
+            auto err = resumeFreeing(*it, listener);
             if (err != ESP_OK) {
                 return err;
             }
-            newPage = &mPageList.back();
-
-            err = it->copyItems(*newPage);
-            if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-                return err;
-            }
-
-            err = it->erase();
-            if (err != ESP_OK) {
-                return err;
-            }
-
-            Page* p = static_cast<Page*>(it);
-            mPageList.erase(it);
-            mFreePageList.push_back(p);
             break;
         }
     }
@@ -194,6 +174,146 @@ esp_err_t PageManager::requestNewPage()
     return ESP_OK;
 }
 
+esp_err_t PageManager::reclaimPage()
+{
+    if (mFreePageList.size() >= NVS_GC_FREE_PAGES || mPageList.empty()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    // items are moved to the active page, so that no free page is used up
+    Page* activePage = &mPageList.back();
+    size_t room = activePage->getFreeEntryCount();
+
+    // find the page with the highest number of unused entries among those whose items fit
+    Page* erasedPage = nullptr;
+    size_t maxUnusedItems = 0;
+    for (auto it = begin(); it != end(); ++it) {
+        if (it->state() != Page::PageState::FULL || static_cast<Page*>(it) == activePage) {
+            continue;
+        }
+        size_t used = it->getUsedEntryCount();
+        if (used <= room && Page::ENTRY_COUNT - used > maxUnusedItems) {
+            erasedPage = it;
+            maxUnusedItems = Page::ENTRY_COUNT - used;
+        }
+    }
+
+    if (erasedPage == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+#ifndef NDEBUG
+    size_t usedEntries = activePage->getUsedEntryCount() + erasedPage->getUsedEntryCount();
+#endif
+    auto err = erasedPage->markFreeing();
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = erasedPage->copyItems(*activePage);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        return err;
+    }
+
+    err = erasedPage->erase();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+#ifndef NDEBUG
+    assert(usedEntries == activePage->getUsedEntryCount());
+#endif
+
+    mPageList.erase(erasedPage);
+    mFreePageList.push_back(erasedPage);
+
+    return ESP_OK;
+}
+
+esp_err_t PageManager::resumeFreeing(Page& page, LoadListener* listener)
+{
+    /* Items are copied either to a page activated for this purpose (requestNewPage) or to the
+     * page which was active at that time (reclaimPage). Either way it is the last page if it has
+     * been written to. In the first case the page holds nothing but copies, so it is erased and
+     * copying starts over. In the second case copying continues where it stopped: keys are unique
+     * across pages other than the one being freed, so an item found on another page is a copy. */
+    Page* newPage = &mPageList.back();
+    if (newPage->state() == Page::PageState::ACTIVE && holdsCopiesOnly(*newPage, page)) {
+        auto err = newPage->erase();
+        if (err != ESP_OK) {
+            return err;
+        }
+        mPageList.erase(newPage);
+        mFreePageList.push_back(newPage);
+        newPage = &mPageList.back();
+    }
+    if (newPage->state() != Page::PageState::ACTIVE) {
+        auto err = activatePage();
+        if (err != ESP_OK) {
+            return err;
+        }
+        newPage = &mPageList.back();
+    }
+
+    Item item;
+    size_t itemIndex = 0;
+    while (page.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+        size_t index = itemIndex;
+        itemIndex += item.span;
+
+        bool copied = false;
+        for (auto it = begin(); it != end() && !copied; ++it) {
+            copied = (static_cast<Page*>(it) != &page) && (it->findItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK);
+        }
+        if (copied) {
+            continue;
+        }
+
+        // entries of an item which was being copied when power went out are lost
+        if (newPage->getFreeEntryCount() < item.span) {
+            auto err = newPage->markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+            err = activatePage();
+            if (err != ESP_OK) {
+                return err;
+            }
+            newPage = &mPageList.back();
+        }
+
+        size_t newIndex = (newPage->state() == Page::PageState::UNINITIALIZED) ? 0 : Page::ENTRY_COUNT - newPage->getFreeEntryCount();
+        auto err = page.copyItem(index, item, *newPage);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (listener) {
+            listener->itemLoaded(*newPage, newIndex, item);
+        }
+    }
+
+    auto err = page.erase();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    mPageList.erase(&page);
+    mFreePageList.push_back(&page);
+    return ESP_OK;
+}
+
+bool PageManager::holdsCopiesOnly(Page& page, Page& freeingPage)
+{
+    Item item;
+    size_t itemIndex = 0;
+    while (page.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+        itemIndex += item.span;
+        if (freeingPage.findItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) != ESP_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
 esp_err_t PageManager::activatePage()
 {
     if (mFreePageList.empty()) {
@@ -20,6 +20,13 @@
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
 #include "intrusive_list.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_NVS_GC_FREE_PAGES
+#define NVS_GC_FREE_PAGES CONFIG_NVS_GC_FREE_PAGES
+#else
+#define NVS_GC_FREE_PAGES 2
+#endif
 
 namespace nvs
 {
@@ -31,7 +38,7 @@ public:
 
     PageManager() {}
 
-    esp_err_t load(uint32_t baseSector, uint32_t sectorCount);
+    esp_err_t load(uint32_t baseSector, uint32_t sectorCount, ItemIndex* index = nullptr, LoadListener* listener = nullptr);
 
     TPageListIterator begin()
     {
@@ -54,6 +61,12 @@ public:
 
     esp_err_t requestNewPage();
 
+    /* Free one page ahead of time by moving its items to the active page, unless there are
+     * NVS_GC_FREE_PAGES free pages already. With at least two free pages, requestNewPage doesn't
+     * have to erase anything. Copies at most one page and erases one sector.
+     * Returns ESP_ERR_NVS_NOT_FOUND if no page was freed. */
+    esp_err_t reclaimPage();
+
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
     uint32_t getBaseSector()
@@ -66,6 +79,10 @@ protected:
 
     esp_err_t activatePage();
 
+    esp_err_t resumeFreeing(Page& page, LoadListener* listener);
+
+    static bool holdsCopiesOnly(Page& page, Page& freeingPage);
+
     TPageList mPageList;
     TPageList mFreePageList;
     std::unique_ptr<Page[]> mPages;
@@ -14,6 +14,7 @@
 #ifndef nvs_platform_h
 #define nvs_platform_h
 
+#include "esp_err.h"
 
 #ifdef ESP_PLATFORM
 #include "freertos/FreeRTOS.h"
@@ -22,60 +23,261 @@
 namespace nvs
 {
 
-class Lock
+/**
+ * Lock which can be held by any number of readers at once, or by a single writer.
+ *
+ * A writer waiting for the lock keeps new readers out, so that a steady stream of
+ * readers can't starve it. Until init() succeeds, all methods do nothing.
+ */
+class ReadWriteLock
 {
 public:
-    Lock()
+    ReadWriteLock() {}
+
+    ~ReadWriteLock()
     {
-        if (mSemaphore) {
-            xSemaphoreTake(mSemaphore, portMAX_DELAY);
+        uninit();
+    }
+
+    esp_err_t init()
+    {
+        if (mTurnstile) {
+            return ESP_OK;
         }
+        mTurnstile = xSemaphoreCreateMutex();
+        mReaderMutex = xSemaphoreCreateMutex();
+        mRoomEmpty = xSemaphoreCreateBinary();
+        if (!mTurnstile || !mReaderMutex || !mRoomEmpty) {
+            uninit();
+            return ESP_ERR_NO_MEM;
+        }
+        xSemaphoreGive(mRoomEmpty);
+        return ESP_OK;
     }
 
-    ~Lock()
+    void uninit()
     {
-        if (mSemaphore) {
-            xSemaphoreGive(mSemaphore);
+        if (mTurnstile) {
+            vSemaphoreDelete(mTurnstile);
         }
+        if (mReaderMutex) {
+            vSemaphoreDelete(mReaderMutex);
+        }
+        if (mRoomEmpty) {
+            vSemaphoreDelete(mRoomEmpty);
+        }
+        mTurnstile = nullptr;
+        mReaderMutex = nullptr;
+        mRoomEmpty = nullptr;
+        mReaders = 0;
     }
 
-    static esp_err_t init()
+    void lock()
     {
-        if (mSemaphore) {
-            return ESP_OK;
+        if (mTurnstile) {
+            xSemaphoreTake(mTurnstile, portMAX_DELAY);
+            xSemaphoreTake(mRoomEmpty, portMAX_DELAY);
         }
-        mSemaphore = xSemaphoreCreateMutex();
-        if (!mSemaphore) {
-            return ESP_ERR_NO_MEM;
+    }
+
+    void unlock()
+    {
+        if (mTurnstile) {
+            xSemaphoreGive(mRoomEmpty);
+            xSemaphoreGive(mTurnstile);
         }
-        return ESP_OK;
     }
 
-    static void uninit()
+    void lockShared()
     {
-        if (mSemaphore) {
-            vSemaphoreDelete(mSemaphore);
+        if (mTurnstile) {
+            xSemaphoreTake(mTurnstile, portMAX_DELAY);
+            xSemaphoreGive(mTurnstile);
+            xSemaphoreTake(mReaderMutex, portMAX_DELAY);
+            if (++mReaders == 1) {
+                xSemaphoreTake(mRoomEmpty, portMAX_DELAY);
+            }
+            xSemaphoreGive(mReaderMutex);
         }
-        mSemaphore = nullptr;
     }
 
-    static SemaphoreHandle_t mSemaphore;
+    void unlockShared()
+    {
+        if (mTurnstile) {
+            xSemaphoreTake(mReaderMutex, portMAX_DELAY);
+            if (--mReaders == 0) {
+                xSemaphoreGive(mRoomEmpty);
+            }
+            xSemaphoreGive(mReaderMutex);
+        }
+    }
+
+protected:
+    ReadWriteLock(const ReadWriteLock& other);
+    const ReadWriteLock& operator= (const ReadWriteLock& rhs);
+
+    SemaphoreHandle_t mTurnstile = nullptr;     // held by a writer while it waits for the lock and while it holds it
+    SemaphoreHandle_t mReaderMutex = nullptr;   // protects mReaders
+    SemaphoreHandle_t mRoomEmpty = nullptr;     // binary semaphore, taken by a writer or by the first reader
+    size_t mReaders = 0;
 };
+
 } // namespace nvs
 
 #else // ESP_PLATFORM
+#include <mutex>
+#include <condition_variable>
+
 namespace nvs
 {
-class Lock
+
+class ReadWriteLock
 {
 public:
-    Lock() { }
-    ~Lock() { }
-    static void init() {}
-    static void uninit() {}
+    ReadWriteLock() {}
+
+    esp_err_t init()
+    {
+        return ESP_OK;
+    }
+
+    void uninit() {}
+
+    void lock()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        ++mWaitingWriters;
+        mCondition.wait(lock, [this]() { return !mWriter && mReaders == 0; });
+        --mWaitingWriters;
+        mWriter = true;
+    }
+
+    void unlock()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mWriter = false;
+        }
+        mCondition.notify_all();
+    }
+
+    void lockShared()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]() { return !mWriter && mWaitingWriters == 0; });
+        ++mReaders;
+    }
+
+    void unlockShared()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mReaders;
+        }
+        mCondition.notify_all();
+    }
+
+protected:
+    ReadWriteLock(const ReadWriteLock& other);
+    const ReadWriteLock& operator= (const ReadWriteLock& rhs);
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    size_t mReaders = 0;
+    size_t mWaitingWriters = 0;
+    bool mWriter = false;
 };
+
 } // namespace nvs
 #endif // ESP_PLATFORM
 
+namespace nvs
+{
+
+/* Holds a ReadWriteLock for reading while in scope */
+class ReadLock
+{
+public:
+    explicit ReadLock(ReadWriteLock& lock) : mLock(lock)
+    {
+        mLock.lockShared();
+    }
+
+    ~ReadLock()
+    {
+        mLock.unlockShared();
+    }
+
+protected:
+    ReadWriteLock& mLock;
+};
+
+/* Holds a ReadWriteLock for writing while in scope */
+class WriteLock
+{
+public:
+    explicit WriteLock(ReadWriteLock& lock) : mLock(lock)
+    {
+        mLock.lock();
+    }
+
+    ~WriteLock()
+    {
+        mLock.unlock();
+    }
+
+protected:
+    ReadWriteLock& mLock;
+};
+
+/**
+ * Holds the lock which protects the lists of partitions and of open handles exclusively while in scope.
+ *
+ * Taken when partitions are initialized or deinitialized and when handles are opened or closed.
+ * Operations on an open handle take it with SharedLock instead, together with the lock of
+ * the partition the handle belongs to, so that they only exclude each other within one partition.
+ */
+class Lock
+{
+public:
+    Lock()
+    {
+        sLock.lock();
+    }
+
+    ~Lock()
+    {
+        sLock.unlock();
+    }
+
+    static esp_err_t init()
+    {
+        return sLock.init();
+    }
+
+    static void uninit()
+    {
+        sLock.uninit();
+    }
+
+    static ReadWriteLock sLock;
+};
+
+/* Holds the lock of the lists of partitions and of open handles for reading while in scope */
+class SharedLock
+{
+public:
+    SharedLock()
+    {
+        Lock::sLock.lockShared();
+    }
+
+    ~SharedLock()
+    {
+        Lock::sLock.unlockShared();
+    }
+};
+
+} // namespace nvs
 
 #endif /* nvs_platform_h */
@@ -0,0 +1,145 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_read_cache.hpp"
+#include <cstring>
+#include <new>
+
+namespace nvs
+{
+
+ReadCache::~ReadCache()
+{
+    clear();
+}
+
+void ReadCache::reset(size_t budget)
+{
+    clear();
+    mBudget = budget;
+    mHits = 0;
+    mMisses = 0;
+}
+
+ReadCache::Entry* ReadCache::find(uint8_t nsIndex, ItemType datatype, const char* key)
+{
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->nsIndex == nsIndex && it->datatype == datatype &&
+                strncmp(it->key, key, sizeof(it->key)) == 0) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+bool ReadCache::read(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize)
+{
+    Entry* entry = find(nsIndex, datatype, key);
+    if (!entry || entry->dataSize != dataSize) {
+        ++mMisses;
+        return false;
+    }
+    if (entry != &mEntries.front()) {
+        mEntries.erase(entry);
+        mEntries.push_front(entry);
+    }
+    memcpy(data, entry->data, dataSize);
+    ++mHits;
+    return true;
+}
+
+bool ReadCache::getDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize)
+{
+    Entry* entry = find(nsIndex, datatype, key);
+    if (!entry) {
+        return false;
+    }
+    dataSize = entry->dataSize;
+    return true;
+}
+
+void ReadCache::insert(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    const size_t entrySize = getEntrySize(dataSize);
+    if (entrySize > mBudget / 4) {
+        return;
+    }
+    Entry* entry = find(nsIndex, datatype, key);
+    if (entry) {
+        remove(entry);
+    }
+    while (mUsedBytes + entrySize > mBudget) {
+        remove(&mEntries.back());
+    }
+
+    // the cache is optional, running out of memory only means the value is not cached
+    entry = new (std::nothrow) Entry;
+    if (!entry) {
+        return;
+    }
+    if (dataSize > 0) {
+        entry->data = new (std::nothrow) uint8_t[dataSize];
+        if (!entry->data) {
+            delete entry;
+            return;
+        }
+        memcpy(entry->data, data, dataSize);
+    }
+    entry->nsIndex = nsIndex;
+    entry->datatype = datatype;
+    strncpy(entry->key, key, sizeof(entry->key) - 1);
+    entry->key[sizeof(entry->key) - 1] = 0;
+    entry->dataSize = dataSize;
+    mEntries.push_front(entry);
+    mUsedBytes += entrySize;
+}
+
+void ReadCache::invalidate(uint8_t nsIndex, const char* key)
+{
+    auto it = mEntries.begin();
+    while (it != mEntries.end()) {
+        Entry* entry = it++;
+        if (entry->nsIndex == nsIndex && strncmp(entry->key, key, sizeof(entry->key)) == 0) {
+            remove(entry);
+        }
+    }
+}
+
+void ReadCache::invalidateNamespace(uint8_t nsIndex)
+{
+    auto it = mEntries.begin();
+    while (it != mEntries.end()) {
+        Entry* entry = it++;
+        if (entry->nsIndex == nsIndex) {
+            remove(entry);
+        }
+    }
+}
+
+void ReadCache::clear()
+{
+    while (!mEntries.empty()) {
+        remove(&mEntries.front());
+    }
+}
+
+void ReadCache::remove(Entry* entry)
+{
+    mEntries.erase(entry);
+    mUsedBytes -= getEntrySize(entry->dataSize);
+    delete[] entry->data;
+    delete entry;
+}
+
+} // namespace nvs
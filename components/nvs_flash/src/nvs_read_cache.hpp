@@ -0,0 +1,133 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_read_cache_hpp
+#define nvs_read_cache_hpp
+
+#include "nvs.h"
+#include "nvs_types.hpp"
+#include "intrusive_list.h"
+
+namespace nvs
+{
+
+/**
+ * RAM copies of recently read values of one partition, evicted in least recently used order.
+ *
+ * Values are keyed by namespace index, data type and key. The memory taken by values
+ * and their bookkeeping is kept within the budget given to reset(). A single value may take
+ * at most a quarter of the budget, so that reading one large blob doesn't evict all other values.
+ * Storage drops values from the cache before they are changed or erased in flash.
+ */
+class ReadCache
+{
+public:
+    class Entry : public intrusive_list_node<Entry>
+    {
+    public:
+        uint8_t nsIndex;
+        ItemType datatype;
+        char key[Item::MAX_KEY_LENGTH + 1];
+        uint8_t* data = nullptr;
+        size_t dataSize = 0;
+    };
+
+    typedef intrusive_list<Entry> TEntryList;
+
+    ReadCache() {}
+    ~ReadCache();
+
+    /* Drop all values and set the budget in bytes; 0 disables the cache. Resets the counters. */
+    void reset(size_t budget);
+
+    bool isActive() const
+    {
+        return mBudget != 0;
+    }
+
+    /* Copy a cached value of exactly dataSize bytes to data. Counts a hit or a miss. */
+    bool read(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize);
+
+    /* Size of a cached value. Doesn't change the counters. */
+    bool getDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize);
+
+    /* Store a value which has just been read from flash, evicting least recently used values if needed */
+    void insert(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    /* Drop values of the key, whatever their data type */
+    void invalidate(uint8_t nsIndex, const char* key);
+
+    /* Drop all values of the namespace */
+    void invalidateNamespace(uint8_t nsIndex);
+
+    void clear();
+
+    TEntryList::iterator begin()
+    {
+        return mEntries.begin();
+    }
+
+    TEntryList::iterator end()
+    {
+        return mEntries.end();
+    }
+
+    size_t size() const
+    {
+        return mEntries.size();
+    }
+
+    size_t getBudget() const
+    {
+        return mBudget;
+    }
+
+    size_t getUsedBytes() const
+    {
+        return mUsedBytes;
+    }
+
+    uint32_t getHits() const
+    {
+        return mHits;
+    }
+
+    uint32_t getMisses() const
+    {
+        return mMisses;
+    }
+
+protected:
+    ReadCache(const ReadCache& other);
+    const ReadCache& operator= (const ReadCache& rhs);
+
+    static size_t getEntrySize(size_t dataSize)
+    {
+        return sizeof(Entry) + dataSize;
+    }
+
+    Entry* find(uint8_t nsIndex, ItemType datatype, const char* key);
+
+    void remove(Entry* entry);
+
+    TEntryList mEntries;    // most recently used first
+    size_t mBudget = 0;
+    size_t mUsedBytes = 0;
+    uint32_t mHits = 0;
+    uint32_t mMisses = 0;
+}; // class ReadCache
+
+} // namespace nvs
+
+#endif /* nvs_read_cache_hpp */
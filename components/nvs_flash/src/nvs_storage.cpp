@@ -23,70 +23,105 @@ namespace nvs
 
 Storage::~Storage()
 {
+    detachBlobStreams();
     clearNamespaces();
 }
 
+void Storage::detachBlobStreams()
+{
+    /* Streams which are still open fail from now on. Chunks written by them are erased on next init. */
+    while (!mBlobStreams.empty()) {
+        BlobStream& stream = mBlobStreams.front();
+        if (stream.mMode == BlobStream::Mode::WRITE) {
+            stream.mMode = BlobStream::Mode::ABORTED;
+        }
+        stream.mStorage = nullptr;
+        mBlobStreams.erase(&stream);
+    }
+}
+
 void Storage::clearNamespaces()
 {
     mNamespaces.clearAndFreeNodes();
 }
 
-void Storage::populateBlobIndices(TBlobIndexList& blobIdxList)
+std::string Storage::MountScanner::getBlobKey(uint8_t nsIndex, const char* key)
 {
-    for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
-        Page& p = *it;
-        size_t itemIndex = 0;
-        Item item;
+    std::string result(1, static_cast<char>(nsIndex));
+    result.append(key, strnlen(key, Item::MAX_KEY_LENGTH));
+    return result;
+}
 
+void Storage::MountScanner::itemLoaded(Page& page, size_t index, const Item& item)
+{
+    if (item.nsIndex == Page::NS_INDEX && item.datatype == ItemType::U8) {
+        mNamespaces[std::string(item.key, strnlen(item.key, Item::MAX_KEY_LENGTH))] = item.data[0];
+    } else if (item.datatype == ItemType::BLOB_IDX) {
         /* If the power went off just after writing a blob index, the duplicate detection
-         * logic in pagemanager will remove the earlier index. So we should never find a
-         * duplicate index at this point */
-
-        while (p.findItem(Page::NS_ANY, ItemType::BLOB_IDX, nullptr, itemIndex, item) == ESP_OK) {
-            BlobIndexNode* entry = new BlobIndexNode;
-
-            item.getKey(entry->key, sizeof(entry->key) - 1);
-            entry->nsIndex = item.nsIndex;
-            entry->chunkStart = item.blobIndex.chunkStart;
-            entry->chunkCount = item.blobIndex.chunkCount;
-
-            blobIdxList.push_back(entry);
-            itemIndex += item.span;
+         * logic in pagemanager removes the earlier index, so only the latest one is kept */
+        BlobIndexInfo info;
+        page.getSeqNumber(info.seqNumber);
+        info.itemIndex = index;
+        info.chunkCount = item.blobIndex.chunkCount;
+        info.chunkStart = item.blobIndex.chunkStart;
+        auto result = mBlobIndices.insert(std::make_pair(getBlobKey(item.nsIndex, item.key), info));
+        BlobIndexInfo& existing = result.first->second;
+        if (!result.second && (existing.seqNumber < info.seqNumber ||
+                (existing.seqNumber == info.seqNumber && existing.itemIndex < info.itemIndex))) {
+            existing = info;
         }
+    } else if (item.datatype == ItemType::BLOB_DATA) {
+        BlobChunk chunk;
+        chunk.page = &page;
+        chunk.nsIndex = item.nsIndex;
+        chunk.chunkIndex = item.chunkIndex;
+        strncpy(chunk.key, item.key, sizeof(chunk.key) - 1);
+        chunk.key[sizeof(chunk.key) - 1] = 0;
+        mBlobChunks.push_back(chunk);
     }
 }
 
-void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
+void Storage::eraseOrphanDataBlobs(MountScanner& scanner)
 {
-    for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
-        Page& p = *it;
-        size_t itemIndex = 0;
-        Item item;
-        /* Chunks with same <ns,key> and with chunkIndex in the following ranges
-         * belong to same family.
-         * 1) VER_0_OFFSET <= chunkIndex < VER_1_OFFSET-1 => Version0 chunks
-         * 2) VER_1_OFFSET <= chunkIndex < VER_ANY => Version1 chunks
-         */
-        while (p.findItem(Page::NS_ANY, ItemType::BLOB_DATA, nullptr, itemIndex, item) == ESP_OK) {
-
-            auto iter = std::find_if(blobIdxList.begin(),
-                    blobIdxList.end(),
-                    [=] (const BlobIndexNode& e) -> bool
-                    {return (strncmp(item.key, e.key, sizeof(e.key) - 1) == 0)
-                            && (item.nsIndex == e.nsIndex)
-                            && (item.chunkIndex >=  static_cast<uint8_t> (e.chunkStart))
-                            && (item.chunkIndex < static_cast<uint8_t> (e.chunkStart) + e.chunkCount);});
-            if (iter == std::end(blobIdxList)) {
-                p.eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex);
-            }
-            itemIndex += item.span;
+    /* Chunks with same <ns,key> and with chunkIndex in the following ranges
+     * belong to same family.
+     * 1) VER_0_OFFSET <= chunkIndex < VER_1_OFFSET-1 => Version0 chunks
+     * 2) VER_1_OFFSET <= chunkIndex < VER_ANY => Version1 chunks
+     */
+    for (auto& chunk : scanner.mBlobChunks) {
+        auto it = scanner.mBlobIndices.find(MountScanner::getBlobKey(chunk.nsIndex, chunk.key));
+        if (it != scanner.mBlobIndices.end()
+                && chunk.chunkIndex >= static_cast<uint8_t> (it->second.chunkStart)
+                && chunk.chunkIndex < static_cast<uint8_t> (it->second.chunkStart) + it->second.chunkCount) {
+            continue;
         }
+        /* The chunk may be gone already if the page was freed during loading */
+        chunk.page->eraseItem(chunk.nsIndex, ItemType::BLOB_DATA, chunk.key, chunk.chunkIndex);
     }
 }
 
 esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
 {
-    auto err = mPageManager.load(baseSector, sectorCount);
+    auto err = mLock.init();
+    if (err == ESP_OK) {
+        err = mReadCacheLock.init();
+    }
+    if (err == ESP_OK) {
+        err = mBlobStreamsLock.init();
+    }
+    if (err != ESP_OK) {
+        mState = StorageState::INVALID;
+        return err;
+    }
+
+    detachBlobStreams();
+
+    // pages fill the index and report their items to the scanner while they are being loaded,
+    // so that the partition is read only once
+    mItemIndex.reset(mItemIndexMaxItems);
+    mReadCache.reset(mReadCacheSize);
+    MountScanner scanner;
+    err = mPageManager.load(baseSector, sectorCount, &mItemIndex, &scanner);
     if (err != ESP_OK) {
         mState = StorageState::INVALID;
         return err;
@@ -95,32 +130,20 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     // load namespaces list
     clearNamespaces();
     std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
-    for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
-        Page& p = *it;
-        size_t itemIndex = 0;
-        Item item;
-        while (p.findItem(Page::NS_INDEX, ItemType::U8, nullptr, itemIndex, item) == ESP_OK) {
-            NamespaceEntry* entry = new NamespaceEntry;
-            item.getKey(entry->mName, sizeof(entry->mName) - 1);
-            item.getValue(entry->mIndex);
-            mNamespaces.push_back(entry);
-            mNamespaceUsage.set(entry->mIndex, true);
-            itemIndex += item.span;
-        }
+    for (auto& ns : scanner.mNamespaces) {
+        NamespaceEntry* entry = new NamespaceEntry;
+        strncpy(entry->mName, ns.first.c_str(), sizeof(entry->mName) - 1);
+        entry->mName[sizeof(entry->mName) - 1] = 0;
+        entry->mIndex = ns.second;
+        mNamespaces.push_back(entry);
+        mNamespaceUsage.set(entry->mIndex, true);
     }
     mNamespaceUsage.set(0, true);
     mNamespaceUsage.set(255, true);
     mState = StorageState::ACTIVE;
 
-    // Populate list of multi-page index entries.
-    TBlobIndexList blobIdxList;
-    populateBlobIndices(blobIdxList);
-
-    // Remove the entries for which there is no parent multi-page index.
-    eraseOrphanDataBlobs(blobIdxList);
-
-    // Purge the blob index list
-    blobIdxList.clearAndFreeNodes();
+    // Remove the data chunks for which there is no parent multi-page index.
+    eraseOrphanDataBlobs(scanner);
 
 #ifndef ESP_PLATFORM
     debugCheck();
@@ -133,11 +156,23 @@ bool Storage::isValid() const
     return mState == StorageState::ACTIVE;
 }
 
-esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart, bool repair)
 {
+    if (mItemIndex.isActive() && nsIndex != Page::NS_ANY && datatype != ItemType::ANY && key != nullptr) {
+        ItemIndex::Candidate candidates[MAX_INDEX_CANDIDATES];
+        // same hash as used by the hash list of each page
+        const uint32_t hash = Item(nsIndex, datatype, 0, key, chunkIdx).calculateCrc32WithoutValue() & 0xffffff;
+        size_t count = mItemIndex.find(hash, candidates, MAX_INDEX_CANDIDATES);
+        if (count != SIZE_MAX) {
+            return findIndexedItem(candidates, count, nsIndex, datatype, key, page, item, chunkIdx, chunkStart, repair);
+        }
+        // too many pages with this hash, fall back to searching all pages
+    }
+
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         size_t itemIndex = 0;
-        auto err = it->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
+        auto err = repair ? it->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart)
+                   : it->findItemNoRepair(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
         if (err == ESP_OK) {
             page = it;
             return ESP_OK;
@@ -146,31 +181,60 @@ esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key,
     return ESP_ERR_NVS_NOT_FOUND;
 }
 
-esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
+esp_err_t Storage::findIndexedItem(const ItemIndex::Candidate* candidates, size_t count, uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart, bool repair)
 {
-    uint8_t chunkCount = 0;
-    TUsedPageList usedPages;
-    size_t remainingSize = dataSize;
-    size_t offset=0;
-    esp_err_t err = ESP_OK;
+    /* Only the pages holding an item with matching hash need to be checked. Searching each of them
+     * from its lowest matching entry gives the same result as searching the whole page.
+     * If the item is present on more than one page (i.e. while it is being overwritten),
+     * the page with lowest sequence number wins, same as when iterating over the page list. */
+    Page* foundPage = nullptr;
+    uint32_t foundSeqNumber = UINT32_MAX;
+    for (size_t i = 0; i < count; ++i) {
+        Page* p = candidates[i].page;
+        size_t itemIndex = candidates[i].index;
+        Item candidateItem;
+        uint32_t seqNumber;
+        auto err = repair ? p->findItem(nsIndex, datatype, key, itemIndex, candidateItem, chunkIdx, chunkStart)
+                   : p->findItemNoRepair(nsIndex, datatype, key, itemIndex, candidateItem, chunkIdx, chunkStart);
+        if (err != ESP_OK || p->getSeqNumber(seqNumber) != ESP_OK) {
+            continue;
+        }
+        if (foundPage == nullptr || seqNumber < foundSeqNumber) {
+            foundPage = p;
+            foundSeqNumber = seqNumber;
+            item = candidateItem;
+        }
+    }
+    if (foundPage == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    page = foundPage;
+    return ESP_OK;
+}
 
+size_t Storage::getMaxBlobSize()
+{
     /* Check how much maximum data can be accommodated**/
-    uint32_t max_pages = mPageManager.getPageCount() - 1;
+    size_t max_pages = mPageManager.getPageCount() - 1;
 
-    if(max_pages > (Page::CHUNK_ANY-1)/2) {
-       max_pages = (Page::CHUNK_ANY-1)/2;
+    if (max_pages > MAX_BLOB_CHUNKS) {
+        max_pages = MAX_BLOB_CHUNKS;
     }
+    return max_pages * Page::CHUNK_MAX_SIZE;
+}
 
-    if (dataSize > max_pages * Page::CHUNK_MAX_SIZE) {
-        return ESP_ERR_NVS_VALUE_TOO_LONG;
-    }
+esp_err_t Storage::writeBlobChunks(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart, uint8_t& chunkCount)
+{
+    size_t remainingSize = dataSize;
+    size_t offset = 0;
+    esp_err_t err = ESP_OK;
 
     do {
         Page& page = getCurrentPage();
         size_t tailroom = page.getVarDataTailroom();
-        size_t chunkSize =0;
-        if (!chunkCount && tailroom < dataSize && tailroom < Page::CHUNK_MAX_SIZE/10) {
-            /** This is the first chunk and tailroom is too small ***/
+        size_t chunkSize = 0;
+        if (!offset && tailroom < dataSize && tailroom < Page::CHUNK_MAX_SIZE/10) {
+            /** This is the first chunk of the data and tailroom is too small ***/
             if (page.state() != Page::PageState::FULL) {
                 err = page.markFull();
                 if (err != ESP_OK) {
@@ -182,13 +246,15 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                 return err;
             } else if(getCurrentPage().getVarDataTailroom() == tailroom) {
                 /* We got the same page or we are not improving.*/
-                return ESP_ERR_NVS_NOT_ENOUGH_SPACE; 
+                return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
             } else {
                 continue;
             }
         } else if (!tailroom) {
-            err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
-            break;
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        if (chunkCount == MAX_BLOB_CHUNKS) {
+            return ESP_ERR_NVS_VALUE_TOO_LONG;
         }
 
         /* Split the blob into two and store the chunk of available size onto the current page */
@@ -198,50 +264,111 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
 
         err = page.writeItem(nsIndex, ItemType::BLOB_DATA, key,
                 static_cast<const uint8_t*> (data) + offset, chunkSize, static_cast<uint8_t> (chunkStart) + chunkCount);
-        chunkCount++;
         assert(err != ESP_ERR_NVS_PAGE_FULL);
         if (err != ESP_OK) {
-            break;
-        } else {
-            UsedPageNode* node = new UsedPageNode();
-            node->mPage = &page;
-            usedPages.push_back(node);
-            if (remainingSize || (tailroom - chunkSize) < Page::ENTRY_SIZE) {
-                if (page.state() != Page::PageState::FULL) {
-                    err = page.markFull();
-                    if (err != ESP_OK) {
-                        break;
-                    }
-                }
-                err = mPageManager.requestNewPage();
+            return err;
+        }
+        chunkCount++;
+        if (remainingSize || (tailroom - chunkSize) < Page::ENTRY_SIZE) {
+            if (page.state() != Page::PageState::FULL) {
+                err = page.markFull();
                 if (err != ESP_OK) {
-                    break;
+                    return err;
                 }
             }
+            err = mPageManager.requestNewPage();
+            if (err != ESP_OK) {
+                return err;
+            }
         }
         offset += chunkSize;
-        if (!remainingSize) {
-            /* All pages are stored. Now store the index.*/
-            Item item;
-            std::fill_n(item.data, sizeof(item.data), 0xff);
-            item.blobIndex.dataSize = dataSize;
-            item.blobIndex.chunkCount = chunkCount;
-            item.blobIndex.chunkStart = chunkStart;
+    } while (remainingSize);
 
-            err = getCurrentPage().writeItem(nsIndex, ItemType::BLOB_IDX, key, item.data, sizeof(item.data));
-            assert(err != ESP_ERR_NVS_PAGE_FULL);
-            break;
+    return ESP_OK;
+}
+
+size_t Storage::getBlobChunkRoom()
+{
+    size_t tailroom = getCurrentPage().getVarDataTailroom();
+    return (tailroom < Page::CHUNK_MAX_SIZE/10) ? Page::CHUNK_MAX_SIZE : tailroom;
+}
+
+esp_err_t Storage::flushBlobBuffer(BlobStream& stream, size_t dataSize)
+{
+    auto err = writeBlobChunks(stream.mNsIndex, stream.mKey, stream.mBuffer, dataSize, stream.mChunkStart, stream.mChunkCount);
+    if (err != ESP_OK) {
+        return err;
+    }
+    stream.mBuffered -= dataSize;
+    memmove(stream.mBuffer, stream.mBuffer + dataSize, stream.mBuffered);
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeBlobIndex(uint8_t nsIndex, const char* key, size_t dataSize, VerOffset chunkStart, uint8_t chunkCount)
+{
+    Item item;
+    std::fill_n(item.data, sizeof(item.data), 0xff);
+    item.blobIndex.dataSize = dataSize;
+    item.blobIndex.chunkCount = chunkCount;
+    item.blobIndex.chunkStart = chunkStart;
+
+    Page& page = getCurrentPage();
+    auto err = page.writeItem(nsIndex, ItemType::BLOB_IDX, key, item.data, sizeof(item.data));
+    if (err == ESP_ERR_NVS_PAGE_FULL) {
+        /* Other items may have filled the page since the last chunk of a streamed blob was written */
+        if (page.state() != Page::PageState::FULL) {
+            err = page.markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
         }
-    } while (1);
+        err = mPageManager.requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+        err = getCurrentPage().writeItem(nsIndex, ItemType::BLOB_IDX, key, item.data, sizeof(item.data));
+    }
+    return err;
+}
+
+esp_err_t Storage::eraseBlobChunks(uint8_t nsIndex, const char* key, VerOffset chunkStart, uint8_t chunkCount)
+{
+    for (uint8_t chunkNum = 0; chunkNum < chunkCount; chunkNum++) {
+        Item item;
+        Page* findPage = nullptr;
+        auto err = findItem(nsIndex, ItemType::BLOB_DATA, key, findPage, item, static_cast<uint8_t> (chunkStart) + chunkNum);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            continue;
+        }
+        if (err == ESP_OK) {
+            err = findPage->eraseItem(nsIndex, ItemType::BLOB_DATA, key, static_cast<uint8_t> (chunkStart) + chunkNum);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
+{
+    mReadCache.invalidate(nsIndex, key);
+
+    if (dataSize > getMaxBlobSize()) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    uint8_t chunkCount = 0;
+    auto err = writeBlobChunks(nsIndex, key, data, dataSize, chunkStart, chunkCount);
+    if (err == ESP_OK) {
+        /* All pages are stored. Now store the index.*/
+        err = writeBlobIndex(nsIndex, key, dataSize, chunkStart, chunkCount);
+    }
 
     if (err != ESP_OK) {
         /* Anything failed, then we should erase all the written chunks*/
-        int ii=0;
-        for (auto it = std::begin(usedPages); it != std::end(usedPages); it++) {
-            it->mPage->eraseItem(nsIndex, ItemType::BLOB_DATA, key, ii++);
-        }
+        eraseBlobChunks(nsIndex, key, chunkStart, chunkCount);
     }
-    usedPages.clearAndFreeNodes();
     return err;
 }
 
@@ -250,6 +377,10 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
     if (mState != StorageState::ACTIVE) {
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
+    mReadCache.invalidate(nsIndex, key);
+    if (datatype == ItemType::BLOB) {
+        abortBlobWrites(nsIndex, key);
+    }
 
     Page* findPage = nullptr;
     Item item;
@@ -357,6 +488,140 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
     return ESP_OK;
 }
 
+esp_err_t Storage::writeTransaction(uint8_t nsIndex, Transaction& transaction)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    size_t entryCount = 0;
+    size_t valueCount = 0;
+    for (auto it = transaction.begin(); it != transaction.end(); ++it) {
+        mReadCache.invalidate(nsIndex, it->key);
+        if (it->datatype == ItemType::BLOB) {
+            abortBlobWrites(nsIndex, it->key);
+            /* A blob is written as a single data chunk followed by its index */
+            entryCount += Page::getItemEntryCount(ItemType::BLOB_DATA, it->dataSize) + 1;
+        } else {
+            entryCount += Page::getItemEntryCount(it->datatype, it->dataSize);
+        }
+        ++valueCount;
+    }
+
+    esp_err_t err;
+    if (entryCount > 0) {
+        /* All values are written to one page, so that they become valid all at once */
+        if (entryCount > Page::ENTRY_COUNT) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        while (getCurrentPage().getFreeEntryCount() < entryCount) {
+            Page& page = getCurrentPage();
+            if (page.state() != Page::PageState::FULL) {
+                err = page.markFull();
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
+            err = mPageManager.requestNewPage();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+
+        /* Pages don't move from here on, so the items to be replaced can be located now */
+        struct ReplacedItem {
+            const char* key;
+            Page* page;
+            ItemType datatype;
+            VerOffset chunkStart;
+        };
+        std::unique_ptr<ReplacedItem[]> replaced(new ReplacedItem[valueCount]);
+        std::unique_ptr<Item[]> entries(new Item[entryCount]);
+        size_t entryIndex = 0;
+        size_t valueIndex = 0;
+        for (auto it = transaction.begin(); it != transaction.end(); ++it) {
+            ReplacedItem& old = replaced[valueIndex++];
+            old.key = it->key;
+            old.page = nullptr;
+            old.chunkStart = VerOffset::VER_ANY;
+            Item item;
+            if (it->datatype == ItemType::BLOB) {
+                old.datatype = ItemType::BLOB_IDX;
+                err = findItem(nsIndex, ItemType::BLOB_IDX, it->key, old.page, item);
+                if (err == ESP_ERR_NVS_NOT_FOUND) {
+                    /* Support for earlier versions where BLOBS were stored without index */
+                    old.datatype = ItemType::BLOB;
+                    err = findItem(nsIndex, ItemType::BLOB, it->key, old.page, item);
+                }
+                if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+                    return err;
+                }
+
+                VerOffset nextStart = VerOffset::VER_0_OFFSET;
+                if (old.page && old.datatype == ItemType::BLOB_IDX) {
+                    old.chunkStart = item.blobIndex.chunkStart;
+                    assert(old.chunkStart == VerOffset::VER_0_OFFSET || old.chunkStart == VerOffset::VER_1_OFFSET);
+                    nextStart = (old.chunkStart == VerOffset::VER_1_OFFSET) ? VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+                }
+
+                Page::fillItemEntries(&entries[entryIndex], nsIndex, ItemType::BLOB_DATA, it->key,
+                        it->data, it->dataSize, static_cast<uint8_t>(nextStart));
+                entryIndex += Page::getItemEntryCount(ItemType::BLOB_DATA, it->dataSize);
+
+                std::fill_n(item.data, sizeof(item.data), 0xff);
+                item.blobIndex.dataSize = it->dataSize;
+                item.blobIndex.chunkCount = 1;
+                item.blobIndex.chunkStart = nextStart;
+                Page::fillItemEntries(&entries[entryIndex], nsIndex, ItemType::BLOB_IDX, it->key,
+                        item.data, sizeof(item.data));
+                ++entryIndex;
+            } else {
+                old.datatype = it->datatype;
+                err = findItem(nsIndex, it->datatype, it->key, old.page, item);
+                if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+                    return err;
+                }
+                Page::fillItemEntries(&entries[entryIndex], nsIndex, it->datatype, it->key, it->data, it->dataSize);
+                entryIndex += Page::getItemEntryCount(it->datatype, it->dataSize);
+            }
+        }
+        assert(entryIndex == entryCount);
+
+        err = getCurrentPage().writeItems(entries.get(), entryCount);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        /* The new values are committed. Old values left behind by a power failure from now on
+         * are removed by PageManager::load. */
+        for (size_t i = 0; i < valueCount && err == ESP_OK; ++i) {
+            ReplacedItem& old = replaced[i];
+            if (!old.page) {
+                continue;
+            }
+            if (old.datatype == ItemType::BLOB_IDX) {
+                err = eraseMultiPageBlob(nsIndex, old.key, old.chunkStart);
+            } else {
+                err = old.page->eraseItem(nsIndex, old.datatype, old.key);
+            }
+        }
+    } else {
+        err = ESP_OK;
+    }
+    transaction.clear();
+
+    if (err == ESP_ERR_FLASH_OP_FAIL) {
+        return ESP_ERR_NVS_REMOVE_FAILED;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+#ifndef ESP_PLATFORM
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
 esp_err_t Storage::createOrOpenNamespace(const char* nsName, bool canCreate, uint8_t& nsIndex)
 {
     if (mState != StorageState::ACTIVE) {
@@ -406,7 +671,7 @@ esp_err_t Storage::readMultiPageBlob(uint8_t nsIndex, const char* key, void* dat
     Page* findPage = nullptr;
 
     /* First read the blob index */
-    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item, Page::CHUNK_ANY, VerOffset::VER_ANY, false);
     if (err != ESP_OK) {
         return err;
     }
@@ -420,14 +685,14 @@ esp_err_t Storage::readMultiPageBlob(uint8_t nsIndex, const char* key, void* dat
 
     /* Now read corresponding chunks */
     for (uint8_t chunkNum = 0; chunkNum < chunkCount; chunkNum++) {
-        err = findItem(nsIndex, ItemType::BLOB_DATA, key, findPage, item, static_cast<uint8_t> (chunkStart) + chunkNum);
+        err = findItem(nsIndex, ItemType::BLOB_DATA, key, findPage, item, static_cast<uint8_t> (chunkStart) + chunkNum, VerOffset::VER_ANY, false);
         if (err != ESP_OK) {
             if (err == ESP_ERR_NVS_NOT_FOUND) {
                 break;
             }
             return err;
         }
-        err = findPage->readItem(nsIndex, ItemType::BLOB_DATA, key, static_cast<uint8_t*>(data) + offset, item.varLength.dataSize, static_cast<uint8_t> (chunkStart) + chunkNum);
+        err = findPage->readItemNoRepair(nsIndex, ItemType::BLOB_DATA, key, static_cast<uint8_t*>(data) + offset, item.varLength.dataSize, static_cast<uint8_t> (chunkStart) + chunkNum);
         if (err != ESP_OK) {
             return err;
         }
@@ -437,9 +702,8 @@ esp_err_t Storage::readMultiPageBlob(uint8_t nsIndex, const char* key, void* dat
     if (err == ESP_OK) {
         assert(offset == dataSize);
     }
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        eraseMultiPageBlob(nsIndex, key); // cleanup if a chunk is not found
-    }
+    /* If a chunk is missing, the remaining chunks are erased with the index next time the blob
+     * is written or erased. Reads don't modify flash, so that they can run concurrently. */
     return err;
 }
 
@@ -449,6 +713,25 @@ esp_err_t Storage::readItem(uint8_t nsIndex, ItemType datatype, const char* key,
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+    if (!mReadCache.isActive()) {
+        return readStoredItem(nsIndex, datatype, key, data, dataSize);
+    }
+    {
+        WriteLock lock(mReadCacheLock);
+        if (mReadCache.read(nsIndex, datatype, key, data, dataSize)) {
+            return ESP_OK;
+        }
+    }
+    auto err = readStoredItem(nsIndex, datatype, key, data, dataSize);
+    if (err == ESP_OK) {
+        WriteLock lock(mReadCacheLock);
+        mReadCache.insert(nsIndex, datatype, key, data, dataSize);
+    }
+    return err;
+}
+
+esp_err_t Storage::readStoredItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize)
+{
     Item item;
     Page* findPage = nullptr;
     if (datatype == ItemType::BLOB) {
@@ -458,11 +741,11 @@ esp_err_t Storage::readItem(uint8_t nsIndex, ItemType datatype, const char* key,
         } // else check if the blob is stored with earlier version format without index
     } 
 
-    auto err = findItem(nsIndex, datatype, key, findPage, item);
+    auto err = findItem(nsIndex, datatype, key, findPage, item, Page::CHUNK_ANY, VerOffset::VER_ANY, false);
     if (err != ESP_OK) {
         return err;
     }
-    return findPage->readItem(nsIndex, datatype, key, data, dataSize);
+    return findPage->readItemNoRepair(nsIndex, datatype, key, data, dataSize);
     
 }
 
@@ -471,6 +754,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
     if (mState != StorageState::ACTIVE) {
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
+    mReadCache.invalidate(nsIndex, key);
     Item item;
     Page* findPage = nullptr;
 
@@ -511,11 +795,292 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
     return ESP_OK;
 }
 
+esp_err_t Storage::openBlobRead(uint8_t nsIndex, const char* key, BlobStream& stream)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    Item item;
+    Page* findPage = nullptr;
+    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item, Page::CHUNK_ANY, VerOffset::VER_ANY, false);
+    if (err == ESP_OK) {
+        stream.mChunkType = ItemType::BLOB_DATA;
+        stream.mChunkStart = item.blobIndex.chunkStart;
+        stream.mChunkCount = item.blobIndex.chunkCount;
+        stream.mSize = item.blobIndex.dataSize;
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        /* Blobs written by earlier versions are stored as a single item without index */
+        err = findItem(nsIndex, ItemType::BLOB, key, findPage, item, Page::CHUNK_ANY, VerOffset::VER_ANY, false);
+        if (err != ESP_OK) {
+            return err;
+        }
+        stream.mChunkType = ItemType::BLOB;
+        stream.mChunkCount = 1;
+        stream.mSize = item.varLength.dataSize;
+    } else {
+        return err;
+    }
+
+    stream.mMode = BlobStream::Mode::READ;
+    stream.mNsIndex = nsIndex;
+    strncpy(stream.mKey, key, sizeof(stream.mKey) - 1);
+    stream.mKey[sizeof(stream.mKey) - 1] = 0;
+    stream.mCursorChunk = 0;
+    stream.mCursorOffset = 0;
+    stream.mVerifiedChunk = Page::CHUNK_ANY;
+    stream.mStorage = this;
+    WriteLock lock(mBlobStreamsLock);
+    mBlobStreams.push_back(&stream);
+    return ESP_OK;
+}
+
+esp_err_t Storage::readBlob(BlobStream& stream, size_t offset, void* data, size_t dataSize)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (stream.mMode != BlobStream::Mode::READ) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (offset > stream.mSize || dataSize > stream.mSize - offset) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    /* Chunks are located starting from the one read last time, so that reading the blob
+     * from start to end takes one lookup per chunk */
+    if (offset < stream.mCursorOffset) {
+        stream.mCursorChunk = 0;
+        stream.mCursorOffset = 0;
+    }
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    while (dataSize > 0) {
+        if (stream.mCursorChunk >= stream.mChunkCount) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        const uint8_t chunkIdx = stream.getChunkIndex(stream.mCursorChunk);
+        Item item;
+        Page* findPage = nullptr;
+        auto err = findItem(stream.mNsIndex, stream.mChunkType, stream.mKey, findPage, item, chunkIdx, VerOffset::VER_ANY, false);
+        if (err != ESP_OK) {
+            return err;
+        }
+        const size_t chunkSize = item.varLength.dataSize;
+        if (offset >= stream.mCursorOffset + chunkSize) {
+            stream.mCursorOffset += chunkSize;
+            ++stream.mCursorChunk;
+            continue;
+        }
+
+        /* The data CRC of a chunk is checked when the chunk is read for the first time */
+        const size_t chunkOffset = offset - stream.mCursorOffset;
+        const size_t readSize = std::min(dataSize, chunkSize - chunkOffset);
+        const bool verifyCrc = (stream.mVerifiedChunk != stream.mCursorChunk);
+        err = findPage->readItemData(stream.mNsIndex, stream.mChunkType, stream.mKey, chunkOffset, dst, readSize, verifyCrc, chunkIdx);
+        if (err != ESP_OK) {
+            return err;
+        }
+        stream.mVerifiedChunk = stream.mCursorChunk;
+        dst += readSize;
+        offset += readSize;
+        dataSize -= readSize;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::openBlobWrite(uint8_t nsIndex, const char* key, BlobStream& stream)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    if (stream.mBuffer == nullptr) {
+        stream.mBuffer = new (std::nothrow) uint8_t[Page::CHUNK_MAX_SIZE];
+        if (stream.mBuffer == nullptr) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    abortBlobWrites(nsIndex, key);
+
+    Item item;
+    Page* findPage = nullptr;
+    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        return err;
+    }
+
+    /* Chunks are written with the version which the current value doesn't use */
+    stream.mReplace = (err == ESP_OK);
+    stream.mPrevStart = VerOffset::VER_0_OFFSET;
+    stream.mChunkStart = VerOffset::VER_0_OFFSET;
+    if (stream.mReplace) {
+        stream.mPrevStart = item.blobIndex.chunkStart;
+        assert(stream.mPrevStart == VerOffset::VER_0_OFFSET || stream.mPrevStart == VerOffset::VER_1_OFFSET);
+        stream.mChunkStart = (stream.mPrevStart == VerOffset::VER_1_OFFSET) ? VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+    }
+
+    stream.mMode = BlobStream::Mode::WRITE;
+    stream.mNsIndex = nsIndex;
+    strncpy(stream.mKey, key, sizeof(stream.mKey) - 1);
+    stream.mKey[sizeof(stream.mKey) - 1] = 0;
+    stream.mChunkType = ItemType::BLOB_DATA;
+    stream.mChunkCount = 0;
+    stream.mSize = 0;
+    stream.mBuffered = 0;
+    stream.mStorage = this;
+    WriteLock lock(mBlobStreamsLock);
+    mBlobStreams.push_back(&stream);
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeBlob(BlobStream& stream, size_t offset, const void* data, size_t dataSize)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (stream.mMode != BlobStream::Mode::WRITE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (offset != stream.mSize) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dataSize == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ESP_ERR_NVS_VALUE_TOO_LONG;
+    if (dataSize <= getMaxBlobSize() - stream.mSize) {
+        err = ESP_OK;
+    }
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    size_t remaining = dataSize;
+    while (err == ESP_OK) {
+        /* The page may have been filled by other writes since the data was buffered */
+        const size_t room = getBlobChunkRoom();
+        if (stream.mBuffered >= room) {
+            err = flushBlobBuffer(stream, room);
+            continue;
+        }
+        if (remaining == 0) {
+            break;
+        }
+        const size_t copySize = std::min(remaining, room - stream.mBuffered);
+        memcpy(stream.mBuffer + stream.mBuffered, src, copySize);
+        stream.mBuffered += copySize;
+        src += copySize;
+        remaining -= copySize;
+    }
+    if (err != ESP_OK) {
+        eraseBlobChunks(stream.mNsIndex, stream.mKey, stream.mChunkStart, stream.mChunkCount);
+        stream.mMode = BlobStream::Mode::ABORTED;
+        stream.mBuffered = 0;
+        return (err == ESP_ERR_NVS_PAGE_FULL) ? ESP_ERR_NVS_NOT_ENOUGH_SPACE : err;
+    }
+    stream.mSize += dataSize;
+#ifndef ESP_PLATFORM
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
+esp_err_t Storage::closeBlob(BlobStream& stream)
+{
+    {
+        WriteLock lock(mBlobStreamsLock);
+        mBlobStreams.erase(&stream);
+    }
+    stream.mStorage = nullptr;
+    if (stream.mMode == BlobStream::Mode::READ) {
+        return ESP_OK;
+    }
+    if (stream.mMode == BlobStream::Mode::ABORTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (mState != StorageState::ACTIVE) {
+        stream.mMode = BlobStream::Mode::ABORTED;
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    const uint8_t nsIndex = stream.mNsIndex;
+    const char* key = stream.mKey;
+    mReadCache.invalidate(nsIndex, key);
+
+    esp_err_t err = ESP_OK;
+    if (stream.mBuffered > 0) {
+        err = flushBlobBuffer(stream, stream.mBuffered);
+    }
+    /* Once the index is written, the new chunks are valid and the old ones are orphans */
+    if (err == ESP_OK) {
+        err = writeBlobIndex(nsIndex, key, stream.mSize, stream.mChunkStart, stream.mChunkCount);
+    }
+    if (err != ESP_OK) {
+        eraseBlobChunks(nsIndex, key, stream.mChunkStart, stream.mChunkCount);
+        stream.mMode = BlobStream::Mode::ABORTED;
+        return (err == ESP_ERR_NVS_PAGE_FULL) ? ESP_ERR_NVS_NOT_ENOUGH_SPACE : err;
+    }
+
+    if (stream.mReplace) {
+        err = eraseMultiPageBlob(nsIndex, key, stream.mPrevStart);
+    } else {
+        /* Support for earlier versions where BLOBS were stored without index */
+        Item item;
+        Page* findPage = nullptr;
+        err = findItem(nsIndex, ItemType::BLOB, key, findPage, item);
+        if (err == ESP_OK) {
+            err = findPage->eraseItem(nsIndex, ItemType::BLOB, key);
+        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_ERR_FLASH_OP_FAIL) {
+        return ESP_ERR_NVS_REMOVE_FAILED;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+#ifndef ESP_PLATFORM
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
+void Storage::abortBlob(BlobStream& stream)
+{
+    {
+        WriteLock lock(mBlobStreamsLock);
+        mBlobStreams.erase(&stream);
+    }
+    stream.mStorage = nullptr;
+    if (stream.mMode == BlobStream::Mode::WRITE) {
+        eraseBlobChunks(stream.mNsIndex, stream.mKey, stream.mChunkStart, stream.mChunkCount);
+        stream.mMode = BlobStream::Mode::ABORTED;
+        stream.mBuffered = 0;
+    }
+}
+
+void Storage::abortBlobWrites(uint8_t nsIndex, const char* key)
+{
+    for (auto it = mBlobStreams.begin(); it != mBlobStreams.end(); ++it) {
+        if (it->mMode == BlobStream::Mode::WRITE && it->mNsIndex == nsIndex &&
+                (key == nullptr || strncmp(it->mKey, key, Item::MAX_KEY_LENGTH) == 0)) {
+            eraseBlobChunks(it->mNsIndex, it->mKey, it->mChunkStart, it->mChunkCount);
+            it->mMode = BlobStream::Mode::ABORTED;
+            it->mBuffered = 0;
+        }
+    }
+}
+
 esp_err_t Storage::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key)
 {
     if (mState != StorageState::ACTIVE) {
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
+    mReadCache.invalidate(nsIndex, key);
+    if (datatype == ItemType::BLOB || datatype == ItemType::ANY) {
+        abortBlobWrites(nsIndex, key);
+    }
 
     if (datatype == ItemType::BLOB) {
         return eraseMultiPageBlob(nsIndex, key);
@@ -540,6 +1105,8 @@ esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
     if (mState != StorageState::ACTIVE) {
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
+    mReadCache.invalidateNamespace(nsIndex);
+    abortBlobWrites(nsIndex, nullptr);
 
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         while (true) {
@@ -562,14 +1129,21 @@ esp_err_t Storage::getItemDataSize(uint8_t nsIndex, ItemType datatype, const cha
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+    if (mReadCache.isActive()) {
+        WriteLock lock(mReadCacheLock);
+        if (mReadCache.getDataSize(nsIndex, datatype, key, dataSize)) {
+            return ESP_OK;
+        }
+    }
+
     Item item;
     Page* findPage = nullptr;
-    auto err = findItem(nsIndex, datatype, key, findPage, item);
+    auto err = findItem(nsIndex, datatype, key, findPage, item, Page::CHUNK_ANY, VerOffset::VER_ANY, false);
     if (err != ESP_OK) {
         if (datatype != ItemType::BLOB) {
             return err;
         }
-        err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+        err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item, Page::CHUNK_ANY, VerOffset::VER_ANY, false);
         if (err != ESP_OK) {
             return err;
         }
@@ -607,20 +1181,69 @@ void Storage::debugCheck()
                 assert(0);
             }
             keys.insert(std::make_pair(keystr, static_cast<Page*>(p)));
+            if (mItemIndex.isActive()) {
+                // every item has to be reachable through the index
+                ItemIndex::Candidate candidates[MAX_INDEX_CANDIDATES];
+                const uint32_t hash = item.calculateCrc32WithoutValue() & 0xffffff;
+                size_t count = mItemIndex.find(hash, candidates, MAX_INDEX_CANDIDATES);
+                bool indexed = (count == SIZE_MAX);
+                for (size_t i = 0; i < count && !indexed; ++i) {
+                    indexed = (candidates[i].page == static_cast<Page*>(p) && candidates[i].index <= itemIndex);
+                }
+                if (!indexed) {
+                    printf("Item not in index: %s\n", keystr.c_str());
+                    assert(0);
+                }
+            }
             itemIndex += item.span;
             usedCount += item.span;
         }
         assert(usedCount == p->getUsedEntryCount());
     }
+
+    // cached values have to match the ones in flash
+    for (auto it = mReadCache.begin(); it != mReadCache.end(); ++it) {
+        std::unique_ptr<uint8_t[]> data(new uint8_t[it->dataSize + 1]);
+        if (readStoredItem(it->nsIndex, it->datatype, it->key, data.get(), it->dataSize) != ESP_OK ||
+                (it->dataSize > 0 && memcmp(data.get(), it->data, it->dataSize) != 0)) {
+            printf("Stale value in read cache: %u_%u_%s\n", static_cast<unsigned>(it->nsIndex), static_cast<unsigned>(it->datatype), it->key);
+            assert(0);
+        }
+    }
 }
 #endif //ESP_PLATFORM
 
+esp_err_t Storage::gcStep()
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    auto err = mPageManager.reclaimPage();
+    if (err != ESP_OK) {
+        return err;
+    }
+#ifndef ESP_PLATFORM
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
 esp_err_t Storage::fillStats(nvs_stats_t& nvsStats)
 {
     nvsStats.namespace_count = mNamespaces.size();
     return mPageManager.fillStats(nvsStats);
 }
 
+void Storage::fillCacheStats(nvs_cache_stats_t& cacheStats)
+{
+    WriteLock lock(mReadCacheLock);
+    cacheStats.used_bytes = mReadCache.getUsedBytes();
+    cacheStats.total_bytes = mReadCache.getBudget();
+    cacheStats.entry_count = mReadCache.size();
+    cacheStats.hits = mReadCache.getHits();
+    cacheStats.misses = mReadCache.getMisses();
+}
+
 esp_err_t Storage::calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries)
 {
     usedEntries = 0;
@@ -633,7 +1256,7 @@ esp_err_t Storage::calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries)
         size_t itemIndex = 0;
         Item item;
         while (true) {
-            auto err = it->findItem(nsIndex, ItemType::ANY, nullptr, itemIndex, item);
+            auto err = it->findItemNoRepair(nsIndex, ItemType::ANY, nullptr, itemIndex, item);
             if (err == ESP_ERR_NVS_NOT_FOUND) {
                 break;
             }
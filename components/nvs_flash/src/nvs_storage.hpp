@@ -17,16 +17,45 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "nvs.hpp"
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
+#include "nvs_item_index.hpp"
+#include "nvs_transaction.hpp"
+#include "nvs_read_cache.hpp"
+#include "nvs_blob_stream.hpp"
+#include "nvs_platform.hpp"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_NVS_ITEM_INDEX
+#define NVS_ITEM_INDEX_MAX_ITEMS CONFIG_NVS_ITEM_INDEX_MAX_ITEMS
+#else
+#define NVS_ITEM_INDEX_MAX_ITEMS 0
+#endif
+
+#ifdef CONFIG_NVS_READ_CACHE
+#define NVS_READ_CACHE_SIZE CONFIG_NVS_READ_CACHE_SIZE
+#else
+#define NVS_READ_CACHE_SIZE 0
+#endif
 
 //extern void dumpBytes(const uint8_t* data, size_t count);
 
 namespace nvs
 {
 
+/**
+ * One NVS partition.
+ *
+ * Storage doesn't lock by itself; callers hold the lock returned by getLock().
+ * Methods which only read (readItem, getItemDataSize, calcEntriesInNamespace, fillStats,
+ * fillCacheStats, openBlobRead, readBlob, debugDump, and closeBlob or abortBlob of a stream
+ * opened for reading) may be called by several tasks at once while the lock is held for reading. They don't modify flash: items which turn out to be corrupted are skipped,
+ * and are erased when they are written or erased next time, or during init.
+ * All other methods need the lock held for writing.
+ */
 class Storage : public intrusive_list_node<Storage>
 {
     enum class StorageState : uint32_t {
@@ -42,21 +71,34 @@ class Storage : public intrusive_list_node<Storage>
 
     typedef intrusive_list<NamespaceEntry> TNamespaces;
 
-    struct UsedPageNode: public intrusive_list_node<UsedPageNode> {
-        public: Page* mPage;
-    };
+    typedef intrusive_list<BlobStream> TBlobStreams;
 
-    typedef intrusive_list<UsedPageNode> TUsedPageList;
+    /* Collects namespaces, blob indices and blob data chunks while init() loads the pages */
+    class MountScanner : public LoadListener
+    {
+    public:
+        void itemLoaded(Page& page, size_t index, const Item& item) override;
 
-    struct BlobIndexNode: public intrusive_list_node<BlobIndexNode> {
-        public:
-            char key[Item::MAX_KEY_LENGTH + 1];
+        struct BlobIndexInfo {
+            uint32_t seqNumber;     // position of the index item, the latest one is valid
+            size_t itemIndex;
+            uint8_t chunkCount;
+            VerOffset chunkStart;
+        };
+
+        struct BlobChunk {
+            Page* page;
             uint8_t nsIndex;
-            uint8_t chunkCount; 
-            VerOffset chunkStart; 
-    };
+            uint8_t chunkIndex;
+            char key[Item::MAX_KEY_LENGTH + 1];
+        };
 
-    typedef intrusive_list<BlobIndexNode> TBlobIndexList;
+        static std::string getBlobKey(uint8_t nsIndex, const char* key);
+
+        std::unordered_map<std::string, uint8_t> mNamespaces;
+        std::unordered_map<std::string, BlobIndexInfo> mBlobIndices;
+        std::vector<BlobChunk> mBlobChunks;
+    };
 
 public:
     ~Storage();
@@ -65,8 +107,25 @@ public:
 
     esp_err_t init(uint32_t baseSector, uint32_t sectorCount);
 
+    /* Limit on the number of items in the partition-wide index, takes effect on next init. 0 disables the index. */
+    void setItemIndexMaxItems(size_t maxItems)
+    {
+        mItemIndexMaxItems = maxItems;
+    }
+
+    /* Memory budget of the read cache in bytes, takes effect on next init. 0 disables the cache. */
+    void setReadCacheSize(size_t size)
+    {
+        mReadCacheSize = size;
+    }
+
     bool isValid() const;
 
+    ReadWriteLock& getLock()
+    {
+        return mLock;
+    }
+
     esp_err_t createOrOpenNamespace(const char* nsName, bool canCreate, uint8_t& nsIndex);
 
     esp_err_t writeItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
@@ -96,6 +155,10 @@ public:
     
     esp_err_t eraseNamespace(uint8_t nsIndex);
 
+    /* Apply the changes staged in the transaction and clear it. Written values become valid
+     * all at once; erasures of replaced values and of staged keys follow. */
+    esp_err_t writeTransaction(uint8_t nsIndex, Transaction& transaction);
+
     const char *getPartName() const
     {
         return mPartitionName;
@@ -111,12 +174,39 @@ public:
 
     esp_err_t eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    /* Start reading a blob in parts. Opening, reading and closing the stream only need the lock
+     * held for reading. */
+    esp_err_t openBlobRead(uint8_t nsIndex, const char* key, BlobStream& stream);
+
+    esp_err_t readBlob(BlobStream& stream, size_t offset, void* data, size_t dataSize);
+
+    /* Start writing a blob in parts. Writes of the same blob by other means, including another
+     * stream, abort the write. */
+    esp_err_t openBlobWrite(uint8_t nsIndex, const char* key, BlobStream& stream);
+
+    /* Append data to the blob, offset has to be equal to the number of bytes written so far.
+     * Data is buffered until it fills the rest of the current page, so that small writes don't
+     * use up the chunks a blob may consist of. If writing fails, the write is aborted. */
+    esp_err_t writeBlob(BlobStream& stream, size_t offset, const void* data, size_t dataSize);
+
+    /* Detach the stream from the storage. For a write, the new value of the blob becomes valid. */
+    esp_err_t closeBlob(BlobStream& stream);
+
+    /* Detach the stream from the storage. For a write, the data written so far is erased. */
+    void abortBlob(BlobStream& stream);
+
+    /* Free one page holding erased entries ahead of time, see PageManager::reclaimPage.
+     * Returns ESP_ERR_NVS_NOT_FOUND if there was nothing to do. */
+    esp_err_t gcStep();
+
     void debugDump();
     
     void debugCheck();
 
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
+    void fillCacheStats(nvs_cache_stats_t& cacheStats);
+
     esp_err_t calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries);
 
 protected:
@@ -128,18 +218,56 @@ protected:
 
     void clearNamespaces();
 
-    void populateBlobIndices(TBlobIndexList&);
+    void detachBlobStreams();
+
+    void eraseOrphanDataBlobs(MountScanner& scanner);
 
-    void eraseOrphanDataBlobs(TBlobIndexList&);
+    size_t getMaxBlobSize();
 
+    /* Write data of a multi-page blob as chunks, numbered from chunkCount on. chunkCount is updated
+     * with each chunk written. */
+    esp_err_t writeBlobChunks(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart, uint8_t& chunkCount);
 
-    esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+    esp_err_t writeBlobIndex(uint8_t nsIndex, const char* key, size_t dataSize, VerOffset chunkStart, uint8_t chunkCount);
+
+    esp_err_t eraseBlobChunks(uint8_t nsIndex, const char* key, VerOffset chunkStart, uint8_t chunkCount);
+
+    /* Number of bytes the next chunk of a streamed blob should hold: the tailroom of the current
+     * page, or a whole page if writeBlobChunks would start a new one */
+    size_t getBlobChunkRoom();
+
+    /* Store the first dataSize buffered bytes of a write stream as chunks */
+    esp_err_t flushBlobBuffer(BlobStream& stream, size_t dataSize);
+
+    /* Abort writes of open blob streams to the given key, or to the whole namespace if key is nullptr */
+    void abortBlobWrites(uint8_t nsIndex, const char* key);
+
+    /* Read an item from flash, bypassing the read cache */
+    esp_err_t readStoredItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize);
+
+    /* Pass repair = false from methods which only read, see Page::findItemNoRepair */
+    esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY, bool repair = true);
+
+    esp_err_t findIndexedItem(const ItemIndex::Candidate* candidates, size_t count, uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart, bool repair);
 
 protected:
+    static const size_t MAX_INDEX_CANDIDATES = 4;
+
+    /* Chunks of both versions of a blob have to fit into the range of chunk indices */
+    static const uint8_t MAX_BLOB_CHUNKS = (Page::CHUNK_ANY - 1) / 2;
+
     const char *mPartitionName;
     size_t mPageCount;
+    size_t mItemIndexMaxItems = NVS_ITEM_INDEX_MAX_ITEMS;
+    ItemIndex mItemIndex; // must outlive the pages in mPageManager
+    size_t mReadCacheSize = NVS_READ_CACHE_SIZE;
+    ReadCache mReadCache;
+    ReadWriteLock mReadCacheLock; // always taken for writing, readers of the storage update the cache as well
+    ReadWriteLock mBlobStreamsLock; // always taken for writing, read streams are opened and closed by readers of the storage
+    ReadWriteLock mLock;
     PageManager mPageManager;
     TNamespaces mNamespaces;
+    TBlobStreams mBlobStreams;
     CompressedEnumTable<bool, 1, 256> mNamespaceUsage;
     StorageState mState = StorageState::INVALID;
 };
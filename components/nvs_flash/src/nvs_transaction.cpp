@@ -0,0 +1,86 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_transaction.hpp"
+#include "nvs_page.hpp"
+#include <cstring>
+
+namespace nvs
+{
+
+Transaction::~Transaction()
+{
+    clear();
+}
+
+Transaction::Record* Transaction::find(const char* key)
+{
+    for (auto it = mRecords.begin(); it != mRecords.end(); ++it) {
+        if (strncmp(it->key, key, sizeof(it->key)) == 0) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+Transaction::Record* Transaction::getRecord(const char* key)
+{
+    Record* record = find(key);
+    if (record) {
+        delete[] record->data;
+        record->data = nullptr;
+        record->dataSize = 0;
+        return record;
+    }
+    record = new Record;
+    strncpy(record->key, key, sizeof(record->key) - 1);
+    record->key[sizeof(record->key) - 1] = 0;
+    mRecords.push_back(record);
+    return record;
+}
+
+esp_err_t Transaction::set(ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    // the whole transaction is written to a single page, so blobs can't be split into several chunks
+    if ((datatype == ItemType::SZ && dataSize > Page::CHUNK_MAX_SIZE) ||
+            (datatype == ItemType::BLOB && dataSize > Page::CHUNK_MAX_SIZE - Page::ENTRY_SIZE)) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    uint8_t* copy = nullptr;
+    if (dataSize > 0) {
+        copy = new uint8_t[dataSize];
+        memcpy(copy, data, dataSize);
+    }
+    Record* record = getRecord(key);
+    record->datatype = datatype;
+    record->data = copy;
+    record->dataSize = dataSize;
+    return ESP_OK;
+}
+
+void Transaction::clear()
+{
+    while (!mRecords.empty()) {
+        Record* record = &mRecords.front();
+        mRecords.erase(record);
+        delete[] record->data;
+        delete record;
+    }
+}
+
+} // namespace nvs
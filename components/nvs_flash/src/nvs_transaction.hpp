@@ -0,0 +1,87 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_transaction_hpp
+#define nvs_transaction_hpp
+
+#include "nvs.h"
+#include "nvs_types.hpp"
+#include "intrusive_list.h"
+
+namespace nvs
+{
+
+/**
+ * Changes staged on a handle opened in NVS_READWRITE_TRANSACTION mode.
+ *
+ * There is at most one record per key: setting a key which already has a record
+ * replaces it. Records keep the order in which keys were first staged.
+ * Storage::writeTransaction applies the records to flash.
+ */
+class Transaction
+{
+public:
+    class Record : public intrusive_list_node<Record>
+    {
+    public:
+        ItemType datatype;
+        char key[Item::MAX_KEY_LENGTH + 1];
+        uint8_t* data = nullptr;
+        size_t dataSize = 0;
+    };
+
+    typedef intrusive_list<Record> TRecordList;
+
+    Transaction() {}
+    ~Transaction();
+
+    esp_err_t set(ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    Record* find(const char* key);
+
+    /* Drop all staged changes */
+    void clear();
+
+    TRecordList::iterator begin()
+    {
+        return mRecords.begin();
+    }
+
+    TRecordList::iterator end()
+    {
+        return mRecords.end();
+    }
+
+    size_t size() const
+    {
+        return mRecords.size();
+    }
+
+    bool empty() const
+    {
+        return mRecords.empty();
+    }
+
+private:
+    Transaction(const Transaction& other);
+    const Transaction& operator= (const Transaction& rhs);
+
+    Record* getRecord(const char* key);
+
+    TRecordList mRecords;
+}; // class Transaction
+
+} // namespace nvs
+
+#endif /* nvs_transaction_hpp */
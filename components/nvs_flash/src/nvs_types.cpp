@@ -12,12 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "nvs_types.hpp"
-
-#if defined(ESP_PLATFORM)
-#include <rom/crc.h>
-#else
-#include "crc.h"
-#endif
+#include "esp_crc.h"
 
 namespace nvs
 {
@@ -25,10 +20,10 @@ uint32_t Item::calculateCrc32() const
 {
     uint32_t result = 0xffffffff;
     const uint8_t* p = reinterpret_cast<const uint8_t*>(this);
-    result = crc32_le(result, p + offsetof(Item, nsIndex),
-                      offsetof(Item, crc32) - offsetof(Item, nsIndex));
-    result = crc32_le(result, p + offsetof(Item, key), sizeof(key));
-    result = crc32_le(result, p + offsetof(Item, data), sizeof(data));
+    result = esp_crc32_le(result, p + offsetof(Item, nsIndex),
+                          offsetof(Item, crc32) - offsetof(Item, nsIndex));
+    result = esp_crc32_le(result, p + offsetof(Item, key), sizeof(key));
+    result = esp_crc32_le(result, p + offsetof(Item, data), sizeof(data));
     return result;
 }
 
@@ -36,17 +31,17 @@ uint32_t Item::calculateCrc32WithoutValue() const
 {
     uint32_t result = 0xffffffff;
     const uint8_t* p = reinterpret_cast<const uint8_t*>(this);
-    result = crc32_le(result, p + offsetof(Item, nsIndex),
-                      offsetof(Item, datatype) - offsetof(Item, nsIndex));
-    result = crc32_le(result, p + offsetof(Item, key), sizeof(key));
-    result = crc32_le(result, p + offsetof(Item, chunkIndex), sizeof(chunkIndex));
+    result = esp_crc32_le(result, p + offsetof(Item, nsIndex),
+                          offsetof(Item, datatype) - offsetof(Item, nsIndex));
+    result = esp_crc32_le(result, p + offsetof(Item, key), sizeof(key));
+    result = esp_crc32_le(result, p + offsetof(Item, chunkIndex), sizeof(chunkIndex));
     return result;
 }
 
 uint32_t Item::calculateCrc32(const uint8_t* data, size_t size)
 {
     uint32_t result = 0xffffffff;
-    result = crc32_le(result, data, size);
+    result = esp_crc32_le(result, data, size);
     return result;
 }
 
@@ -14,10 +14,12 @@
 #include "catch.hpp"
 #include "nvs.hpp"
 #include "nvs_test_api.h"
+#include "nvs_handle_table.hpp"
 #ifdef CONFIG_NVS_ENCRYPTION
 #include "nvs_encr.hpp"
 #endif
 #include "spi_flash_emulation.h"
+#include "esp_crc.h"
 #include <sstream>
 #include <iostream>
 #include <fstream>
@@ -25,6 +27,9 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
 
 #define TEST_ESP_ERR(rc, res) CHECK((rc) == (res))
 #define TEST_ESP_OK(rc) CHECK((rc) == ESP_OK)
@@ -289,9 +294,14 @@ TEST_CASE("Page handles invalid CRC of variable length items", "[nvs][cur]")
 class HashListTestHelper : public HashList
 {
     public:
-        size_t getBlockCount()
+        bool hasTable()
         {
-            return mBlockList.size();
+            return mSlots != nullptr;
+        }
+
+        size_t getTableSize()
+        {
+            return mSlotCount * sizeof(HashListNode);
         }
 };
 
@@ -299,19 +309,19 @@ TEST_CASE("HashList is cleaned up as soon as items are erased", "[nvs]")
 {
     HashListTestHelper hashlist;
     // Add items
-    const size_t count = 128;
+    const size_t count = HashList::MAX_ITEMS;
     for (size_t i = 0; i < count; ++i) {
         char key[16];
         snprintf(key, sizeof(key), "i%ld", (long int)i);
         Item item(1, ItemType::U32, 1, key);
         hashlist.insert(item, i);
     }
-    INFO("Added " << count << " items, " << hashlist.getBlockCount() << " blocks");
+    CHECK(hashlist.hasTable());
     // Remove them in reverse order
     for (size_t i = count; i > 0; --i) {
         hashlist.erase(i - 1, true);
     }
-    CHECK(hashlist.getBlockCount() == 0);
+    CHECK(!hashlist.hasTable());
     // Add again
     for (size_t i = 0; i < count; ++i) {
         char key[16];
@@ -319,12 +329,62 @@ TEST_CASE("HashList is cleaned up as soon as items are erased", "[nvs]")
         Item item(1, ItemType::U32, 1, key);
         hashlist.insert(item, i);
     }
-    INFO("Added " << count << " items, " << hashlist.getBlockCount() << " blocks");
+    CHECK(hashlist.hasTable());
     // Remove them in the same order
     for (size_t i = 0; i < count; ++i) {
         hashlist.erase(i, true);
     }
-    CHECK(hashlist.getBlockCount() == 0);
+    CHECK(!hashlist.hasTable());
+}
+
+TEST_CASE("HashList table size follows the number of items", "[nvs]")
+{
+    HashListTestHelper hashlist;
+    const size_t count = HashList::MAX_ITEMS;
+    for (size_t i = 0; i < count; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "i%ld", (long int)i);
+        hashlist.insert(Item(1, ItemType::U32, 1, key), i);
+        if (i + 1 == 8) {
+            CHECK(hashlist.getTableSize() <= 64);
+        }
+    }
+    CHECK(hashlist.getTableSize() <= 576);
+    for (size_t i = count; i > 8; --i) {
+        hashlist.erase(i - 1, true);
+    }
+    CHECK(hashlist.getTableSize() <= 64);
+    for (size_t i = 0; i < 8; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "i%ld", (long int)i);
+        CHECK(hashlist.find(0, Item(1, ItemType::U32, 1, key)) == i);
+    }
+}
+
+TEST_CASE("HashList finds items after erasing colliding neighbours", "[nvs]")
+{
+    HashList hashlist;
+    const size_t count = HashList::MAX_ITEMS;
+    for (size_t i = 0; i < count; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "i%ld", (long int)i);
+        hashlist.insert(Item(1, ItemType::U32, 1, key), i);
+    }
+    // erase every third item, remaining ones have to be found at their index
+    for (size_t i = 0; i < count; i += 3) {
+        hashlist.erase(i, true);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "i%ld", (long int)i);
+        size_t expected = (i % 3 == 0) ? SIZE_MAX : i;
+        CHECK(hashlist.find(0, Item(1, ItemType::U32, 1, key)) == expected);
+    }
+    // lowest index at or after start is returned for duplicates
+    hashlist.insert(Item(1, ItemType::U32, 1, "i1"), 0);
+    CHECK(hashlist.find(0, Item(1, ItemType::U32, 1, "i1")) == 0);
+    CHECK(hashlist.find(1, Item(1, ItemType::U32, 1, "i1")) == 1);
+    CHECK(hashlist.find(2, Item(1, ItemType::U32, 1, "i1")) == SIZE_MAX);
 }
 
 TEST_CASE("can init PageManager in empty flash", "[nvs]")
@@ -1390,6 +1450,10 @@ TEST_CASE("multiple partitions access check", "[nvs]")
     TEST_ESP_OK( nvs_get_i32(handle2, "foo", &v2));
     CHECK(v1 == 0xdeadbeef);
     CHECK(v2 == 0xcafebabe);
+    nvs_close(handle1);
+    nvs_close(handle2);
+    TEST_ESP_OK( nvs_flash_deinit_partition("nvs1") );
+    TEST_ESP_OK( nvs_flash_deinit_partition("nvs2") );
 }
 
 TEST_CASE("nvs page selection takes into account free entries also not just erased entries", "[nvs]")
@@ -1875,6 +1939,8 @@ TEST_CASE("Check that NVS supports old blob format without blob index", "[nvs]")
     TEST_ESP_OK( nvs_get_blob(handle, "dummyBase64Key", buf, &buflen));
     CHECK(memcmp(buf, base64data, buflen) == 0);
 
+    nvs_close(handle);
+    TEST_ESP_OK( nvs_flash_deinit_partition("test") );
 }
 
 TEST_CASE("monkey test with old-format blob present", "[nvs][monkey]")
@@ -3034,6 +3100,1104 @@ TEST_CASE("check and read data from partition generated via manufacturing utilit
 }
 #endif
 
+TEST_CASE("item index speeds up lookups in a large partition", "[nvs]")
+{
+    const size_t sectorCount = 64;
+    const size_t lookupCount = 2000;
+    SpiFlashEmulator emu(sectorCount);
+
+    /* Fill all but one page with single-entry items, so that lookups of keys
+     * in the last page and of missing keys have to visit every page */
+    size_t itemCount = 0;
+    for (size_t sector = 0; sector < sectorCount - 1; ++sector) {
+        Page p;
+        TEST_ESP_OK(p.load(sector));
+        TEST_ESP_OK(p.setSeqNumber(sector));
+        for (size_t i = 0; i < Page::ENTRY_COUNT; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(itemCount));
+            TEST_ESP_OK(p.writeItem(1, key, static_cast<uint32_t>(itemCount)));
+            ++itemCount;
+        }
+        TEST_ESP_OK(p.markFull());
+    }
+
+    auto measure = [&](size_t maxItems, size_t& readOps) -> double {
+        Storage storage;
+        storage.setItemIndexMaxItems(maxItems);
+        storage.setReadCacheSize(0);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        emu.clearStats();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookupCount; ++i) {
+            char key[16];
+            uint32_t value;
+            size_t n = itemCount - 1 - i % Page::ENTRY_COUNT;
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(n));
+            REQUIRE(storage.readItem(1, key, value) == ESP_OK);
+            REQUIRE(value == n);
+            snprintf(key, sizeof(key), "missing%d", static_cast<int>(i));
+            REQUIRE(storage.readItem(1, key, value) == ESP_ERR_NVS_NOT_FOUND);
+        }
+        auto end = std::chrono::steady_clock::now();
+        readOps = emu.getReadOps();
+        return std::chrono::duration<double, std::micro>(end - start).count() / (2 * lookupCount);
+    };
+
+    size_t pageReadOps, indexReadOps;
+    double pageTime = measure(0, pageReadOps);
+    double indexTime = measure(sectorCount * Page::ENTRY_COUNT, indexReadOps);
+    CHECK(indexReadOps <= pageReadOps);
+
+    s_perf << "Average lookup time in " << sectorCount << " pages (" << itemCount << " items): "
+           << pageTime << " us searching page by page, " << indexTime << " us with item index" << std::endl;
+}
+
+TEST_CASE("transaction handle stages changes until commit", "[nvs]")
+{
+    SpiFlashEmulator emu(3);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+    nvs_handle handle, txn;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "a", 1));
+    TEST_ESP_OK(nvs_set_i32(handle, "gone", 5));
+
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE_TRANSACTION, &txn));
+    emu.clearStats();
+    TEST_ESP_OK(nvs_set_i32(txn, "a", 2));
+    TEST_ESP_OK(nvs_set_str(txn, "s", "staged"));
+    TEST_ESP_ERR(nvs_erase_key(txn, "gone"), ESP_ERR_NOT_SUPPORTED);
+    TEST_ESP_OK(nvs_set_i32(txn, "a", 3));
+    TEST_ESP_ERR(nvs_set_i32(txn, "key_is_too_long_", 0), ESP_ERR_NVS_KEY_TOO_LONG);
+    TEST_ESP_ERR(nvs_erase_all(txn), ESP_ERR_NOT_SUPPORTED);
+    CHECK(emu.getWriteOps() == 0);
+
+    int32_t v;
+    char buf[16];
+    size_t len = sizeof(buf);
+    TEST_ESP_OK(nvs_get_i32(txn, "a", &v));
+    CHECK(v == 3);
+    TEST_ESP_OK(nvs_get_str(txn, "s", buf, &len));
+    CHECK(strcmp(buf, "staged") == 0);
+
+    TEST_ESP_OK(nvs_get_i32(handle, "a", &v));
+    CHECK(v == 1);
+    len = sizeof(buf);
+    TEST_ESP_ERR(nvs_get_str(handle, "s", buf, &len), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(nvs_get_i32(handle, "gone", &v));
+    CHECK(v == 5);
+
+    TEST_ESP_OK(nvs_commit(txn));
+    TEST_ESP_OK(nvs_get_i32(handle, "a", &v));
+    CHECK(v == 3);
+    len = sizeof(buf);
+    TEST_ESP_OK(nvs_get_str(handle, "s", buf, &len));
+    CHECK(strcmp(buf, "staged") == 0);
+    TEST_ESP_OK(nvs_get_i32(handle, "gone", &v));
+    CHECK(v == 5);
+
+    // uncommitted changes are dropped on close
+    TEST_ESP_OK(nvs_set_i32(txn, "a", 4));
+    nvs_close(txn);
+    TEST_ESP_OK(nvs_get_i32(handle, "a", &v));
+    CHECK(v == 3);
+
+    // all values of a transaction have to fit into one page
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE_TRANSACTION, &txn));
+    uint8_t blob[Page::CHUNK_MAX_SIZE] = {0};
+    TEST_ESP_ERR(nvs_set_blob(txn, "big", blob, sizeof(blob)), ESP_ERR_NVS_VALUE_TOO_LONG);
+    TEST_ESP_OK(nvs_set_blob(txn, "b1", blob, sizeof(blob) - Page::ENTRY_SIZE));
+    TEST_ESP_OK(nvs_set_blob(txn, "b2", blob, 64));
+    TEST_ESP_ERR(nvs_commit(txn), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    nvs_close(txn);
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE_TRANSACTION, &txn));
+    TEST_ESP_OK(nvs_set_blob(txn, "b1", blob, sizeof(blob) - Page::ENTRY_SIZE));
+    TEST_ESP_OK(nvs_commit(txn));
+    len = sizeof(blob);
+    TEST_ESP_OK(nvs_get_blob(handle, "b1", blob, &len));
+    CHECK(len == sizeof(blob) - Page::ENTRY_SIZE);
+    nvs_close(txn);
+    nvs_close(handle);
+}
+
+TEST_CASE("transaction commit is all-or-nothing when power is lost", "[nvs]")
+{
+    const size_t keyCount = 20;
+    uint8_t oldBlob[200];
+    uint8_t newBlob[200];
+    std::fill_n(oldBlob, sizeof(oldBlob), 0x11);
+    std::fill_n(newBlob, sizeof(newBlob), 0x55);
+    // data entries which start with a blank word must not stop recovery of a half-written commit
+    std::fill_n(newBlob + Page::ENTRY_SIZE, Page::ENTRY_SIZE, 0xff);
+
+    for (uint32_t failAt = 0; ; ++failAt) {
+        SpiFlashEmulator emu(4);
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 4));
+        nvs_handle handle;
+        char key[16];
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+            TEST_ESP_OK(nvs_set_u32(handle, key, i));
+        }
+        TEST_ESP_OK(nvs_set_str(handle, "str", "old value"));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", oldBlob, sizeof(oldBlob)));
+        nvs_close(handle);
+
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE_TRANSACTION, &handle));
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+            TEST_ESP_OK(nvs_set_u32(handle, key, i + 1000));
+        }
+        TEST_ESP_OK(nvs_set_str(handle, "str", "new value"));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", newBlob, sizeof(newBlob)));
+        emu.failAfter(failAt);
+        esp_err_t commitErr = nvs_commit(handle);
+        nvs_close(handle);
+        emu.failAfter(UINT32_MAX);
+
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 4));
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        size_t newCount = 0;
+        for (size_t i = 0; i < keyCount; ++i) {
+            uint32_t v;
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+            TEST_ESP_OK(nvs_get_u32(handle, key, &v));
+            REQUIRE((v == i || v == i + 1000));
+            newCount += (v == i + 1000);
+        }
+        char str[16];
+        size_t len = sizeof(str);
+        TEST_ESP_OK(nvs_get_str(handle, "str", str, &len));
+        newCount += (strcmp(str, "new value") == 0);
+        uint8_t blob[sizeof(newBlob)];
+        len = sizeof(blob);
+        TEST_ESP_OK(nvs_get_blob(handle, "blob", blob, &len));
+        REQUIRE(len == sizeof(blob));
+        newCount += (memcmp(blob, newBlob, sizeof(blob)) == 0);
+        REQUIRE((newCount == 0 || newCount == keyCount + 2));
+        if (commitErr == ESP_OK) {
+            CHECK(newCount == keyCount + 2);
+        }
+
+        // writes after recovery must succeed, and storage must be free of duplicates (checked on write)
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "after%d", static_cast<int>(i));
+            TEST_ESP_OK(nvs_set_str(handle, key, "value written after recovery"));
+        }
+        nvs_close(handle);
+        if (commitErr == ESP_OK) {
+            break;
+        }
+    }
+}
+
+TEST_CASE("transaction reduces flash operations of a provisioning step", "[nvs]")
+{
+    const size_t keyCount = 40;
+    const char value[] = "provisioning value";
+    auto measure = [&](nvs_open_mode mode, size_t& writeOps) -> size_t {
+        SpiFlashEmulator emu(8);
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 8));
+        nvs_handle handle;
+        TEST_ESP_OK(nvs_open("prov", mode, &handle));
+        emu.clearStats();
+        for (size_t i = 0; i < keyCount; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+            if (i % 2) {
+                TEST_ESP_OK(nvs_set_u32(handle, key, i));
+            } else {
+                TEST_ESP_OK(nvs_set_str(handle, key, value));
+            }
+        }
+        TEST_ESP_OK(nvs_commit(handle));
+        nvs_close(handle);
+        writeOps = emu.getWriteOps();
+        return emu.getTotalTime();
+    };
+
+    size_t plainOps, txnOps;
+    size_t plainTime = measure(NVS_READWRITE, plainOps);
+    size_t txnTime = measure(NVS_READWRITE_TRANSACTION, txnOps);
+    CHECK(txnOps < plainOps);
+    CHECK(txnTime < plainTime);
+
+    s_perf << "Time to write " << keyCount << " keys: " << plainTime << " us (" << plainOps << " write ops) one by one, "
+           << txnTime << " us (" << txnOps << " write ops) in one transaction" << std::endl;
+}
+
+TEST_CASE("mount time of a 1 MB partition", "[nvs]")
+{
+    const size_t sectorCount = 256;
+    const size_t nsCount = 4;
+    const size_t blobSize = 600;
+    SpiFlashEmulator emu(sectorCount);
+
+    /* Fill all but the last page with a mix of integers, strings and blobs spread over
+     * several namespaces. Every 16th page also gets a blob data chunk without an index,
+     * which has to be removed during mount. */
+    uint8_t blob[blobSize];
+    std::fill_n(blob, blobSize, 0x5a);
+    size_t itemCount = 0;
+    for (size_t sector = 0; sector < sectorCount - 1; ++sector) {
+        Page p;
+        TEST_ESP_OK(p.load(sector));
+        TEST_ESP_OK(p.setSeqNumber(sector));
+        char key[16];
+        if (sector == 0) {
+            for (size_t ns = 1; ns <= nsCount; ++ns) {
+                snprintf(key, sizeof(key), "ns%d", static_cast<int>(ns));
+                TEST_ESP_OK(p.writeItem(Page::NS_INDEX, key, static_cast<uint8_t>(ns)));
+            }
+        }
+        const uint8_t ns = 1 + sector % nsCount;
+        snprintf(key, sizeof(key), "blob%d", static_cast<int>(sector));
+        TEST_ESP_OK(p.writeItem(ns, ItemType::BLOB_DATA, key, blob, blobSize, static_cast<uint8_t>(VerOffset::VER_0_OFFSET)));
+        Item idx;
+        std::fill_n(idx.data, sizeof(idx.data), 0xff);
+        idx.blobIndex.dataSize = blobSize;
+        idx.blobIndex.chunkCount = 1;
+        idx.blobIndex.chunkStart = VerOffset::VER_0_OFFSET;
+        TEST_ESP_OK(p.writeItem(ns, ItemType::BLOB_IDX, key, idx.data, sizeof(idx.data)));
+        if (sector % 16 == 0) {
+            snprintf(key, sizeof(key), "orphan%d", static_cast<int>(sector));
+            TEST_ESP_OK(p.writeItem(ns, ItemType::BLOB_DATA, key, blob, 64, static_cast<uint8_t>(VerOffset::VER_1_OFFSET)));
+        }
+        for (size_t i = 0; i < 10; ++i, ++itemCount) {
+            snprintf(key, sizeof(key), "str%d", static_cast<int>(itemCount));
+            TEST_ESP_OK(p.writeItem(ns, ItemType::SZ, key, "some string value of forty bytes or so", 40));
+        }
+        while (p.getVarDataTailroom() > 0) {
+            snprintf(key, sizeof(key), "int%d", static_cast<int>(itemCount++));
+            TEST_ESP_OK(p.writeItem(ns, key, static_cast<uint32_t>(itemCount)));
+        }
+        if (sector < sectorCount - 2) {
+            TEST_ESP_OK(p.markFull());
+        }
+    }
+
+    emu.clearStats();
+    Storage storage;
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    const size_t mountTime = emu.getTotalTime();
+    const size_t mountReadOps = emu.getReadOps();
+
+    size_t len;
+    TEST_ESP_OK(storage.getItemDataSize(1, ItemType::BLOB, "blob0", len));
+    CHECK(len == blobSize);
+    uint8_t nsIndex;
+    TEST_ESP_OK(storage.createOrOpenNamespace("ns4", false, nsIndex));
+    CHECK(nsIndex == 4);
+    for (size_t sector = 0; sector < sectorCount - 1; sector += 16) {
+        Page p;
+        TEST_ESP_OK(p.load(sector));
+        char key[16];
+        snprintf(key, sizeof(key), "orphan%d", static_cast<int>(sector));
+        CHECK(p.findItem(1 + sector % nsCount, ItemType::BLOB_DATA, key,
+                static_cast<uint8_t>(VerOffset::VER_1_OFFSET)) == ESP_ERR_NVS_NOT_FOUND);
+    }
+
+    s_perf << "Time to mount 1 MB partition (" << sectorCount << " pages, " << itemCount << " items): "
+           << mountTime << " us (" << mountReadOps << " read ops)" << std::endl;
+}
+
+TEST_CASE("read cache serves repeated reads without accessing flash", "[nvs]")
+{
+    SpiFlashEmulator emu(8);
+    Storage storage;
+    storage.setReadCacheSize(1024);
+    TEST_ESP_OK(storage.init(0, 8));
+
+    const char str[] = "calibration";
+    uint8_t blob[64];
+    std::fill_n(blob, sizeof(blob), 0xa5);
+    TEST_ESP_OK(storage.writeItem(1, "flag", static_cast<uint32_t>(1)));
+    TEST_ESP_OK(storage.writeItem(1, ItemType::SZ, "str", str, sizeof(str)));
+    TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "blob", blob, sizeof(blob)));
+    TEST_ESP_OK(storage.writeItem(2, "flag", static_cast<uint32_t>(2)));
+
+    auto readAll = [&]() {
+        uint32_t value;
+        TEST_ESP_OK(storage.readItem(1, "flag", value));
+        CHECK(value == 1);
+        char strBuf[sizeof(str)];
+        size_t len;
+        TEST_ESP_OK(storage.getItemDataSize(1, ItemType::SZ, "str", len));
+        CHECK(len == sizeof(str));
+        TEST_ESP_OK(storage.readItem(1, ItemType::SZ, "str", strBuf, len));
+        CHECK(strcmp(strBuf, str) == 0);
+        uint8_t blobBuf[sizeof(blob)];
+        TEST_ESP_OK(storage.getItemDataSize(1, ItemType::BLOB, "blob", len));
+        CHECK(len == sizeof(blob));
+        TEST_ESP_OK(storage.readItem(1, ItemType::BLOB, "blob", blobBuf, len));
+        CHECK(memcmp(blobBuf, blob, sizeof(blob)) == 0);
+        TEST_ESP_OK(storage.readItem(2, "flag", value));
+        CHECK(value == 2);
+    };
+
+    readAll();
+    nvs_cache_stats_t stats;
+    storage.fillCacheStats(stats);
+    CHECK(stats.hits == 0);
+    CHECK(stats.misses == 4);
+    CHECK(stats.entry_count == 4);
+    CHECK(stats.total_bytes == 1024);
+    CHECK(stats.used_bytes > sizeof(str) + sizeof(blob));
+    CHECK(stats.used_bytes <= stats.total_bytes);
+
+    emu.clearStats();
+    readAll();
+    CHECK(emu.getReadOps() == 0);
+    storage.fillCacheStats(stats);
+    CHECK(stats.hits == 4);
+    CHECK(stats.misses == 4);
+
+    /* writes and erasures drop the cached values */
+    uint32_t value;
+    TEST_ESP_OK(storage.writeItem(1, "flag", static_cast<uint32_t>(3)));
+    TEST_ESP_OK(storage.readItem(1, "flag", value));
+    CHECK(value == 3);
+    TEST_ESP_OK(storage.eraseItem(1, "flag"));
+    TEST_ESP_ERR(storage.readItem(1, "flag", value), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(storage.readItem(2, "flag", value));
+    CHECK(value == 2);
+    uint8_t blobBuf[sizeof(blob)];
+    TEST_ESP_OK(storage.eraseItem(1, ItemType::BLOB, "blob"));
+    TEST_ESP_ERR(storage.readItem(1, ItemType::BLOB, "blob", blobBuf, sizeof(blobBuf)), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(storage.eraseNamespace(2));
+    TEST_ESP_ERR(storage.readItem(2, "flag", value), ESP_ERR_NVS_NOT_FOUND);
+    size_t len;
+    TEST_ESP_OK(storage.getItemDataSize(1, ItemType::SZ, "str", len));
+
+    Transaction transaction;
+    TEST_ESP_OK(transaction.set(ItemType::SZ, "str", "updated", 8));
+    TEST_ESP_OK(storage.writeTransaction(1, transaction));
+    TEST_ESP_OK(storage.getItemDataSize(1, ItemType::SZ, "str", len));
+    CHECK(len == 8);
+    char strBuf[8];
+    TEST_ESP_OK(storage.readItem(1, ItemType::SZ, "str", strBuf, len));
+    CHECK(strcmp(strBuf, "updated") == 0);
+
+    /* cache is dropped on init */
+    TEST_ESP_OK(storage.init(0, 8));
+    storage.fillCacheStats(stats);
+    CHECK(stats.entry_count == 0);
+    CHECK(stats.used_bytes == 0);
+    CHECK(stats.hits == 0);
+    CHECK(stats.misses == 0);
+}
+
+TEST_CASE("read cache evicts least recently used values", "[nvs]")
+{
+    const size_t budget = 512;
+    const size_t keyCount = 32;
+    SpiFlashEmulator emu(8);
+    Storage storage;
+    storage.setReadCacheSize(budget);
+    TEST_ESP_OK(storage.init(0, 8));
+
+    char key[16];
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+        TEST_ESP_OK(storage.writeItem(1, key, static_cast<uint32_t>(i)));
+    }
+    uint32_t value;
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+        TEST_ESP_OK(storage.readItem(1, key, value));
+        CHECK(value == i);
+    }
+    nvs_cache_stats_t stats;
+    storage.fillCacheStats(stats);
+    CHECK(stats.entry_count < keyCount);
+    CHECK(stats.used_bytes <= budget);
+
+    /* the first key has been evicted, the last one is still cached */
+    emu.clearStats();
+    snprintf(key, sizeof(key), "key%d", static_cast<int>(keyCount - 1));
+    TEST_ESP_OK(storage.readItem(1, key, value));
+    CHECK(emu.getReadOps() == 0);
+    TEST_ESP_OK(storage.readItem(1, "key0", value));
+    CHECK(emu.getReadOps() > 0);
+
+    /* values larger than a quarter of the budget are not cached */
+    uint8_t blob[budget / 4];
+    TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "blob", blob, sizeof(blob)));
+    TEST_ESP_OK(storage.readItem(1, ItemType::BLOB, "blob", blob, sizeof(blob)));
+    emu.clearStats();
+    TEST_ESP_OK(storage.readItem(1, ItemType::BLOB, "blob", blob, sizeof(blob)));
+    CHECK(emu.getReadOps() > 0);
+}
+
+TEST_CASE("read cache statistics can be obtained through the API", "[nvs]")
+{
+    const size_t readCount = 1000;
+    SpiFlashEmulator emu(8);
+    nvs_cache_stats_t stats;
+    TEST_ESP_ERR(nvs_get_cache_stats(NULL, NULL), ESP_ERR_INVALID_ARG);
+    TEST_ESP_ERR(nvs_get_cache_stats("nonexistent", &stats), ESP_ERR_NVS_NOT_INITIALIZED);
+
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 8));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("calib", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "offset", -42));
+    TEST_ESP_OK(nvs_set_str(handle, "mode", "fast"));
+    for (size_t i = 0; i < readCount; ++i) {
+        int32_t offset;
+        TEST_ESP_OK(nvs_get_i32(handle, "offset", &offset));
+        CHECK(offset == -42);
+        char mode[8];
+        size_t len = sizeof(mode);
+        TEST_ESP_OK(nvs_get_str(handle, "mode", mode, &len));
+        CHECK(strcmp(mode, "fast") == 0);
+    }
+    nvs_close(handle);
+
+    TEST_ESP_OK(nvs_get_cache_stats(NULL, &stats));
+    CHECK(stats.entry_count == 2);
+    CHECK(stats.misses == 2);
+    CHECK(stats.hits == 2 * readCount - 2);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("read cache reduces time to read hot keys", "[nvs]")
+{
+    const size_t keyCount = 8;
+    const size_t readCount = 1000;
+    auto measure = [&](size_t cacheSize, size_t& readOps) -> size_t {
+        SpiFlashEmulator emu(8);
+        Storage storage;
+        storage.setReadCacheSize(cacheSize);
+        TEST_ESP_OK(storage.init(0, 8));
+        char key[16];
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "flag%d", static_cast<int>(i));
+            TEST_ESP_OK(storage.writeItem(1, key, static_cast<uint8_t>(i)));
+        }
+        emu.clearStats();
+        for (size_t i = 0; i < readCount; ++i) {
+            snprintf(key, sizeof(key), "flag%d", static_cast<int>(i % keyCount));
+            uint8_t value;
+            TEST_ESP_OK(storage.readItem(1, key, value));
+            CHECK(value == i % keyCount);
+        }
+        readOps = emu.getReadOps();
+        return emu.getTotalTime();
+    };
+
+    size_t plainOps, cachedOps;
+    size_t plainTime = measure(0, plainOps);
+    size_t cachedTime = measure(1024, cachedOps);
+    CHECK(cachedOps < plainOps);
+    CHECK(cachedTime < plainTime);
+
+    s_perf << "Time to read " << keyCount << " keys " << readCount << " times: " << plainTime << " us (" << plainOps << " read ops) from flash, "
+           << cachedTime << " us (" << cachedOps << " read ops) with read cache" << std::endl;
+}
+
+TEST_CASE("concurrent readers never see partially written values", "[nvs]")
+{
+    const uint32_t writeCount = 1000;
+    const size_t readersPerPartition = 3;
+    const char* partNames[] = { NVS_DEFAULT_PART_NAME, "other" };
+    SpiFlashEmulator emu(16);
+    TEST_ESP_OK(nvs_flash_init_custom(partNames[0], 0, 8));
+    TEST_ESP_OK(nvs_flash_init_custom(partNames[1], 8, 8));
+
+    /* Each value consists of several copies of the same counter, so that a value mixing
+     * two writes can be detected. Catch assertions are not thread safe, so threads only count errors. */
+    auto writeValues = [](nvs_handle handle, uint32_t counter) -> esp_err_t {
+        uint32_t blob[32];
+        std::fill_n(blob, sizeof(blob) / sizeof(blob[0]), counter);
+        char str[32];
+        snprintf(str, sizeof(str), "%u-%u", counter, counter);
+        esp_err_t err = nvs_set_u64(handle, "u64", (static_cast<uint64_t>(counter) << 32) | counter);
+        if (err == ESP_OK) {
+            err = nvs_set_blob(handle, "blob", blob, sizeof(blob));
+        }
+        if (err == ESP_OK) {
+            err = nvs_set_str(handle, "str", str);
+        }
+        return err;
+    };
+    auto readValues = [](nvs_handle handle, uint32_t& counter) -> bool {
+        uint64_t u64;
+        if (nvs_get_u64(handle, "u64", &u64) != ESP_OK || static_cast<uint32_t>(u64 >> 32) != static_cast<uint32_t>(u64)) {
+            return false;
+        }
+        counter = static_cast<uint32_t>(u64);
+        uint32_t blob[32];
+        size_t len = sizeof(blob);
+        if (nvs_get_blob(handle, "blob", blob, &len) != ESP_OK || len != sizeof(blob) ||
+                std::count(blob, blob + sizeof(blob) / sizeof(blob[0]), blob[0]) != sizeof(blob) / sizeof(blob[0])) {
+            return false;
+        }
+        char str[32];
+        len = sizeof(str);
+        unsigned first, second;
+        if (nvs_get_str(handle, "str", str, &len) != ESP_OK || sscanf(str, "%u-%u", &first, &second) != 2 || first != second) {
+            return false;
+        }
+        return true;
+    };
+
+    nvs_handle writeHandles[2];
+    for (size_t i = 0; i < 2; ++i) {
+        TEST_ESP_OK(nvs_open_from_partition(partNames[i], "stress", NVS_READWRITE, &writeHandles[i]));
+        TEST_ESP_OK(writeValues(writeHandles[i], 0));
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<size_t> errors(0);
+    std::atomic<size_t> reads(0);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 2; ++i) {
+        threads.emplace_back([&, i]() {
+            for (uint32_t counter = 1; counter <= writeCount; ++counter) {
+                if (writeValues(writeHandles[i], counter) != ESP_OK) {
+                    ++errors;
+                }
+            }
+        });
+        for (size_t j = 0; j < readersPerPartition; ++j) {
+            threads.emplace_back([&, i]() {
+                nvs_handle handle;
+                if (nvs_open_from_partition(partNames[i], "stress", NVS_READONLY, &handle) != ESP_OK) {
+                    ++errors;
+                    return;
+                }
+                uint32_t last = 0;
+                while (!done) {
+                    uint32_t counter = 0;
+                    if (!readValues(handle, counter) || counter < last) {
+                        ++errors;
+                    } else {
+                        last = counter;
+                    }
+                    nvs_stats_t stats;
+                    if (nvs_get_stats(partNames[i], &stats) != ESP_OK) {
+                        ++errors;
+                    }
+                    ++reads;
+                }
+                nvs_close(handle);
+            });
+        }
+    }
+    threads[0].join();
+    threads[readersPerPartition + 1].join();
+    done = true;
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    CHECK(errors == 0);
+    CHECK(reads > 0);
+    for (size_t i = 0; i < 2; ++i) {
+        uint32_t counter = 0;
+        CHECK(readValues(writeHandles[i], counter));
+        CHECK(counter == writeCount);
+        nvs_close(writeHandles[i]);
+        TEST_ESP_OK(nvs_flash_deinit_partition(partNames[i]));
+    }
+}
+
+TEST_CASE("handle table detects stale handles after slots are reused", "[nvs]")
+{
+    HandleTable table;
+    auto entry = table.add();
+    REQUIRE(entry != nullptr);
+    nvs_handle first = entry->mHandle;
+    CHECK(first != 0);
+    CHECK(table.find(first) == entry);
+    CHECK(table.find(0) == nullptr);
+    CHECK(table.find(first + 1) == nullptr);
+    table.remove(entry);
+    CHECK(table.find(first) == nullptr);
+
+    /* keep reusing slots until the first one comes around again */
+    for (size_t i = 0; i < HandleTable::INITIAL_SLOTS; ++i) {
+        entry = table.add();
+        REQUIRE(entry != nullptr);
+        CHECK(entry->mHandle != first);
+        CHECK(table.find(first) == nullptr);
+        table.remove(entry);
+    }
+    CHECK(table.size() == 0);
+    CHECK(table.capacity() == HandleTable::INITIAL_SLOTS);
+
+    /* the table grows when all slots are in use, handles stay valid */
+    const size_t count = HandleTable::INITIAL_SLOTS * 2 + 1;
+    nvs_handle handles[count];
+    for (size_t i = 0; i < count; ++i) {
+        entry = table.add();
+        REQUIRE(entry != nullptr);
+        handles[i] = entry->mHandle;
+    }
+    CHECK(table.size() == count);
+    CHECK(table.capacity() == HandleTable::INITIAL_SLOTS * 4);
+    for (size_t i = 0; i < count; ++i) {
+        entry = table.find(handles[i]);
+        REQUIRE(entry != nullptr);
+        CHECK(entry->mHandle == handles[i]);
+    }
+    table.remove(table.find(handles[0]));
+    CHECK(table.find(handles[0]) == nullptr);
+    entry = table.add();
+    REQUIRE(entry != nullptr);
+    CHECK(entry->mHandle != handles[0]);
+    CHECK(table.capacity() == HandleTable::INITIAL_SLOTS * 4);
+}
+
+TEST_CASE("nvs_open can open more handles than the initial table size", "[nvs]")
+{
+    SpiFlashEmulator emu(4);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 4));
+    const size_t count = HandleTable::INITIAL_SLOTS * 2 + 1;
+    nvs_handle handles[count];
+    for (size_t i = 0; i < count; ++i) {
+        TEST_ESP_OK(nvs_open("ns", NVS_READWRITE, &handles[i]));
+    }
+
+    nvs_handle closed = handles[0];
+    nvs_close(closed);
+    TEST_ESP_OK(nvs_open("ns", NVS_READWRITE, &handles[0]));
+    CHECK(handles[0] != closed);
+    TEST_ESP_ERR(nvs_set_i32(closed, "key", 1), ESP_ERR_NVS_INVALID_HANDLE);
+    TEST_ESP_OK(nvs_set_i32(handles[0], "key", 1));
+    int32_t value;
+    TEST_ESP_OK(nvs_get_i32(handles[count - 1], "key", &value));
+    CHECK(value == 1);
+
+    /* deinit releases handles which haven't been closed */
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 4));
+    TEST_ESP_ERR(nvs_get_i32(handles[1], "key", &value), ESP_ERR_NVS_INVALID_HANDLE);
+    TEST_ESP_ERR(nvs_get_i32(handles[count - 1], "key", &value), ESP_ERR_NVS_INVALID_HANDLE);
+    for (size_t i = 0; i < count; ++i) {
+        TEST_ESP_OK(nvs_open("ns", NVS_READONLY, &handles[i]));
+        nvs_close(handles[i]);
+    }
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob stream writes and reads a large blob in parts", "[nvs]")
+{
+    const size_t blobSize = 60000;
+    const size_t writePart = 1000;
+    const size_t readPart = 777;
+    SpiFlashEmulator emu(20);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 20));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("model", NVS_READWRITE, &handle));
+
+    std::unique_ptr<uint8_t[]> blob(new uint8_t[blobSize]);
+    for (size_t i = 0; i < blobSize; ++i) {
+        blob[i] = static_cast<uint8_t>(i * 7 + i / 256);
+    }
+    nvs_blob_stream_t stream;
+    TEST_ESP_OK(nvs_blob_open_write(handle, "weights", &stream));
+    for (size_t offset = 0; offset < blobSize; offset += writePart) {
+        TEST_ESP_OK(nvs_blob_write(stream, offset, blob.get() + offset, writePart));
+    }
+    TEST_ESP_ERR(nvs_blob_write(stream, 0, blob.get(), writePart), ESP_ERR_INVALID_ARG);
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    /* the blob is readable with nvs_get_blob as well */
+    std::unique_ptr<uint8_t[]> copy(new uint8_t[blobSize]);
+    size_t size = blobSize;
+    TEST_ESP_OK(nvs_get_blob(handle, "weights", copy.get(), &size));
+    CHECK(size == blobSize);
+    CHECK(memcmp(copy.get(), blob.get(), blobSize) == 0);
+
+    size = 0;
+    TEST_ESP_OK(nvs_blob_open_read(handle, "weights", &stream, &size));
+    CHECK(size == blobSize);
+    uint8_t part[readPart];
+    for (size_t offset = 0; offset < blobSize; offset += readPart) {
+        size_t len = std::min(readPart, blobSize - offset);
+        TEST_ESP_OK(nvs_blob_read(stream, offset, part, len));
+        REQUIRE(memcmp(part, blob.get() + offset, len) == 0);
+    }
+    /* reading backwards and across chunk boundaries */
+    for (size_t offset = blobSize - readPart; offset >= 5 * readPart; offset -= 5 * readPart) {
+        TEST_ESP_OK(nvs_blob_read(stream, offset, part, readPart));
+        REQUIRE(memcmp(part, blob.get() + offset, readPart) == 0);
+    }
+    TEST_ESP_ERR(nvs_blob_read(stream, blobSize - 10, part, 11), ESP_ERR_NVS_INVALID_LENGTH);
+    TEST_ESP_ERR(nvs_blob_write(stream, 0, part, 1), ESP_ERR_INVALID_STATE);
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    TEST_ESP_ERR(nvs_blob_open_read(handle, "missing", &stream, &size), ESP_ERR_NVS_NOT_FOUND);
+    nvs_close(handle);
+
+    TEST_ESP_OK(nvs_open("model", NVS_READONLY, &handle));
+    TEST_ESP_ERR(nvs_blob_open_write(handle, "weights", &stream), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob stream stores small writes in page sized chunks", "[nvs]")
+{
+    const size_t blobSize = 20000;
+    const size_t writePart = 16;
+    SpiFlashEmulator emu(10);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 10));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("model", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "other", 1));
+
+    std::unique_ptr<uint8_t[]> blob(new uint8_t[blobSize]);
+    for (size_t i = 0; i < blobSize; ++i) {
+        blob[i] = static_cast<uint8_t>(i * 13);
+    }
+    /* many more writes than the 127 chunks a blob may consist of, with other items written in between */
+    nvs_blob_stream_t stream;
+    TEST_ESP_OK(nvs_blob_open_write(handle, "weights", &stream));
+    for (size_t offset = 0; offset < blobSize; offset += writePart) {
+        TEST_ESP_OK(nvs_blob_write(stream, offset, blob.get() + offset, writePart));
+        if (offset % 4096 == 0) {
+            TEST_ESP_OK(nvs_set_i32(handle, "other", offset));
+        }
+    }
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    std::unique_ptr<uint8_t[]> copy(new uint8_t[blobSize]);
+    size_t size = blobSize;
+    TEST_ESP_OK(nvs_get_blob(handle, "weights", copy.get(), &size));
+    CHECK(size == blobSize);
+    CHECK(memcmp(copy.get(), blob.get(), blobSize) == 0);
+
+    /* one chunk per page: data entries, plus a header per chunk, the index and the other item */
+    size_t entries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &entries));
+    CHECK(entries <= (blobSize + Page::ENTRY_SIZE - 1) / Page::ENTRY_SIZE + 2 * 10);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob stream replaces the previous value when closed", "[nvs]")
+{
+    SpiFlashEmulator emu(6);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 6));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("certs", NVS_READWRITE, &handle));
+
+    uint8_t oldBlob[3000];
+    uint8_t newBlob[5000];
+    std::fill_n(oldBlob, sizeof(oldBlob), 0x11);
+    for (size_t i = 0; i < sizeof(newBlob); ++i) {
+        newBlob[i] = static_cast<uint8_t>(i);
+    }
+    TEST_ESP_OK(nvs_set_blob(handle, "ca", oldBlob, sizeof(oldBlob)));
+    size_t usedEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedEntries));
+
+    auto checkValue = [&](const uint8_t* expected, size_t expectedSize) {
+        uint8_t value[sizeof(newBlob)];
+        size_t size = sizeof(value);
+        TEST_ESP_OK(nvs_get_blob(handle, "ca", value, &size));
+        CHECK(size == expectedSize);
+        CHECK(memcmp(value, expected, expectedSize) == 0);
+    };
+
+    /* aborted write leaves the old value and no chunks behind */
+    nvs_blob_stream_t stream;
+    TEST_ESP_OK(nvs_blob_open_write(handle, "ca", &stream));
+    TEST_ESP_OK(nvs_blob_write(stream, 0, newBlob, 2000));
+    checkValue(oldBlob, sizeof(oldBlob));
+    nvs_blob_abort(stream);
+    checkValue(oldBlob, sizeof(oldBlob));
+    size_t entries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &entries));
+    CHECK(entries == usedEntries);
+
+    /* writing the key by other means aborts the stream; nvs_set_blob uses the same chunk
+     * version as the stream, so chunks left behind would show up as duplicates */
+    TEST_ESP_OK(nvs_blob_open_write(handle, "ca", &stream));
+    TEST_ESP_OK(nvs_blob_write(stream, 0, newBlob, 2000));
+    TEST_ESP_OK(nvs_set_blob(handle, "ca", oldBlob, sizeof(oldBlob)));
+    TEST_ESP_ERR(nvs_blob_write(stream, 2000, newBlob + 2000, 1000), ESP_ERR_INVALID_STATE);
+    TEST_ESP_ERR(nvs_blob_close(stream), ESP_ERR_INVALID_STATE);
+    checkValue(oldBlob, sizeof(oldBlob));
+
+    TEST_ESP_OK(nvs_blob_open_write(handle, "ca", &stream));
+    TEST_ESP_OK(nvs_blob_write(stream, 0, newBlob, 2000));
+    TEST_ESP_OK(nvs_blob_write(stream, 2000, newBlob + 2000, 3000));
+    TEST_ESP_OK(nvs_blob_close(stream));
+    checkValue(newBlob, sizeof(newBlob));
+
+    /* a write which hasn't been closed is rolled back on next init */
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedEntries));
+    TEST_ESP_OK(nvs_blob_open_write(handle, "ca", &stream));
+    TEST_ESP_OK(nvs_blob_write(stream, 0, oldBlob, sizeof(oldBlob)));
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 6));
+    TEST_ESP_ERR(nvs_blob_write(stream, sizeof(oldBlob), oldBlob, 1), ESP_ERR_NVS_NOT_INITIALIZED);
+    TEST_ESP_ERR(nvs_blob_close(stream), ESP_ERR_NVS_NOT_INITIALIZED);
+    TEST_ESP_OK(nvs_open("certs", NVS_READWRITE, &handle));
+    checkValue(newBlob, sizeof(newBlob));
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &entries));
+    CHECK(entries == usedEntries);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("Recovery from power-off during streamed blob write", "[nvs]")
+{
+    uint8_t oldBlob[1500];
+    uint8_t newBlob[6000];
+    std::fill_n(oldBlob, sizeof(oldBlob), 0x11);
+    for (size_t i = 0; i < sizeof(newBlob); ++i) {
+        newBlob[i] = static_cast<uint8_t>(i * 3);
+    }
+
+    for (uint32_t failAt = 0; ; failAt += 7) {
+        SpiFlashEmulator emu(5);
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 5));
+        nvs_handle handle;
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", oldBlob, sizeof(oldBlob)));
+
+        emu.failAfter(failAt);
+        nvs_blob_stream_t stream;
+        esp_err_t err = nvs_blob_open_write(handle, "blob", &stream);
+        for (size_t offset = 0; err == ESP_OK && offset < sizeof(newBlob); offset += 1000) {
+            err = nvs_blob_write(stream, offset, newBlob + offset, 1000);
+        }
+        esp_err_t closeErr = nvs_blob_close(stream);
+        nvs_close(handle);
+        emu.failAfter(UINT32_MAX);
+
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 5));
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        uint8_t blob[sizeof(newBlob)];
+        size_t size = sizeof(blob);
+        TEST_ESP_OK(nvs_get_blob(handle, "blob", blob, &size));
+        if (size == sizeof(oldBlob)) {
+            REQUIRE(memcmp(blob, oldBlob, size) == 0);
+            REQUIRE(closeErr != ESP_OK);
+        } else {
+            REQUIRE(size == sizeof(newBlob));
+            REQUIRE(memcmp(blob, newBlob, size) == 0);
+        }
+
+        // writes after recovery must succeed, and storage must be free of duplicates (checked on write)
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", oldBlob, sizeof(oldBlob)));
+        TEST_ESP_OK(nvs_set_str(handle, "after", "value written after recovery"));
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+        if (closeErr == ESP_OK) {
+            break;
+        }
+    }
+}
+
+TEST_CASE("nvs_gc_step keeps erasing out of writes", "[nvs]")
+{
+    const size_t writeCount = 2000;
+    const size_t keyCount = 10;
+    auto measure = [&](bool gc, size_t& p50, size_t& p99, size_t& erasingWrites) {
+        SpiFlashEmulator emu(6);
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 6));
+        nvs_handle handle;
+        TEST_ESP_OK(nvs_open("latency", NVS_READWRITE, &handle));
+        std::vector<size_t> times;
+        erasingWrites = 0;
+        for (size_t i = 0; i < writeCount; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(i % keyCount));
+            size_t time = emu.getTotalTime();
+            size_t eraseOps = emu.getEraseOps();
+            if (i % keyCount < 3) {
+                TEST_ESP_OK(nvs_set_str(handle, key, "a string which takes three entries"));
+            } else {
+                TEST_ESP_OK(nvs_set_u32(handle, key, i));
+            }
+            times.push_back(emu.getTotalTime() - time);
+            if (emu.getEraseOps() != eraseOps) {
+                ++erasingWrites;
+            }
+            // the application would call nvs_gc_step while idle, its time isn't counted
+            while (gc && nvs_gc_step(NULL) == ESP_OK) {
+            }
+        }
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+        std::sort(times.begin(), times.end());
+        p50 = times[times.size() / 2];
+        p99 = times[times.size() * 99 / 100];
+    };
+
+    size_t plainP50, plainP99, plainErasing;
+    size_t gcP50, gcP99, gcErasing;
+    measure(false, plainP50, plainP99, plainErasing);
+    measure(true, gcP50, gcP99, gcErasing);
+    CHECK(plainErasing > 0);
+    CHECK(gcErasing == 0);
+    CHECK(gcP99 <= plainP99);
+
+    s_perf << "Latency of " << writeCount << " writes: p50 " << plainP50 << " us, p99 " << plainP99 << " us, "
+           << plainErasing << " erasing; with nvs_gc_step: p50 " << gcP50 << " us, p99 " << gcP99 << " us, "
+           << gcErasing << " erasing" << std::endl;
+}
+
+TEST_CASE("Recovery from power-off during nvs_gc_step", "[nvs]")
+{
+    uint8_t blob[3000];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i * 7);
+    }
+    const size_t keyCount = 8;
+    const size_t writeCount = 300;
+    const char* str = "string value which spans several entries";
+    // overwritten values leave erased entries behind, strings written once keep every page in use
+    auto getKey = [&](size_t i, char* key, size_t size) {
+        if (i % 10 == 0) {
+            snprintf(key, size, "str%d", static_cast<int>(i));
+        } else {
+            snprintf(key, size, "key%d", static_cast<int>(i % keyCount));
+        }
+    };
+
+    for (uint32_t failAt = 0; ; failAt += 3) {
+        SpiFlashEmulator emu(5);
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 5));
+        nvs_handle handle;
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+        for (size_t i = 0; i < writeCount; ++i) {
+            char key[16];
+            getKey(i, key, sizeof(key));
+            if (i % 10 == 0) {
+                TEST_ESP_OK(nvs_set_str(handle, key, str));
+            } else {
+                TEST_ESP_OK(nvs_set_u32(handle, key, i));
+            }
+        }
+        nvs_close(handle);
+
+        emu.failAfter(failAt);
+        esp_err_t err = nvs_gc_step(NULL);
+        REQUIRE(err != ESP_ERR_NVS_NOT_FOUND);
+        emu.failAfter(UINT32_MAX);
+
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 5));
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        uint8_t readBlob[sizeof(blob)];
+        size_t size = sizeof(readBlob);
+        TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &size));
+        REQUIRE(size == sizeof(blob));
+        REQUIRE(memcmp(readBlob, blob, size) == 0);
+        for (size_t i = 0; i < writeCount; ++i) {
+            char key[16];
+            getKey(i, key, sizeof(key));
+            if (i % 10 == 0) {
+                char value[64];
+                size = sizeof(value);
+                TEST_ESP_OK(nvs_get_str(handle, key, value, &size));
+                CHECK(strcmp(value, str) == 0);
+            } else if (i >= writeCount - 2 * keyCount) {
+                uint32_t value;
+                TEST_ESP_OK(nvs_get_u32(handle, key, &value));
+                CHECK(value % keyCount == i % keyCount);
+                CHECK(value >= writeCount - 2 * keyCount);
+            }
+        }
+
+        // writes after recovery must succeed, and storage must be free of duplicates (checked on write)
+        for (size_t i = 0; i < 200; ++i) {
+            TEST_ESP_OK(nvs_set_u32(handle, "after", i));
+        }
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+        if (err == ESP_OK) {
+            break;
+        }
+    }
+}
+
+static uint32_t crc32_le_bitwise(uint32_t crc, const uint8_t* buf, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+        }
+    }
+    return ~crc;
+}
+
+/* Byte at a time, as crc32_le in ROM */
+static uint32_t crc32_le_bytewise(uint32_t crc, const uint8_t* buf, size_t len)
+{
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint8_t byte = static_cast<uint8_t>(i);
+            table[i] = ~crc32_le_bitwise(0xffffffff, &byte, 1);
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc = table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+TEST_CASE("esp_crc32_le matches reference CRC32 for any length and alignment", "[nvs]")
+{
+    uint8_t buf[128 + 8];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = static_cast<uint8_t>(rand());
+    }
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t len = 0; len <= 128; ++len) {
+            REQUIRE(esp_crc32_le(0xffffffff, buf + offset, len) == crc32_le_bitwise(0xffffffff, buf + offset, len));
+            REQUIRE(esp_crc32_le(0, buf + offset, len) == crc32_le_bitwise(0, buf + offset, len));
+        }
+    }
+    // chained calls give the same result as one call over the whole buffer
+    uint32_t crc = esp_crc32_le(0xffffffff, buf, 13);
+    crc = esp_crc32_le(crc, buf + 13, 51);
+    CHECK(crc == esp_crc32_le(0xffffffff, buf, 64));
+    // check value of the CRC-32 used by zlib
+    CHECK(esp_crc32_le(0, reinterpret_cast<const uint8_t*>("123456789"), 9) == 0xcbf43926);
+}
+
+TEST_CASE("esp_crc32_le performance", "[nvs]")
+{
+    const size_t count = 200000;
+    Item item(1, ItemType::U32, 1, "some key");
+    uint32_t value = 42;
+    memcpy(item.data, &value, sizeof(value));
+    volatile uint32_t sink = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        item.data[4] = static_cast<uint8_t>(i);
+        sink = sink + item.calculateCrc32();
+    }
+    auto entryTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&item);
+    begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        item.data[4] = static_cast<uint8_t>(i);
+        uint32_t crc = crc32_le_bytewise(0xffffffff, p + offsetof(Item, nsIndex), offsetof(Item, crc32) - offsetof(Item, nsIndex));
+        crc = crc32_le_bytewise(crc, p + offsetof(Item, key), sizeof(item.key));
+        sink = sink + crc32_le_bytewise(crc, p + offsetof(Item, data), sizeof(item.data));
+    }
+    auto bytewiseTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+    s_perf << "Time to calculate CRC32 of an entry: " << entryTime / count << " ns ("
+           << bytewiseTime / count << " ns byte by byte)" << std::endl;
+}
+
 /* Add new tests above */
 /* This test has to be the final one */
 
@@ -36,13 +36,23 @@ static_assert(sizeof(wl_state_t) % 32 == 0, "wl_state_t structure size must be m
 #endif // _MSC_VER
 
 
-WL_Flash::WL_Flash()
+WL_Flash::WL_Flash(size_t cache_sectors, size_t max_pending_moves)
 {
+    this->cache_size = cache_sectors;
+    this->max_pending_moves = (max_pending_moves > 0) ? max_pending_moves : 1;
+    memset(&this->cache_stats, 0, sizeof(this->cache_stats));
 }
 
 WL_Flash::~WL_Flash()
 {
     free(this->temp_buff);
+    free(this->move_buff);
+    if (this->cache) {
+        for (size_t i = 0; i < this->cache_size; i++) {
+            free(this->cache[i].data);
+        }
+        free(this->cache);
+    }
 }
 
 esp_err_t WL_Flash::config(wl_config_t *cfg, Flash_Access *flash_drv)
@@ -112,6 +122,30 @@ esp_err_t WL_Flash::config(wl_config_t *cfg, Flash_Access *flash_drv)
         result = ESP_ERR_NO_MEM;
     }
     WL_RESULT_CHECK(result);
+
+    if (this->max_pending_moves > 1) {
+        // Deferred moves are done in batches, so give them a buffer for a complete block
+        this->move_buff = (uint8_t *)malloc(this->cfg.page_size);
+        if (this->move_buff == NULL) {
+            result = ESP_ERR_NO_MEM;
+        }
+        WL_RESULT_CHECK(result);
+    }
+
+    if (this->cache_size > 0) {
+        this->cache = (wl_cache_entry_t *)calloc(this->cache_size, sizeof(wl_cache_entry_t));
+        if (this->cache == NULL) {
+            result = ESP_ERR_NO_MEM;
+        }
+        WL_RESULT_CHECK(result);
+        for (size_t i = 0; i < this->cache_size; i++) {
+            this->cache[i].data = (uint8_t *)malloc(this->cfg.sector_size);
+            if (this->cache[i].data == NULL) {
+                result = ESP_ERR_NO_MEM;
+            }
+            WL_RESULT_CHECK(result);
+        }
+    }
     this->configured = true;
     return ESP_OK;
 }
@@ -212,6 +246,9 @@ esp_err_t WL_Flash::init()
             WL_RESULT_CHECK(result);
             result = this->flash_drv->write(this->addr_state1, state_copy, sizeof(wl_state_t));
             WL_RESULT_CHECK(result);
+            // Position records are checked against the device ID of the restored state
+            result = this->flash_drv->read(this->addr_state1, &this->state, sizeof(wl_state_t));
+            WL_RESULT_CHECK(result);
             for (size_t i = 0; i < ((this->cfg.full_mem_size / this->cfg.sector_size) * this->cfg.wr_size); i++) {
                 bool pos_bits;
                 result = this->flash_drv->read(this->addr_state2 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
@@ -223,8 +260,6 @@ esp_err_t WL_Flash::init()
                     WL_RESULT_CHECK(result);
                 }
             }
-            result = this->flash_drv->read(this->addr_state1, &this->state, sizeof(wl_state_t));
-            WL_RESULT_CHECK(result);
             this->state.pos = this->state.max_pos - 1;
         }
         // done. We have recovered the state
@@ -234,6 +269,13 @@ esp_err_t WL_Flash::init()
             WL_RESULT_CHECK(result);
         }
     }
+    // Position records of the last deferred moves may be missing in the second state copy
+    for (this->state2_pos = 0; (result == ESP_OK) && (this->state2_pos < this->state.pos); this->state2_pos++) {
+        result = this->flash_drv->read(this->addr_state2 + sizeof(wl_state_t) + this->state2_pos * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
+        if ((result == ESP_OK) && (this->OkBuffSet(this->state2_pos) == false)) {
+            break;
+        }
+    }
     if (result != ESP_OK) {
         this->initialized = false;
         ESP_LOGE(TAG, "%s: returned 0x%08x", __func__, (uint32_t)result);
@@ -427,13 +469,44 @@ bool WL_Flash::OkBuffSet(int n)
 
 esp_err_t WL_Flash::updateWL()
 {
-    esp_err_t result = ESP_OK;
     this->state.access_count++;
-    if (this->state.access_count < this->state.max_count) {
-        return result;
+    if (this->state.access_count >= this->state.max_count) {
+        // Here we have to move the block and increase the state
+        this->state.access_count = 0;
+        this->pending_moves++;
     }
-    // Here we have to move the block and increase the state
-    this->state.access_count = 0;
+    if (this->pending_moves < this->max_pending_moves) {
+        return ESP_OK;
+    }
+    return this->moveBlocks();
+}
+
+esp_err_t WL_Flash::moveBlocks()
+{
+    esp_err_t result = ESP_OK;
+    while (this->pending_moves > 0) {
+        result = this->moveBlock();
+        if (result != ESP_OK) {
+            break; // we will try next time
+        }
+        this->pending_moves--;
+    }
+    // Records in the second state copy are only read to restore the first one,
+    // so they are written once for all blocks moved here.
+    esp_err_t copy_result = this->writeStateRecords(this->addr_state2, this->state2_pos, this->state.pos);
+    if (copy_result == ESP_OK) {
+        this->state2_pos = this->state.pos;
+    }
+    if (result == ESP_OK) {
+        result = copy_result;
+    }
+    ESP_LOGV(TAG, "%s - result= 0x%08x, pos= 0x%08x, pending_moves= %i", __func__, result, this->state.pos, this->pending_moves);
+    return result;
+}
+
+esp_err_t WL_Flash::moveBlock()
+{
+    esp_err_t result = ESP_OK;
     ESP_LOGV(TAG, "%s - access_count= 0x%08x, pos= 0x%08x", __func__, this->state.access_count, this->state.pos);
     // copy data to dummy block
     size_t data_addr = this->state.pos + 1; // next block, [pos+1] copy to [pos]
@@ -445,22 +518,25 @@ esp_err_t WL_Flash::updateWL()
     result = this->flash_drv->erase_range(this->dummy_addr, this->cfg.page_size);
     if (result != ESP_OK) {
         ESP_LOGE(TAG, "%s - erase wl dummy sector result= 0x%08x", __func__, result);
-        this->state.access_count = this->state.max_count - 1; // we will update next time
         return result;
     }
 
-    size_t copy_count = this->cfg.page_size / this->cfg.temp_buff_size;
+    uint8_t *buff = this->temp_buff;
+    size_t buff_size = this->cfg.temp_buff_size;
+    if (this->move_buff != NULL) {
+        buff = this->move_buff;
+        buff_size = this->cfg.page_size;
+    }
+    size_t copy_count = this->cfg.page_size / buff_size;
     for (size_t i = 0; i < copy_count; i++) {
-        result = this->flash_drv->read(data_addr + i * this->cfg.temp_buff_size, this->temp_buff, this->cfg.temp_buff_size);
+        result = this->flash_drv->read(data_addr + i * buff_size, buff, buff_size);
         if (result != ESP_OK) {
             ESP_LOGE(TAG, "%s - not possible to read buffer, will try next time, result= 0x%08x", __func__, result);
-            this->state.access_count = this->state.max_count - 1; // we will update next time
             return result;
         }
-        result = this->flash_drv->write(this->dummy_addr + i * this->cfg.temp_buff_size, this->temp_buff, this->cfg.temp_buff_size);
+        result = this->flash_drv->write(this->dummy_addr + i * buff_size, buff, buff_size);
         if (result != ESP_OK) {
             ESP_LOGE(TAG, "%s - not possible to write buffer, will try next time, result= 0x%08x", __func__, result);
-            this->state.access_count = this->state.max_count - 1; // we will update next time
             return result;
         }
     }
@@ -470,17 +546,9 @@ esp_err_t WL_Flash::updateWL()
     uint32_t byte_pos = this->state.pos * this->cfg.wr_size;
     this->fillOkBuff(this->state.pos);
     // write state to mem. We updating only affected bits
-    result |= this->flash_drv->write(this->addr_state1 + sizeof(wl_state_t) + byte_pos, this->temp_buff, this->cfg.wr_size);
+    result = this->flash_drv->write(this->addr_state1 + sizeof(wl_state_t) + byte_pos, this->temp_buff, this->cfg.wr_size);
     if (result != ESP_OK) {
         ESP_LOGE(TAG, "%s - update position 1 result= 0x%08x", __func__, result);
-        this->state.access_count = this->state.max_count - 1; // we will update next time
-        return result;
-    }
-    this->fillOkBuff(this->state.pos);
-    result |= this->flash_drv->write(this->addr_state2 + sizeof(wl_state_t) + byte_pos, this->temp_buff, this->cfg.wr_size);
-    if (result != ESP_OK) {
-        ESP_LOGE(TAG, "%s - update position 2 result= 0x%08x", __func__, result);
-        this->state.access_count = this->state.max_count - 1; // we will update next time
         return result;
     }
 
@@ -495,6 +563,11 @@ esp_err_t WL_Flash::updateWL()
         // write main state
         this->state.crc = crc32::crc32_le(WL_CFG_CRC_CONST, (uint8_t *)&this->state, WL_STATE_CRC_LEN_V2);
 
+        // The first state copy is restored from the second one if the power is lost below,
+        // so the second copy must have all position records of this loop first.
+        result = this->writeStateRecords(this->addr_state2, this->state2_pos, this->state.max_pos);
+        WL_RESULT_CHECK(result);
+        this->state2_pos = this->state.max_pos;
         result = this->flash_drv->erase_range(this->addr_state1, this->state_size);
         WL_RESULT_CHECK(result);
         result = this->flash_drv->write(this->addr_state1, &this->state, sizeof(wl_state_t));
@@ -503,6 +576,7 @@ esp_err_t WL_Flash::updateWL()
         WL_RESULT_CHECK(result);
         result = this->flash_drv->write(this->addr_state2, &this->state, sizeof(wl_state_t));
         WL_RESULT_CHECK(result);
+        this->state2_pos = 0;
         ESP_LOGD(TAG, "%s - move_count= 0x%08x, pos= 0x%08x, ", __func__, this->state.move_count, this->state.pos);
     }
     // Save structures to the flash... and check result
@@ -514,6 +588,47 @@ esp_err_t WL_Flash::updateWL()
     return result;
 }
 
+esp_err_t WL_Flash::writeStateRecords(size_t state_addr, size_t first_pos, size_t end_pos)
+{
+    esp_err_t result = ESP_OK;
+    uint8_t *buff = this->temp_buff;
+    size_t buff_count = 1;
+    if (this->move_buff != NULL) {
+        buff = this->move_buff;
+        buff_count = this->cfg.page_size / this->cfg.wr_size;
+    }
+    while (first_pos < end_pos) {
+        size_t count = end_pos - first_pos;
+        if (count > buff_count) {
+            count = buff_count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            this->fillOkBuff(first_pos + i);
+            if (buff != this->temp_buff) {
+                memcpy(buff + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
+            }
+        }
+        result = this->flash_drv->write(state_addr + sizeof(wl_state_t) + first_pos * this->cfg.wr_size, buff, count * this->cfg.wr_size);
+        if (result != ESP_OK) {
+            ESP_LOGE(TAG, "%s - update position result= 0x%08x", __func__, result);
+            return result;
+        }
+        first_pos += count;
+    }
+    return result;
+}
+
+esp_err_t WL_Flash::maintenance()
+{
+    if (!this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (this->pending_moves == 0) {
+        return ESP_OK;
+    }
+    return this->moveBlocks();
+}
+
 size_t WL_Flash::calcAddr(size_t addr)
 {
     size_t result = (this->flash_size - this->state.move_count * this->cfg.page_size + addr) % this->flash_size;
@@ -550,13 +665,32 @@ esp_err_t WL_Flash::erase_sector(size_t sector)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - sector= 0x%08x", __func__, (uint32_t) sector);
-    result = this->updateWL();
+    if (this->cache_size == 0) {
+        return this->eraseFlash(sector);
+    }
+    wl_cache_entry_t *entry = this->cacheFind(sector);
+    if (entry == NULL) {
+        result = this->cacheGet(sector, &entry);
+        WL_RESULT_CHECK(result);
+    } else if (entry->dirty) {
+        // The previous contents of the sector never reached the flash, so this erase costs nothing
+        this->cache_stats.merges++;
+    }
+    memset(entry->data, 0xff, this->cfg.sector_size);
+    entry->dirty = true;
+    return result;
+}
+
+esp_err_t WL_Flash::eraseFlash(size_t sector)
+{
+    esp_err_t result = this->updateWL();
     WL_RESULT_CHECK(result);
     size_t virt_addr = this->calcAddr(sector * this->cfg.sector_size);
     result = this->flash_drv->erase_sector((this->cfg.start_addr + virt_addr) / this->cfg.sector_size);
     WL_RESULT_CHECK(result);
     return result;
 }
+
 esp_err_t WL_Flash::erase_range(size_t start_address, size_t size)
 {
     esp_err_t result = ESP_OK;
@@ -581,6 +715,41 @@ esp_err_t WL_Flash::write(size_t dest_addr, const void *src, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - dest_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) dest_addr, (uint32_t) size);
+    if (this->cache_size == 0) {
+        return this->writeFlash(dest_addr, src, size);
+    }
+    const uint8_t *src_data = (const uint8_t *)src;
+    while (size > 0) {
+        size_t offset = dest_addr % this->cfg.sector_size;
+        size_t chunk = this->cfg.sector_size - offset;
+        if (chunk > size) {
+            chunk = size;
+        }
+        wl_cache_entry_t *entry = this->cacheFind(dest_addr / this->cfg.sector_size);
+        if (entry != NULL) {
+            this->cache_stats.hits++;
+            // Same result as writing to flash: bits can only be cleared
+            for (size_t i = 0; i < chunk; i++) {
+                entry->data[offset + i] &= src_data[i];
+            }
+        } else {
+            this->cache_stats.misses++;
+        }
+        // A sector which is clean in the cache matches the flash, so it is written through
+        if (entry == NULL || !entry->dirty) {
+            result = this->writeFlash(dest_addr, src_data, chunk);
+            WL_RESULT_CHECK(result);
+        }
+        dest_addr += chunk;
+        src_data += chunk;
+        size -= chunk;
+    }
+    return result;
+}
+
+esp_err_t WL_Flash::writeFlash(size_t dest_addr, const void *src, size_t size)
+{
+    esp_err_t result = ESP_OK;
     uint32_t count = (size - 1) / this->cfg.page_size;
     for (size_t i = 0; i < count; i++) {
         size_t virt_addr = this->calcAddr(dest_addr + i * this->cfg.page_size);
@@ -600,6 +769,35 @@ esp_err_t WL_Flash::read(size_t src_addr, void *dest, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - src_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) src_addr, (uint32_t) size);
+    if (this->cache_size == 0) {
+        return this->readFlash(src_addr, dest, size);
+    }
+    uint8_t *dest_data = (uint8_t *)dest;
+    while (size > 0) {
+        size_t offset = src_addr % this->cfg.sector_size;
+        size_t chunk = this->cfg.sector_size - offset;
+        if (chunk > size) {
+            chunk = size;
+        }
+        wl_cache_entry_t *entry = this->cacheFind(src_addr / this->cfg.sector_size);
+        if (entry != NULL) {
+            this->cache_stats.hits++;
+            memcpy(dest_data, entry->data + offset, chunk);
+        } else {
+            this->cache_stats.misses++;
+            result = this->readFlash(src_addr, dest_data, chunk);
+            WL_RESULT_CHECK(result);
+        }
+        src_addr += chunk;
+        dest_data += chunk;
+        size -= chunk;
+    }
+    return result;
+}
+
+esp_err_t WL_Flash::readFlash(size_t src_addr, void *dest, size_t size)
+{
+    esp_err_t result = ESP_OK;
     uint32_t count = (size - 1) / this->cfg.page_size;
     for (size_t i = 0; i < count; i++) {
         size_t virt_addr = this->calcAddr(src_addr + i * this->cfg.page_size);
@@ -613,6 +811,75 @@ esp_err_t WL_Flash::read(size_t src_addr, void *dest, size_t size)
     return result;
 }
 
+WL_Flash::wl_cache_entry_t *WL_Flash::cacheFind(size_t sector)
+{
+    for (size_t i = 0; i < this->cache_size; i++) {
+        wl_cache_entry_t *entry = &this->cache[i];
+        if (entry->used && entry->sector == sector) {
+            entry->last_use = ++this->cache_clock;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t WL_Flash::cacheGet(size_t sector, wl_cache_entry_t **entry)
+{
+    // Take a free entry, or the least recently used one
+    wl_cache_entry_t *victim = &this->cache[0];
+    for (size_t i = 0; i < this->cache_size; i++) {
+        wl_cache_entry_t *candidate = &this->cache[i];
+        if (!candidate->used) {
+            victim = candidate;
+            break;
+        }
+        if ((int32_t)(candidate->last_use - victim->last_use) < 0) {
+            victim = candidate;
+        }
+    }
+    if (victim->used) {
+        esp_err_t result = this->cacheWriteBack(victim);
+        WL_RESULT_CHECK(result);
+    }
+    victim->used = true;
+    victim->dirty = false;
+    victim->sector = sector;
+    victim->last_use = ++this->cache_clock;
+    *entry = victim;
+    return ESP_OK;
+}
+
+esp_err_t WL_Flash::cacheWriteBack(wl_cache_entry_t *entry)
+{
+    if (!entry->dirty) {
+        return ESP_OK;
+    }
+    esp_err_t result = this->eraseFlash(entry->sector);
+    WL_RESULT_CHECK(result);
+    result = this->writeFlash(entry->sector * this->cfg.sector_size, entry->data, this->cfg.sector_size);
+    WL_RESULT_CHECK(result);
+    entry->dirty = false;
+    this->cache_stats.writebacks++;
+    return result;
+}
+
+esp_err_t WL_Flash::sync()
+{
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < this->cache_size; i++) {
+        if (this->cache[i].used) {
+            result = this->cacheWriteBack(&this->cache[i]);
+            WL_RESULT_CHECK(result);
+        }
+    }
+    return result;
+}
+
+void WL_Flash::get_cache_stats(wl_cache_stats_t *stats)
+{
+    memcpy(stats, &this->cache_stats, sizeof(wl_cache_stats_t));
+}
+
 Flash_Access *WL_Flash::get_drv()
 {
     return this->flash_drv;
@@ -624,9 +891,13 @@ wl_config_t *WL_Flash::get_cfg()
 
 esp_err_t WL_Flash::flush()
 {
-    esp_err_t result = ESP_OK;
+    esp_err_t result = this->sync();
+    WL_RESULT_CHECK(result);
     this->state.access_count = this->state.max_count - 1;
     result = this->updateWL();
+    if (result == ESP_OK && this->pending_moves > 0) {
+        result = this->moveBlocks();
+    }
     ESP_LOGD(TAG, "%s - result= 0x%08x, move_count= 0x%08x", __func__, result, this->state.move_count);
     return result;
 }
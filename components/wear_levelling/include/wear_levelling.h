@@ -29,6 +29,16 @@ typedef int32_t wl_handle_t;
 
 #define WL_INVALID_HANDLE -1
 
+/**
+* @brief Statistics of the write-back sector cache
+*/
+typedef struct {
+    uint32_t hits;          /*!< Number of sector reads and writes served by the cache*/
+    uint32_t misses;        /*!< Number of sector reads and writes which went to flash*/
+    uint32_t merges;        /*!< Number of erases of a sector whose earlier contents were not written back yet, and so never reached flash*/
+    uint32_t writebacks;    /*!< Number of sectors erased and written back to flash*/
+} wl_cache_stats_t;
+
 /**
 * @brief Mount WL for defined partition
 *
@@ -128,6 +138,55 @@ size_t wl_size(wl_handle_t handle);
 */
 size_t wl_sector_size(wl_handle_t handle);
 
+/**
+* @brief Write sectors held in the write-back cache to flash
+*
+* Erases and writes done through the wl_erase_range and wl_write functions are
+* kept in RAM when the write-back cache is enabled (CONFIG_WL_CACHE_SECTORS > 0),
+* and are lost if power goes off before they are written to flash. This function
+* writes them back. It is called by wl_unmount, and by FAT filesystem on fsync.
+* Without the cache, this function does nothing.
+*
+* @param handle WL module handle that was initialized before
+*
+* @return
+*       - ESP_OK, if the cache was written back successfully;
+*       - or one of error codes from lower-level flash driver.
+*/
+esp_err_t wl_sync(wl_handle_t handle);
+
+/**
+* @brief Do wear levelling work which has been deferred
+*
+* Every few erases, wear levelling moves a block of data to the next position in
+* flash. With CONFIG_WL_DEFERRED_MOVES enabled, erase functions only count the
+* moves which are due, and this function does them all at once, with one buffer
+* for a complete block and fewer updates of the state sectors. Call it when
+* the application is idle. If it is not called often enough, erase functions
+* do the moves once CONFIG_WL_MAX_PENDING_MOVES of them are due.
+* Without deferred moves, this function does nothing.
+*
+* @param handle WL module handle that was initialized before
+*
+* @return
+*       - ESP_OK, if all moves which were due have been done;
+*       - or one of error codes from lower-level flash driver.
+*/
+esp_err_t wl_maintenance(wl_handle_t handle);
+
+/**
+* @brief Get statistics of the write-back cache
+*
+* @param handle WL module handle that was initialized before
+* @param[out] stats Counters accumulated since wl_mount was called
+*
+* @return
+*       - ESP_OK, if the statistics were returned;
+*       - ESP_ERR_INVALID_ARG, if stats is NULL or handle is out of range;
+*       - ESP_ERR_NOT_FOUND, if handle doesn't refer to a mounted partition.
+*/
+esp_err_t wl_get_cache_stats(wl_handle_t handle, wl_cache_stats_t *stats);
+
 
 #ifdef __cplusplus
 } // extern "C"
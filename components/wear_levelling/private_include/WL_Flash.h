@@ -18,6 +18,24 @@
 #include "Flash_Access.h"
 #include "WL_Config.h"
 #include "WL_State.h"
+#include "wear_levelling.h"
+#include "sdkconfig.h"
+
+#ifndef WL_CACHE_SECTORS
+#ifdef CONFIG_WL_CACHE_SECTORS
+#define WL_CACHE_SECTORS CONFIG_WL_CACHE_SECTORS
+#else
+#define WL_CACHE_SECTORS 0
+#endif // CONFIG_WL_CACHE_SECTORS
+#endif // WL_CACHE_SECTORS
+
+#ifndef WL_MAX_PENDING_MOVES
+#ifdef CONFIG_WL_MAX_PENDING_MOVES
+#define WL_MAX_PENDING_MOVES CONFIG_WL_MAX_PENDING_MOVES
+#else
+#define WL_MAX_PENDING_MOVES 1
+#endif // CONFIG_WL_MAX_PENDING_MOVES
+#endif // WL_MAX_PENDING_MOVES
 
 /**
 * @brief This class is used to make wear levelling for flash devices. Class implements Flash_Access interface
@@ -26,7 +44,12 @@
 class WL_Flash : public Flash_Access
 {
 public :
-    WL_Flash();
+    /**
+    * @param cache_sectors number of sectors kept in the write-back cache, 0 to write directly to flash
+    * @param max_pending_moves number of due block moves which wait for maintenance() before they are
+    *                          done by an erase, 1 to move each block as soon as it is due
+    */
+    WL_Flash(size_t cache_sectors = WL_CACHE_SECTORS, size_t max_pending_moves = WL_MAX_PENDING_MOVES);
     ~WL_Flash() override;
 
     virtual esp_err_t config(wl_config_t *cfg, Flash_Access *flash_drv);
@@ -43,6 +66,10 @@ public :
     esp_err_t read(size_t src_addr, void *dest, size_t size) override;
 
     esp_err_t flush() override;
+    esp_err_t sync();
+    esp_err_t maintenance();
+
+    void get_cache_stats(wl_cache_stats_t *stats);
 
     Flash_Access *get_drv();
     wl_config_t *get_cfg();
@@ -67,11 +94,41 @@ protected:
     size_t dummy_addr;
     uint32_t pos_data[4];
 
+    size_t max_pending_moves;
+    size_t pending_moves = 0;
+    size_t state2_pos = 0;      // position records before this one are written to the second state copy
+    uint8_t *move_buff = NULL;  // buffer for a complete block, used when block moves are deferred
+
+    // Write-back cache of data sectors. Erased sectors are kept in RAM and all writes to them
+    // are merged there, so that a sector is erased in flash once when it is written back.
+    typedef struct {
+        size_t sector;      // sector number, as seen by the user of WL_Flash
+        uint32_t last_use;  // value of cache_clock when the sector was accessed last
+        bool used;
+        bool dirty;         // sector has to be erased and written back
+        uint8_t *data;
+    } wl_cache_entry_t;
+
+    size_t cache_size;
+    wl_cache_entry_t *cache = NULL;
+    uint32_t cache_clock = 0;
+    wl_cache_stats_t cache_stats;
+
     esp_err_t initSections();
     esp_err_t updateWL();
+    esp_err_t moveBlocks();
+    esp_err_t moveBlock();
+    esp_err_t writeStateRecords(size_t state_addr, size_t first_pos, size_t end_pos);
     esp_err_t recoverPos();
     size_t calcAddr(size_t addr);
 
+    esp_err_t eraseFlash(size_t sector);
+    esp_err_t writeFlash(size_t dest_addr, const void *src, size_t size);
+    esp_err_t readFlash(size_t src_addr, void *dest, size_t size);
+    wl_cache_entry_t *cacheFind(size_t sector);
+    esp_err_t cacheGet(size_t sector, wl_cache_entry_t **entry);
+    esp_err_t cacheWriteBack(wl_cache_entry_t *entry);
+
     esp_err_t updateVersion();
     esp_err_t updateV1_V2();
     void fillOkBuff(int n);
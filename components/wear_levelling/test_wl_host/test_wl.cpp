@@ -6,6 +6,7 @@
 #include "esp_partition.h"
 #include "wear_levelling.h"
 #include "WL_Flash.h"
+#include "Partition.h"
 #include "SpiFlash.h"
 
 #include "catch.hpp"
@@ -207,4 +208,289 @@ TEST_CASE("power down test", "[wear_levelling]")
     // Unmount
     result = wl_unmount(wl_handle);
     REQUIRE(result == ESP_OK);
-}
\ No newline at end of file
+}
+
+TEST_CASE("write-back cache merges repeated updates of a sector", "[wear_levelling]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    // Same configuration as wl_mount uses
+    wl_config_t cfg;
+    cfg.full_mem_size = partition->size;
+    cfg.start_addr = 0;
+    cfg.version = 2;
+    cfg.sector_size = SPI_FLASH_SEC_SIZE;
+    cfg.page_size = SPI_FLASH_SEC_SIZE;
+    cfg.updaterate = 16;
+    cfg.temp_buff_size = 32;
+    cfg.wr_size = 16;
+
+    const size_t sector_size = SPI_FLASH_SEC_SIZE;
+    const size_t record_size = 128;
+    const int32_t sectors_count = 3;
+    const int32_t updates = 300;
+    uint32_t *sector_data = new uint32_t[sector_size / sizeof(uint32_t)];
+    uint32_t erases[2];
+
+    for (int cached = 0; cached < 2; cached++) {
+        Partition part(partition);
+        WL_Flash wl_flash(cached ? 4 : 0);
+        REQUIRE(wl_flash.config(&cfg, &part) == ESP_OK);
+        REQUIRE(wl_flash.init() == ESP_OK);
+        spiflash.reset_total_erase_cycles();
+
+        // Rewrite a few sectors over and over, in small records like FAT does for directory entries
+        for (int32_t i = 0; i < updates; i++) {
+            size_t sector = i % sectors_count;
+            REQUIRE(wl_flash.erase_sector(sector) == ESP_OK);
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                sector_data[m] = i + m;
+            }
+            for (size_t offset = 0; offset < sector_size; offset += record_size) {
+                REQUIRE(wl_flash.write(sector * sector_size + offset, (uint8_t *)sector_data + offset, record_size) == ESP_OK);
+            }
+            REQUIRE(wl_flash.read(sector * sector_size, sector_data, sector_size) == ESP_OK);
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                REQUIRE(sector_data[m] == i + m);
+            }
+        }
+        REQUIRE(wl_flash.sync() == ESP_OK);
+        erases[cached] = spiflash.get_total_erase_cycles();
+
+        wl_cache_stats_t stats;
+        wl_flash.get_cache_stats(&stats);
+        if (cached) {
+            CHECK(stats.writebacks == sectors_count);
+            CHECK(stats.merges == updates - sectors_count);
+            CHECK(stats.misses == 0);
+        } else {
+            CHECK(stats.writebacks == 0);
+            CHECK(stats.hits == 0);
+        }
+        REQUIRE(wl_flash.flush() == ESP_OK);
+    }
+
+    // Data written back by the cache is there for an instance without the cache
+    Partition part(partition);
+    WL_Flash wl_flash(0);
+    REQUIRE(wl_flash.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_flash.init() == ESP_OK);
+    for (int32_t sector = 0; sector < sectors_count; sector++) {
+        int32_t last_update = updates - sectors_count + sector;
+        REQUIRE(wl_flash.read(sector * sector_size, sector_data, sector_size) == ESP_OK);
+        for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+            REQUIRE(sector_data[m] == last_update + m);
+        }
+    }
+
+    printf("Flash erases for %d sector updates: %d without cache, %d with cache\n", updates, erases[0], erases[1]);
+    CHECK(erases[1] * 10 < erases[0]);
+    delete[] sector_data;
+}
+
+// Passes operations to a partition and counts them. Partition::erase_sector calls erase_range.
+class Counting_Flash : public Partition
+{
+public:
+    Counting_Flash(const esp_partition_t *partition) : Partition(partition)
+    {
+    }
+
+    esp_err_t erase_range(size_t start_address, size_t size) override
+    {
+        erases += size / SPI_FLASH_SEC_SIZE;
+        return Partition::erase_range(start_address, size);
+    }
+
+    esp_err_t write(size_t dest_addr, const void *src, size_t size) override
+    {
+        writes++;
+        return Partition::write(dest_addr, src, size);
+    }
+
+    esp_err_t read(size_t src_addr, void *dest, size_t size) override
+    {
+        reads++;
+        return Partition::read(src_addr, dest, size);
+    }
+
+    uint32_t erases = 0;
+    uint32_t writes = 0;
+    uint32_t reads = 0;
+};
+
+TEST_CASE("deferred block moves take fewer flash operations", "[wear_levelling]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    wl_config_t cfg;
+    cfg.full_mem_size = partition->size;
+    cfg.start_addr = 0;
+    cfg.version = 2;
+    cfg.sector_size = SPI_FLASH_SEC_SIZE;
+    cfg.page_size = SPI_FLASH_SEC_SIZE;
+    cfg.updaterate = 16;
+    cfg.temp_buff_size = 32;
+    cfg.wr_size = 16;
+
+    const size_t sector_size = SPI_FLASH_SEC_SIZE;
+    const size_t total_size = 16 * 1024 * 1024;
+    const size_t maintenance_interval = 64;
+    uint32_t *sector_data = new uint32_t[sector_size / sizeof(uint32_t)];
+    uint32_t ops_per_gb[2];
+
+    for (int deferred = 0; deferred < 2; deferred++) {
+        Counting_Flash flash(partition);
+        WL_Flash wl_flash(0, deferred ? 16 : 1);
+        REQUIRE(wl_flash.config(&cfg, &flash) == ESP_OK);
+        REQUIRE(wl_flash.init() == ESP_OK);
+        size_t sectors_count = wl_flash.chip_size() / sector_size;
+        flash.erases = flash.writes = flash.reads = 0;
+
+        for (size_t i = 0; i < total_size / sector_size; i++) {
+            size_t sector = i % sectors_count;
+            REQUIRE(wl_flash.erase_sector(sector) == ESP_OK);
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                sector_data[m] = i + m;
+            }
+            REQUIRE(wl_flash.write(sector * sector_size, sector_data, sector_size) == ESP_OK);
+            if (deferred && (i + 1) % maintenance_interval == 0) {
+                REQUIRE(wl_flash.maintenance() == ESP_OK);
+            }
+        }
+        REQUIRE(wl_flash.flush() == ESP_OK);
+
+        uint32_t ops = flash.erases + flash.writes + flash.reads;
+        ops_per_gb[deferred] = (uint64_t) ops * 1024 * 1024 * 1024 / total_size;
+        printf("Flash operations per GB written, %s: %u (%u erases, %u writes, %u reads)\n",
+               deferred ? "with wl_maintenance" : "moving blocks in erase", ops_per_gb[deferred],
+               flash.erases, flash.writes, flash.reads);
+
+        // Data survives the moves
+        WL_Flash wl_check;
+        REQUIRE(wl_check.config(&cfg, &flash) == ESP_OK);
+        REQUIRE(wl_check.init() == ESP_OK);
+        size_t last_write = total_size / sector_size - 1;
+        for (size_t sector = 0; sector < sectors_count; sector++) {
+            size_t i = last_write - (last_write - sector) % sectors_count;
+            REQUIRE(wl_check.read(sector * sector_size, sector_data, sector_size) == ESP_OK);
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                REQUIRE(sector_data[m] == i + m);
+            }
+        }
+    }
+
+    CHECK(ops_per_gb[1] * 2 < ops_per_gb[0]);
+    delete[] sector_data;
+}
+
+// Passes operations to a partition until the power is lost, then fails all of them
+class Power_Loss_Flash : public Partition
+{
+public:
+    Power_Loss_Flash(const esp_partition_t *partition) : Partition(partition)
+    {
+    }
+
+    esp_err_t erase_range(size_t start_address, size_t size) override
+    {
+        if (!power_on()) {
+            return ESP_FAIL;
+        }
+        return Partition::erase_range(start_address, size);
+    }
+
+    esp_err_t write(size_t dest_addr, const void *src, size_t size) override
+    {
+        if (!power_on()) {
+            return ESP_FAIL;
+        }
+        return Partition::write(dest_addr, src, size);
+    }
+
+    esp_err_t read(size_t src_addr, void *dest, size_t size) override
+    {
+        if (!power_on()) {
+            return ESP_FAIL;
+        }
+        return Partition::read(src_addr, dest, size);
+    }
+
+    bool power_on()
+    {
+        if (ops_left == 0) {
+            return false;
+        }
+        if (ops_left > 0) {
+            ops_left--;
+        }
+        return true;
+    }
+
+    int32_t ops_left = -1; // operations done before the power is lost, -1 for no power loss
+};
+
+TEST_CASE("power loss during deferred block moves keeps data", "[wear_levelling]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    wl_config_t cfg;
+    cfg.full_mem_size = 16 * SPI_FLASH_SEC_SIZE;
+    cfg.start_addr = 0;
+    cfg.version = 2;
+    cfg.sector_size = SPI_FLASH_SEC_SIZE;
+    cfg.page_size = SPI_FLASH_SEC_SIZE;
+    cfg.updaterate = 1;
+    cfg.temp_buff_size = 32;
+    cfg.wr_size = 16;
+
+    const size_t sector_size = SPI_FLASH_SEC_SIZE;
+    const size_t max_pending_moves = 64;
+    uint32_t *sector_data = new uint32_t[sector_size / sizeof(uint32_t)];
+
+    bool moves_done = false;
+    for (int32_t power_loss_at = 0; !moves_done; power_loss_at++) {
+        REQUIRE(esp_partition_erase_range(partition, 0, cfg.full_mem_size) == ESP_OK);
+        Power_Loss_Flash flash(partition);
+        size_t sectors_count;
+        {
+            // Every erase makes a block move due, so the moves pass the end of the state records
+            WL_Flash wl_flash(0, max_pending_moves);
+            REQUIRE(wl_flash.config(&cfg, &flash) == ESP_OK);
+            REQUIRE(wl_flash.init() == ESP_OK);
+            sectors_count = wl_flash.chip_size() / sector_size;
+            for (size_t i = 0; i < sectors_count * 3; i++) {
+                size_t sector = i % sectors_count;
+                REQUIRE(wl_flash.erase_sector(sector) == ESP_OK);
+                for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                    sector_data[m] = i + m;
+                }
+                REQUIRE(wl_flash.write(sector * sector_size, sector_data, sector_size) == ESP_OK);
+            }
+            flash.ops_left = power_loss_at;
+            moves_done = (wl_flash.maintenance() == ESP_OK);
+            flash.ops_left = -1;
+        }
+
+        // Data survives the power loss and the state recovered after it
+        for (int boot = 0; boot < 2; boot++) {
+            WL_Flash wl_check;
+            REQUIRE(wl_check.config(&cfg, &flash) == ESP_OK);
+            REQUIRE(wl_check.init() == ESP_OK);
+            for (size_t sector = 0; sector < sectors_count; sector++) {
+                size_t i = sectors_count * 2 + sector;
+                REQUIRE(wl_check.read(sector * sector_size, sector_data, sector_size) == ESP_OK);
+                for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                    REQUIRE(sector_data[m] == i + m);
+                }
+            }
+        }
+    }
+    delete[] sector_data;
+}
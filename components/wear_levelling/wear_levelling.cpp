@@ -249,6 +249,45 @@ size_t wl_sector_size(wl_handle_t handle)
     return result;
 }
 
+esp_err_t wl_sync(wl_handle_t handle)
+{
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    result = s_instances[handle].instance->sync();
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
+esp_err_t wl_maintenance(wl_handle_t handle)
+{
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    result = s_instances[handle].instance->maintenance();
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
+esp_err_t wl_get_cache_stats(wl_handle_t handle, wl_cache_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    s_instances[handle].instance->get_cache_stats(stats);
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
 static esp_err_t check_handle(wl_handle_t handle, const char *func)
 {
     if (handle == WL_INVALID_HANDLE) {